@@ -0,0 +1,208 @@
+/*
+    This file is part of TON Blockchain Library.
+
+    TON Blockchain Library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    TON Blockchain Library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with TON Blockchain Library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "block/account-storage-stat.h"
+#include "vm/cellslice.h"
+#include "td/utils/crypto.h"
+
+#include <map>
+#include <mutex>
+
+namespace block {
+
+td::Status AccountStorageStat::replace_roots(std::vector<Ref<vm::Cell>> new_roots, td::uint64 max_added_cells,
+                                             td::uint64 max_added_bits) {
+  if (same_roots(new_roots)) {
+    return td::Status::OK();
+  }
+  added_cells_ = added_bits_ = 0;
+  max_added_cells_ = max_added_cells;
+  max_added_bits_ = max_added_bits;
+  // new roots are added first, so cells kept from the old trees only get their counters incremented
+  for (auto& root : new_roots) {
+    if (root.not_null() && !add_cell(root)) {
+      return td::Status::Error("account storage is too big");
+    }
+  }
+  for (auto& root : roots_) {
+    if (root.not_null()) {
+      remove_cell(root);
+    }
+  }
+  roots_ = std::move(new_roots);
+  return td::Status::OK();
+}
+
+bool AccountStorageStat::same_roots(const std::vector<Ref<vm::Cell>>& roots) const {
+  if (roots.size() != roots_.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < roots.size(); i++) {
+    if (roots[i].is_null() != roots_[i].is_null()) {
+      return false;
+    }
+    if (roots[i].not_null() && roots[i]->get_hash() != roots_[i]->get_hash()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool AccountStorageStat::add_cell(const Ref<vm::Cell>& cell) {
+  auto hash = cell->get_hash();
+  auto it = cells_.find(hash);
+  if (it != cells_.end()) {
+    it->second.refcnt++;
+    return true;
+  }
+  vm::CellSlice cs{vm::NoVm{}, cell};
+  Entry entry;
+  entry.refcnt = 1;
+  entry.bits = cs.size();
+  // the map may rehash during the recursion below, so the entry is not referenced after this
+  cells_.emplace(hash, entry);
+  total_cells_++;
+  total_bits_ += entry.bits;
+  if (++added_cells_ > max_added_cells_ || (added_bits_ += entry.bits) > max_added_bits_) {
+    return false;
+  }
+  for (unsigned i = 0; i < cs.size_refs(); i++) {
+    if (!add_cell(cs.prefetch_ref(i))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void AccountStorageStat::remove_cell(const Ref<vm::Cell>& cell) {
+  auto it = cells_.find(cell->get_hash());
+  CHECK(it != cells_.end());
+  if (--it->second.refcnt > 0) {
+    return;
+  }
+  total_cells_--;
+  total_bits_ -= it->second.bits;
+  cells_.erase(it);
+  vm::CellSlice cs{vm::NoVm{}, cell};
+  for (unsigned i = 0; i < cs.size_refs(); i++) {
+    remove_cell(cs.prefetch_ref(i));
+  }
+}
+
+vm::CellStorageStat AccountStorageStat::stat_with(Ref<vm::Cell> root) const {
+  vm::CellStorageStat stat;
+  if (root.not_null()) {
+    add_untracked(root, stat);
+  }
+  stat.clear_seen();
+  stat.cells += total_cells_;
+  stat.bits += total_bits_;
+  return stat;
+}
+
+void AccountStorageStat::add_untracked(const Ref<vm::Cell>& cell, vm::CellStorageStat& stat) const {
+  auto hash = cell->get_hash();
+  if (cells_.count(hash) || !stat.seen.insert(hash).second) {
+    return;
+  }
+  vm::CellSlice cs{vm::NoVm{}, cell};
+  stat.cells++;
+  stat.bits += cs.size();
+  for (unsigned i = 0; i < cs.size_refs(); i++) {
+    add_untracked(cs.prefetch_ref(i), stat);
+  }
+}
+
+namespace {
+
+// about 100 bytes of memory per cached cell
+constexpr td::uint64 max_cached_cells = 1 << 21;
+
+td::Bits256 roots_key(const std::vector<Ref<vm::Cell>>& roots) {
+  std::string buf;
+  for (auto& root : roots) {
+    buf += root.is_null() ? std::string(32, '\0') : root->get_hash().as_slice().str();
+  }
+  td::Bits256 key;
+  td::sha256(buf, key.as_slice());
+  return key;
+}
+
+struct StatCache {
+  struct Entry {
+    std::unique_ptr<AccountStorageStat> stat;
+    td::uint64 seqno;
+  };
+  std::mutex mutex;
+  std::map<td::Bits256, Entry> entries;
+  td::uint64 total_cells{0};
+  td::uint64 seqno{0};
+
+  static StatCache& get() {
+    static StatCache cache;
+    return cache;
+  }
+};
+
+}  // namespace
+
+std::unique_ptr<AccountStorageStat> AccountStorageStat::take_cached(const std::vector<Ref<vm::Cell>>& roots) {
+  auto key = roots_key(roots);
+  auto& cache = StatCache::get();
+  std::lock_guard<std::mutex> lock(cache.mutex);
+  auto it = cache.entries.find(key);
+  if (it == cache.entries.end()) {
+    return nullptr;
+  }
+  auto stat = std::move(it->second.stat);
+  cache.total_cells -= stat->cells_.size();
+  cache.entries.erase(it);
+  stat->roots_ = roots;
+  return stat;
+}
+
+void AccountStorageStat::put_cached(std::unique_ptr<AccountStorageStat> stat) {
+  if (!stat || stat->cells_.size() < min_tracked_cells() || stat->cells_.size() > max_cached_cells) {
+    return;
+  }
+  auto key = roots_key(stat->roots_);
+  // the key identifies the roots, so cached objects don't keep the trees loaded in memory
+  stat->roots_.clear();
+  auto& cache = StatCache::get();
+  std::vector<std::unique_ptr<AccountStorageStat>> evicted;  // destroyed outside of the lock
+  std::lock_guard<std::mutex> lock(cache.mutex);
+  auto& entry = cache.entries[key];
+  if (entry.stat) {
+    cache.total_cells -= entry.stat->cells_.size();
+    evicted.push_back(std::move(entry.stat));
+  }
+  cache.total_cells += stat->cells_.size();
+  entry.stat = std::move(stat);
+  entry.seqno = ++cache.seqno;
+  while (cache.total_cells > max_cached_cells) {
+    auto oldest = cache.entries.begin();
+    for (auto it = cache.entries.begin(); it != cache.entries.end(); ++it) {
+      if (it->second.seqno < oldest->second.seqno) {
+        oldest = it;
+      }
+    }
+    cache.total_cells -= oldest->second.stat->cells_.size();
+    evicted.push_back(std::move(oldest->second.stat));
+    cache.entries.erase(oldest);
+  }
+}
+
+}  // namespace block
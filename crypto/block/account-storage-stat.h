@@ -0,0 +1,87 @@
+/*
+    This file is part of TON Blockchain Library.
+
+    TON Blockchain Library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    TON Blockchain Library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with TON Blockchain Library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+#include "vm/cells.h"
+#include "vm/boc.h"
+#include "td/utils/HashMap.h"
+#include "td/utils/Status.h"
+
+#include <limits>
+#include <memory>
+#include <vector>
+
+namespace block {
+using td::Ref;
+
+// Unique cells and bits of several cell trees (code, data and library of an account), the same
+// numbers vm::CellStorageStat counts, kept up to date when the roots change.
+// Every tracked cell keeps the number of references to it from tracked cells and from the roots,
+// so replace_roots() only visits cells that appear or disappear: subtrees present both before and
+// after are skipped by hash, and the work is proportional to the change, not to the state size.
+class AccountStorageStat {
+ public:
+  AccountStorageStat() = default;
+  AccountStorageStat(const AccountStorageStat& other) = delete;
+  AccountStorageStat& operator=(const AccountStorageStat& other) = delete;
+
+  // Fails if more than max_added_cells cells or max_added_bits bits are added before the old roots
+  // are released; the new trees alone are then bigger than that. After a failure the object is
+  // inconsistent and must be discarded.
+  td::Status replace_roots(std::vector<Ref<vm::Cell>> new_roots,
+                           td::uint64 max_added_cells = std::numeric_limits<td::uint64>::max(),
+                           td::uint64 max_added_bits = std::numeric_limits<td::uint64>::max());
+  bool same_roots(const std::vector<Ref<vm::Cell>>& roots) const;
+  const std::vector<Ref<vm::Cell>>& get_roots() const {
+    return roots_;
+  }
+  td::uint64 get_total_cells() const {
+    return total_cells_;
+  }
+  td::uint64 get_total_bits() const {
+    return total_bits_;
+  }
+  // statistics of the tracked trees together with the tree of `root`
+  vm::CellStorageStat stat_with(Ref<vm::Cell> root) const;
+
+  // accounts with fewer cells are cheap to recount and are not tracked
+  static constexpr td::uint64 min_tracked_cells() {
+    return 1024;
+  }
+  // Objects are kept between transactions and blocks in a bounded process-wide cache, keyed by roots
+  static std::unique_ptr<AccountStorageStat> take_cached(const std::vector<Ref<vm::Cell>>& roots);
+  static void put_cached(std::unique_ptr<AccountStorageStat> stat);
+
+ private:
+  struct Entry {
+    td::uint32 refcnt{0};
+    td::uint32 bits{0};
+  };
+  td::HashMap<vm::CellHash, Entry> cells_;
+  std::vector<Ref<vm::Cell>> roots_;
+  td::uint64 total_cells_{0};
+  td::uint64 total_bits_{0};
+  td::uint64 added_cells_{0};
+  td::uint64 added_bits_{0};
+  td::uint64 max_added_cells_{0};
+  td::uint64 max_added_bits_{0};
+
+  bool add_cell(const Ref<vm::Cell>& cell);
+  void remove_cell(const Ref<vm::Cell>& cell);
+  void add_untracked(const Ref<vm::Cell>& cell, vm::CellStorageStat& stat) const;
+};
+
+}  // namespace block
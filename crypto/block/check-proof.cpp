@@ -158,6 +158,42 @@ td::Status check_shard_proof(ton::BlockIdExt blk, ton::BlockIdExt shard_blk, td:
   return td::Status::OK();
 }
 
+td::Status check_new_shard_blocks_proof(ton::BlockIdExt mc_blk, const std::vector<ton::BlockIdExt>& shard_blocks,
+                                        td::Slice proof) {
+  if (!mc_blk.is_masterchain() || !mc_blk.is_valid_full()) {
+    return td::Status::Error(PSLICE() << "block " << mc_blk.to_str() << " must be a masterchain block");
+  }
+  TRY_RESULT_PREFIX(P_roots, vm::std_boc_deserialize_multi(proof), "cannot deserialize shard configuration proof");
+  if (P_roots.size() != 2) {
+    return td::Status::Error("shard configuration proof must have exactly two roots");
+  }
+  try {
+    auto mc_state_root = vm::MerkleProof::virtualize(std::move(P_roots[1]), 1);
+    if (mc_state_root.is_null()) {
+      return td::Status::Error("shard configuration proof is invalid");
+    }
+    ton::Bits256 mc_state_hash = mc_state_root->get_hash().bits();
+    TRY_STATUS_PREFIX(
+        check_block_header_proof(vm::MerkleProof::virtualize(std::move(P_roots[0]), 1), mc_blk, &mc_state_hash, true),
+        "error in masterchain block header proof :");
+    auto shards_dict = block::ShardConfig::extract_shard_hashes_dict(std::move(mc_state_root));
+    block::ShardConfig sh_conf;
+    if (!shards_dict || !sh_conf.unpack(shards_dict->get_root_cell())) {
+      return td::Status::Error("cannot extract shard configuration dictionary from proof");
+    }
+    if (sh_conf.get_shard_blocks_registered_at(mc_blk.seqno()) != shard_blocks) {
+      return td::Status::Error(PSLICE() << "list of new shard blocks does not match shard configuration of "
+                                        << mc_blk.to_str());
+    }
+  } catch (vm::VmError err) {
+    return td::Status::Error(PSLICE() << "error while traversing shard configuration proof : " << err.get_msg());
+  } catch (vm::VmVirtError err) {
+    return td::Status::Error(PSLICE() << "virtualization error while traversing shard configuration proof : "
+                                      << err.get_msg());
+  }
+  return td::Status::OK();
+}
+
 td::Status check_account_proof(td::Slice proof, ton::BlockIdExt shard_blk, const block::StdAddress& addr,
                                td::Ref<vm::Cell> root, ton::LogicalTime* last_trans_lt, ton::Bits256* last_trans_hash,
                                td::uint32* save_utime, ton::LogicalTime* save_lt) {
@@ -256,6 +292,100 @@ td::Result<AccountState::Info> AccountState::validate(ton::BlockIdExt ref_blk, b
   return res;
 }
 
+td::Result<std::vector<AccountState::Info>> AccountStateList::validate(
+    ton::BlockIdExt ref_blk, ton::WorkchainId workchain, const std::vector<ton::StdSmcAddress>& addrs) const {
+  std::vector<Ref<vm::Cell>> roots;
+  if (!states.empty()) {
+    TRY_RESULT_PREFIX_ASSIGN(roots, vm::std_boc_deserialize_multi(states.as_slice()),
+                             "cannot deserialize account states");
+  }
+  if (blk != ref_blk && ref_blk.id.seqno != ~0U) {
+    return td::Status::Error(PSLICE() << "obtained getAccountStates() for a different reference block "
+                                      << blk.to_str() << " instead of requested " << ref_blk.to_str());
+  }
+  if (!shard_blk.is_valid_full()) {
+    return td::Status::Error(PSLICE() << "shard block id " << shard_blk.to_str() << " in answer is invalid");
+  }
+  if (count == 0 || count > addrs.size()) {
+    return td::Status::Error(PSLICE() << "answer contains " << count << " account states, but " << addrs.size()
+                                      << " were requested");
+  }
+  auto answered = td::span(addrs).substr(0, count);
+  for (const auto& addr : addrs) {
+    if (!ton::shard_contains(shard_blk.shard_full(), ton::extract_addr_prefix(workchain, addr))) {
+      return td::Status::Error(PSLICE() << "received data from shard block " << shard_blk.to_str()
+                                        << " that cannot contain requested account " << workchain << ":"
+                                        << addr.to_hex());
+    }
+  }
+
+  TRY_STATUS(block::check_shard_proof(blk, shard_blk, shard_proof.as_slice()));
+
+  TRY_RESULT_PREFIX(Q_roots, vm::std_boc_deserialize_multi(proof.as_slice()), "cannot deserialize account proof");
+  if (Q_roots.size() != 2) {
+    return td::Status::Error(PSLICE() << "account state proof must have exactly two roots");
+  }
+  std::vector<AccountState::Info> res;
+  res.reserve(answered.size());
+  try {
+    auto state_root = vm::MerkleProof::virtualize(std::move(Q_roots[1]), 1);
+    if (state_root.is_null()) {
+      return td::Status::Error("account state proof is invalid");
+    }
+    ton::Bits256 state_hash = state_root->get_hash().bits();
+    td::uint32 gen_utime;
+    ton::LogicalTime gen_lt;
+    TRY_STATUS_PREFIX(check_block_header_proof(vm::MerkleProof::virtualize(std::move(Q_roots[0]), 1), shard_blk,
+                                               &state_hash, true, &gen_utime, &gen_lt),
+                      "error in account shard block header proof : ");
+    block::gen::ShardStateUnsplit::Record sstate;
+    if (!(tlb::unpack_cell(std::move(state_root), sstate))) {
+      return td::Status::Error("cannot unpack state header");
+    }
+    vm::AugmentedDictionary accounts_dict{vm::load_cell_slice(sstate.accounts).prefetch_ref(), 256,
+                                          block::tlb::aug_ShardAccounts};
+    std::size_t next_root = 0;
+    for (const auto& addr : answered) {
+      AccountState::Info info;
+      info.gen_utime = gen_utime;
+      info.gen_lt = gen_lt;
+      info.last_trans_hash.set_zero();
+      auto acc_csr = accounts_dict.lookup(addr);
+      if (acc_csr.not_null()) {
+        if (next_root >= roots.size()) {
+          return td::Status::Error(PSLICE() << "account state proof shows that account state for " << workchain << ":"
+                                            << addr.to_hex() << " must be non-empty, but it actually is empty");
+        }
+        block::gen::ShardAccount::Record acc_info;
+        if (!tlb::csr_unpack(std::move(acc_csr), acc_info)) {
+          return td::Status::Error("cannot unpack ShardAccount from proof");
+        }
+        auto& root = roots[next_root++];
+        if (acc_info.account->get_hash().bits().compare(root->get_hash().bits(), 256)) {
+          return td::Status::Error(PSLICE() << "account state hash mismatch for " << workchain << ":"
+                                            << addr.to_hex() << ": Merkle proof expects "
+                                            << acc_info.account->get_hash().bits().to_hex(256)
+                                            << " but received data has " << root->get_hash().bits().to_hex(256));
+        }
+        info.last_trans_hash = acc_info.last_trans_hash;
+        info.last_trans_lt = acc_info.last_trans_lt;
+        info.root = info.true_root = root;
+      }
+      res.push_back(std::move(info));
+    }
+    if (next_root != roots.size()) {
+      return td::Status::Error(PSLICE() << "received " << roots.size()
+                                        << " account states, but the proof contains only " << next_root
+                                        << " non-empty accounts");
+    }
+  } catch (vm::VmError err) {
+    return td::Status::Error(PSLICE() << "error while traversing account proof : " << err.get_msg());
+  } catch (vm::VmVirtError err) {
+    return td::Status::Error(PSLICE() << "virtualization error while traversing account proof : " << err.get_msg());
+  }
+  return std::move(res);
+}
+
 td::Result<Transaction::Info> Transaction::validate() {
   if (root.is_null()) {
     return td::Status::Error("transactions are expected to be non-empty");
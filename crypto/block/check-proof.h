@@ -28,6 +28,8 @@ td::Status check_block_header_proof(td::Ref<vm::Cell> root, ton::BlockIdExt blki
                                     ton::Bits256* store_state_hash_to = nullptr, bool check_state_hash = false,
                                     td::uint32* save_utime = nullptr, ton::LogicalTime* save_lt = nullptr);
 td::Status check_shard_proof(ton::BlockIdExt blk, ton::BlockIdExt shard_blk, td::Slice shard_proof);
+td::Status check_new_shard_blocks_proof(ton::BlockIdExt mc_blk, const std::vector<ton::BlockIdExt>& shard_blocks,
+                                        td::Slice proof);
 td::Status check_account_proof(td::Slice proof, ton::BlockIdExt shard_blk, const block::StdAddress& addr,
                                td::Ref<vm::Cell> root, ton::LogicalTime* last_trans_lt = nullptr,
                                ton::Bits256* last_trans_hash = nullptr, td::uint32* save_utime = nullptr,
@@ -57,6 +59,20 @@ struct AccountState {
   td::Result<Info> validate(ton::BlockIdExt ref_blk, block::StdAddress addr) const;
 };
 
+struct AccountStateList {
+  ton::BlockIdExt blk;
+  ton::BlockIdExt shard_blk;
+  td::BufferSlice shard_proof;
+  td::BufferSlice proof;
+  td::BufferSlice states;
+  // the server answers only the first `count` requested accounts if their states are too large
+  td::uint32 count;
+
+  // returns the states of the first `count` accounts of `addrs`
+  td::Result<std::vector<AccountState::Info>> validate(ton::BlockIdExt ref_blk, ton::WorkchainId workchain,
+                                                       const std::vector<ton::StdSmcAddress>& addrs) const;
+};
+
 struct Transaction {
   ton::BlockIdExt blkid;
   ton::LogicalTime lt;
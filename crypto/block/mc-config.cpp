@@ -38,6 +38,7 @@
 #include "openssl/digest.hpp"
 #include <stack>
 #include <algorithm>
+#include <mutex>
 
 namespace block {
 using namespace std::literals::string_literals;
@@ -706,6 +707,88 @@ td::Result<MsgPrices> Config::get_msg_prices(bool is_masterchain) const {
   return MsgPrices(rec.lump_price, rec.bit_price, rec.cell_price, rec.ihr_price_factor, rec.first_frac, rec.next_frac);
 }
 
+namespace {
+
+// the configuration changes rarely, a few entries cover the states still in use
+constexpr size_t max_parsed_configs = 8;
+
+struct ParsedConfigCache {
+  struct Entry {
+    Ref<ParsedConfig> parsed;
+    td::uint64 seqno;
+  };
+  std::mutex mutex;
+  std::map<td::Bits256, Entry> entries;
+  td::uint64 seqno{0};
+
+  static ParsedConfigCache& get() {
+    static ParsedConfigCache cache;
+    return cache;
+  }
+};
+
+}  // namespace
+
+td::Result<Ref<ParsedConfig>> ParsedConfig::unpack(const Config& config) {
+  Ref<ParsedConfig> res{true};
+  auto& parsed = res.unique_write();
+  parsed.config_root = config.get_root_cell();
+  TRY_RESULT_ASSIGN(parsed.storage_prices, config.get_storage_prices());
+  TRY_RESULT_ASSIGN(parsed.gas_mc, config.get_gas_limits_prices(true));
+  TRY_RESULT_ASSIGN(parsed.gas_std, config.get_gas_limits_prices(false));
+  TRY_RESULT_ASSIGN(parsed.fwd_mc, config.get_msg_prices(true));
+  TRY_RESULT_ASSIGN(parsed.fwd_std, config.get_msg_prices(false));
+  auto cell = config.get_config_param(14);
+  if (cell.is_null()) {
+    parsed.basechain_create_fee = parsed.masterchain_create_fee = td::zero_refint();
+  } else {
+    block::gen::BlockCreateFees::Record create_fees;
+    if (!(tlb::unpack_cell(cell, create_fees) &&
+          block::tlb::t_Grams.as_integer_to(create_fees.masterchain_block_fee, parsed.masterchain_create_fee) &&
+          block::tlb::t_Grams.as_integer_to(create_fees.basechain_block_fee, parsed.basechain_create_fee))) {
+      return td::Status::Error(-668, "cannot unpack BlockCreateFees from configuration parameter #14");
+    }
+  }
+  TRY_RESULT_ASSIGN(parsed.size_limits, config.get_size_limits_config());
+  TRY_RESULT_ASSIGN(parsed.workchains, Config::unpack_workchain_list(config.get_config_param(12)));
+  return std::move(res);
+}
+
+td::Result<Ref<ParsedConfig>> Config::get_parsed_config() const {
+  if (parsed_.not_null()) {
+    return parsed_;
+  }
+  if (config_root.is_null()) {
+    return td::Status::Error("configuration root not set");
+  }
+  td::Bits256 key = config_root->get_hash().bits();
+  auto& cache = ParsedConfigCache::get();
+  {
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    auto it = cache.entries.find(key);
+    if (it != cache.entries.end()) {
+      it->second.seqno = ++cache.seqno;
+      parsed_ = it->second.parsed;
+      return parsed_;
+    }
+  }
+  // unpacked outside of the lock; if several threads miss at once, the last one stays in the cache
+  TRY_RESULT(parsed, ParsedConfig::unpack(*this));
+  std::lock_guard<std::mutex> lock(cache.mutex);
+  cache.entries[key] = ParsedConfigCache::Entry{parsed, ++cache.seqno};
+  if (cache.entries.size() > max_parsed_configs) {
+    auto oldest = cache.entries.begin();
+    for (auto it = cache.entries.begin(); it != cache.entries.end(); ++it) {
+      if (it->second.seqno < oldest->second.seqno) {
+        oldest = it;
+      }
+    }
+    cache.entries.erase(oldest);
+  }
+  parsed_ = std::move(parsed);
+  return parsed_;
+}
+
 CatchainValidatorsConfig Config::unpack_catchain_validators_config(Ref<vm::Cell> cell) {
   if (cell.not_null()) {
     block::gen::CatchainConfig::Record_catchain_config cfg;
@@ -1328,6 +1411,18 @@ std::vector<ton::BlockId> ShardConfig::get_proper_neighbor_shard_hash_ids(ton::S
   });
 }
 
+// top shardchain blocks first registered in the shard configuration of masterchain block mc_seqno
+std::vector<ton::BlockIdExt> ShardConfig::get_shard_blocks_registered_at(ton::BlockSeqno mc_seqno) const {
+  std::vector<ton::BlockIdExt> res;
+  for (const auto& id : get_shard_hash_ids(true)) {
+    auto ref = get_shard_hash(ton::ShardIdFull(id));
+    if (ref.not_null() && ref->reg_mc_seqno_ == mc_seqno) {
+      res.push_back(ref->top_block_id());
+    }
+  }
+  return res;
+}
+
 bool ShardConfig::is_neighbor(ton::ShardIdFull x, ton::ShardIdFull y) {
   if (x.is_masterchain() || y.is_masterchain()) {
     return true;
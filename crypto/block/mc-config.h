@@ -437,6 +437,31 @@ struct WorkchainInfo : public td::CntObject {
 
 using WorkchainSet = std::map<td::int32, Ref<WorkchainInfo>>;
 
+class Config;
+
+// Prices and limits needed by every block and transaction, unpacked from the configuration once.
+// Objects are immutable and shared through a small process-wide cache keyed by the configuration
+// root hash, so collators, validators and external message checks referring to the same
+// masterchain configuration do not unpack these parameters again.
+struct ParsedConfig : public td::CntObject {
+  Ref<vm::Cell> config_root;
+  std::vector<StoragePrices> storage_prices;  // #18
+  GasLimitsPrices gas_mc, gas_std;            // #20, #21
+  MsgPrices fwd_mc, fwd_std;                  // #24, #25
+  td::RefInt256 masterchain_create_fee;       // #14
+  td::RefInt256 basechain_create_fee;         // #14
+  SizeLimitsConfig size_limits;               // #43
+  WorkchainSet workchains;                    // #12
+  const GasLimitsPrices& get_gas_limits_prices(bool is_masterchain) const {
+    return is_masterchain ? gas_mc : gas_std;
+  }
+  const MsgPrices& get_msg_prices(bool is_masterchain) const {
+    return is_masterchain ? fwd_mc : fwd_std;
+  }
+  // unpacks without the cache, use Config::get_parsed_config() instead
+  static td::Result<Ref<ParsedConfig>> unpack(const Config& config);
+};
+
 class ShardConfig {
   Ref<vm::Cell> shard_hashes_;
   Ref<McShardHash> mc_shard_hash_;
@@ -472,6 +497,7 @@ class ShardConfig {
   std::vector<ton::BlockId> get_intersecting_shard_hash_ids(ton::ShardIdFull myself) const;
   std::vector<ton::BlockId> get_neighbor_shard_hash_ids(ton::ShardIdFull myself) const;
   std::vector<ton::BlockId> get_proper_neighbor_shard_hash_ids(ton::ShardIdFull myself) const;
+  std::vector<ton::BlockIdExt> get_shard_blocks_registered_at(ton::BlockSeqno mc_seqno) const;
   static std::unique_ptr<vm::Dictionary> extract_shard_hashes_dict(Ref<vm::Cell> mc_state_root);
   bool process_shard_hashes(std::function<int(McShardHash&)> func);
   bool process_sibling_shard_hashes(std::function<int(McShardHash&, const McShardHash*)> func);
@@ -526,6 +552,7 @@ class Config {
   WorkchainSet workchains_;
   int version_{-1};
   long long capabilities_{-1};
+  mutable Ref<ParsedConfig> parsed_;
 
  protected:
   std::unique_ptr<vm::Dictionary> special_smc_dict;
@@ -590,6 +617,8 @@ class Config {
   td::Result<GasLimitsPrices> get_gas_limits_prices(bool is_masterchain = false) const;
   static td::Result<GasLimitsPrices> do_get_gas_limits_prices(td::Ref<vm::Cell> cell, int id);
   td::Result<MsgPrices> get_msg_prices(bool is_masterchain = false) const;
+  // shared object with the parameters above; references into it stay valid while this Config is alive
+  td::Result<Ref<ParsedConfig>> get_parsed_config() const;
   static CatchainValidatorsConfig unpack_catchain_validators_config(Ref<vm::Cell> cell);
   CatchainValidatorsConfig get_catchain_validators_config() const;
   td::Status visit_validator_params() const;
@@ -31,16 +31,10 @@ bool OutputQueueMerger::MsgKeyValue::operator<(const MsgKeyValue& other) const {
          (lt == other.lt && td::bitstring::bits_memcmp(key.cbits() + 96, other.key.cbits() + 96, 256) < 0);
 }
 
-bool OutputQueueMerger::MsgKeyValue::less(const std::unique_ptr<MsgKeyValue>& he1,
-                                          const std::unique_ptr<MsgKeyValue>& he2) {
+bool OutputQueueMerger::MsgKeyValue::less(const MsgKeyValue* he1, const MsgKeyValue* he2) {
   return *he1 < *he2;
 }
 
-bool OutputQueueMerger::MsgKeyValue::greater(const std::unique_ptr<MsgKeyValue>& he1,
-                                             const std::unique_ptr<MsgKeyValue>& he2) {
-  return *he2 < *he1;
-}
-
 OutputQueueMerger::MsgKeyValue::MsgKeyValue(td::ConstBitPtr key_pfx, int key_pfx_len, int _src, Ref<vm::Cell> node)
     : source(_src) {
   unpack_node(key_pfx, key_pfx_len, std::move(node));
@@ -57,18 +51,6 @@ bool OutputQueueMerger::MsgKeyValue::invalidate() {
   return false;
 }
 
-ton::LogicalTime OutputQueueMerger::MsgKeyValue::get_node_lt(Ref<vm::Cell> node, int key_pfx_len) {
-  if (node.is_null() || (unsigned)key_pfx_len > (unsigned)max_key_len) {
-    return std::numeric_limits<td::uint64>::max();
-  }
-  vm::dict::LabelParser label{std::move(node), max_key_len - key_pfx_len, vm::dict::LabelParser::chk_size};
-  if (!label.is_valid()) {
-    return std::numeric_limits<td::uint64>::max();
-  }
-  label.skip_label();
-  return label.remainder->prefetch_ulong(64);
-}
-
 bool OutputQueueMerger::MsgKeyValue::unpack_node(td::ConstBitPtr key_pfx, int key_pfx_len, Ref<vm::Cell> node) {
   if (node.is_null() || (unsigned)key_pfx_len >= (unsigned)max_key_len) {
     return invalidate();
@@ -117,17 +99,20 @@ bool OutputQueueMerger::MsgKeyValue::split(MsgKeyValue& second) {
     return false;
   }
   unsigned long long keep_lt = lt;
-  unsigned long long left_lt = get_node_lt(msg->prefetch_ref(0), key_len + 1);
-  bool sw = (left_lt == lt);
+  auto fork = std::move(msg);
   second.source = source;
-  key[key_len] = sw;
-  if (!second.unpack_node(key.cbits(), key_len + 1, msg->prefetch_ref(sw))) {
+  key[key_len] = true;
+  if (!second.unpack_node(key.cbits(), key_len + 1, fork->prefetch_ref(1))) {
     return false;
   }
-  key[key_len] = 1 - sw;
-  if (!unpack_node(td::ConstBitPtr{nullptr}, key_len + 1, msg->prefetch_ref(1 - sw))) {
+  key[key_len] = false;
+  if (!unpack_node(td::ConstBitPtr{nullptr}, key_len + 1, fork->prefetch_ref(0))) {
     return false;
   }
+  // this node continues with the child containing the least lt (the left one if both do)
+  if (lt != keep_lt) {
+    std::swap(*this, second);
+  }
   if (lt != keep_lt || second.lt < keep_lt) {
     return false;
   }
@@ -139,25 +124,29 @@ bool OutputQueueMerger::add_root(int src, Ref<vm::Cell> outmsg_root) {
     return true;
   }
   //block::gen::HashmapAug{352, block::gen::t_EnqueuedMsg, block::gen::t_uint64}.print_ref(std::cerr, outmsg_root);
-  auto kv = std::make_unique<MsgKeyValue>(src, std::move(outmsg_root));
-  if (kv->replace_by_prefix(common_pfx.cbits(), common_pfx_len)) {
-    heap.push_back(std::move(kv));
+  auto kv = alloc_node();
+  if (kv->unpack_node(td::ConstBitPtr{nullptr}, 0, std::move(outmsg_root)) &&
+      kv->replace_by_prefix(common_pfx.cbits(), common_pfx_len)) {
+    kv->source = src;
+    heap.push_back(HeapEntry{kv->lt, kv});
+  } else {
+    free_node(kv);
   }
   return true;
 }
 
-OutputQueueMerger::OutputQueueMerger(ton::ShardIdFull _queue_for, std::vector<block::McShardDescr> _neighbors)
-    : queue_for(_queue_for), neighbors(std::move(_neighbors)), eof(false), failed(false) {
-  init();
+OutputQueueMerger::OutputQueueMerger(ton::ShardIdFull _queue_for, const std::vector<block::McShardDescr>& neighbors)
+    : queue_for(_queue_for), eof(false), failed(false) {
+  init(neighbors);
 }
 
-void OutputQueueMerger::init() {
+void OutputQueueMerger::init(const std::vector<block::McShardDescr>& neighbors) {
   common_pfx.bits().store_int(queue_for.workchain, 32);
   int l = queue_for.pfx_len();
   td::bitstring::bits_store_long_top(common_pfx.bits() + 32, queue_for.shard, l);
   common_pfx_len = 32 + l;
   int i = 0;
-  for (block::McShardDescr& neighbor : neighbors) {
+  for (const block::McShardDescr& neighbor : neighbors) {
     if (!neighbor.is_disabled()) {
       LOG(DEBUG) << "adding " << (neighbor.outmsg_root.is_null() ? "" : "non-") << "empty output queue for neighbor #"
                  << i << " (" << neighbor.blk_.to_str() << ")";
@@ -167,7 +156,7 @@ void OutputQueueMerger::init() {
       i++;
     }
   }
-  std::make_heap(heap.begin(), heap.end(), MsgKeyValue::greater);
+  std::make_heap(heap.begin(), heap.end(), HeapEntry::greater);
   eof = heap.empty();
   if (!eof) {
     load();
@@ -175,11 +164,11 @@ void OutputQueueMerger::init() {
 }
 
 OutputQueueMerger::MsgKeyValue* OutputQueueMerger::cur() {
-  return eof ? nullptr : msg_list.at(pos).get();
+  return eof ? nullptr : msg_list.at(pos);
 }
 
 std::unique_ptr<OutputQueueMerger::MsgKeyValue> OutputQueueMerger::extract_cur() {
-  return eof ? std::unique_ptr<MsgKeyValue>{} : std::move(msg_list.at(pos));
+  return eof ? std::unique_ptr<MsgKeyValue>{} : std::make_unique<MsgKeyValue>(std::move(*msg_list.at(pos)));
 }
 
 bool OutputQueueMerger::next() {
@@ -193,28 +182,52 @@ bool OutputQueueMerger::next() {
   }
 }
 
+OutputQueueMerger::MsgKeyValue* OutputQueueMerger::alloc_node() {
+  if (free_nodes.empty()) {
+    nodes.emplace_back();
+    return &nodes.back();
+  }
+  auto kv = free_nodes.back();
+  free_nodes.pop_back();
+  return kv;
+}
+
+void OutputQueueMerger::free_node(MsgKeyValue* kv) {
+  kv->msg.clear();
+  free_nodes.push_back(kv);
+}
+
+void OutputQueueMerger::push(MsgKeyValue* kv) {
+  heap.push_back(HeapEntry{kv->lt, kv});
+  std::push_heap(heap.begin(), heap.end(), HeapEntry::greater);
+}
+
 bool OutputQueueMerger::load() {
   if (heap.empty() || failed) {
     return false;
   }
-  unsigned long long lt = heap[0]->lt;
-  std::size_t orig_size = msg_list.size();
+  for (auto kv : msg_list) {
+    free_node(kv);
+  }
+  msg_list.clear();
+  pos = 0;
+  unsigned long long lt = heap[0].lt;
   do {
-    while (heap[0]->is_fork()) {
-      auto other = std::make_unique<MsgKeyValue>();
-      if (!heap[0]->split(*other)) {
+    // the top subtree keeps its least lt when split, so it stays on top and only the other half is pushed
+    while (heap[0].kv->is_fork()) {
+      auto other = alloc_node();
+      if (!heap[0].kv->split(*other)) {
         failed = true;
         return false;
       }
-      heap.push_back(std::move(other));
-      std::push_heap(heap.begin(), heap.end(), MsgKeyValue::greater);
+      push(other);
     }
-    assert(heap[0]->lt == lt);
-    std::pop_heap(heap.begin(), heap.end(), MsgKeyValue::greater);
-    msg_list.push_back(std::move(heap.back()));
+    DCHECK(heap[0].lt == lt);
+    std::pop_heap(heap.begin(), heap.end(), HeapEntry::greater);
+    msg_list.push_back(heap.back().kv);
     heap.pop_back();
-  } while (!heap.empty() && heap[0]->lt <= lt);
-  std::sort(msg_list.begin() + orig_size, msg_list.end(), MsgKeyValue::less);
+  } while (!heap.empty() && heap[0].lt <= lt);
+  std::sort(msg_list.begin(), msg_list.end(), MsgKeyValue::less);
   return true;
 }
 
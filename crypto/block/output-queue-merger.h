@@ -21,9 +21,14 @@
 #include "vm/cells/CellSlice.h"
 #include "block/mc-config.h"
 
+#include <deque>
+
 namespace block {
 using td::Ref;
 
+// Merges the output queues of the neighbors into one stream of messages for shard `queue_for`, ordered by (lt, hash).
+// Every queue is traversed lazily: a subtree is only split into its children when the least lt of its messages
+// (the augmentation of its root) is the least among all pending subtrees.
 struct OutputQueueMerger {
   struct MsgKeyValue {
     static constexpr int max_key_len = 32 + 64 + 256;
@@ -40,12 +45,10 @@ struct OutputQueueMerger {
       return key_len < max_key_len;
     }
     bool invalidate();
-    static bool less(const std::unique_ptr<MsgKeyValue>& he1, const std::unique_ptr<MsgKeyValue>& he2);
-    static bool greater(const std::unique_ptr<MsgKeyValue>& he1, const std::unique_ptr<MsgKeyValue>& he2);
+    static bool less(const MsgKeyValue* he1, const MsgKeyValue* he2);
 
    protected:
     friend struct OutputQueueMerger;
-    static ton::LogicalTime get_node_lt(Ref<vm::Cell> node, int key_pfx_len);
     bool replace_with_child(bool child_idx);
     bool replace_by_prefix(td::ConstBitPtr req_pfx, int req_pfx_len);
     bool unpack_node(td::ConstBitPtr key_pfx, int key_pfx_len, Ref<vm::Cell> node);
@@ -53,28 +56,43 @@ struct OutputQueueMerger {
   };
   //
   ton::ShardIdFull queue_for;
-  std::vector<std::unique_ptr<MsgKeyValue>> msg_list;
-  std::vector<block::McShardDescr> neighbors;
 
  public:
-  OutputQueueMerger(ton::ShardIdFull _queue_for, std::vector<block::McShardDescr> _neighbors);
+  OutputQueueMerger(ton::ShardIdFull _queue_for, const std::vector<block::McShardDescr>& neighbors);
   bool is_eof() const {
     return eof;
   }
+  // the current message, valid until next()
   MsgKeyValue* cur();
   std::unique_ptr<MsgKeyValue> extract_cur();
   bool next();
 
  private:
+  struct HeapEntry {
+    ton::LogicalTime lt;
+    MsgKeyValue* kv;
+    static bool greater(const HeapEntry& he1, const HeapEntry& he2) {
+      return he1.lt > he2.lt;
+    }
+  };
   td::BitArray<32 + 64> common_pfx;
   int common_pfx_len;
-  std::vector<std::unique_ptr<MsgKeyValue>> heap;
+  // pending subtrees by their least lt; messages with equal lt are ordered by hash only in msg_list
+  std::vector<HeapEntry> heap;
+  // messages with the current lt
+  std::vector<MsgKeyValue*> msg_list;
   std::size_t pos{0};
+  // nodes are allocated once and reused when their messages leave msg_list
+  std::deque<MsgKeyValue> nodes;
+  std::vector<MsgKeyValue*> free_nodes;
   bool eof;
   bool failed;
-  void init();
+  void init(const std::vector<block::McShardDescr>& neighbors);
   bool add_root(int src, Ref<vm::Cell> outmsg_root);
   bool load();
+  MsgKeyValue* alloc_node();
+  void free_node(MsgKeyValue* kv);
+  void push(MsgKeyValue* kv);
 };
 
 }  // namespace block
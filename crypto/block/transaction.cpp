@@ -794,6 +794,16 @@ bool ComputePhaseConfig::parse_GasLimitsPrices_internal(Ref<vm::CellSlice> cs, t
   return true;
 }
 
+void ComputePhaseConfig::set_gas_limits_prices(const GasLimitsPrices& prices) {
+  gas_limit = prices.gas_limit;
+  special_gas_limit = prices.special_gas_limit;
+  gas_credit = prices.gas_credit;
+  gas_price = prices.gas_price;
+  flat_gas_limit = prices.flat_gas_limit;
+  flat_gas_price = prices.flat_gas_price;
+  compute_threshold();
+}
+
 void ComputePhaseConfig::compute_threshold() {
   gas_price256 = td::make_refint(gas_price);
   if (gas_limit > flat_gas_limit) {
@@ -1850,12 +1860,25 @@ bool Transaction::check_state_size_limit(const ActionPhaseConfig& cfg) {
       cell_equal(account.library, new_library)) {
     return true;
   }
-  // new_storage_stat is used here beause these stats will be reused in compute_state()
-  new_storage_stat.limit_cells = cfg.size_limits.max_acc_state_cells;
-  new_storage_stat.limit_bits = cfg.size_limits.max_acc_state_bits;
-  new_storage_stat.add_used_storage(new_code);
-  new_storage_stat.add_used_storage(new_data);
-  new_storage_stat.add_used_storage(new_library);
+  if (auto stat = get_account_storage_stat()) {
+    // only cells that appeared or disappeared are visited
+    auto S = stat->replace_roots({new_code, new_data, new_library}, cfg.size_limits.max_acc_state_cells,
+                                 cfg.size_limits.max_acc_state_bits);
+    new_storage_stat.clear();
+    if (S.is_error()) {
+      account_storage_stat.reset();
+      return false;
+    }
+    new_storage_stat.cells = stat->get_total_cells();
+    new_storage_stat.bits = stat->get_total_bits();
+  } else {
+    // new_storage_stat is used here beause these stats will be reused in compute_state()
+    new_storage_stat.limit_cells = cfg.size_limits.max_acc_state_cells;
+    new_storage_stat.limit_bits = cfg.size_limits.max_acc_state_bits;
+    new_storage_stat.add_used_storage(new_code);
+    new_storage_stat.add_used_storage(new_data);
+    new_storage_stat.add_used_storage(new_library);
+  }
   if (acc_status == Account::acc_active) {
     new_storage_stat.clear_limit();
   } else {
@@ -1865,6 +1888,26 @@ bool Transaction::check_state_size_limit(const ActionPhaseConfig& cfg) {
          new_storage_stat.bits <= cfg.size_limits.max_acc_state_bits;
 }
 
+AccountStorageStat* Transaction::get_account_storage_stat() {
+  if (account_storage_stat) {
+    return account_storage_stat.get();
+  }
+  if (account.storage_stat.cells < AccountStorageStat::min_tracked_cells()) {
+    return nullptr;
+  }
+  std::vector<Ref<vm::Cell>> roots{account.code, account.data, account.library};
+  account_storage_stat = AccountStorageStat::take_cached(roots);
+  if (!account_storage_stat) {
+    td::Timer timer;
+    account_storage_stat = std::make_unique<AccountStorageStat>();
+    account_storage_stat->replace_roots(std::move(roots)).ensure();
+    if (timer.elapsed() > 0.1) {
+      LOG(INFO) << "Compute account storage stat took " << timer.elapsed() << "s";
+    }
+  }
+  return account_storage_stat.get();
+}
+
 bool Transaction::prepare_bounce_phase(const ActionPhaseConfig& cfg) {
   if (in_msg.is_null() || !bounce_enabled) {
     return false;
@@ -2087,6 +2130,10 @@ bool Transaction::compute_state() {
   auto new_stats = try_update_storage_stat(account.storage_stat, account.storage, storage);
   if (new_stats) {
     stats = new_stats.unwrap();
+  } else if (acc_status == Account::acc_active && get_account_storage_stat()) {
+    // code, data and library are the only large subtrees of an active account's storage
+    account_storage_stat->replace_roots({new_code, new_data, new_library}).ensure();
+    stats = account_storage_stat->stat_with(storage);
   } else {
     td::Timer timer;
     CHECK(stats.add_used_storage(Ref<vm::Cell>(storage)));
@@ -2402,6 +2449,9 @@ Ref<vm::Cell> Transaction::commit(Account& acc) {
   acc.last_trans_hash_ = root->get_hash().bits();
   acc.last_paid = last_paid;
   acc.storage_stat = new_storage_stat;
+  if (account_storage_stat && account_storage_stat->same_roots({new_code, new_data, new_library})) {
+    AccountStorageStat::put_cached(std::move(account_storage_stat));
+  }
   acc.storage = new_storage;
   acc.balance = std::move(balance);
   acc.due_payment = std::move(due_payment);
@@ -0,0 +1,435 @@
+/*
+    This file is part of TON Blockchain Library.
+
+    TON Blockchain Library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    TON Blockchain Library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with TON Blockchain Library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "common/sha256batch.h"
+
+#include "openssl/digest.hpp"
+
+#include "td/utils/common.h"
+#include "td/utils/port/thread_local.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define TON_SHA256_X86 1
+#include <cpuid.h>
+#include <immintrin.h>
+#else
+#define TON_SHA256_X86 0
+#endif
+
+namespace digest {
+
+namespace {
+
+#if TON_SHA256_X86
+
+alignas(16) const td::uint32 K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+alignas(16) const td::uint32 H0[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                                      0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+
+// Message as full blocks taken from the input followed by one or two padded tail blocks
+struct PaddedMessage {
+  const unsigned char *data;
+  size_t full_blocks;
+  size_t blocks;
+  unsigned char tail[128];
+
+  void init(const Sha256Job &job) {
+    data = job.data;
+    full_blocks = job.size / 64;
+    size_t rest = job.size % 64;
+    size_t tail_blocks = rest + 9 <= 64 ? 1 : 2;
+    blocks = full_blocks + tail_blocks;
+    std::memset(tail, 0, tail_blocks * 64);
+    if (rest != 0) {
+      std::memcpy(tail, data + full_blocks * 64, rest);
+    }
+    tail[rest] = 0x80;
+    td::uint64 bits = static_cast<td::uint64>(job.size) * 8;
+    auto *end = tail + tail_blocks * 64;
+    for (int i = 1; i <= 8; i++) {
+      end[-i] = static_cast<unsigned char>(bits);
+      bits >>= 8;
+    }
+  }
+  const unsigned char *block(size_t i) const {
+    return i < full_blocks ? data + i * 64 : tail + (i - full_blocks) * 64;
+  }
+};
+
+bool cpu_has_sha_ni() {
+  unsigned a, b, c, d;
+  if (!__get_cpuid(1, &a, &b, &c, &d)) {
+    return false;
+  }
+  bool ssse3 = (c & (1u << 9)) != 0;
+  bool sse41 = (c & (1u << 19)) != 0;
+  if (!__get_cpuid_count(7, 0, &a, &b, &c, &d)) {
+    return false;
+  }
+  return ssse3 && sse41 && (b & (1u << 29)) != 0;
+}
+
+bool cpu_has_avx2() {
+  unsigned a, b, c, d;
+  if (!__get_cpuid(1, &a, &b, &c, &d)) {
+    return false;
+  }
+  bool osxsave = (c & (1u << 27)) != 0;
+  bool avx = (c & (1u << 28)) != 0;
+  if (!osxsave || !avx) {
+    return false;
+  }
+  unsigned xcr0_lo, xcr0_hi;
+  __asm__ volatile("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+  if ((xcr0_lo & 6) != 6) {
+    return false;
+  }
+  if (!__get_cpuid_count(7, 0, &a, &b, &c, &d)) {
+    return false;
+  }
+  return (b & (1u << 5)) != 0;
+}
+
+#define TON_SHA_NI_TARGET __attribute__((target("sha,sse4.1,ssse3")))
+
+// One group of four SHA-NI rounds; G is the group number, message schedule lives in M[0..3]
+template <int G, int N>
+TON_SHA_NI_TARGET inline __attribute__((always_inline)) void sha_ni_rounds(__m128i (&state0)[N],
+                                                                          __m128i (&state1)[N],
+                                                                          __m128i (&m)[N][4],
+                                                                          const unsigned char *const (&block)[N]) {
+  const __m128i mask = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+  const __m128i k = _mm_load_si128(reinterpret_cast<const __m128i *>(K + 4 * G));
+  // independent streams are interleaved to hide the latency of sha256rnds2
+#pragma GCC unroll 4
+  for (int j = 0; j < N; j++) {
+    if (G < 4) {
+      m[j][G] = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(block[j] + 16 * G)), mask);
+    }
+    __m128i msg = _mm_add_epi32(m[j][G % 4], k);
+    state1[j] = _mm_sha256rnds2_epu32(state1[j], state0[j], msg);
+    if (G >= 3 && G < 15) {
+      __m128i tmp = _mm_alignr_epi8(m[j][G % 4], m[j][(G + 3) % 4], 4);
+      m[j][(G + 1) % 4] = _mm_sha256msg2_epu32(_mm_add_epi32(m[j][(G + 1) % 4], tmp), m[j][G % 4]);
+    }
+    msg = _mm_shuffle_epi32(msg, 0x0E);
+    state0[j] = _mm_sha256rnds2_epu32(state0[j], state1[j], msg);
+    if (G >= 1 && G < 13) {
+      m[j][(G + 3) % 4] = _mm_sha256msg1_epu32(m[j][(G + 3) % 4], m[j][G % 4]);
+    }
+  }
+}
+
+// Hashes N messages with SHA-NI, processing their blocks in lockstep
+template <int N>
+TON_SHA_NI_TARGET void sha_ni_hash(const PaddedMessage *msgs, unsigned char *const (&out)[N]) {
+  const __m128i mask = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+  // state is kept as ABEF and CDGH
+  __m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(H0)), 0xB1);
+  __m128i efgh = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(H0 + 4)), 0x1B);
+  __m128i abef = _mm_alignr_epi8(tmp, efgh, 8);
+  __m128i cdgh = _mm_blend_epi16(efgh, tmp, 0xF0);
+
+  __m128i state0[N], state1[N];
+  for (int j = 0; j < N; j++) {
+    state0[j] = abef;
+    state1[j] = cdgh;
+  }
+  size_t blocks = msgs[0].blocks;
+  for (int j = 1; j < N; j++) {
+    blocks = std::min(blocks, msgs[j].blocks);
+  }
+  for (size_t b = 0; b < blocks; b++) {
+    const unsigned char *block[N];
+    __m128i save0[N], save1[N], m[N][4];
+    for (int j = 0; j < N; j++) {
+      block[j] = msgs[j].block(b);
+      save0[j] = state0[j];
+      save1[j] = state1[j];
+    }
+    sha_ni_rounds<0>(state0, state1, m, block);
+    sha_ni_rounds<1>(state0, state1, m, block);
+    sha_ni_rounds<2>(state0, state1, m, block);
+    sha_ni_rounds<3>(state0, state1, m, block);
+    sha_ni_rounds<4>(state0, state1, m, block);
+    sha_ni_rounds<5>(state0, state1, m, block);
+    sha_ni_rounds<6>(state0, state1, m, block);
+    sha_ni_rounds<7>(state0, state1, m, block);
+    sha_ni_rounds<8>(state0, state1, m, block);
+    sha_ni_rounds<9>(state0, state1, m, block);
+    sha_ni_rounds<10>(state0, state1, m, block);
+    sha_ni_rounds<11>(state0, state1, m, block);
+    sha_ni_rounds<12>(state0, state1, m, block);
+    sha_ni_rounds<13>(state0, state1, m, block);
+    sha_ni_rounds<14>(state0, state1, m, block);
+    sha_ni_rounds<15>(state0, state1, m, block);
+    for (int j = 0; j < N; j++) {
+      state0[j] = _mm_add_epi32(state0[j], save0[j]);
+      state1[j] = _mm_add_epi32(state1[j], save1[j]);
+    }
+  }
+  // the remaining blocks of longer messages are finished one stream at a time
+  for (int j = 0; j < N; j++) {
+    for (size_t b = blocks; b < msgs[j].blocks; b++) {
+      __m128i s0[1] = {state0[j]}, s1[1] = {state1[j]}, m[1][4];
+      const unsigned char *block[1] = {msgs[j].block(b)};
+      sha_ni_rounds<0>(s0, s1, m, block);
+      sha_ni_rounds<1>(s0, s1, m, block);
+      sha_ni_rounds<2>(s0, s1, m, block);
+      sha_ni_rounds<3>(s0, s1, m, block);
+      sha_ni_rounds<4>(s0, s1, m, block);
+      sha_ni_rounds<5>(s0, s1, m, block);
+      sha_ni_rounds<6>(s0, s1, m, block);
+      sha_ni_rounds<7>(s0, s1, m, block);
+      sha_ni_rounds<8>(s0, s1, m, block);
+      sha_ni_rounds<9>(s0, s1, m, block);
+      sha_ni_rounds<10>(s0, s1, m, block);
+      sha_ni_rounds<11>(s0, s1, m, block);
+      sha_ni_rounds<12>(s0, s1, m, block);
+      sha_ni_rounds<13>(s0, s1, m, block);
+      sha_ni_rounds<14>(s0, s1, m, block);
+      sha_ni_rounds<15>(s0, s1, m, block);
+      state0[j] = _mm_add_epi32(state0[j], s0[0]);
+      state1[j] = _mm_add_epi32(state1[j], s1[0]);
+    }
+  }
+  for (int j = 0; j < N; j++) {
+    tmp = _mm_shuffle_epi32(state0[j], 0x1B);          // FEBA
+    __m128i dchg = _mm_shuffle_epi32(state1[j], 0xB1);  // DCHG
+    __m128i dcba = _mm_blend_epi16(tmp, dchg, 0xF0);
+    __m128i hgfe = _mm_alignr_epi8(dchg, tmp, 8);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out[j]), _mm_shuffle_epi8(dcba, mask));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out[j] + 16), _mm_shuffle_epi8(hgfe, mask));
+  }
+}
+
+void sha256_batch_sha_ni(td::Span<Sha256Job> jobs) {
+  PaddedMessage msgs[2];
+  size_t i = 0;
+  for (; i + 2 <= jobs.size(); i += 2) {
+    msgs[0].init(jobs[i]);
+    msgs[1].init(jobs[i + 1]);
+    unsigned char *const out[2] = {jobs[i].out, jobs[i + 1].out};
+    sha_ni_hash<2>(msgs, out);
+  }
+  if (i < jobs.size()) {
+    msgs[0].init(jobs[i]);
+    unsigned char *const out[1] = {jobs[i].out};
+    sha_ni_hash<1>(msgs, out);
+  }
+}
+
+#define TON_AVX2_TARGET __attribute__((target("avx2")))
+
+template <int R>
+TON_AVX2_TARGET inline __attribute__((always_inline)) __m256i rotr(__m256i x) {
+  return _mm256_or_si256(_mm256_srli_epi32(x, R), _mm256_slli_epi32(x, 32 - R));
+}
+
+// Hashes up to eight messages, one per 32-bit lane
+TON_AVX2_TARGET void avx2_hash(const PaddedMessage *msgs, size_t n, unsigned char *const *out) {
+  static const unsigned char zero_block[64] = {};
+  __m256i state[8];
+  for (int i = 0; i < 8; i++) {
+    state[i] = _mm256_set1_epi32(static_cast<int>(H0[i]));
+  }
+  size_t blocks = 0;
+  for (size_t j = 0; j < n; j++) {
+    blocks = std::max(blocks, msgs[j].blocks);
+  }
+  for (size_t b = 0; b < blocks; b++) {
+    alignas(32) td::uint32 words[16][8];
+    alignas(32) td::int32 active[8];
+    for (size_t j = 0; j < 8; j++) {
+      const unsigned char *block = zero_block;
+      active[j] = 0;
+      if (j < n && b < msgs[j].blocks) {
+        block = msgs[j].block(b);
+        active[j] = -1;
+      }
+      for (int t = 0; t < 16; t++) {
+        const unsigned char *p = block + 4 * t;
+        words[t][j] = (td::uint32(p[0]) << 24) | (td::uint32(p[1]) << 16) | (td::uint32(p[2]) << 8) | p[3];
+      }
+    }
+    __m256i w[16];
+    for (int t = 0; t < 16; t++) {
+      w[t] = _mm256_load_si256(reinterpret_cast<const __m256i *>(words[t]));
+    }
+    __m256i a = state[0], b_ = state[1], c = state[2], d = state[3];
+    __m256i e = state[4], f = state[5], g = state[6], h = state[7];
+    for (int t = 0; t < 64; t++) {
+      if (t >= 16) {
+        __m256i w15 = w[(t - 15) & 15], w2 = w[(t - 2) & 15];
+        __m256i s0 = _mm256_xor_si256(_mm256_xor_si256(rotr<7>(w15), rotr<18>(w15)), _mm256_srli_epi32(w15, 3));
+        __m256i s1 = _mm256_xor_si256(_mm256_xor_si256(rotr<17>(w2), rotr<19>(w2)), _mm256_srli_epi32(w2, 10));
+        w[t & 15] = _mm256_add_epi32(_mm256_add_epi32(w[t & 15], s0), _mm256_add_epi32(w[(t - 7) & 15], s1));
+      }
+      __m256i sigma1 = _mm256_xor_si256(_mm256_xor_si256(rotr<6>(e), rotr<11>(e)), rotr<25>(e));
+      __m256i ch = _mm256_xor_si256(_mm256_and_si256(e, f), _mm256_andnot_si256(e, g));
+      __m256i t1 = _mm256_add_epi32(_mm256_add_epi32(h, sigma1),
+                                    _mm256_add_epi32(_mm256_add_epi32(ch, w[t & 15]),
+                                                     _mm256_set1_epi32(static_cast<int>(K[t]))));
+      __m256i sigma0 = _mm256_xor_si256(_mm256_xor_si256(rotr<2>(a), rotr<13>(a)), rotr<22>(a));
+      __m256i maj = _mm256_or_si256(_mm256_and_si256(a, b_), _mm256_and_si256(c, _mm256_or_si256(a, b_)));
+      __m256i t2 = _mm256_add_epi32(sigma0, maj);
+      h = g;
+      g = f;
+      f = e;
+      e = _mm256_add_epi32(d, t1);
+      d = c;
+      c = b_;
+      b_ = a;
+      a = _mm256_add_epi32(t1, t2);
+    }
+    // lanes whose message has already ended keep their state
+    __m256i mask = _mm256_load_si256(reinterpret_cast<const __m256i *>(active));
+    __m256i res[8] = {a, b_, c, d, e, f, g, h};
+    for (int i = 0; i < 8; i++) {
+      state[i] = _mm256_blendv_epi8(state[i], _mm256_add_epi32(state[i], res[i]), mask);
+    }
+  }
+  alignas(32) td::uint32 words[8][8];
+  for (int i = 0; i < 8; i++) {
+    _mm256_store_si256(reinterpret_cast<__m256i *>(words[i]), state[i]);
+  }
+  for (size_t j = 0; j < n; j++) {
+    for (int i = 0; i < 8; i++) {
+      auto x = words[i][j];
+      out[j][4 * i] = static_cast<unsigned char>(x >> 24);
+      out[j][4 * i + 1] = static_cast<unsigned char>(x >> 16);
+      out[j][4 * i + 2] = static_cast<unsigned char>(x >> 8);
+      out[j][4 * i + 3] = static_cast<unsigned char>(x);
+    }
+  }
+}
+
+void sha256_batch_avx2(td::Span<Sha256Job> jobs) {
+  PaddedMessage msgs[8];
+  unsigned char *out[8];
+  for (size_t i = 0; i < jobs.size(); i += 8) {
+    size_t n = std::min<size_t>(8, jobs.size() - i);
+    for (size_t j = 0; j < n; j++) {
+      msgs[j].init(jobs[i + j]);
+      out[j] = jobs[i + j].out;
+    }
+    avx2_hash(msgs, n, out);
+  }
+}
+
+#endif
+
+void sha256_batch_openssl(td::Span<Sha256Job> jobs) {
+  static TD_THREAD_LOCAL digest::SHA256 *hasher;
+  td::init_thread_local<digest::SHA256>(hasher);
+  for (auto &job : jobs) {
+    hasher->reset();
+    hasher->feed(job.data, job.size);
+    hasher->extract(job.out);
+  }
+}
+
+Sha256Backend detect_backend() {
+#if TON_SHA256_X86
+  if (cpu_has_sha_ni()) {
+    return Sha256Backend::ShaNi;
+  }
+  if (cpu_has_avx2()) {
+    return Sha256Backend::Avx2;
+  }
+#endif
+  return Sha256Backend::OpenSSL;
+}
+
+std::atomic<Sha256Backend> &current_backend() {
+  static std::atomic<Sha256Backend> backend{detect_backend()};
+  return backend;
+}
+
+}  // namespace
+
+void sha256_batch(td::Span<Sha256Job> jobs) {
+  switch (current_backend().load(std::memory_order_relaxed)) {
+#if TON_SHA256_X86
+    case Sha256Backend::ShaNi:
+      sha256_batch_sha_ni(jobs);
+      return;
+    case Sha256Backend::Avx2:
+      // short batches are not worth the lane setup
+      if (jobs.size() >= 4) {
+        sha256_batch_avx2(jobs);
+        return;
+      }
+      break;
+#endif
+    default:
+      break;
+  }
+  sha256_batch_openssl(jobs);
+}
+
+Sha256Backend sha256_batch_backend() {
+  return current_backend().load(std::memory_order_relaxed);
+}
+
+bool sha256_batch_backend_supported(Sha256Backend backend) {
+  switch (backend) {
+#if TON_SHA256_X86
+    case Sha256Backend::ShaNi:
+      return cpu_has_sha_ni();
+    case Sha256Backend::Avx2:
+      return cpu_has_avx2();
+#endif
+    case Sha256Backend::OpenSSL:
+      return true;
+    default:
+      return false;
+  }
+}
+
+void sha256_batch_set_backend(Sha256Backend backend) {
+  if (!sha256_batch_backend_supported(backend)) {
+    backend = Sha256Backend::OpenSSL;
+  }
+  current_backend().store(backend, std::memory_order_relaxed);
+}
+
+td::Slice sha256_batch_backend_name(Sha256Backend backend) {
+  switch (backend) {
+    case Sha256Backend::ShaNi:
+      return td::Slice("SHA-NI");
+    case Sha256Backend::Avx2:
+      return td::Slice("AVX2");
+    case Sha256Backend::OpenSSL:
+      return td::Slice("OpenSSL");
+  }
+  return td::Slice("unknown");
+}
+
+}  // namespace digest
@@ -0,0 +1,52 @@
+/*
+    This file is part of TON Blockchain Library.
+
+    TON Blockchain Library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    TON Blockchain Library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with TON Blockchain Library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include "td/utils/Slice.h"
+#include "td/utils/Span.h"
+
+#include <cstddef>
+
+namespace digest {
+
+// One message of a batch: `size` bytes at `data`, the 32-byte digest is written to `out`
+struct Sha256Job {
+  const unsigned char *data;
+  std::size_t size;
+  unsigned char *out;
+};
+
+enum class Sha256Backend { OpenSSL, Avx2, ShaNi };
+
+// Computes SHA-256 of several independent messages at once.
+// Meant for many short messages (cell representations are at most 266 bytes): SHA-NI runs two
+// interleaved streams, AVX2 runs eight messages in parallel lanes, otherwise OpenSSL is used.
+void sha256_batch(td::Span<Sha256Job> jobs);
+
+inline void sha256(td::Slice data, unsigned char out[32]) {
+  Sha256Job job{data.ubegin(), data.size(), out};
+  sha256_batch(td::Span<Sha256Job>(&job, 1));
+}
+
+// Backend chosen at runtime from cpu features
+Sha256Backend sha256_batch_backend();
+bool sha256_batch_backend_supported(Sha256Backend backend);
+// Overrides runtime detection, for tests and benchmarks
+void sha256_batch_set_backend(Sha256Backend backend);
+td::Slice sha256_batch_backend_name(Sha256Backend backend);
+
+}  // namespace digest
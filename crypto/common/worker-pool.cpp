@@ -0,0 +1,103 @@
+/*
+    This file is part of TON Blockchain Library.
+
+    TON Blockchain Library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    TON Blockchain Library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with TON Blockchain Library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "common/worker-pool.h"
+
+namespace td {
+
+WorkerPool &WorkerPool::get() {
+  static WorkerPool pool;
+  return pool;
+}
+
+WorkerPool::~WorkerPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cond_.notify_all();
+  for (auto &worker : workers_) {
+    worker.join();
+  }
+}
+
+void WorkerPool::run(size_t n, int threads, const std::function<void(size_t)> &func) {
+  auto job = std::make_shared<Job>(n, threads - 1, func);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    while (static_cast<int>(workers_.size()) < threads - 1) {
+      workers_.emplace_back([this] { loop(); });
+    }
+    jobs_.push_back(job);
+  }
+  cond_.notify_all();
+  job->work();
+  job->wait();
+  if (job->error) {
+    std::rethrow_exception(job->error);
+  }
+}
+
+void WorkerPool::Job::work() {
+  size_t cnt = 0;
+  std::exception_ptr err;
+  for (size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < n; cnt++) {
+    try {
+      func(i);
+    } catch (...) {
+      err = std::current_exception();
+      // indices that were not handed out yet are never run, count them as done
+      size_t last = next.exchange(n, std::memory_order_relaxed);
+      cnt += 1 + (last < n ? n - last : 0);
+      break;
+    }
+  }
+  if (cnt != 0) {
+    std::lock_guard<std::mutex> lock(mutex);
+    done += cnt;
+    if (err && !error) {
+      error = std::move(err);
+    }
+    if (done == n) {
+      cond.notify_all();
+    }
+  }
+}
+
+void WorkerPool::Job::wait() {
+  std::unique_lock<std::mutex> lock(mutex);
+  cond.wait(lock, [&] { return done == n; });
+}
+
+void WorkerPool::loop() {
+  while (true) {
+    std::shared_ptr<Job> job;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cond_.wait(lock, [&] { return stop_ || !jobs_.empty(); });
+      if (stop_) {
+        return;
+      }
+      job = jobs_.front();
+      if (--job->helpers <= 0 || job->next.load(std::memory_order_relaxed) >= job->n) {
+        jobs_.pop_front();
+      }
+    }
+    job->work();
+  }
+}
+
+}  // namespace td
@@ -0,0 +1,73 @@
+/*
+    This file is part of TON Blockchain Library.
+
+    TON Blockchain Library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    TON Blockchain Library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with TON Blockchain Library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include "td/utils/port/thread.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace td {
+
+// A process-wide pool of worker threads. run() calls func(0), ..., func(n - 1) on the calling thread and on at most
+// `threads - 1` workers, and returns when all calls are finished.
+// If a call throws, no further calls are started, and run() rethrows the first exception once the calls already
+// running are finished.
+// The pool grows to the largest number of threads requested so far; callers running blocking calls (like database
+// reads) may ask for more threads than there are cores.
+class WorkerPool {
+ public:
+  static WorkerPool &get();
+  ~WorkerPool();
+
+  void run(size_t n, int threads, const std::function<void(size_t)> &func);
+
+ private:
+  struct Job {
+    Job(size_t n, int helpers, const std::function<void(size_t)> &func) : n(n), helpers(helpers), func(func) {
+    }
+    size_t n;
+    int helpers;  // number of workers that may still join, guarded by the pool mutex
+    const std::function<void(size_t)> &func;
+    std::atomic<size_t> next{0};
+    std::mutex mutex;
+    std::condition_variable cond;
+    size_t done = 0;
+    std::exception_ptr error;
+
+    void work();
+    void wait();
+  };
+
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  std::deque<std::shared_ptr<Job>> jobs_;
+  std::vector<td::thread> workers_;
+  bool stop_ = false;
+
+  WorkerPool() = default;
+  void loop();
+};
+
+}  // namespace td
@@ -25,18 +25,31 @@
 #include <cstring>
 #include <cstdlib>
 #include <cmath>
+#include <limits>
+#include <set>
+#include <thread>
 #include "common/refcnt.hpp"
 #include "common/bigint.hpp"
 #include "common/refint.h"
 #include "common/bigexp.h"
 #include "common/bitstring.h"
 #include "common/util.h"
+#include "common/sha256batch.h"
+#include "common/worker-pool.h"
 #include "vm/cells.h"
 #include "vm/cellslice.h"
+#include "vm/boc.h"
+#include "vm/dict.h"
+#include "vm/vmstate.h"
+#include "vm/cells/MerkleProof.h"
+#include "vm/cells/MerkleUpdate.h"
+#include "vm/cells/UsageCell.h"
 
 #include "td/utils/tests.h"
 #include "td/utils/crypto.h"
 #include "td/utils/misc.h"
+#include "td/utils/Random.h"
+#include "td/utils/Timer.h"
 
 static std::stringstream create_ss() {
   std::stringstream ss;
@@ -114,6 +127,497 @@ TEST(Cells, simple) {
   REGRESSION_VERIFY(os.str());
 }
 
+TEST(Cells, sha256_batch) {
+  auto initial = digest::sha256_batch_backend();
+  for (auto backend : {digest::Sha256Backend::OpenSSL, digest::Sha256Backend::Avx2, digest::Sha256Backend::ShaNi}) {
+    if (!digest::sha256_batch_backend_supported(backend)) {
+      continue;
+    }
+    digest::sha256_batch_set_backend(backend);
+    for (size_t n = 1; n <= 20; n++) {
+      std::vector<std::string> messages(n);
+      std::vector<std::array<unsigned char, 32>> hashes(n);
+      std::vector<digest::Sha256Job> jobs;
+      for (size_t i = 0; i < n; i++) {
+        messages[i] = td::rand_string(0, 127, td::Random::fast(0, 300));
+        jobs.push_back({td::Slice(messages[i]).ubegin(), messages[i].size(), hashes[i].data()});
+      }
+      digest::sha256_batch(jobs);
+      for (size_t i = 0; i < n; i++) {
+        ASSERT_EQ(td::sha256(messages[i]), td::Slice(hashes[i].data(), 32).str());
+      }
+    }
+
+    // a tree wide enough to be hashed in batches
+    std::vector<td::Ref<vm::Cell>> layer;
+    for (int i = 0; i < 200; i++) {
+      vm::CellBuilder cb;
+      cb.store_long(i, 32).store_bytes(td::rand_string(0, 127, td::Random::fast(0, 120)));
+      layer.push_back(cb.finalize());
+    }
+    while (layer.size() > 1) {
+      std::vector<td::Ref<vm::Cell>> next;
+      for (size_t i = 0; i < layer.size(); i += 3) {
+        vm::CellBuilder cb;
+        cb.store_long(i, 16);
+        for (size_t j = i; j < std::min(i + 3, layer.size()); j++) {
+          cb.store_ref(layer[j]);
+        }
+        next.push_back(cb.finalize());
+      }
+      layer = std::move(next);
+    }
+    auto boc = vm::std_boc_serialize(layer[0], 0).move_as_ok();
+    auto root = vm::std_boc_deserialize(boc).move_as_ok();
+    ASSERT_EQ(layer[0]->get_hash().as_slice(), root->get_hash().as_slice());
+    ASSERT_EQ(boc, vm::std_boc_serialize(root, 0).move_as_ok());
+
+    // pruned branches make cells with several hashes, which are not deferred, between deferred ones
+    auto proof =
+        vm::MerkleProof::generate(layer[0], [](const td::Ref<vm::Cell>&) { return td::Random::fast(0, 3) == 0; });
+    for (int mode : {0, 31}) {
+      boc = vm::std_boc_serialize(proof, mode).move_as_ok();
+      root = vm::std_boc_deserialize(boc).move_as_ok();
+      ASSERT_EQ(proof->get_hash().as_slice(), root->get_hash().as_slice());
+    }
+  }
+  digest::sha256_batch_set_backend(initial);
+}
+
+TEST(Cells, boc_batch_pruned_child) {
+  // root -> {c0, c1}, c0 -> {leaf0}, c1 -> {d}, d -> {e, leaf1}, e -> {leaf2}, e is pruned
+  // d has several hashes and is created between leaf0 and c0, while leaf0 is still pending
+  auto leaf = [](int i) { return vm::CellBuilder().store_long(i, 32).finalize(); };
+  auto e = vm::CellBuilder().store_long(1, 8).store_ref(leaf(2)).finalize();
+  auto d = vm::CellBuilder().store_long(2, 8).store_ref(e).store_ref(leaf(1)).finalize();
+  auto c0 = vm::CellBuilder().store_long(3, 8).store_ref(leaf(0)).finalize();
+  auto c1 = vm::CellBuilder().store_long(4, 8).store_ref(d).finalize();
+  auto root = vm::CellBuilder().store_long(5, 8).store_ref(c0).store_ref(c1).finalize();
+  auto proof = vm::MerkleProof::generate(
+      root, [&](const td::Ref<vm::Cell>& cell) { return cell->get_hash() == e->get_hash(); });
+  for (int mode : {0, 31}) {
+    auto boc = vm::std_boc_serialize(proof, mode).move_as_ok();
+    auto res = vm::std_boc_deserialize(boc).move_as_ok();
+    ASSERT_EQ(proof->get_hash().as_slice(), res->get_hash().as_slice());
+    ASSERT_EQ(root->get_hash().as_slice(), vm::MerkleProof::virtualize(res, 1)->get_hash().as_slice());
+    ASSERT_EQ(boc, vm::std_boc_serialize(res, mode).move_as_ok());
+  }
+}
+
+namespace {
+
+// extra value of a node is the sum of the first 32 bits of all values below it
+struct SumAugmentation : vm::dict::AugmentationData {
+  bool skip_extra(vm::CellSlice& cs) const override {
+    return cs.advance(32);
+  }
+  bool eval_leaf(vm::CellBuilder& cb, vm::CellSlice& val_cs) const override {
+    return cb.store_long_bool(val_cs.prefetch_ulong(32), 32);
+  }
+  bool eval_fork(vm::CellBuilder& cb, vm::CellSlice& left_cs, vm::CellSlice& right_cs) const override {
+    return cb.store_long_bool((left_cs.fetch_ulong(32) + right_cs.fetch_ulong(32)) & 0xffffffff, 32);
+  }
+  bool eval_empty(vm::CellBuilder& cb) const override {
+    return cb.store_long_bool(0, 32);
+  }
+};
+
+struct CellCreateCounter : vm::VmStateInterface {
+  td::uint64 created = 0;
+  void register_cell_create() override {
+    created++;
+  }
+};
+
+struct DictBatchTest {
+  int key_bits;
+  std::vector<td::BitArray<320>> keys;
+  std::vector<vm::DictionaryFixed::BatchUpdate> updates;
+
+  // random sorted unique keys; a small `key_range` gives dense keys, so that deletions merge edges
+  void generate(td::Random::Xorshift128plus& rnd, size_t count, td::uint64 key_range) {
+    std::set<td::uint64> key_set;
+    while (key_set.size() < count) {
+      key_set.insert(rnd() % key_range);
+    }
+    keys.clear();
+    updates.clear();
+    for (auto x : key_set) {
+      td::BitArray<320> key;
+      key.set_zero();
+      key.bits().store_uint(x, std::min(key_bits, 64));
+      keys.push_back(key);
+    }
+    for (auto& key : keys) {
+      vm::DictionaryFixed::BatchUpdate upd{key.cbits(), {}};
+      if (rnd() % 4 != 0) {
+        vm::CellBuilder cb;
+        cb.store_long(rnd(), 32).store_long(rnd() % 3, 2);
+        upd.value = vm::load_cell_slice_ref(cb.finalize());
+        upd.mode = static_cast<vm::Dictionary::SetMode>(rnd() % 3 + 1);
+      }
+      updates.push_back(std::move(upd));
+    }
+  }
+
+  template <class T>
+  int apply_one_by_one(T& dict) const {
+    int applied = 0;
+    for (auto& upd : updates) {
+      if (upd.value.is_null()) {
+        applied += dict.lookup_delete(upd.key, key_bits).not_null();
+      } else {
+        applied += dict.set(upd.key, key_bits, upd.value, upd.mode);
+      }
+    }
+    return applied;
+  }
+};
+
+template <class T>
+void check_dict_batch(T& dict1, T& dict2, int key_bits, td::uint64 key_range) {
+  td::Random::Xorshift128plus rnd(key_bits * 1000 + key_range);
+  DictBatchTest test{key_bits, {}, {}};
+  for (int step = 0; step < 60; step++) {
+    test.generate(rnd, rnd() % 200 + 1, key_range);
+    int applied1 = test.apply_one_by_one(dict1);
+    int applied2 = dict2.apply_batch(test.updates);
+    ASSERT_EQ(applied1, applied2);
+    ASSERT_EQ(dict1.is_empty(), dict2.is_empty());
+    if (!dict1.is_empty()) {
+      ASSERT_EQ(dict1.get_root_cell()->get_hash(), dict2.get_root_cell()->get_hash());
+    }
+    ASSERT_TRUE(dict2.validate_all());
+  }
+  if (test.updates.size() > 1) {
+    std::swap(test.updates[0], test.updates[1]);
+    ASSERT_EQ(-1, dict2.apply_batch(test.updates));
+  }
+}
+
+}  // namespace
+
+TEST(Cells, dict_batch) {
+  SumAugmentation aug;
+  for (int key_bits : {8, 16, 64, 267}) {
+    for (td::uint64 key_range : {256, 1024, 1 << 30}) {
+      if (key_bits < 63 && key_range > (1ull << key_bits)) {
+        continue;
+      }
+      vm::Dictionary dict1{key_bits}, dict2{key_bits};
+      check_dict_batch(dict1, dict2, key_bits, key_range);
+      vm::AugmentedDictionary aug_dict1{key_bits, aug}, aug_dict2{key_bits, aug};
+      check_dict_batch(aug_dict1, aug_dict2, key_bits, key_range);
+    }
+  }
+}
+
+TEST(Cells, dict_batch_benchmark) {
+  SumAugmentation aug;
+  td::Random::Xorshift128plus rnd(123);
+  DictBatchTest init{256, {}, {}};
+  init.generate(rnd, 100000, std::numeric_limits<td::uint64>::max());
+  for (auto& upd : init.updates) {
+    vm::CellBuilder cb;
+    cb.store_long(rnd(), 32);
+    upd.value = vm::load_cell_slice_ref(cb.finalize());
+    upd.mode = vm::Dictionary::SetMode::Set;
+  }
+  vm::AugmentedDictionary base{256, aug};
+  base.apply_batch(init.updates);
+  for (size_t count : {100, 1000, 10000}) {
+    DictBatchTest test{256, {}, {}};
+    test.generate(rnd, count, std::numeric_limits<td::uint64>::max());
+    for (auto& upd : test.updates) {
+      upd.mode = vm::Dictionary::SetMode::Set;
+    }
+    auto dict1 = base, dict2 = base;
+    CellCreateCounter counter1, counter2;
+    td::Timer timer1;
+    {
+      vm::VmStateInterface::Guard guard(&counter1);
+      test.apply_one_by_one(dict1);
+    }
+    double time1 = timer1.elapsed();
+    td::Timer timer2;
+    {
+      vm::VmStateInterface::Guard guard(&counter2);
+      dict2.apply_batch(test.updates);
+    }
+    double time2 = timer2.elapsed();
+    ASSERT_EQ(dict1.get_root_cell()->get_hash(), dict2.get_root_cell()->get_hash());
+    LOG(INFO) << count << " updates of an augmented dictionary with 100000 keys: one by one "
+              << static_cast<double>(counter1.created) / static_cast<double>(count) << " cells per key, " << time1
+              << "s; batch " << static_cast<double>(counter2.created) / static_cast<double>(count)
+              << " cells per key, " << time2 << "s";
+  }
+}
+
+TEST(Cells, lazy_hashing) {
+  // a dictionary updated key by key, as the collator does with message queues and descriptions
+  auto build = [](int seed) {
+    td::Random::Xorshift128plus rnd(seed);
+    vm::Dictionary dict{64};
+    for (int i = 0; i < 5000; i++) {
+      td::BitArray<64> key;
+      key.store_ulong(rnd());
+      vm::CellBuilder cb;
+      cb.store_long(i, 32);
+      if (i % 7 == 0) {
+        cb.store_ref(vm::CellBuilder().store_long(rnd(), 64).finalize());
+      }
+      dict.set_builder(key, cb);
+    }
+    return dict.get_root_cell();
+  };
+  auto hashes = vm::DataCell::get_total_hashes();
+  auto eager_root = build(1);
+  auto eager_boc = vm::std_boc_serialize(eager_root, 31).move_as_ok();
+  auto eager_hashes = vm::DataCell::get_total_hashes() - hashes;
+
+  hashes = vm::DataCell::get_total_hashes();
+  td::Ref<vm::Cell> lazy_root;
+  {
+    vm::DataCell::LazyHashing lazy_hashing;
+    lazy_root = build(1);
+  }
+  ASSERT_EQ(0, vm::DataCell::get_total_hashes() - hashes);
+  auto lazy_boc = vm::std_boc_serialize(lazy_root, 31).move_as_ok();
+  auto lazy_hashes = vm::DataCell::get_total_hashes() - hashes;
+  ASSERT_EQ(eager_root->get_hash(), lazy_root->get_hash());
+  ASSERT_EQ(eager_boc, lazy_boc);
+  LOG(INFO) << "SHA-256 invocations for 5000 dictionary insertions: " << eager_hashes << " eager, " << lazy_hashes
+            << " lazy";
+  ASSERT_TRUE(lazy_hashes < eager_hashes);
+
+  // concurrent first use of the same lazily hashed cells
+  for (int iteration = 0; iteration < 10; iteration++) {
+    {
+      vm::DataCell::LazyHashing lazy_hashing;
+      lazy_root = build(iteration);
+    }
+    std::vector<std::thread> threads;
+    std::vector<vm::Cell::Hash> results(4);
+    for (size_t i = 0; i < results.size(); i++) {
+      threads.emplace_back([&, i] { results[i] = lazy_root->get_hash(); });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+    auto expected = build(iteration)->get_hash();
+    for (auto& hash : results) {
+      ASSERT_EQ(expected, hash);
+    }
+  }
+}
+
+TEST(Cells, worker_pool_exception) {
+  for (int threads : {1, 2, 4}) {
+    for (size_t bad : {0, 17, 99}) {
+      std::atomic<size_t> calls{0};
+      bool caught = false;
+      try {
+        td::WorkerPool::get().run(100, threads, [&](size_t i) {
+          calls++;
+          if (i == bad) {
+            throw vm::VmError{vm::Excno::cell_und, "test"};
+          }
+        });
+      } catch (vm::VmError& err) {
+        caught = true;
+        ASSERT_EQ(static_cast<int>(vm::Excno::cell_und), err.get_errno());
+      }
+      ASSERT_TRUE(caught);
+      ASSERT_TRUE(calls.load() <= 100);
+      if (threads == 1) {
+        ASSERT_EQ(bad + 1, calls.load());
+      }
+    }
+    // the pool is still usable after a failed job
+    std::atomic<size_t> sum{0};
+    td::WorkerPool::get().run(100, threads, [&](size_t i) { sum += i; });
+    ASSERT_EQ(4950u, sum.load());
+  }
+}
+
+TEST(Cells, merkle_update_parallel) {
+  auto saved = vm::MerkleUpdate::get_parallelism();
+  td::Random::Xorshift128plus rnd(123);
+  auto random_dict = [&](int size) {
+    vm::Dictionary dict{32};
+    for (int i = 0; i < size; i++) {
+      vm::CellBuilder cb;
+      cb.store_long(rnd(), 64);
+      if (rnd.fast(0, 3) == 0) {
+        cb.store_ref(vm::CellBuilder().store_long(rnd(), 64).finalize());
+      }
+      dict.set_builder(td::BitArray<32>(static_cast<long long>(rnd.fast(0, 1 << 20))), cb);
+    }
+    return dict.get_root_cell();
+  };
+  // random changes of a dictionary, read through a usage tree to build the update
+  auto random_update = [&](td::Ref<vm::Cell> from) {
+    auto usage_tree = std::make_shared<vm::CellUsageTree>();
+    vm::Dictionary dict{vm::UsageCell::create(from, usage_tree->root_ptr()), 32};
+    int changes = rnd.fast(1, 200);
+    for (int i = 0; i < changes; i++) {
+      td::BitArray<32> key(static_cast<long long>(rnd.fast(0, 1 << 20)));
+      if (rnd.fast(0, 2) == 0) {
+        dict.lookup_delete(key);
+      } else if (rnd.fast(0, 1) == 0) {
+        dict.lookup(key);
+      } else {
+        vm::CellBuilder cb;
+        cb.store_long(rnd(), 64);
+        dict.set_builder(key, cb);
+      }
+    }
+    auto to = dict.get_root_cell();
+    return std::make_pair(to, vm::MerkleUpdate::generate(from, to, usage_tree.get()));
+  };
+  auto parts = [](td::Ref<vm::Cell> update) {
+    vm::CellSlice cs(vm::NoVm(), update);
+    return std::make_pair(cs.prefetch_ref(0), cs.prefetch_ref(1));
+  };
+  std::vector<vm::MerkleUpdate::Parallelism> settings{{1, 5}, {4, 0}, {4, 1}, {4, 3}, {2, 5}, {8, 8}, {4, 100}};
+  for (int t = 0; t < 20; t++) {
+    auto from = random_dict(rnd.fast(1, 3000));
+    auto update = random_update(from);
+    auto other = random_update(random_dict(rnd.fast(1000, 3000)));
+    // pruned cells of the other update are not in the tree of this one
+    auto bad_from = parts(update.second).first;
+    auto bad_to = parts(other.second).second;
+    std::string expected_error;
+    for (auto& setting : settings) {
+      vm::MerkleUpdate::set_parallelism(setting);
+      vm::MerkleUpdate::validate(update.second).ensure();
+      auto to = vm::MerkleUpdate::apply(from, update.second);
+      ASSERT_TRUE(to.not_null());
+      ASSERT_EQ(update.first->get_hash(), to->get_hash());
+      auto status = vm::MerkleUpdate::validate_raw(bad_from, bad_to, 0, 0);
+      ASSERT_TRUE(status.is_error());
+      if (expected_error.empty()) {
+        expected_error = status.message().str();
+      }
+      ASSERT_EQ(expected_error, status.message().str());
+    }
+  }
+  vm::MerkleUpdate::set_parallelism(saved);
+}
+
+namespace {
+td::Ref<vm::Cell> gen_proof_test_dict(td::Random::Xorshift128plus& rnd, int size) {
+  vm::Dictionary dict{32};
+  for (int i = 0; i < size; i++) {
+    vm::CellBuilder cb;
+    cb.store_long(rnd(), 64);
+    if (rnd.fast(0, 3) == 0) {
+      cb.store_ref(vm::CellBuilder().store_long(rnd(), 64).finalize());
+    }
+    dict.set_builder(td::BitArray<32>(static_cast<long long>(rnd.fast(0, 1 << 20))), cb);
+  }
+  return dict.get_root_cell();
+}
+
+// a state-like tree: a dictionary, a Merkle update of a dictionary and a copy of the update in a Merkle proof;
+// with `shared_update` the update changes the dictionary of the tree, so it keeps cells and pruned branches of it
+td::Ref<vm::Cell> gen_proof_test_state(td::Random::Xorshift128plus& rnd, int size, bool shared_update) {
+  auto dict_root = gen_proof_test_dict(rnd, size);
+  auto old_root = shared_update ? dict_root : gen_proof_test_dict(rnd, size);
+  auto usage_tree = std::make_shared<vm::CellUsageTree>();
+  vm::Dictionary usage_dict{vm::UsageCell::create(old_root, usage_tree->root_ptr()), 32};
+  vm::CellBuilder cb;
+  cb.store_long(rnd(), 64);
+  usage_dict.set_builder(td::BitArray<32>(static_cast<long long>(rnd.fast(0, 1 << 20))), cb);
+  auto update = vm::MerkleUpdate::generate(old_root, usage_dict.get_root_cell(), usage_tree.get());
+  auto proof = vm::CellBuilder::create_merkle_proof(update);
+  return vm::CellBuilder().store_ref(dict_root).store_ref(update).store_ref(proof).finalize();
+}
+
+// loads the cells read by a few random lookups, as a liteserver query does
+std::shared_ptr<vm::CellUsageTree> gen_proof_test_usage(td::Random::Xorshift128plus& rnd, td::Ref<vm::Cell> root,
+                                                        int lookups) {
+  auto usage_tree = std::make_shared<vm::CellUsageTree>();
+  auto usage_root = vm::UsageCell::create(root, usage_tree->root_ptr());
+  vm::CellSlice cs{vm::NoVm(), usage_root};
+  vm::Dictionary dict{cs.prefetch_ref(0), 32};
+  for (int i = 0; i < lookups; i++) {
+    dict.lookup(td::BitArray<32>(static_cast<long long>(rnd.fast(0, 1 << 20))));
+  }
+  for (unsigned i = 1; i < cs.size_refs(); i++) {
+    if (rnd.fast(0, 1) == 0) {
+      // walk down the first references of the update or the proof
+      auto cell = cs.prefetch_ref(i);
+      while (true) {
+        vm::CellSlice child_cs{vm::NoVm(), cell};
+        if (child_cs.size_refs() == 0) {
+          break;
+        }
+        cell = child_cs.prefetch_ref(rnd.fast(0, child_cs.size_refs() - 1));
+      }
+    }
+  }
+  return usage_tree;
+}
+}  // namespace
+
+TEST(Cells, merkle_proof_boc) {
+  td::Random::Xorshift128plus rnd(123);
+  for (int t = 0; t < 100; t++) {
+    bool shared_update = t % 2 == 1;
+    auto root = gen_proof_test_state(rnd, rnd.fast(1, 2000), shared_update);
+    vm::MerkleProofBocBuilder builder{root};
+    int trees = rnd.fast(0, 3);
+    for (int i = 0; i < trees; i++) {
+      auto usage_tree = gen_proof_test_usage(rnd, root, rnd.fast(0, 10));
+      builder.add_usage_tree(usage_tree.get());
+    }
+    auto proof = builder.extract_proof();
+    ASSERT_TRUE(proof.not_null());
+    for (int mode : {0, 1, 2, 3, 31}) {
+      auto expected = vm::std_boc_serialize(proof, mode).move_as_ok();
+      auto got = builder.serialize(mode).move_as_ok();
+      if (shared_update) {
+        // cells of the update may equal cells of the proof, see MerkleProofBocBuilder
+        ASSERT_EQ(proof->get_hash(), vm::std_boc_deserialize(got).move_as_ok()->get_hash());
+      } else {
+        ASSERT_EQ(expected.as_slice(), got.as_slice());
+      }
+    }
+  }
+}
+
+TEST(Cells, merkle_proof_boc_benchmark) {
+  td::Random::Xorshift128plus rnd(123);
+  auto root = gen_proof_test_state(rnd, 100000, false);
+  std::vector<std::shared_ptr<vm::CellUsageTree>> usage_trees;
+  for (int i = 0; i < 100; i++) {
+    usage_trees.push_back(gen_proof_test_usage(rnd, root, 1));
+  }
+  size_t cells_bytes = 0, direct_bytes = 0;
+  td::Timer cells_timer;
+  for (auto& usage_tree : usage_trees) {
+    cells_bytes += vm::std_boc_serialize(vm::MerkleProof::generate(root, usage_tree.get())).move_as_ok().size();
+  }
+  double cells_time = cells_timer.elapsed();
+  td::Timer direct_timer;
+  for (auto& usage_tree : usage_trees) {
+    vm::MerkleProofBocBuilder builder{root};
+    builder.add_usage_tree(usage_tree.get());
+    direct_bytes += builder.serialize().move_as_ok().size();
+  }
+  double direct_time = direct_timer.elapsed();
+  ASSERT_EQ(cells_bytes, direct_bytes);
+  vm::MerkleProofBocBuilder combined{root};
+  for (auto& usage_tree : usage_trees) {
+    combined.add_usage_tree(usage_tree.get());
+  }
+  auto combined_bytes = combined.serialize().move_as_ok().size();
+  LOG(INFO) << "proofs of 100 lookups in a dictionary with 100000 keys: " << cells_time * 1e6 / 100.0
+            << "us per proof through cells, " << direct_time * 1e6 / 100.0 << "us per proof serialized directly; "
+            << direct_bytes << " bytes in separate proofs, " << combined_bytes << " bytes in one proof";
+}
+
 void test_two_bitstrings(const td::BitSlice& bs1, const td::BitSlice& bs2) {
   using td::to_binary;
   using td::to_hex;
@@ -19,12 +19,14 @@
 #include "vm/boc.h"
 #include "vm/cellslice.h"
 #include "vm/cells.h"
+#include "vm/dict.h"
 #include "common/AtomicRef.h"
 #include "vm/cells/CellString.h"
 #include "vm/cells/MerkleProof.h"
 #include "vm/cells/MerkleUpdate.h"
 #include "vm/db/CellStorage.h"
 #include "vm/db/CellHashTable.h"
+#include "vm/db/DynamicBagOfCellsDb.h"
 #include "vm/db/TonDb.h"
 #include "vm/db/StaticBagOfCellsDb.h"
 
@@ -58,6 +60,7 @@
 #include <openssl/sha.h>
 
 #include "openssl/digest.hpp"
+#include "common/sha256batch.h"
 
 namespace vm {
 
@@ -158,6 +161,50 @@ class BenchSha256Tdlib : public td::Benchmark {
     td::do_not_optimize_away(res);
   }
 };
+class BenchSha256Batch : public td::Benchmark {
+ public:
+  BenchSha256Batch(digest::Sha256Backend backend, size_t batch_size) : backend_(backend), batch_size_(batch_size) {
+  }
+  std::string get_description() const override {
+    return PSTRING() << "SHA256 " << digest::sha256_batch_backend_name(backend_) << " batch " << batch_size_;
+  }
+
+  void start_up() override {
+    // sizes of typical ordinary cell representations
+    messages_.clear();
+    hashes_.resize(batch_size_);
+    jobs_.clear();
+    for (size_t i = 0; i < batch_size_; i++) {
+      messages_.push_back(td::rand_string('a', 'z', 2 + 64 + 2 * (2 + 32)));
+    }
+    for (size_t i = 0; i < batch_size_; i++) {
+      jobs_.push_back({td::Slice(messages_[i]).ubegin(), messages_[i].size(), hashes_[i].data()});
+    }
+    old_backend_ = digest::sha256_batch_backend();
+    digest::sha256_batch_set_backend(backend_);
+  }
+  void tear_down() override {
+    digest::sha256_batch_set_backend(old_backend_);
+  }
+
+  void run(int n) override {
+    int res = 0;
+    for (int i = 0; i < n; i += static_cast<int>(batch_size_)) {
+      digest::sha256_batch(jobs_);
+      res += hashes_[0][0];
+    }
+    td::do_not_optimize_away(res);
+  }
+
+ private:
+  digest::Sha256Backend backend_;
+  digest::Sha256Backend old_backend_;
+  size_t batch_size_;
+  std::vector<std::string> messages_;
+  std::vector<std::array<unsigned char, 32>> hashes_;
+  std::vector<digest::Sha256Job> jobs_;
+};
+
 TEST(Cell, sha_benchmark) {
   bench(BenchSha256Tdlib());
   bench(BenchSha256Low());
@@ -165,6 +212,16 @@ TEST(Cell, sha_benchmark) {
   bench(BenchSha256());
 }
 
+TEST(Cell, sha_batch_benchmark) {
+  for (auto backend : {digest::Sha256Backend::OpenSSL, digest::Sha256Backend::Avx2, digest::Sha256Backend::ShaNi}) {
+    if (!digest::sha256_batch_backend_supported(backend)) {
+      continue;
+    }
+    bench(BenchSha256Batch(backend, 1));
+    bench(BenchSha256Batch(backend, 32));
+  }
+}
+
 std::string serialize_boc(Ref<Cell> cell, int mode = 31) {
   CHECK(cell.not_null());
   vm::BagOfCells boc;
@@ -1972,6 +2029,172 @@ TEST(TonDb, DynamicBocRespectsUsageCell) {
   ASSERT_STREQ(serialization, serialization_of_virtualized_cell);
 }
 
+class CountingKeyValueReader : public td::KeyValueReader {
+ public:
+  explicit CountingKeyValueReader(std::shared_ptr<td::KeyValueReader> reader) : reader_(std::move(reader)) {
+  }
+  td::Result<GetStatus> get(td::Slice key, std::string &value) override {
+    gets_++;
+    return reader_->get(key, value);
+  }
+  td::Result<size_t> count(td::Slice prefix) override {
+    return reader_->count(prefix);
+  }
+  int get_gets() const {
+    return gets_.load();
+  }
+
+ private:
+  std::shared_ptr<td::KeyValueReader> reader_;
+  std::atomic<int> gets_{0};
+};
+
+TEST(TonDb, DynamicBocPrefetch) {
+  td::Random::Xorshift128plus rnd(123);
+  vm::Dictionary dict{64};
+  std::vector<td::BitArray<64>> keys;
+  for (int i = 0; i < 1000; i++) {
+    td::BitArray<64> key;
+    key.store_ulong(rnd());
+    vm::CellBuilder cb;
+    cb.store_long(i, 32).store_ref(vm::CellBuilder().store_long(i, 32).finalize());
+    ASSERT_TRUE(dict.set_builder(key, cb));
+    keys.push_back(key);
+  }
+  auto root = vm::CellBuilder().store_long(0, 8).store_ref(dict.get_root_cell()).finalize();
+
+  auto kv = std::make_shared<td::MemoryKeyValue>();
+  {
+    auto dboc = vm::DynamicBagOfCellsDb::create();
+    dboc->set_loader(std::make_unique<vm::CellLoader>(kv));
+    dboc->inc(root);
+    dboc->prepare_commit();
+    vm::CellStorer cell_storer(*kv);
+    dboc->commit(cell_storer);
+  }
+
+  std::vector<td::ConstBitPtr> lookup_keys;
+  for (int i = 0; i < 1000; i += 37) {
+    lookup_keys.push_back(keys[i].cbits());
+  }
+  for (int threads : {1, 4}) {
+    vm::CellDbReader::set_prefetch_threads(threads);
+    auto reader = std::make_shared<CountingKeyValueReader>(kv);
+    // every call returns a new tree of cells, nothing of which is loaded yet
+    auto load_dict_root = [&] {
+      auto dboc = vm::DynamicBagOfCellsDb::create();
+      dboc->set_loader(std::make_unique<vm::CellLoader>(reader));
+      return vm::load_cell_slice(dboc->load_cell(root->get_hash().as_slice()).move_as_ok()).prefetch_ref();
+    };
+
+    // paths to some keys and the cells their values refer to
+    auto dict_root = load_dict_root();
+    vm::CellDbReader::prefetch_dict(dict_root, 64, lookup_keys, 64, 1);
+    int gets = reader->get_gets();
+    vm::Dictionary loaded_dict{dict_root, 64};
+    for (int i = 0; i < 1000; i += 37) {
+      auto value = loaded_dict.lookup(keys[i]);
+      ASSERT_TRUE(value.not_null());
+      ASSERT_EQ(i, value->prefetch_long(32));
+      ASSERT_EQ(i, vm::load_cell_slice(value->prefetch_ref()).prefetch_long(32));
+    }
+    ASSERT_EQ(gets, reader->get_gets());
+    ASSERT_TRUE(loaded_dict.lookup(keys[1]).not_null());
+    ASSERT_TRUE(gets < reader->get_gets());
+
+    // cells at most three levels below the root
+    dict_root = load_dict_root();
+    vm::CellDbReader::prefetch_subtree(dict_root, 3);
+    gets = reader->get_gets();
+    std::function<void(td::Ref<vm::Cell>, int)> walk = [&](td::Ref<vm::Cell> cell, int depth) {
+      auto cs = vm::load_cell_slice(cell);
+      for (unsigned i = 0; depth > 0 && i < cs.size_refs(); i++) {
+        walk(cs.prefetch_ref(i), depth - 1);
+      }
+    };
+    walk(dict_root, 3);
+    ASSERT_EQ(gets, reader->get_gets());
+
+    // the subdictionary of keys with a common prefix
+    dict_root = load_dict_root();
+    vm::CellDbReader::prefetch_dict(dict_root, 64, td::Span<td::ConstBitPtr>(lookup_keys.data(), 1), 6, 64);
+    gets = reader->get_gets();
+    vm::Dictionary prefix_dict{dict_root, 64};
+    int found = 0;
+    for (auto &key : keys) {
+      if (!td::bitstring::bits_memcmp(key.cbits(), lookup_keys[0], 6)) {
+        ASSERT_TRUE(prefix_dict.lookup(key).not_null());
+        found++;
+      }
+    }
+    ASSERT_TRUE(found > 1);
+    ASSERT_EQ(gets, reader->get_gets());
+  }
+  vm::CellDbReader::set_prefetch_threads(16);
+}
+
+TEST(TonDb, MerkleProofBocFromDb) {
+  td::Random::Xorshift128plus rnd(123);
+  vm::Dictionary dict{64};
+  std::vector<td::BitArray<64>> keys;
+  for (int i = 0; i < 1000; i++) {
+    td::BitArray<64> key;
+    key.store_ulong(rnd());
+    vm::CellBuilder cb;
+    cb.store_long(i, 32).store_ref(vm::CellBuilder().store_long(i, 32).finalize());
+    ASSERT_TRUE(dict.set_builder(key, cb));
+    keys.push_back(key);
+  }
+  auto root = vm::CellBuilder().store_long(0, 8).store_ref(dict.get_root_cell()).finalize();
+
+  auto kv = std::make_shared<td::MemoryKeyValue>();
+  {
+    auto dboc = vm::DynamicBagOfCellsDb::create();
+    dboc->set_loader(std::make_unique<vm::CellLoader>(kv));
+    dboc->inc(root);
+    dboc->prepare_commit();
+    vm::CellStorer cell_storer(*kv);
+    dboc->commit(cell_storer);
+  }
+
+  auto reader = std::make_shared<CountingKeyValueReader>(kv);
+  auto dboc = vm::DynamicBagOfCellsDb::create();
+  dboc->set_loader(std::make_unique<vm::CellLoader>(reader));
+  auto db_root = dboc->load_cell(root->get_hash().as_slice()).move_as_ok();
+  auto usage_tree = std::make_shared<vm::CellUsageTree>();
+  auto usage_root = vm::UsageCell::create(db_root, usage_tree->root_ptr());
+  vm::Dictionary usage_dict{vm::load_cell_slice(usage_root).prefetch_ref(), 64};
+  for (int i = 0; i < 1000; i += 37) {
+    ASSERT_TRUE(usage_dict.lookup(keys[i]).not_null());
+  }
+  // a leaf loaded outside of the usage tree is kept in the proof as it is, other leaves are pruned
+  vm::Dictionary db_dict{vm::load_cell_slice(db_root).prefetch_ref(), 64};
+  ASSERT_EQ(0, vm::load_cell_slice(db_dict.lookup(keys[0])->prefetch_ref()).prefetch_long(32));
+
+  int gets = reader->get_gets();
+  vm::MerkleProofBocBuilder builder(db_root);
+  builder.add_usage_tree(usage_tree.get());
+  for (int mode : {0, vm::BagOfCells::Mode::WithIndex | vm::BagOfCells::Mode::WithCRC32C}) {
+    auto boc = builder.serialize(mode).move_as_ok();
+    // pruned cells are not loaded
+    ASSERT_EQ(gets, reader->get_gets());
+    auto expected = vm::std_boc_serialize(vm::MerkleProof::generate(db_root, usage_tree.get()), mode).move_as_ok();
+    ASSERT_TRUE(expected.as_slice() == boc.as_slice());
+    ASSERT_EQ(gets, reader->get_gets());
+
+    auto proof = vm::std_boc_deserialize(boc).move_as_ok();
+    auto virtualized_root = vm::MerkleProof::virtualize(proof, 1);
+    ASSERT_EQ(root->get_hash(), virtualized_root->get_hash());
+    vm::Dictionary proof_dict{vm::load_cell_slice(virtualized_root).prefetch_ref(), 64};
+    for (int i = 0; i < 1000; i += 37) {
+      auto value = proof_dict.lookup(keys[i]);
+      ASSERT_TRUE(value.not_null());
+      ASSERT_EQ(i, value->prefetch_long(32));
+    }
+    ASSERT_EQ(0, vm::load_cell_slice(proof_dict.lookup(keys[0])->prefetch_ref()).prefetch_long(32));
+  }
+}
+
 TEST(TonDb, DoNotMakeListsPrunned) {
   auto cell = vm::CellBuilder().store_bytes("abc").finalize();
   auto is_prunned = [&](const td::Ref<vm::Cell> &cell) { return true; };
@@ -24,6 +24,10 @@
 #include "block/block-auto.h"
 #include "block/block.h"
 #include "block/block-parse.h"
+#include "block/account-storage-stat.h"
+#include "block/output-queue-merger.h"
+#include "block/transaction.h"
+#include "ton/ton-shard.h"
 
 #include "fift/Fift.h"
 #include "fift/words.h"
@@ -1659,3 +1663,337 @@ TEST(Smarcont, Channel) {
 #undef expect_ok
 #undef expect_code
 }
+
+TEST(Smartcont, AccountStorageStat) {
+  td::Random::Xorshift128plus rnd(123);
+  // values are picked from a small pool, so the same cells are reachable along many paths
+  std::vector<td::Ref<vm::Cell>> pool;
+  for (int i = 0; i < 64; i++) {
+    vm::CellBuilder cb;
+    cb.store_long(i, 32);
+    if (i > 0) {
+      cb.store_ref(pool[rnd() % pool.size()]);
+    }
+    pool.push_back(cb.finalize());
+  }
+  std::vector<vm::Dictionary> dicts(3, vm::Dictionary{16});
+  auto modify = [&](vm::Dictionary& dict, int count) {
+    for (int i = 0; i < count; i++) {
+      td::BitArray<16> key;
+      key.store_ulong(rnd() % 4096);
+      if (rnd() % 4 == 0) {
+        dict.lookup_delete(key);
+      } else {
+        vm::CellBuilder cb;
+        cb.store_long(rnd() % 4, 8);
+        cb.store_ref(pool[rnd() % pool.size()]);
+        dict.set_builder(key, cb);
+      }
+    }
+  };
+  auto get_roots = [&]() {
+    std::vector<td::Ref<vm::Cell>> roots;
+    for (auto& dict : dicts) {
+      roots.push_back(dict.get_root_cell());
+    }
+    return roots;
+  };
+  auto full_stat = [](const std::vector<td::Ref<vm::Cell>>& roots) {
+    vm::CellStorageStat stat;
+    for (auto& root : roots) {
+      if (root.not_null()) {
+        stat.add_used_storage(root);
+      }
+    }
+    return stat;
+  };
+
+  block::AccountStorageStat stat;
+  modify(dicts[0], 3000);
+  modify(dicts[1], 1000);
+  stat.replace_roots(get_roots()).ensure();
+  for (int step = 0; step < 100; step++) {
+    if (rnd() % 10 == 0) {
+      dicts[rnd() % 3] = dicts[rnd() % 3];
+    } else if (rnd() % 20 == 0) {
+      dicts[2] = vm::Dictionary{16};
+    } else {
+      modify(dicts[rnd() % 3], static_cast<int>(rnd() % 50));
+    }
+    auto roots = get_roots();
+    stat.replace_roots(roots).ensure();
+    auto expected = full_stat(roots);
+    ASSERT_EQ(expected.cells, stat.get_total_cells());
+    ASSERT_EQ(expected.bits, stat.get_total_bits());
+
+    vm::CellBuilder cb;
+    cb.store_long(step, 32);
+    for (auto& root : roots) {
+      cb.store_maybe_ref(root);
+    }
+    cb.store_ref(pool[rnd() % pool.size()]);
+    auto storage = cb.finalize();
+    auto expected_with = full_stat({storage});
+    auto with = stat.stat_with(storage);
+    ASSERT_EQ(expected_with.cells, with.cells);
+    ASSERT_EQ(expected_with.bits, with.bits);
+  }
+
+  // adding more than the limit fails, the old trees are not counted against it
+  auto roots = get_roots();
+  auto expected = full_stat(roots);
+  block::AccountStorageStat limited;
+  ASSERT_TRUE(limited.replace_roots(roots, expected.cells - 1).is_error());
+  block::AccountStorageStat unlimited;
+  unlimited.replace_roots(roots).ensure();
+  modify(dicts[0], 1);
+  ASSERT_TRUE(unlimited.replace_roots(get_roots(), expected.cells, expected.bits).is_ok());
+
+  // the cache returns the object by roots and keeps it consistent
+  auto cached = std::make_unique<block::AccountStorageStat>();
+  cached->replace_roots(roots).ensure();
+  block::AccountStorageStat::put_cached(std::move(cached));
+  ASSERT_TRUE(block::AccountStorageStat::take_cached(get_roots()) == nullptr);
+  cached = block::AccountStorageStat::take_cached(roots);
+  ASSERT_TRUE(cached != nullptr);
+  ASSERT_TRUE(block::AccountStorageStat::take_cached(roots) == nullptr);
+  ASSERT_TRUE(cached->same_roots(roots));
+  cached->replace_roots(get_roots()).ensure();
+  expected = full_stat(get_roots());
+  ASSERT_EQ(expected.cells, cached->get_total_cells());
+  ASSERT_EQ(expected.bits, cached->get_total_bits());
+}
+
+namespace {
+// OutMsgQueue-like dictionaries for OutputQueueMerger: the value of a message starts with its lt, which is also the
+// augmentation, the rest of EnqueuedMsg is not looked at by the merger
+struct AugQueueLt final : vm::dict::AugmentationData {
+  bool skip_extra(vm::CellSlice& cs) const override {
+    return cs.advance(64);
+  }
+  bool eval_leaf(vm::CellBuilder& cb, vm::CellSlice& val_cs) const override {
+    return cb.store_long_bool(val_cs.prefetch_ulong(64), 64);
+  }
+  bool eval_fork(vm::CellBuilder& cb, vm::CellSlice& left_cs, vm::CellSlice& right_cs) const override {
+    return cb.store_long_bool(std::min(left_cs.prefetch_ulong(64), right_cs.prefetch_ulong(64)), 64);
+  }
+  bool eval_empty(vm::CellBuilder& cb) const override {
+    return cb.store_long_bool(0, 64);
+  }
+};
+
+struct QueuedMsg {
+  td::uint64 lt;
+  td::BitArray<352> key;
+  int source;
+  bool operator<(const QueuedMsg& other) const {
+    return lt < other.lt || (lt == other.lt && td::bitstring::bits_memcmp(key.cbits() + 96, other.key.cbits() + 96,
+                                                                           256) < 0);
+  }
+};
+
+// `count` messages split between `neighbors` queues; returns the queues and the messages for shard `queue_for`
+std::pair<std::vector<block::McShardDescr>, std::vector<QueuedMsg>> gen_out_msg_queues(td::Random::Xorshift128plus& rnd,
+                                                                                       ton::ShardIdFull queue_for,
+                                                                                       int neighbors, int count) {
+  static const AugQueueLt aug;
+  std::vector<vm::AugmentedDictionary> queues(neighbors, vm::AugmentedDictionary{352, aug});
+  std::vector<QueuedMsg> expected;
+  for (int i = 0; i < count; i++) {
+    QueuedMsg msg;
+    msg.source = static_cast<int>(rnd() % neighbors);
+    // many messages share an lt, they are ordered by hash
+    msg.lt = rnd() % (count / 4 + 1) + 1000;
+    // workchain, next hop address prefix, message hash
+    msg.key.bits().store_int(queue_for.workchain, 32);
+    for (int j = 0; j < 5; j++) {
+      td::bitstring::bits_store_long_top(msg.key.bits() + 32 + 64 * j, rnd(), 64);
+    }
+    vm::CellBuilder cb;
+    cb.store_long(msg.lt, 64).store_long(i, 32);
+    CHECK(queues[msg.source].set_builder(msg.key, cb, vm::Dictionary::SetMode::Add));
+    if (ton::shard_contains(queue_for, ton::extract_addr_prefix(queue_for.workchain, (msg.key.cbits() + 32)))) {
+      expected.push_back(msg);
+    }
+  }
+  std::sort(expected.begin(), expected.end());
+  std::vector<block::McShardDescr> descrs;
+  for (int i = 0; i < neighbors; i++) {
+    block::McShardDescr descr{ton::BlockIdExt{queue_for.workchain, ton::shardIdAll, 1, {}, {}}, 0, 0};
+    descr.outmsg_root = queues[i].get_root_cell();
+    descrs.push_back(std::move(descr));
+  }
+  return {std::move(descrs), std::move(expected)};
+}
+
+void check_output_queue_merger(block::OutputQueueMerger& merger, const std::vector<QueuedMsg>& expected) {
+  for (auto& msg : expected) {
+    ASSERT_TRUE(!merger.is_eof());
+    auto kv = merger.cur();
+    ASSERT_TRUE(kv && kv->msg.not_null());
+    ASSERT_EQ(msg.lt, kv->lt);
+    ASSERT_EQ(msg.source, kv->source);
+    ASSERT_TRUE(msg.key == kv->key);
+    ASSERT_EQ(msg.lt, kv->msg->prefetch_ulong(64));
+    merger.next();
+  }
+  ASSERT_TRUE(merger.is_eof());
+}
+}  // namespace
+
+TEST(Smartcont, OutputQueueMerger) {
+  td::Random::Xorshift128plus rnd(123);
+  for (int pfx_len : {0, 1, 3}) {
+    auto queue_for = ton::shard_prefix(ton::AccountIdPrefixFull{0, 0x5000000000000000ULL}, pfx_len);
+    for (int neighbors : {1, 2, 8}) {
+      auto queues = gen_out_msg_queues(rnd, queue_for, neighbors, 2000);
+      block::OutputQueueMerger merger{queue_for, queues.first};
+      check_output_queue_merger(merger, queues.second);
+    }
+  }
+  // disabled neighbors and empty queues are skipped
+  ton::ShardIdFull queue_for{0, ton::shardIdAll};
+  auto queues = gen_out_msg_queues(rnd, queue_for, 4, 500);
+  queues.first[1].disable();
+  queues.first[2].outmsg_root.clear();
+  std::vector<QueuedMsg> expected;
+  for (auto& msg : queues.second) {
+    if (msg.source != 1 && msg.source != 2) {
+      expected.push_back(msg);
+    }
+  }
+  block::OutputQueueMerger merger{queue_for, queues.first};
+  check_output_queue_merger(merger, expected);
+}
+
+TEST(Smartcont, OutputQueueMergerBenchmark) {
+  td::Random::Xorshift128plus rnd(123);
+  ton::ShardIdFull queue_for{0, ton::shardIdAll};
+  auto queues = gen_out_msg_queues(rnd, queue_for, 16, 100000);
+  td::Timer timer;
+  block::OutputQueueMerger merger{queue_for, queues.first};
+  size_t count = 0;
+  for (; !merger.is_eof(); merger.next()) {
+    count++;
+  }
+  LOG(INFO) << "merged " << count << " messages from 16 neighbors in " << timer.elapsed() * 1e3 << "ms";
+  ASSERT_EQ(queues.second.size(), count);
+}
+
+namespace {
+
+td::Ref<vm::Cell> gen_test_config(int validators, td::uint64 gas_price) {
+  vm::Dictionary dict{32};
+  auto set_param = [&](int idx, vm::CellBuilder& cb) {
+    CHECK(dict.set_ref(td::BitArray<32>{idx}, cb.finalize()));
+  };
+  vm::CellBuilder cb;
+  CHECK(cb.store_long_bool(0x6b, 8) && block::tlb::t_Grams.store_integer_value(cb, td::BigInt256(1700000000)) &&
+        block::tlb::t_Grams.store_integer_value(cb, td::BigInt256(1000000000)));
+  set_param(14, cb);
+  vm::Dictionary prices{32};
+  for (td::uint32 since = 0; since < 3; since++) {
+    vm::CellBuilder cb2;
+    CHECK(cb2.store_long_bool(0xcc, 8) && cb2.store_long_bool(since, 32) && cb2.store_long_bool(1 + since, 64) &&
+          cb2.store_long_bool(500, 64) && cb2.store_long_bool(1000, 64) && cb2.store_long_bool(500000, 64));
+    CHECK(prices.set_builder(td::BitArray<32>{since}, cb2));
+  }
+  CHECK(dict.set_ref(td::BitArray<32>{18}, prices.get_root_cell()));
+  for (int idx : {20, 21}) {
+    CHECK(cb.store_long_bool(0xd1, 8) && cb.store_long_bool(100, 64) && cb.store_long_bool(100000, 64) &&
+          cb.store_long_bool(0xde, 8) && cb.store_long_bool(gas_price * (idx == 20 ? 10 : 1), 64) &&
+          cb.store_long_bool(1000000, 64) && cb.store_long_bool(10000000, 64) && cb.store_long_bool(10000, 64) &&
+          cb.store_long_bool(10000000, 64) && cb.store_long_bool(100000000, 64) &&
+          cb.store_long_bool(1000000000, 64));
+    set_param(idx, cb);
+  }
+  for (int idx : {24, 25}) {
+    CHECK(cb.store_long_bool(0xea, 8) && cb.store_long_bool(idx == 24 ? 10000000 : 1000000, 64) &&
+          cb.store_long_bool(655360000, 64) && cb.store_long_bool(65536000000, 64) && cb.store_long_bool(98304, 32) &&
+          cb.store_long_bool(21845, 16) && cb.store_long_bool(21845, 16));
+    set_param(idx, cb);
+  }
+  vm::Dictionary list{16};
+  for (int i = 0; i < validators; i++) {
+    vm::CellBuilder cb2;
+    td::Bits256 key;
+    td::Random::secure_bytes(key.as_slice());
+    CHECK(cb2.store_long_bool(0x73, 8) && cb2.store_long_bool(0x8e81278a, 32) && cb2.store_bits_bool(key) &&
+          cb2.store_long_bool(1000 + i, 64) && cb2.store_bits_bool(key));
+    CHECK(list.set_builder(td::BitArray<16>{i}, cb2));
+  }
+  CHECK(cb.store_long_bool(0x12, 8) && cb.store_long_bool(0, 32) && cb.store_long_bool(0x7fffffff, 32) &&
+        cb.store_long_bool(validators, 16) && cb.store_long_bool(std::min(validators, 100), 16) &&
+        cb.store_long_bool(1000 * validators + validators * (validators - 1) / 2, 64) &&
+        cb.store_maybe_ref(list.get_root_cell()));
+  set_param(34, cb);
+  return dict.get_root_cell();
+}
+
+}  // namespace
+
+TEST(Smartcont, ParsedConfig) {
+  auto root = gen_test_config(10, 1000);
+  auto config = block::Config::unpack_config(root).move_as_ok();
+  auto parsed = config->get_parsed_config().move_as_ok();
+  ASSERT_EQ(3u, parsed->storage_prices.size());
+  ASSERT_EQ(10000u, parsed->get_gas_limits_prices(true).gas_price);
+  ASSERT_EQ(1000u, parsed->get_gas_limits_prices(false).gas_price);
+  ASSERT_EQ(100000u, parsed->gas_std.flat_gas_price);
+  ASSERT_EQ(10000000u, parsed->get_msg_prices(true).lump_price);
+  ASSERT_EQ(1000000u, parsed->get_msg_prices(false).lump_price);
+  ASSERT_EQ(0, td::cmp(parsed->masterchain_create_fee, 1700000000));
+  ASSERT_EQ(0, td::cmp(parsed->basechain_create_fee, 1000000000));
+  ASSERT_TRUE(parsed->workchains.empty());
+
+  // same gas settings as unpacking the parameter directly
+  block::ComputePhaseConfig cfg1, cfg2;
+  td::RefInt256 freeze_due_limit, delete_due_limit;
+  ASSERT_TRUE(cfg1.parse_GasLimitsPrices(config->get_config_param(21), freeze_due_limit, delete_due_limit));
+  cfg2.set_gas_limits_prices(parsed->gas_std);
+  ASSERT_EQ(cfg1.gas_limit, cfg2.gas_limit);
+  ASSERT_EQ(cfg1.special_gas_limit, cfg2.special_gas_limit);
+  ASSERT_EQ(cfg1.gas_credit, cfg2.gas_credit);
+  ASSERT_EQ(cfg1.flat_gas_limit, cfg2.flat_gas_limit);
+  ASSERT_EQ(0, td::cmp(cfg1.max_gas_threshold, cfg2.max_gas_threshold));
+  ASSERT_EQ(0, td::cmp(freeze_due_limit, td::make_refint(parsed->gas_std.freeze_due_limit)));
+  ASSERT_EQ(0, td::cmp(delete_due_limit, td::make_refint(parsed->gas_std.delete_due_limit)));
+
+  // another Config object with the same root shares the parsed parameters
+  auto config2 = block::Config::unpack_config(root).move_as_ok();
+  ASSERT_EQ(parsed.get(), config2->get_parsed_config().move_as_ok().get());
+  auto config3 = block::Config::unpack_config(gen_test_config(10, 2000)).move_as_ok();
+  auto parsed3 = config3->get_parsed_config().move_as_ok();
+  ASSERT_TRUE(parsed.get() != parsed3.get());
+  ASSERT_EQ(2000u, parsed3->gas_std.gas_price);
+
+  // parameters required by the parsed config are checked
+  vm::Dictionary dict{root, 32};
+  CHECK(dict.lookup_delete(td::BitArray<32>{25}).not_null());
+  auto config4 = block::Config::unpack_config(dict.get_root_cell()).move_as_ok();
+  ASSERT_TRUE(config4->get_parsed_config().is_error());
+}
+
+TEST(Smartcont, ParsedConfigBenchmark) {
+  const int n = 1000;
+  auto root = gen_test_config(400, 1000);
+  auto config = block::Config::unpack_config(root).move_as_ok();
+  td::Timer timer;
+  for (int i = 0; i < n; i++) {
+    ASSERT_TRUE(block::ParsedConfig::unpack(*config).is_ok());
+  }
+  double unpack_time = timer.elapsed() / n;
+  timer = td::Timer();
+  for (int i = 0; i < n; i++) {
+    ASSERT_TRUE(block::Config::unpack_config(root).move_as_ok()->get_parsed_config().is_ok());
+  }
+  double cached_time = timer.elapsed() / n;
+  // external message checks used to unpack the whole configuration, including the validator set
+  timer = td::Timer();
+  for (int i = 0; i < n / 10; i++) {
+    ASSERT_TRUE(block::Config::unpack_config(root, td::Bits256::zero(), 0xffff).is_ok());
+  }
+  double full_time = timer.elapsed() / (n / 10);
+  LOG(INFO) << "prices and limits: " << unpack_time * 1e6 << "us unpacked, " << cached_time * 1e6
+            << "us cached; whole configuration with 400 validators: " << full_time * 1e6 << "us";
+}
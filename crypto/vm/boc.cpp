@@ -87,16 +87,22 @@ td::Result<int> CellSerializationInfo::get_bits(td::Slice cell) const {
 }
 
 // TODO: check usage when result is empty
-td::Result<Ref<DataCell>> CellSerializationInfo::create_data_cell(td::Slice cell_slice,
-                                                                  td::Span<Ref<Cell>> refs) const {
-  CellBuilder cb;
+td::Result<Ref<DataCell>> CellSerializationInfo::create_data_cell(td::Slice cell_slice, td::Span<Ref<Cell>> refs,
+                                                                  DataCell::Batch* batch) const {
   TRY_RESULT(bits, get_bits(cell_slice));
-  cb.store_bits(cell_slice.ubegin() + data_offset, bits);
   DCHECK(refs_cnt == (td::int64)refs.size());
-  for (int k = 0; k < refs_cnt; k++) {
-    cb.store_ref(std::move(refs[k]));
+  Ref<DataCell> res;
+  if (batch && !with_hashes) {
+    // stored hashes are checked right away, so such cells are never deferred
+    TRY_RESULT_ASSIGN(res, batch->create(td::ConstBitPtr{cell_slice.ubegin() + data_offset}, bits, refs, special));
+  } else {
+    CellBuilder cb;
+    cb.store_bits(cell_slice.ubegin() + data_offset, bits);
+    for (int k = 0; k < refs_cnt; k++) {
+      cb.store_ref(std::move(refs[k]));
+    }
+    TRY_RESULT_ASSIGN(res, cb.finalize_novm_nothrow(special));
   }
-  TRY_RESULT(res, cb.finalize_novm_nothrow(special));
   CHECK(!res.is_null());
   if (res->is_special() != special) {
     return td::Status::Error("is_special mismatch");
@@ -182,6 +188,7 @@ int BagOfCells::add_root(td::Ref<vm::Cell> add_root) {
 }
 
 // Changes in this function may require corresponding changes in crypto/vm/large-boc-serializer.cpp
+// and in crypto/vm/cells/MerkleProof.cpp
 td::Status BagOfCells::import_cells() {
   cells_clear();
   for (auto& root : roots) {
@@ -200,6 +207,7 @@ td::Status BagOfCells::import_cells() {
 }
 
 // Changes in this function may require corresponding changes in crypto/vm/large-boc-serializer.cpp
+// and in crypto/vm/cells/MerkleProof.cpp
 td::Result<int> BagOfCells::import_cell(td::Ref<vm::Cell> cell, int depth) {
   if (depth > max_depth) {
     return td::Status::Error("error while importing a cell into a bag of cells: cell depth too large");
@@ -250,6 +258,7 @@ td::Result<int> BagOfCells::import_cell(td::Ref<vm::Cell> cell, int depth) {
 }
 
 // Changes in this function may require corresponding changes in crypto/vm/large-boc-serializer.cpp
+// and in crypto/vm/cells/MerkleProof.cpp
 void BagOfCells::reorder_cells() {
   int_hashes = 0;
   for (int i = cell_count - 1; i >= 0; --i) {
@@ -328,6 +337,7 @@ void BagOfCells::reorder_cells() {
 // force=1 : visit (allocate and process all children)
 // force=2 : allocate (assign a new index; can be run only after visiting)
 // Changes in this function may require corresponding changes in crypto/vm/large-boc-serializer.cpp
+// and in crypto/vm/cells/MerkleProof.cpp
 int BagOfCells::revisit(int cell_idx, int force) {
   DCHECK(cell_idx >= 0 && cell_idx < cell_count);
   CellInfo& dci = cell_list_[cell_idx];
@@ -375,6 +385,7 @@ int BagOfCells::revisit(int cell_idx, int force) {
 }
 
 // Changes in this function may require corresponding changes in crypto/vm/large-boc-serializer.cpp
+// and in crypto/vm/cells/MerkleProof.cpp
 td::uint64 BagOfCells::compute_sizes(int mode, int& r_size, int& o_size) {
   int rs = 0, os = 0;
   if (!root_count || !data_bytes) {
@@ -402,6 +413,7 @@ td::uint64 BagOfCells::compute_sizes(int mode, int& r_size, int& o_size) {
 }
 
 // Changes in this function may require corresponding changes in crypto/vm/large-boc-serializer.cpp
+// and in crypto/vm/cells/MerkleProof.cpp
 std::size_t BagOfCells::estimate_serialized_size(int mode) {
   if ((mode & Mode::WithCacheBits) && !(mode & Mode::WithIndex)) {
     info.invalidate();
@@ -494,6 +506,7 @@ std::string BagOfCells::extract_string() const {
 //  cell_data:(tot_cells_size * [ uint8 ])
 //  = BagOfCells;
 // Changes in this function may require corresponding changes in crypto/vm/large-boc-serializer.cpp
+// and in crypto/vm/cells/MerkleProof.cpp
 template<typename WriterT>
 std::size_t BagOfCells::serialize_to_impl(WriterT& writer, int mode) {
   auto store_ref = [&](unsigned long long value) {
@@ -740,7 +753,8 @@ td::Result<td::Slice> BagOfCells::get_cell_slice(int idx, td::Slice data) {
 
 td::Result<td::Ref<vm::DataCell>> BagOfCells::deserialize_cell(int idx, td::Slice cells_slice,
                                                                td::Span<td::Ref<DataCell>> cells_span,
-                                                               std::vector<td::uint8>* cell_should_cache) {
+                                                               std::vector<td::uint8>* cell_should_cache,
+                                                               DataCell::Batch* batch) {
   TRY_RESULT(cell_slice, get_cell_slice(idx, cells_slice));
   std::array<td::Ref<Cell>, 4> refs_buf;
 
@@ -762,7 +776,12 @@ td::Result<td::Ref<vm::DataCell>> BagOfCells::deserialize_cell(int idx, td::Slic
                                         << " is to non-existent cell #" << ref_idx << ", only " << cell_count
                                         << " cells are defined");
     }
-    refs[k] = cells_span[cell_count - ref_idx - 1];
+    auto ref_pos = static_cast<size_t>(cell_count - ref_idx - 1);
+    if (batch && batch->is_pending(cells_span[ref_pos].get())) {
+      // the child is still waiting for its hash
+      batch->flush();
+    }
+    refs[k] = cells_span[ref_pos];
     if (cell_should_cache) {
       auto& cnt = (*cell_should_cache)[ref_idx];
       if (cnt < 2) {
@@ -771,7 +790,7 @@ td::Result<td::Ref<vm::DataCell>> BagOfCells::deserialize_cell(int idx, td::Slic
     }
   }
 
-  return cell_info.create_data_cell(cell_slice, refs);
+  return cell_info.create_data_cell(cell_slice, refs, batch);
 }
 
 td::Result<long long> BagOfCells::deserialize(const td::Slice& data, int max_roots) {
@@ -859,10 +878,13 @@ td::Result<long long> BagOfCells::deserialize(const td::Slice& data, int max_roo
   std::vector<Ref<DataCell>> cell_list;
   cell_list.reserve(cell_count);
   std::array<td::Ref<Cell>, 4> refs_buf;
+  // cells not referencing each other are hashed together
+  DataCell::Batch batch;
   for (int i = 0; i < cell_count; i++) {
     // reconstruct cell with index cell_count - 1 - i
     int idx = cell_count - 1 - i;
-    auto r_cell = deserialize_cell(idx, cells_slice, cell_list, info.has_cache_bits ? &cell_should_cache : nullptr);
+    auto r_cell =
+        deserialize_cell(idx, cells_slice, cell_list, info.has_cache_bits ? &cell_should_cache : nullptr, &batch);
     if (r_cell.is_error()) {
       return td::Status::Error(PSLICE() << "invalid bag-of-cells failed to deserialize cell #" << idx << " "
                                         << r_cell.error());
@@ -870,6 +892,7 @@ td::Result<long long> BagOfCells::deserialize(const td::Slice& data, int max_roo
     cell_list.push_back(r_cell.move_as_ok());
     DCHECK(cell_list.back().not_null());
   }
+  batch.flush();
   if (info.has_cache_bits) {
     for (int idx = 0; idx < cell_count; idx++) {
       auto should_cache = cell_should_cache[idx] > 1;
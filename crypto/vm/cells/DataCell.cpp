@@ -18,14 +18,97 @@
 */
 #include "vm/cells/DataCell.h"
 
-#include "openssl/digest.hpp"
-
 #include "td/utils/ScopeGuard.h"
+#include "td/utils/port/thread_local.h"
 
 #include "vm/cells/CellWithStorage.h"
 
+#include <atomic>
+#include <cstring>
+#include <thread>
+
 namespace vm {
-std::unique_ptr<DataCell> DataCell::create_empty_data_cell(Info info) {
+// An ordinary level 0 cell whose hash is computed on first use, see DataCell::LazyHashing
+class LazyDataCell : public DataCell {
+ public:
+  explicit LazyDataCell(Info info) : DataCell(std::move(info)) {
+  }
+
+ private:
+  enum : td::uint8 { hash_pending, hash_computing, hash_ready };
+  mutable std::atomic<td::uint8> hash_state_{hash_pending};
+
+  const Hash do_get_hash(td::uint32 level) const override {
+    if (hash_state_.load(std::memory_order_acquire) != hash_ready) {
+      compute_hash();
+    }
+    return DataCell::do_get_hash(level);
+  }
+
+  void compute_hash() const {
+    // children are hashed before taking the cell, so a thread never waits while holding one
+    for (unsigned i = 0; i < get_refs_cnt(); i++) {
+      get_ref_raw_ptr(i)->get_hash(0);
+    }
+    auto state = static_cast<td::uint8>(hash_pending);
+    if (!hash_state_.compare_exchange_strong(state, hash_computing, std::memory_order_acq_rel)) {
+      while (hash_state_.load(std::memory_order_acquire) != hash_ready) {
+        std::this_thread::yield();
+      }
+      return;
+    }
+    unsigned char repr[2 + max_bytes + max_refs * (depth_bytes + hash_bytes)];
+    size_t repr_size = 0;
+    repr[repr_size++] = info_.d1();
+    repr[repr_size++] = info_.d2();
+    auto data_size = (get_bits() + 7) >> 3;
+    std::memcpy(repr + repr_size, get_data(), data_size);
+    repr_size += data_size;
+    for (unsigned i = 0; i < get_refs_cnt(); i++) {
+      store_depth(repr + repr_size, get_ref_raw_ptr(i)->get_depth(0));
+      repr_size += depth_bytes;
+    }
+    for (unsigned i = 0; i < get_refs_cnt(); i++) {
+      std::memcpy(repr + repr_size, get_ref_raw_ptr(i)->get_hash(0).as_slice().data(), hash_bytes);
+      repr_size += hash_bytes;
+    }
+    auto* storage = const_cast<LazyDataCell*>(this)->get_storage();
+    digest::sha256(td::Slice(repr, repr_size), info_.get_hashes(storage)[0].as_slice().ubegin());
+    count_hashes(1);
+    hash_state_.store(hash_ready, std::memory_order_release);
+  }
+};
+
+namespace {
+TD_THREAD_LOCAL int lazy_hashing_depth;
+TD_THREAD_LOCAL td::int64 thread_hashes;
+}  // namespace
+
+void DataCell::count_hashes(td::int64 cnt) {
+  get_thread_safe_counter_hashes().add(cnt);
+  thread_hashes += cnt;
+}
+
+td::int64 DataCell::get_thread_hashes() {
+  return thread_hashes;
+}
+
+DataCell::LazyHashing::LazyHashing() {
+  lazy_hashing_depth++;
+}
+
+DataCell::LazyHashing::~LazyHashing() {
+  lazy_hashing_depth--;
+}
+
+bool DataCell::LazyHashing::is_enabled() {
+  return lazy_hashing_depth > 0;
+}
+
+std::unique_ptr<DataCell> DataCell::create_empty_data_cell(Info info, bool lazy) {
+  if (lazy) {
+    return detail::CellWithUniquePtrStorage<LazyDataCell>::create(info.get_storage_size(), info);
+  }
   return detail::CellWithUniquePtrStorage<DataCell>::create(info.get_storage_size(), info);
 }
 
@@ -61,7 +144,7 @@ DataCell::SpecialType DataCell::special_type() const {
 }
 
 td::Result<Ref<DataCell>> DataCell::create(td::ConstBitPtr data, unsigned bits, td::MutableSpan<Ref<Cell>> refs,
-                                           bool special) {
+                                           bool special, Batch* batch) {
   for (auto& ref : refs) {
     if (ref.is_null()) {
       return td::Status::Error("Has null cell reference");
@@ -188,7 +271,10 @@ td::Result<Ref<DataCell>> DataCell::create(td::ConstBitPtr data, unsigned bits,
   info.hash_count_ = hash_count & 7;
   info.virtualization_ = virtualization & 7;
 
-  auto data_cell = create_empty_data_cell(info);
+  // only cells whose hash depends on nothing but data and children's level 0 hashes are hashed lazily
+  bool lazy = batch == nullptr && type == SpecialType::Ordinary && level_mask.get_level() == 0 &&
+              LazyHashing::is_enabled();
+  auto data_cell = create_empty_data_cell(info, lazy);
   auto* storage = data_cell->get_storage();
 
   // init data
@@ -211,6 +297,25 @@ td::Result<Ref<DataCell>> DataCell::create(td::ConstBitPtr data, unsigned bits,
   auto* hashes_ptr = info.get_hashes(storage);
   auto* depth_ptr = info.get_depth(storage);
 
+  if (lazy) {
+    td::uint16 depth = 0;
+    for (int i = 0; i < info.refs_count_; i++) {
+      depth = std::max(depth, refs_ptr[i]->get_depth(0));
+    }
+    if (info.refs_count_ != 0) {
+      if (depth >= max_depth) {
+        return td::Status::Error("Depth is too big");
+      }
+      depth++;
+    }
+    depth_ptr[0] = depth;
+    return Ref<DataCell>(data_cell.release(), Ref<DataCell>::acquire_t{});
+  }
+
+  // a cell with a single hash does not depend on its own hashes and can be hashed later
+  bool deferred = batch != nullptr && hash_count == 1;
+  unsigned char local_repr[Batch::max_repr_size];
+
   // NB: be careful with special cells
   auto total_hash_count = level_mask.get_hashes_count();
   auto hash_i_offset = total_hash_count - hash_count;
@@ -224,22 +329,20 @@ td::Result<Ref<DataCell>> DataCell::create(td::ConstBitPtr data, unsigned bits,
     if (hash_i < hash_i_offset) {
       continue;
     }
-    unsigned char tmp[2];
-    tmp[0] = info.d1(level_mask.apply(level_i));
-    tmp[1] = info.d2();
-
-    static TD_THREAD_LOCAL digest::SHA256* hasher;
-    td::init_thread_local<digest::SHA256>(hasher);
-    hasher->reset();
-
-    hasher->feed(td::Slice(tmp, 2));
+    unsigned char* repr = deferred ? batch->next_repr() : local_repr;
+    size_t repr_size = 0;
+    repr[repr_size++] = info.d1(level_mask.apply(level_i));
+    repr[repr_size++] = info.d2();
 
     if (hash_i == hash_i_offset) {
       DCHECK(level_i == 0 || type == SpecialType::PrunnedBranch);
-      hasher->feed(td::Slice(data_ptr, (bits + 7) >> 3));
+      auto data_size = (bits + 7) >> 3;
+      std::memcpy(repr + repr_size, data_ptr, data_size);
+      repr_size += data_size;
     } else {
       DCHECK(level_i != 0 && type != SpecialType::PrunnedBranch);
-      hasher->feed(hashes_ptr[hash_i - hash_i_offset - 1].as_slice());
+      std::memcpy(repr + repr_size, hashes_ptr[hash_i - hash_i_offset - 1].as_slice().data(), hash_bytes);
+      repr_size += hash_bytes;
     }
 
     auto dest_i = hash_i - hash_i_offset;
@@ -255,9 +358,8 @@ td::Result<Ref<DataCell>> DataCell::create(td::ConstBitPtr data, unsigned bits,
       }
 
       // add depth into hash
-      td::uint8 child_depth_buf[depth_bytes];
-      store_depth(child_depth_buf, child_depth);
-      hasher->feed(td::Slice(child_depth_buf, depth_bytes));
+      store_depth(repr + repr_size, child_depth);
+      repr_size += depth_bytes;
 
       depth = std::max(depth, child_depth);
     }
@@ -272,13 +374,21 @@ td::Result<Ref<DataCell>> DataCell::create(td::ConstBitPtr data, unsigned bits,
     // children hash
     for (int i = 0; i < info.refs_count_; i++) {
       if (type == SpecialType::MerkleProof || type == SpecialType::MerkleUpdate) {
-        hasher->feed(refs_ptr[i]->get_hash(level_i + 1).as_slice());
+        std::memcpy(repr + repr_size, refs_ptr[i]->get_hash(level_i + 1).as_slice().data(), hash_bytes);
       } else {
-        hasher->feed(refs_ptr[i]->get_hash(level_i).as_slice());
+        std::memcpy(repr + repr_size, refs_ptr[i]->get_hash(level_i).as_slice().data(), hash_bytes);
       }
+      repr_size += hash_bytes;
     }
-    auto extracted_size = hasher->extract(hashes_ptr[dest_i].as_slice());
-    DCHECK(extracted_size == hash_bytes);
+    DCHECK(repr_size <= Batch::max_repr_size);
+    if (deferred) {
+      auto* hash = hashes_ptr[dest_i].as_slice().ubegin();
+      Ref<DataCell> res(data_cell.release(), Ref<DataCell>::acquire_t{});
+      batch->add(res, repr_size, hash);
+      return res;
+    }
+    digest::sha256(td::Slice(repr, repr_size), hashes_ptr[dest_i].as_slice().ubegin());
+    count_hashes(1);
   }
 
   return Ref<DataCell>(data_cell.release(), Ref<DataCell>::acquire_t{});
@@ -296,6 +406,35 @@ const DataCell::Hash DataCell::do_get_hash(td::uint32 level) const {
   return info_.get_hashes(get_storage())[hash_i];
 }
 
+td::Result<Ref<DataCell>> DataCell::Batch::create(td::ConstBitPtr data, unsigned bits, td::Span<Ref<Cell>> refs,
+                                                  bool special) {
+  std::array<Ref<Cell>, max_refs> copied_refs;
+  CHECK(refs.size() <= copied_refs.size());
+  for (size_t i = 0; i < refs.size(); i++) {
+    copied_refs[i] = refs[i];
+  }
+  return DataCell::create(std::move(data), bits, td::MutableSpan<Ref<Cell>>(copied_refs.data(), refs.size()), special,
+                          this);
+}
+
+void DataCell::Batch::add(Ref<DataCell> cell, size_t repr_size, unsigned char* hash) {
+  jobs_.push_back(digest::Sha256Job{next_repr(), repr_size, hash});
+  cells_.push_back(std::move(cell));
+  if (cells_.size() >= max_size) {
+    flush();
+  }
+}
+
+void DataCell::Batch::flush() {
+  if (jobs_.empty()) {
+    return;
+  }
+  digest::sha256_batch(jobs_);
+  count_hashes(static_cast<td::int64>(jobs_.size()));
+  jobs_.clear();
+  cells_.clear();
+}
+
 td::uint16 DataCell::do_get_depth(td::uint32 level) const {
   auto hash_i = get_level_mask().apply(level).get_hash_i();
   if (special_type() == SpecialType::PrunnedBranch) {
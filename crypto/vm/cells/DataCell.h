@@ -23,6 +23,11 @@
 
 #include "td/utils/ThreadSafeCounter.h"
 
+#include "common/sha256batch.h"
+
+#include <array>
+#include <vector>
+
 namespace vm {
 
 class DataCell : public Cell {
@@ -179,6 +184,12 @@ class DataCell : public Cell {
   static td::int64 get_total_data_cells() {
     return get_thread_safe_counter().sum();
   }
+  // number of representation hashes computed so far
+  static td::int64 get_total_hashes() {
+    return get_thread_safe_counter_hashes().sum();
+  }
+  // same for the current thread only
+  static td::int64 get_thread_hashes();
 
   template <class StorerT>
   void store(StorerT& storer) const {
@@ -187,6 +198,60 @@ class DataCell : public Cell {
     storer.store_slice(td::Slice(get_data(), (get_bits() + 7) / 8));
   }
 
+  // Creates cells whose representation hashes are computed together, for bulk paths like
+  // BagOfCells::deserialize. Cells with a single hash are only hashed on flush(), so until then
+  // they must not be hashed, serialized or referenced by other cells. flush() is also called when
+  // the batch fills up and on destruction.
+  class Batch {
+   public:
+    Batch() = default;
+    Batch(const Batch& other) = delete;
+    Batch& operator=(const Batch& other) = delete;
+    ~Batch() {
+      flush();
+    }
+    td::Result<Ref<DataCell>> create(td::ConstBitPtr data, unsigned bits, td::Span<Ref<Cell>> refs, bool special);
+    // number of cells waiting for their hashes
+    size_t size() const {
+      return cells_.size();
+    }
+    // cells created with more than one hash are not deferred, so pending cells are not always the last ones created
+    bool is_pending(const Cell* cell) const {
+      for (auto& pending : cells_) {
+        if (pending.get() == cell) {
+          return true;
+        }
+      }
+      return false;
+    }
+    void flush();
+
+   private:
+    friend class DataCell;
+    enum { max_size = 32, max_repr_size = 2 + max_bytes + max_refs * (depth_bytes + hash_bytes) };
+    std::vector<Ref<DataCell>> cells_;
+    std::vector<digest::Sha256Job> jobs_;
+    std::array<unsigned char, max_size * max_repr_size> repr_;
+
+    unsigned char* next_repr() {
+      return repr_.data() + jobs_.size() * max_repr_size;
+    }
+    void add(Ref<DataCell> cell, size_t repr_size, unsigned char* hash);
+  };
+
+  // While an object of this class exists, ordinary cells created by the current thread compute their hash on the
+  // first get_hash() instead of in create(). Meant for code building intermediate structures (e.g. dictionaries
+  // updated key by key) whose cells are mostly discarded before anybody needs their hashes.
+  // Hashes are the same in both modes, and lazily hashed cells may be shared between threads.
+  class LazyHashing {
+   public:
+    LazyHashing();
+    LazyHashing(const LazyHashing& other) = delete;
+    LazyHashing& operator=(const LazyHashing& other) = delete;
+    ~LazyHashing();
+    static bool is_enabled();
+  };
+
  protected:
   static constexpr auto max_storage_size = max_refs * sizeof(void*) + (max_level + 1) * hash_bytes + max_bytes;
 
@@ -195,15 +260,25 @@ class DataCell : public Cell {
     static auto res = td::NamedThreadSafeCounter::get_default().get_counter("DataCell");
     return res;
   }
-  static std::unique_ptr<DataCell> create_empty_data_cell(Info info);
+  static td::NamedThreadSafeCounter::CounterRef get_thread_safe_counter_hashes() {
+    static auto res = td::NamedThreadSafeCounter::get_default().get_counter("DataCellHash");
+    return res;
+  }
+  static void count_hashes(td::int64 cnt);
+  static std::unique_ptr<DataCell> create_empty_data_cell(Info info, bool lazy);
+
+  friend class LazyDataCell;
 
+ protected:
   const Hash do_get_hash(td::uint32 level) const override;
   td::uint16 do_get_depth(td::uint32 level) const override;
 
+ private:
+
   friend class CellBuilder;
   static td::Result<Ref<DataCell>> create(td::ConstBitPtr data, unsigned bits, td::Span<Ref<Cell>> refs, bool special);
   static td::Result<Ref<DataCell>> create(td::ConstBitPtr data, unsigned bits, td::MutableSpan<Ref<Cell>> refs,
-                                          bool special);
+                                          bool special, Batch* batch = nullptr);
 };
 
 std::ostream& operator<<(std::ostream& os, const DataCell& c);
@@ -20,10 +20,17 @@
 #include "vm/cells/CellBuilder.h"
 #include "vm/cells/CellSlice.h"
 #include "vm/boc.h"
+#include "vm/boc-writers.h"
 
+#include "td/utils/bits.h"
 #include "td/utils/HashMap.h"
 #include "td/utils/HashSet.h"
 
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <limits>
+
 namespace vm {
 namespace detail {
 class MerkleProofImpl {
@@ -365,6 +372,395 @@ Ref<Cell> MerkleProof::combine_fast_raw(Ref<Cell> a, Ref<Cell> b) {
   return res.move_as_ok();
 }
 
+namespace detail {
+// Builds the bag of cells of MerkleProof::generate(root, is_prunned) in the standard way (equivalent to
+// the implementation in crypto/vm/boc.cpp) from the original cells: a cell of the proof is either
+// the original cell, a pruned branch of it, or the original data with other references and level.
+// Changes in boc.cpp may require corresponding changes here
+class MerkleProofBocSerializer {
+ public:
+  explicit MerkleProofBocSerializer(const td::HashSet<Cell::Hash> &visited_cells) : visited_cells_(visited_cells) {
+  }
+  td::Result<td::BufferSlice> serialize(Ref<Cell> root, int mode);
+
+ private:
+  struct CellInfo {
+    std::array<int, 4> ref_idx;
+    unsigned char ref_num{0};
+    unsigned char wt;
+    int new_idx{-1};
+    Cell::LevelMask level_mask;
+    bool unchanged;  // the cell of the proof is the original cell
+    size_t data_offset;
+    size_t data_size;  // d1, d2 and data
+    bool is_special() const {
+      return !wt;
+    }
+  };
+  using Key = std::pair<Cell::Hash, int>;
+
+  const td::HashSet<Cell::Hash> &visited_cells_;
+  // (hash, merkle depth) of an original cell -> index of its cell in the proof
+  td::HashMap<Key, int> proof_cells_;
+  // Cells of the proof are identified by the hash of the original cell and by -1 if the cell is unchanged,
+  // merkle_depth if references were replaced, or -2 - merkle_depth for a pruned branch, so equal cells of the proof
+  // are stored once without computing their hashes. The only exception is a cell with replaced references equal to
+  // a cell of non-zero level of the original tree, which is then stored twice; the proof itself is the same.
+  td::HashMap<Key, int> cells_;
+  std::vector<CellInfo> cell_list_;
+  std::vector<CellInfo> cell_list_tmp_;
+  std::vector<unsigned char> data_;
+  int cell_count_{0}, int_refs_{0}, rv_idx_{0};
+  unsigned long long data_bytes_{0};
+
+  td::Result<int> import_cell(Ref<Cell> cell, int merkle_depth, int depth);
+  td::Result<int> do_import_cell(Ref<Cell> cell, int merkle_depth, int depth);
+  td::Result<int> import_pruned_branch(const Cell &cell, int merkle_depth);
+  int add_cell(Key key, CellInfo info, const unsigned char *data, size_t size);
+  int reorder_cells(int root_idx);
+  int revisit(int cell_idx, int force = 0);
+};
+
+td::Result<int> MerkleProofBocSerializer::import_cell(Ref<Cell> cell, int merkle_depth, int depth) {
+  if (depth > Cell::max_depth) {
+    return td::Status::Error("error while importing a cell into a bag of cells: cell depth too large");
+  }
+  Key key{cell->get_hash(), merkle_depth};
+  auto it = proof_cells_.find(key);
+  if (it != proof_cells_.end()) {
+    return it->second;
+  }
+  TRY_RESULT(idx, do_import_cell(std::move(cell), merkle_depth, depth));
+  proof_cells_.emplace(key, idx);
+  return idx;
+}
+
+td::Result<int> MerkleProofBocSerializer::do_import_cell(Ref<Cell> cell, int merkle_depth, int depth) {
+  if (cell->get_virtualization() != 0) {
+    return td::Status::Error(
+        "error while importing a cell into a bag of cells: cell has non-zero virtualization level");
+  }
+  auto hash = cell->get_hash();
+  unsigned char buf[Cell::max_serialized_bytes];
+  CellInfo info;
+  info.ref_num = 0;
+  info.wt = 1;
+  info.unchanged = true;
+  bool visited = visited_cells_.count(hash) != 0;
+  if (!visited && !cell->is_loaded()) {
+    // pruned cells are not loaded, see CellBuilder::create_pruned_branch()
+    return import_pruned_branch(*cell, merkle_depth);
+  }
+  auto r_loaded_dc = cell->load_cell();
+  if (r_loaded_dc.is_error()) {
+    return td::Status::Error("error while importing a cell into a bag of cells: " +
+                             r_loaded_dc.move_as_error().to_string());
+  }
+  auto dc = r_loaded_dc.move_as_ok().data_cell;
+  info.level_mask = dc->get_level_mask();
+  if (dc->size_refs() == 0) {
+    // loaded leaves are kept as they are, see CellBuilder::create_pruned_branch()
+    int size = dc->serialize(buf, sizeof(buf));
+    if (dc->special_type() == Cell::SpecialType::PrunnedBranch) {
+      // equal to a pruned branch of the cell whose hashes it keeps
+      int level = dc->get_level();
+      return add_cell(Key{dc->get_hash(level - 1), -1 - level}, info, buf, size);
+    }
+    return add_cell(Key{hash, -1}, info, buf, size);
+  }
+  if (!visited) {
+    return import_pruned_branch(*dc, merkle_depth);
+  }
+
+  CellSlice cs(NoVm(), dc);
+  int child_merkle_depth = cs.child_merkle_depth(merkle_depth);
+  std::array<int, 4> refs;
+  std::fill(refs.begin(), refs.end(), -1);
+  Cell::LevelMask level_mask;
+  unsigned sum_child_wt = 1;
+  for (unsigned i = 0; i < cs.size_refs(); i++) {
+    TRY_RESULT(ref, import_cell(cs.prefetch_ref(i), child_merkle_depth, depth + 1));
+    refs[i] = ref;
+    const auto &child = cell_list_[ref];
+    sum_child_wt += child.wt;
+    level_mask = level_mask.apply_or(child.level_mask);
+    info.unchanged &= child.unchanged;
+  }
+  if (cs.special_type() == Cell::SpecialType::MerkleProof || cs.special_type() == Cell::SpecialType::MerkleUpdate) {
+    level_mask = level_mask.shift_right();
+  }
+  info.ref_idx = refs;
+  info.ref_num = static_cast<unsigned char>(cs.size_refs());
+  info.wt = static_cast<unsigned char>(std::min(0xffU, sum_child_wt));
+  info.level_mask = level_mask;
+  int size = dc->serialize(buf, sizeof(buf));
+  buf[0] = static_cast<unsigned char>(info.ref_num + 8 * dc->is_special() + 32 * level_mask.get_mask());
+  return add_cell(Key{hash, info.unchanged ? -1 : merkle_depth}, info, buf, size);
+}
+
+// same cell as CellBuilder::create_pruned_branch(cell, merkle_depth + 1) for a cell with references or not loaded;
+// only the hashes and depths of the cell are used
+td::Result<int> MerkleProofBocSerializer::import_pruned_branch(const Cell &cell, int merkle_depth) {
+  auto level_mask = cell.get_level_mask();
+  auto level = level_mask.get_level();
+  if (static_cast<td::uint32>(merkle_depth) < level) {
+    return td::Status::Error("cannot create a pruned branch of a cell with a too big level");
+  }
+  unsigned char buf[Cell::max_serialized_bytes];
+  CellInfo info;
+  info.ref_num = 0;
+  info.wt = 1;
+  info.level_mask = level_mask.apply_or(Cell::LevelMask::one_level(merkle_depth + 1));
+  info.unchanged = false;
+  size_t size = 4 + level_mask.get_hashes_count() * (Cell::hash_bytes + Cell::depth_bytes);
+  buf[0] = static_cast<unsigned char>(8 + 32 * info.level_mask.get_mask());
+  buf[1] = static_cast<unsigned char>((size - 2) * 2);
+  buf[2] = static_cast<unsigned char>(Cell::SpecialType::PrunnedBranch);
+  buf[3] = static_cast<unsigned char>(info.level_mask.get_mask());
+  auto ptr = buf + 4;
+  for (td::uint32 i = 0; i <= level; i++) {
+    if (level_mask.is_significant(i)) {
+      std::memcpy(ptr, cell.get_hash(i).as_slice().ubegin(), Cell::hash_bytes);
+      ptr += Cell::hash_bytes;
+    }
+  }
+  for (td::uint32 i = 0; i <= level; i++) {
+    if (level_mask.is_significant(i)) {
+      auto cell_depth = cell.get_depth(i);
+      *ptr++ = static_cast<unsigned char>(cell_depth >> 8);
+      *ptr++ = static_cast<unsigned char>(cell_depth & 0xff);
+    }
+  }
+  return add_cell(Key{cell.get_hash(), -2 - merkle_depth}, info, buf, size);
+}
+
+int MerkleProofBocSerializer::add_cell(Key key, CellInfo info, const unsigned char *data, size_t size) {
+  auto res = cells_.emplace(key, cell_count_);
+  if (!res.second) {
+    // children of an equal cell are already present, so no cells were added while importing them
+    return res.first->second;
+  }
+  int_refs_ += info.ref_num;
+  data_bytes_ += size;
+  info.data_offset = data_.size();
+  info.data_size = size;
+  data_.insert(data_.end(), data, data + size);
+  cell_list_.push_back(info);
+  return cell_count_++;
+}
+
+int MerkleProofBocSerializer::reorder_cells(int root_idx) {
+  for (int i = cell_count_ - 1; i >= 0; --i) {
+    CellInfo &dci = cell_list_[i];
+    int s = dci.ref_num, c = s, sum = BagOfCells::max_cell_whs - 1, mask = 0;
+    for (int j = 0; j < s; ++j) {
+      CellInfo &dcj = cell_list_[dci.ref_idx[j]];
+      int limit = (BagOfCells::max_cell_whs - 1 + j) / s;
+      if (dcj.wt <= limit) {
+        sum -= dcj.wt;
+        --c;
+        mask |= (1 << j);
+      }
+    }
+    if (c) {
+      for (int j = 0; j < s; ++j) {
+        if (!(mask & (1 << j))) {
+          CellInfo &dcj = cell_list_[dci.ref_idx[j]];
+          int limit = sum++ / c;
+          if (dcj.wt > limit) {
+            dcj.wt = static_cast<unsigned char>(limit);
+          }
+        }
+      }
+    }
+  }
+  for (int i = 0; i < cell_count_; i++) {
+    CellInfo &dci = cell_list_[i];
+    int s = dci.ref_num, sum = 1;
+    for (int j = 0; j < s; ++j) {
+      sum += cell_list_[dci.ref_idx[j]].wt;
+    }
+    DCHECK(sum <= BagOfCells::max_cell_whs);
+    if (sum <= dci.wt) {
+      dci.wt = static_cast<unsigned char>(sum);
+    } else {
+      dci.wt = 0;
+    }
+  }
+  rv_idx_ = 0;
+  cell_list_tmp_.clear();
+  cell_list_tmp_.reserve(cell_count_);
+  revisit(root_idx, 0);
+  revisit(root_idx, 1);
+  revisit(root_idx, 2);
+  DCHECK(rv_idx_ == cell_count_);
+  root_idx = cell_list_[root_idx].new_idx;
+  cell_list_ = std::move(cell_list_tmp_);
+  cell_list_tmp_.clear();
+  return root_idx;
+}
+
+int MerkleProofBocSerializer::revisit(int cell_idx, int force) {
+  DCHECK(cell_idx >= 0 && cell_idx < cell_count_);
+  CellInfo &dci = cell_list_[cell_idx];
+  if (dci.new_idx >= 0) {
+    return dci.new_idx;
+  }
+  if (!force) {
+    // previsit
+    if (dci.new_idx != -1) {
+      // already previsited or visited
+      return dci.new_idx;
+    }
+    int n = dci.ref_num;
+    for (int j = n - 1; j >= 0; --j) {
+      int child_idx = dci.ref_idx[j];
+      // either previsit or visit child, depending on whether it is special
+      revisit(dci.ref_idx[j], cell_list_[child_idx].is_special());
+    }
+    return dci.new_idx = -2;  // mark as previsited
+  }
+  if (force > 1) {
+    // time to allocate
+    auto i = dci.new_idx = rv_idx_++;
+    cell_list_tmp_.push_back(dci);
+    return i;
+  }
+  if (dci.new_idx == -3) {
+    // already visited
+    return dci.new_idx;
+  }
+  if (dci.is_special()) {
+    // if current cell is special, previsit it first
+    revisit(cell_idx, 0);
+  }
+  // visit children
+  int n = dci.ref_num;
+  for (int j = n - 1; j >= 0; --j) {
+    revisit(dci.ref_idx[j], 1);
+  }
+  // allocate children
+  for (int j = n - 1; j >= 0; --j) {
+    dci.ref_idx[j] = revisit(dci.ref_idx[j], 2);
+  }
+  return dci.new_idx = -3;  // mark as visited (and all children processed)
+}
+
+td::Result<td::BufferSlice> MerkleProofBocSerializer::serialize(Ref<Cell> root, int mode) {
+  if (root.is_null()) {
+    return td::Status::Error("cannot serialize a null cell reference into a bag of cells");
+  }
+  if (mode & ~(BagOfCells::Mode::WithIndex | BagOfCells::Mode::WithCRC32C)) {
+    return td::Status::Error("unsupported bag of cells serialization mode");
+  }
+  if (root->get_level() != 0) {
+    return td::Status::Error("cannot create Merkle proof");
+  }
+  TRY_RESULT(proof_idx, import_cell(root, 0, 1));
+
+  // the MerkleProof cell, see CellBuilder::create_merkle_proof()
+  unsigned char buf[Cell::max_serialized_bytes];
+  CellInfo info;
+  info.ref_idx = {proof_idx, -1, -1, -1};
+  info.ref_num = 1;
+  info.wt = static_cast<unsigned char>(std::min(0xffU, 1U + cell_list_[proof_idx].wt));
+  info.level_mask = cell_list_[proof_idx].level_mask.shift_right();
+  info.unchanged = false;
+  buf[0] = static_cast<unsigned char>(1 + 8 + 32 * info.level_mask.get_mask());
+  buf[1] = static_cast<unsigned char>((1 + Cell::hash_bytes + Cell::depth_bytes) * 2);
+  buf[2] = static_cast<unsigned char>(Cell::SpecialType::MerkleProof);
+  std::memcpy(buf + 3, root->get_hash(0).as_slice().ubegin(), Cell::hash_bytes);
+  auto root_depth = root->get_depth(0);
+  buf[3 + Cell::hash_bytes] = static_cast<unsigned char>(root_depth >> 8);
+  buf[4 + Cell::hash_bytes] = static_cast<unsigned char>(root_depth & 0xff);
+  int root_idx = add_cell(Key{root->get_hash(), std::numeric_limits<int>::max()}, info, buf,
+                         3 + Cell::hash_bytes + Cell::depth_bytes);
+  root_idx = reorder_cells(root_idx);
+
+  int ref_byte_size = 0, offset_byte_size = 0;
+  while (cell_count_ >= (1LL << (ref_byte_size << 3))) {
+    ref_byte_size++;
+  }
+  td::uint64 data_size = data_bytes_ + static_cast<unsigned long long>(int_refs_) * ref_byte_size;
+  while (data_size >= (1ULL << (offset_byte_size << 3))) {
+    offset_byte_size++;
+  }
+  if (ref_byte_size > 4 || offset_byte_size > 8) {
+    return td::Status::Error("bag of cells is too big");
+  }
+  bool has_index = mode & BagOfCells::Mode::WithIndex;
+  bool has_crc32c = mode & BagOfCells::Mode::WithCRC32C;
+  size_t total_size = 4 + 1 + 1 + 3 * ref_byte_size + offset_byte_size + ref_byte_size +
+                      (has_index ? cell_count_ * offset_byte_size : 0) + data_size + (has_crc32c ? 4 : 0);
+  td::BufferSlice res(total_size);
+  boc_writers::BufferWriter writer{res.as_slice().ubegin(), res.as_slice().ubegin() + total_size};
+  writer.store_uint(BagOfCells::Info::boc_generic, 4);
+  writer.store_uint((has_index ? 1 << 7 : 0) | (has_crc32c ? 1 << 6 : 0) | ref_byte_size, 1);
+  writer.store_uint(offset_byte_size, 1);
+  writer.store_uint(cell_count_, ref_byte_size);
+  writer.store_uint(1, ref_byte_size);
+  writer.store_uint(0, ref_byte_size);
+  writer.store_uint(data_size, offset_byte_size);
+  writer.store_uint(cell_count_ - 1 - root_idx, ref_byte_size);
+  if (has_index) {
+    std::size_t offs = 0;
+    for (int i = cell_count_ - 1; i >= 0; --i) {
+      offs += cell_list_[i].data_size + cell_list_[i].ref_num * ref_byte_size;
+      writer.store_uint(offs, offset_byte_size);
+    }
+  }
+  for (int i = 0; i < cell_count_; ++i) {
+    const auto &dc_info = cell_list_[cell_count_ - 1 - i];
+    writer.store_bytes(data_.data() + dc_info.data_offset, dc_info.data_size);
+    for (unsigned j = 0; j < dc_info.ref_num; ++j) {
+      int k = cell_count_ - 1 - dc_info.ref_idx[j];
+      DCHECK(k > i && k < cell_count_);
+      writer.store_uint(k, ref_byte_size);
+    }
+  }
+  if (has_crc32c) {
+    unsigned crc = writer.get_crc32();
+    writer.store_uint(td::bswap32(crc), 4);
+  }
+  CHECK(writer.empty());
+  return std::move(res);
+}
+}  // namespace detail
+
+MerkleProofBocBuilder::MerkleProofBocBuilder(Ref<Cell> root) : root_(std::move(root)) {
+}
+
+void MerkleProofBocBuilder::add_usage_tree(CellUsageTree *usage_tree) {
+  dfs_usage_tree(root_, usage_tree, usage_tree->root_id());
+}
+
+void MerkleProofBocBuilder::dfs_usage_tree(Ref<Cell> cell, CellUsageTree *usage_tree, CellUsageTree::NodeId node_id) {
+  if (!usage_tree->is_loaded(node_id)) {
+    return;
+  }
+  visited_cells_.insert(cell->get_hash());
+  CellSlice cs(NoVm(), cell);
+  for (unsigned i = 0; i < cs.size_refs(); i++) {
+    dfs_usage_tree(cs.prefetch_ref(i), usage_tree, usage_tree->get_child(node_id, i));
+  }
+}
+
+Ref<Cell> MerkleProofBocBuilder::extract_proof() const {
+  return MerkleProof::generate(root_, [&](const Ref<Cell> &cell) { return !visited_cells_.count(cell->get_hash()); });
+}
+
+td::Result<td::BufferSlice> MerkleProofBocBuilder::serialize(int mode) const {
+  if (mode & ~(BagOfCells::Mode::WithIndex | BagOfCells::Mode::WithCRC32C)) {
+    // hashes and cache bits need the cells of the proof
+    Ref<Cell> proof_root = extract_proof();
+    if (proof_root.is_null()) {
+      return td::Status::Error("cannot create Merkle proof");
+    }
+    return std_boc_serialize(std::move(proof_root), mode);
+  }
+  return detail::MerkleProofBocSerializer(visited_cells_).serialize(root_, mode);
+}
+
 MerkleProofBuilder::MerkleProofBuilder(Ref<Cell> root)
     : usage_tree(std::make_shared<CellUsageTree>()), orig_root(std::move(root)) {
   usage_root = UsageCell::create(orig_root, usage_tree->root_ptr());
@@ -393,12 +789,12 @@ bool MerkleProofBuilder::extract_proof_to(Ref<Cell> &proof_root) const {
 }
 
 td::Result<td::BufferSlice> MerkleProofBuilder::extract_proof_boc() const {
-  Ref<Cell> proof_root = extract_proof();
-  if (proof_root.is_null()) {
+  if (orig_root.is_null()) {
     return td::Status::Error("cannot create Merkle proof");
-  } else {
-    return std_boc_serialize(std::move(proof_root));
   }
+  MerkleProofBocBuilder builder{orig_root};
+  builder.add_usage_tree(usage_tree.get());
+  return builder.serialize();
 }
 
 }  // namespace vm
@@ -19,6 +19,7 @@
 #pragma once
 #include "vm/cells/Cell.h"
 #include "td/utils/buffer.h"
+#include "td/utils/HashSet.h"
 
 #include <utility>
 #include <functional>
@@ -51,6 +52,24 @@ class MerkleProof {
   static Ref<Cell> combine_fast_raw(Ref<Cell> a, Ref<Cell> b);
 };
 
+// Serializes a Merkle proof of `root` straight into a bag of cells, without creating the cells of the proof.
+// Several usage trees of the same root may be added; the proof covers the cells loaded through any of them.
+// serialize() returns the same bytes as std_boc_serialize(MerkleProof::generate(root, ...), mode), unless the tree
+// already contains proofs of its own cells (see detail::MerkleProofBocSerializer); the proof is the same then.
+class MerkleProofBocBuilder {
+ public:
+  explicit MerkleProofBocBuilder(Ref<Cell> root);
+  void add_usage_tree(CellUsageTree *usage_tree);
+  Ref<Cell> extract_proof() const;
+  td::Result<td::BufferSlice> serialize(int mode = 0) const;
+
+ private:
+  Ref<Cell> root_;
+  td::HashSet<Cell::Hash> visited_cells_;
+
+  void dfs_usage_tree(Ref<Cell> cell, CellUsageTree *usage_tree, CellUsageTree::NodeId node_id);
+};
+
 class MerkleProofBuilder {
   std::shared_ptr<CellUsageTree> usage_tree;
   Ref<vm::Cell> orig_root, usage_root;
@@ -18,29 +18,159 @@
 */
 #include "vm/cells/MerkleUpdate.h"
 #include "vm/cells/MerkleProof.h"
+#include "common/worker-pool.h"
 
 #include "td/utils/HashMap.h"
 #include "td/utils/HashSet.h"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <tuple>
+
 namespace vm {
 namespace detail {
+namespace {
+std::atomic<int> merkle_threads{std::max(1, std::min(8, static_cast<int>(std::thread::hardware_concurrency())))};
+std::atomic<int> merkle_split_depth{5};
+
+using Key = std::pair<Cell::Hash, int>;
+
+inline const Cell::Hash &key_hash(const Cell::Hash &key) {
+  return key;
+}
+inline const Cell::Hash &key_hash(const Key &key) {
+  return key.first;
+}
+
+// Hash table split into shards by cell hash, each shard is locked only if the table is used by several threads
+template <class KeyT, class ValueT>
+class CellHashTable {
+ public:
+  explicit CellHashTable(bool concurrent) : concurrent_(concurrent) {
+  }
+  // returns false if the key is already present
+  bool emplace(const KeyT &key, ValueT value) {
+    auto &shard = get_shard(key);
+    auto lock = lock_shard(shard);
+    return shard.map.emplace(key, std::move(value)).second;
+  }
+  bool find(const KeyT &key, ValueT &value) {
+    auto &shard = get_shard(key);
+    auto lock = lock_shard(shard);
+    auto it = shard.map.find(key);
+    if (it == shard.map.end()) {
+      return false;
+    }
+    value = it->second;
+    return true;
+  }
+  bool contains(const KeyT &key) {
+    auto &shard = get_shard(key);
+    auto lock = lock_shard(shard);
+    return shard.map.count(key) != 0;
+  }
+  void clear() {
+    for (auto &shard : shards_) {
+      shard.map.clear();
+    }
+  }
+
+ private:
+  struct Shard {
+    std::mutex mutex;
+    td::HashMap<KeyT, ValueT> map;
+  };
+  bool concurrent_;
+  std::array<Shard, 64> shards_;
+
+  Shard &get_shard(const KeyT &key) {
+    return shards_[key_hash(key).as_slice().ubegin()[0] % shards_.size()];
+  }
+  std::unique_lock<std::mutex> lock_shard(Shard &shard) {
+    return concurrent_ ? std::unique_lock<std::mutex>(shard.mutex) : std::unique_lock<std::mutex>();
+  }
+};
+
+// Collects the distinct non-pruned subtrees found at depth `split_depth` of the tree
+void collect_subtrees(Ref<Cell> cell, int merkle_depth, int depth, int split_depth, td::HashSet<Key> &visited,
+                      std::vector<std::pair<Ref<Cell>, int>> &subtrees) {
+  if (!visited.emplace(cell->get_hash(), merkle_depth).second) {
+    return;
+  }
+  CellSlice cs(NoVm(), cell);
+  if (cs.special_type() == Cell::SpecialType::PrunnedBranch) {
+    return;
+  }
+  if (depth == split_depth) {
+    subtrees.emplace_back(std::move(cell), merkle_depth);
+    return;
+  }
+  int child_merkle_depth = cs.child_merkle_depth(merkle_depth);
+  for (unsigned i = 0; i < cs.size_refs(); i++) {
+    collect_subtrees(cs.prefetch_ref(i), child_merkle_depth, depth + 1, split_depth, visited, subtrees);
+  }
+}
+
+std::vector<std::pair<Ref<Cell>, int>> collect_subtrees(Ref<Cell> root, int merkle_depth, int split_depth) {
+  td::HashSet<Key> visited;
+  std::vector<std::pair<Ref<Cell>, int>> subtrees;
+  collect_subtrees(std::move(root), merkle_depth, 0, split_depth, visited, subtrees);
+  return subtrees;
+}
+}  // namespace
+
+// Both trees are walked in two phases: first the cells down to the split depth on the calling thread, collecting
+// the subtrees found there, then these subtrees on the worker pool. Cells already visited by any thread are skipped.
+// The remaining walk from the root then only finds the results of the subtrees in the shared tables.
 class MerkleUpdateApply {
  public:
+  explicit MerkleUpdateApply(MerkleUpdate::Parallelism parallelism)
+      : parallelism_(parallelism)
+      , parallel_(parallelism.threads > 1)
+      , known_cells_(parallel_)
+      , visited_(parallel_)
+      , ready_cells_(parallel_) {
+  }
+
   Ref<Cell> apply(Ref<Cell> from, Ref<Cell> update_from, Ref<Cell> update_to, td::uint32 from_level,
                   td::uint32 to_level) {
     if (from_level != from->get_level()) {
       return {};
     }
-    dfs_both(from, update_from, from_level);
+    if (!parallel_) {
+      dfs_both(from, update_from, from_level);
+      return dfs(update_to, to_level);
+    }
+    std::vector<std::tuple<Ref<Cell>, Ref<Cell>, int>> both_subtrees;
+    dfs_both(from, update_from, from_level, 0, &both_subtrees);
+    td::WorkerPool::get().run(both_subtrees.size(), parallelism_.threads, [&](size_t i) {
+      dfs_both(std::get<0>(both_subtrees[i]), std::get<1>(both_subtrees[i]), std::get<2>(both_subtrees[i]));
+    });
+    auto subtrees = collect_subtrees(update_to, to_level, parallelism_.split_depth);
+    td::WorkerPool::get().run(subtrees.size(), parallelism_.threads,
+                          [&](size_t i) { dfs(subtrees[i].first, subtrees[i].second); });
     return dfs(update_to, to_level);
   }
 
  private:
-  using Key = std::pair<Cell::Hash, int>;
-  td::HashMap<Cell::Hash, Ref<Cell>> known_cells_;
-  td::HashMap<Key, Ref<Cell>> ready_cells_;
-
-  void dfs_both(Ref<Cell> original, Ref<Cell> update_from, int merkle_depth) {
+  MerkleUpdate::Parallelism parallelism_;
+  bool parallel_;
+  CellHashTable<Cell::Hash, Ref<Cell>> known_cells_;
+  CellHashTable<Key, bool> visited_;
+  CellHashTable<Key, Ref<Cell>> ready_cells_;
+
+  void dfs_both(Ref<Cell> original, Ref<Cell> update_from, int merkle_depth, int depth = 0,
+                std::vector<std::tuple<Ref<Cell>, Ref<Cell>, int>> *subtrees = nullptr) {
+    if (subtrees && depth == parallelism_.split_depth) {
+      subtrees->emplace_back(std::move(original), std::move(update_from), merkle_depth);
+      return;
+    }
+    if (!visited_.emplace(Key{update_from->get_hash(), merkle_depth}, true)) {
+      return;
+    }
     CellSlice cs_update_from(NoVm(), update_from);
     known_cells_.emplace(original->get_hash(merkle_depth), original);
     if (cs_update_from.special_type() == Cell::SpecialType::PrunnedBranch) {
@@ -50,7 +180,7 @@ class MerkleUpdateApply {
 
     CellSlice cs_original(NoVm(), original);
     for (unsigned i = 0; i < cs_original.size_refs(); i++) {
-      dfs_both(cs_original.prefetch_ref(i), cs_update_from.prefetch_ref(i), child_merkle_depth);
+      dfs_both(cs_original.prefetch_ref(i), cs_update_from.prefetch_ref(i), child_merkle_depth, depth + 1, subtrees);
     }
   }
 
@@ -58,19 +188,17 @@ class MerkleUpdateApply {
     CellSlice cs(NoVm(), cell);
     if (cs.special_type() == Cell::SpecialType::PrunnedBranch) {
       if ((int)cell->get_level() == merkle_depth + 1) {
-        auto it = known_cells_.find(cell->get_hash(merkle_depth));
-        if (it != known_cells_.end()) {
-          return it->second;
-        }
-        return {};
+        Ref<Cell> res;
+        known_cells_.find(cell->get_hash(merkle_depth), res);
+        return res;
       }
       return cell;
     }
     Key key{cell->get_hash(), merkle_depth};
     {
-      auto it = ready_cells_.find(key);
-      if (it != ready_cells_.end()) {
-        return it->second;
+      Ref<Cell> res;
+      if (ready_cells_.find(key, res)) {
+        return res;
       }
     }
 
@@ -93,40 +221,72 @@ class MerkleUpdateApply {
 
 class MerkleUpdateValidator {
  public:
+  explicit MerkleUpdateValidator(MerkleUpdate::Parallelism parallelism)
+      : parallelism_(parallelism)
+      , parallel_(parallelism.threads > 1)
+      , known_cells_(parallel_)
+      , visited_from_(parallel_)
+      , visited_to_(parallel_) {
+  }
+
   td::Status validate(Ref<Cell> update_from, Ref<Cell> update_to, td::uint32 from_level, td::uint32 to_level) {
-    dfs_from(update_from, from_level);
+    if (!parallel_) {
+      dfs_from(update_from, from_level);
+      return dfs_to(update_to, to_level);
+    }
+    std::vector<std::pair<Ref<Cell>, int>> subtrees;
+    dfs_from(update_from, from_level, 0, &subtrees);
+    td::WorkerPool::get().run(subtrees.size(), parallelism_.threads,
+                          [&](size_t i) { dfs_from(subtrees[i].first, subtrees[i].second); });
+    subtrees = collect_subtrees(update_to, to_level, parallelism_.split_depth);
+    std::atomic<bool> failed{false};
+    td::WorkerPool::get().run(subtrees.size(), parallelism_.threads, [&](size_t i) {
+      if (dfs_to(subtrees[i].first, subtrees[i].second).is_error()) {
+        failed = true;
+      }
+    });
+    if (failed) {
+      // walk again in the sequential order to report the same error
+      visited_to_.clear();
+    }
     return dfs_to(update_to, to_level);
   }
 
  private:
-  td::HashSet<Cell::Hash> known_cells_;
-  using Key = std::pair<Cell::Hash, int>;
-  td::HashSet<Key> visited_from_;
-  td::HashSet<Key> visited_to_;
-
-  void dfs_from(Ref<Cell> cell, int merkle_depth) {
-    if (!visited_from_.emplace(cell->get_hash(), merkle_depth).second) {
+  MerkleUpdate::Parallelism parallelism_;
+  bool parallel_;
+  CellHashTable<Cell::Hash, bool> known_cells_;
+  CellHashTable<Key, bool> visited_from_;
+  CellHashTable<Key, bool> visited_to_;
+
+  void dfs_from(Ref<Cell> cell, int merkle_depth, int depth = 0,
+                std::vector<std::pair<Ref<Cell>, int>> *subtrees = nullptr) {
+    if (subtrees && depth == parallelism_.split_depth) {
+      subtrees->emplace_back(std::move(cell), merkle_depth);
+      return;
+    }
+    if (!visited_from_.emplace(Key{cell->get_hash(), merkle_depth}, true)) {
       return;
     }
     CellSlice cs(NoVm(), cell);
-    known_cells_.insert(cell->get_hash(merkle_depth));
+    known_cells_.emplace(cell->get_hash(merkle_depth), true);
     if (cs.special_type() == Cell::SpecialType::PrunnedBranch) {
       return;
     }
     int child_merkle_depth = cs.child_merkle_depth(merkle_depth);
     for (unsigned i = 0; i < cs.size_refs(); i++) {
-      dfs_from(cs.prefetch_ref(i), child_merkle_depth);
+      dfs_from(cs.prefetch_ref(i), child_merkle_depth, depth + 1, subtrees);
     }
   }
 
   td::Status dfs_to(Ref<Cell> cell, int merkle_depth) {
-    if (!visited_to_.emplace(cell->get_hash(), merkle_depth).second) {
+    if (!visited_to_.emplace(Key{cell->get_hash(), merkle_depth}, true)) {
       return td::Status::OK();
     }
     CellSlice cs(NoVm(), cell);
     if (cs.special_type() == Cell::SpecialType::PrunnedBranch) {
       if ((int)cell->get_level() == merkle_depth + 1) {
-        if (known_cells_.count(cell->get_hash(merkle_depth)) == 0) {
+        if (!known_cells_.contains(cell->get_hash(merkle_depth))) {
           return td::Status::Error(PSLICE()
                                    << "Unknown prunned cell (validate): " << cell->get_hash(merkle_depth).to_hex());
         }
@@ -143,6 +303,16 @@ class MerkleUpdateValidator {
 };
 }  // namespace detail
 
+MerkleUpdate::Parallelism MerkleUpdate::get_parallelism() {
+  return {detail::merkle_threads.load(std::memory_order_relaxed),
+          detail::merkle_split_depth.load(std::memory_order_relaxed)};
+}
+
+void MerkleUpdate::set_parallelism(Parallelism parallelism) {
+  detail::merkle_threads.store(std::max(parallelism.threads, 1), std::memory_order_relaxed);
+  detail::merkle_split_depth.store(std::max(parallelism.split_depth, 0), std::memory_order_relaxed);
+}
+
 td::Status MerkleUpdate::may_apply(Ref<Cell> from, Ref<Cell> update) {
   if (update->get_level() != 0 || from->get_level() != 0) {
     return td::Status::Error("Level of update of from is not zero");
@@ -178,7 +348,8 @@ Ref<Cell> MerkleUpdate::apply_raw(Ref<Cell> from, Ref<Cell> update_from, Ref<Cel
                << ", applied to value with hash = " << from->get_hash(from_level).to_hex();
     return {};
   }
-  return detail::MerkleUpdateApply().apply(from, std::move(update_from), std::move(update_to), from_level, to_level);
+  return detail::MerkleUpdateApply(get_parallelism())
+      .apply(from, std::move(update_from), std::move(update_to), from_level, to_level);
 }
 
 std::pair<Ref<Cell>, Ref<Cell>> MerkleUpdate::generate_raw(Ref<Cell> from, Ref<Cell> to, CellUsageTree *usage_tree) {
@@ -198,7 +369,8 @@ std::pair<Ref<Cell>, Ref<Cell>> MerkleUpdate::generate_raw(Ref<Cell> from, Ref<C
 
 td::Status MerkleUpdate::validate_raw(Ref<Cell> update_from, Ref<Cell> update_to, td::uint32 from_level,
                                       td::uint32 to_level) {
-  return detail::MerkleUpdateValidator().validate(std::move(update_from), std::move(update_to), from_level, to_level);
+  return detail::MerkleUpdateValidator(get_parallelism())
+      .validate(std::move(update_from), std::move(update_to), from_level, to_level);
 }
 
 td::Status MerkleUpdate::validate(Ref<Cell> update) {
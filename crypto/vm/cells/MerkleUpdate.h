@@ -46,5 +46,14 @@ class MerkleUpdate {
                                  td::uint32 to_level);
 
   static Ref<Cell> combine(Ref<Cell> ab, Ref<Cell> bc);
+
+  // apply() and validate() hand the subtrees found at `split_depth` to a pool of worker threads, using at most
+  // `threads` threads including the calling one. The results do not depend on these settings.
+  struct Parallelism {
+    int threads;
+    int split_depth;
+  };
+  static Parallelism get_parallelism();
+  static void set_parallelism(Parallelism parallelism);
 };
 }  // namespace vm
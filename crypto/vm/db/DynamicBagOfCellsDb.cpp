@@ -21,6 +21,8 @@
 #include "vm/db/CellHashTable.h"
 
 #include "vm/cells/ExtCell.h"
+#include "vm/dict.h"
+#include "common/worker-pool.h"
 
 #include "td/utils/base64.h"
 #include "td/utils/format.h"
@@ -28,6 +30,9 @@
 
 #include "vm/cellslice.h"
 
+#include <algorithm>
+#include <atomic>
+
 namespace vm {
 namespace {
 
@@ -576,6 +581,157 @@ class DynamicBagOfCellsDbImpl : public DynamicBagOfCellsDb, private ExtCellCreat
 };
 }  // namespace
 
+namespace {
+std::atomic<int> prefetch_threads{16};
+
+// Walks a tree level by level: all cells of a level are loaded in parallel, then the cells of the next level are
+// selected by the hints of the cells that led to them.
+class CellPrefetcher {
+ public:
+  explicit CellPrefetcher(size_t max_cells) : max_cells_(max_cells) {
+  }
+  CellPrefetcher(size_t max_cells, int key_len, int prefix_len, int subtree_depth)
+      : max_cells_(max_cells), key_len_(key_len), prefix_len_(prefix_len), subtree_depth_(subtree_depth) {
+  }
+
+  // `cell` with `depth` more levels below it
+  void add_subtree(Ref<Cell> cell, int depth) {
+    add({std::move(cell), depth, -1, 0});
+  }
+  // path to `key` from the dictionary root `cell`
+  void add_key(Ref<Cell> cell, td::ConstBitPtr key) {
+    keys_.push_back(key);
+    add({std::move(cell), 0, static_cast<int>(keys_.size()) - 1, 0});
+  }
+
+  void run() {
+    while (!level_.empty()) {
+      load_level();
+      std::vector<Entry> level = std::move(level_);
+      level_.clear();
+      for (auto &entry : level) {
+        try {
+          expand(entry);
+        } catch (VmError &) {
+          // not a valid dictionary node, the traversal will fail on it as well
+        }
+      }
+    }
+  }
+
+ private:
+  struct Entry {
+    Ref<Cell> cell;
+    int depth;
+    int key;  // index in keys_ for a dictionary node, -1 for a subtree
+    int pos;  // key bits before the label of the node
+  };
+  size_t max_cells_;
+  size_t visited_ = 0;
+  int key_len_ = 0;
+  int prefix_len_ = 0;
+  int subtree_depth_ = 0;
+  std::vector<td::ConstBitPtr> keys_;  // dictionary nodes refer to their key by index
+  std::vector<Entry> level_;
+
+  void add(Entry entry) {
+    if (entry.cell.not_null() && visited_ < max_cells_) {
+      visited_++;
+      level_.push_back(std::move(entry));
+    }
+  }
+
+  void load_level() {
+    std::vector<const Cell *> to_load;
+    for (auto &entry : level_) {
+      if (!entry.cell->is_loaded()) {
+        to_load.push_back(entry.cell.get());
+      }
+    }
+    // several keys may lead to the same node
+    std::sort(to_load.begin(), to_load.end());
+    to_load.erase(std::unique(to_load.begin(), to_load.end()), to_load.end());
+    int threads = static_cast<int>(std::min<size_t>(to_load.size(), prefetch_threads.load(std::memory_order_relaxed)));
+    if (threads <= 1) {
+      for (auto cell : to_load) {
+        cell->load_cell().ignore();
+      }
+      return;
+    }
+    td::WorkerPool::get().run(to_load.size(), threads, [&](size_t i) { to_load[i]->load_cell().ignore(); });
+  }
+
+  void add_children(const Ref<DataCell> &cell, int depth) {
+    if (depth <= 0) {
+      return;
+    }
+    for (unsigned i = 0; i < cell->size_refs(); i++) {
+      add_subtree(cell->get_ref(i), depth - 1);
+    }
+  }
+
+  void expand(Entry &entry) {
+    auto r_loaded = entry.cell->load_cell();
+    if (r_loaded.is_error()) {
+      return;
+    }
+    auto data_cell = r_loaded.move_as_ok().data_cell;
+    if (entry.key < 0) {
+      add_children(data_cell, entry.depth);
+      return;
+    }
+    auto key = keys_[entry.key];
+    int n = key_len_ - entry.pos;
+    int rest = prefix_len_ - entry.pos;
+    dict::LabelParser label{Ref<Cell>(data_cell), n, dict::LabelParser::chk_none};
+    if (!label.is_valid()) {
+      return;
+    }
+    if (label.l_bits >= rest) {
+      // the path ends in this node: a leaf or the root of the subdictionary with the requested prefix
+      if (label.has_prefix(key + entry.pos, rest)) {
+        add_children(data_cell, subtree_depth_);
+      }
+      return;
+    }
+    if (!label.is_prefix_of(key + entry.pos, rest)) {
+      return;
+    }
+    int pos = entry.pos + label.l_bits;
+    auto child = label.remainder->prefetch_ref(key[pos] ? 1 : 0);
+    if (pos + 1 == prefix_len_) {
+      add_subtree(std::move(child), subtree_depth_);
+    } else {
+      add({std::move(child), 0, entry.key, pos + 1});
+    }
+  }
+};
+}  // namespace
+
+void CellDbReader::prefetch_dict(td::Span<Ref<Cell>> dict_roots, int key_len, td::Span<td::ConstBitPtr> keys,
+                                 int prefix_len, int subtree_depth, size_t max_cells) {
+  prefix_len = std::max(0, std::min(prefix_len, key_len));
+  CellPrefetcher prefetcher{max_cells, key_len, prefix_len, subtree_depth};
+  for (auto &root : dict_roots) {
+    for (auto key : keys) {
+      prefetcher.add_key(root, key);
+    }
+  }
+  prefetcher.run();
+}
+
+void CellDbReader::prefetch_subtree(td::Span<Ref<Cell>> roots, int max_depth, size_t max_cells) {
+  CellPrefetcher prefetcher{max_cells};
+  for (auto &root : roots) {
+    prefetcher.add_subtree(root, max_depth);
+  }
+  prefetcher.run();
+}
+
+void CellDbReader::set_prefetch_threads(int threads) {
+  prefetch_threads = std::max(threads, 1);
+}
+
 std::unique_ptr<DynamicBagOfCellsDb> DynamicBagOfCellsDb::create() {
   return std::make_unique<DynamicBagOfCellsDbImpl>();
 }
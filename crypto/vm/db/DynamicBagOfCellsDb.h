@@ -20,6 +20,7 @@
 #include "vm/cells.h"
 
 #include "td/utils/Slice.h"
+#include "td/utils/Span.h"
 #include "td/utils/Status.h"
 #include "td/actor/PromiseFuture.h"
 
@@ -39,6 +40,22 @@ class CellDbReader {
  public:
   virtual ~CellDbReader() = default;
   virtual td::Result<Ref<DataCell>> load_cell(td::Slice hash) = 0;
+
+  // Prefetch hints: cells that a traversal of a lazily loaded tree is going to need are loaded ahead of it.
+  // Cells are loaded level by level and the loads of one level run in parallel, so a traversal over a cold cache waits
+  // for a few waves of database reads instead of a chain of sequential ones. Loaded data is kept by the cells of the
+  // tree, so the traversal must use the same tree (e.g. not a copy wrapped in usage cells, which would also record the
+  // prefetched cells as used). Load errors are ignored: the traversal reports them itself.
+
+  // Paths to `keys` in each of the dictionaries (Hashmap) with roots `dict_roots` and `key_len`-bit keys. Only the first
+  // `prefix_len` bits of each key are used; below the node where a path ends (a leaf if prefix_len == key_len, otherwise
+  // the root of the subdictionary of keys with that prefix) `subtree_depth` more levels are loaded.
+  static void prefetch_dict(td::Span<Ref<Cell>> dict_roots, int key_len, td::Span<td::ConstBitPtr> keys, int prefix_len,
+                            int subtree_depth = 0, size_t max_cells = 1 << 16);
+  // `roots` and the cells at most `max_depth` levels below them, nearest levels first
+  static void prefetch_subtree(td::Span<Ref<Cell>> roots, int max_depth, size_t max_cells = 1 << 16);
+  // number of parallel loads, 1 loads sequentially
+  static void set_prefetch_threads(int threads);
 };
 
 class DynamicBagOfCellsDb {
@@ -24,6 +24,8 @@
 
 #include "td/utils/bits.h"
 
+#include <algorithm>
+
 namespace vm {
 
 /*
@@ -1202,6 +1204,196 @@ Ref<Cell> Dictionary::lookup_delete_ref(td::ConstBitPtr key, int key_len) {
   return extract_value_ref(lookup_delete(key, key_len));
 }
 
+/*
+ *
+ *   Batch updates
+ *
+ */
+
+namespace {
+
+inline bool batch_is_insert(const DictionaryFixed::BatchUpdate& upd) {
+  return upd.value.not_null() && upd.mode != Dictionary::SetMode::Replace;
+}
+
+inline int batch_common_prefix_len(td::ConstBitPtr a, td::ConstBitPtr b, int len) {
+  std::size_t same = 0;
+  td::bitstring::bits_memcmp(a, b, len, &same);
+  return (int)same;
+}
+
+// updates are sorted and share the key bits before `pos`, so they are split by the bit at `pos`
+inline const DictionaryFixed::BatchUpdate* batch_split(const DictionaryFixed::BatchUpdate* from,
+                                                        const DictionaryFixed::BatchUpdate* to, int pos) {
+  return std::partition_point(from, to, [pos](const DictionaryFixed::BatchUpdate& upd) { return !upd.key[pos]; });
+}
+
+}  // namespace
+
+// creates a fork node with label `label` and children c1, c2; if one of the children is empty, the remaining one
+// is merged into the edge leading to it
+Ref<Cell> DictionaryFixed::dict_batch_fork(td::ConstBitPtr label, int l_bits, Ref<Cell> c1, Ref<Cell> c2,
+                                           int n) const {
+  if (c1.not_null() && c2.not_null()) {
+    CellBuilder cb;
+    append_dict_label(cb, label, l_bits, n);
+    return finish_create_fork(cb, std::move(c1), std::move(c2), n - l_bits);
+  }
+  if (c1.is_null() && c2.is_null()) {
+    return {};
+  }
+  bool sw_bit = c2.not_null();
+  unsigned char buffer[Dictionary::max_key_bytes];
+  td::BitPtr bw{buffer};
+  bw.concat(label, l_bits);
+  bw.concat_same(sw_bit, 1);
+  LabelParser label2{sw_bit ? std::move(c2) : std::move(c1), n - l_bits - 1, label_mode()};
+  bw += label2.extract_label_to(bw);
+  CellBuilder cb;
+  append_dict_label(cb, td::ConstBitPtr{buffer}, bw.offs, n);
+  if (!cell_builder_add_slice_bool(cb, *label2.remainder)) {
+    throw VmError{Excno::cell_ov, "cannot change label of an old dictionary cell while merging edges"};
+  }
+  return cb.finalize();
+}
+
+// builds a subdictionary containing only the keys inserted by updates [from, to)
+Ref<Cell> DictionaryFixed::dict_build_batch(int n, const BatchUpdate* from, const BatchUpdate* to,
+                                            int& applied) const {
+  // deletions and replacements of absent keys do nothing
+  while (from < to && !batch_is_insert(*from)) {
+    ++from;
+  }
+  while (from < to && !batch_is_insert(to[-1])) {
+    --to;
+  }
+  if (from == to) {
+    return {};
+  }
+  int offs = key_bits - n;
+  CellBuilder cb;
+  if (to - from == 1) {
+    ++applied;
+    append_dict_label(cb, from->key + offs, n, n);
+    return finish_create_leaf(cb, *from->value);
+  }
+  int pfx_len = batch_common_prefix_len(from->key + offs, to[-1].key + offs, n);
+  assert(pfx_len < n);
+  auto mid = batch_split(from, to, offs + pfx_len);
+  auto c1 = dict_build_batch(n - pfx_len - 1, from, mid, applied);
+  auto c2 = dict_build_batch(n - pfx_len - 1, mid, to, applied);
+  append_dict_label(cb, from->key + offs, pfx_len, n);
+  return finish_create_fork(cb, std::move(c1), std::move(c2), n - pfx_len);
+}
+
+Ref<Cell> DictionaryFixed::dict_apply_batch(Ref<Cell> dict, int n, const BatchUpdate* from, const BatchUpdate* to,
+                                            int& applied) const {
+  if (from == to) {
+    return dict;
+  }
+  if (dict.is_null()) {
+    return dict_build_batch(n, from, to, applied);
+  }
+  LabelParser label{dict, n, label_mode()};
+  unsigned char buffer[Dictionary::max_key_bytes];
+  label.extract_label_to(td::BitPtr{buffer});
+  return dict_apply_batch_node(std::move(dict), td::ConstBitPtr{buffer}, label.l_bits, std::move(label.remainder), n,
+                               from, to, applied);
+}
+
+// Applies updates [from, to) to a node with label `label` of length l_bits and contents `payload` located at the
+// depth corresponding to n remaining key bits. `dict` is the original cell of the node, or null if the label is
+// only a suffix of the original one, so that the node has to be re-created even if it is not changed.
+Ref<Cell> DictionaryFixed::dict_apply_batch_node(Ref<Cell> dict, td::ConstBitPtr label, int l_bits,
+                                                 Ref<CellSlice> payload, int n, const BatchUpdate* from,
+                                                 const BatchUpdate* to, int& applied) const {
+  int offs = key_bits - n;
+  auto label_pfx_len = [&](const BatchUpdate& upd) {
+    return batch_common_prefix_len(upd.key + offs, label, l_bits);
+  };
+  // updates outside of this node are either inserts or do nothing
+  while (from < to && !batch_is_insert(*from) && label_pfx_len(*from) < l_bits) {
+    ++from;
+  }
+  while (from < to && !batch_is_insert(to[-1]) && label_pfx_len(to[-1]) < l_bits) {
+    --to;
+  }
+  auto unchanged = [&]() -> Ref<Cell> {
+    if (dict.not_null()) {
+      return dict;
+    }
+    CellBuilder cb;
+    append_dict_label(cb, label, l_bits, n);
+    if (!cell_builder_add_slice_bool(cb, *payload)) {
+      throw VmError{Excno::cell_ov, "cannot change label of an old dictionary cell"};
+    }
+    return cb.finalize();
+  };
+  if (from == to) {
+    return unchanged();
+  }
+  // the keys sharing a prefix with the label form a contiguous range, so it is enough to check the first and the last
+  int pfx_len = std::min(label_pfx_len(*from), label_pfx_len(to[-1]));
+  if (pfx_len < l_bits) {
+    // new keys diverge from the label: a new fork is inserted inside the current edge, the old node goes one level
+    // deeper with the rest of its label, the new keys on the other side form a new subdictionary
+    bool sw_bit = label[pfx_len];
+    auto mid = batch_split(from, to, offs + pfx_len);
+    int m = n - pfx_len - 1;
+    Ref<Cell> c1, c2;
+    if (sw_bit) {
+      c1 = dict_build_batch(m, from, mid, applied);
+      c2 = dict_apply_batch_node({}, label + (pfx_len + 1), l_bits - pfx_len - 1, std::move(payload), m, mid, to,
+                                 applied);
+    } else {
+      c1 = dict_apply_batch_node({}, label + (pfx_len + 1), l_bits - pfx_len - 1, std::move(payload), m, from, mid,
+                                 applied);
+      c2 = dict_build_batch(m, mid, to, applied);
+    }
+    return dict_batch_fork(label, pfx_len, std::move(c1), std::move(c2), n);
+  }
+  if (l_bits == n) {
+    // a leaf node; keys are unique, so only one update is left for it
+    assert(to - from == 1);
+    if (from->value.is_null()) {
+      ++applied;
+      return {};
+    }
+    if (from->mode == SetMode::Add) {
+      return unchanged();
+    }
+    ++applied;
+    CellBuilder cb;
+    append_dict_label(cb, label, l_bits, n);
+    return finish_create_leaf(cb, *from->value);
+  }
+  // a fork node: updates are distributed between the children, the node is re-created once
+  auto c1 = payload->prefetch_ref(0);
+  auto c2 = payload->prefetch_ref(1);
+  auto mid = batch_split(from, to, offs + l_bits);
+  auto new_c1 = dict_apply_batch(c1, n - l_bits - 1, from, mid, applied);
+  auto new_c2 = dict_apply_batch(c2, n - l_bits - 1, mid, to, applied);
+  if (new_c1.get() == c1.get() && new_c2.get() == c2.get()) {
+    return unchanged();
+  }
+  return dict_batch_fork(label, l_bits, std::move(new_c1), std::move(new_c2), n);
+}
+
+int DictionaryFixed::apply_batch(const std::vector<BatchUpdate>& updates) {
+  force_validate();
+  for (std::size_t i = 1; i < updates.size(); i++) {
+    if (td::bitstring::bits_memcmp(updates[i - 1].key, updates[i].key, key_bits) >= 0) {
+      return -1;
+    }
+  }
+  int applied = 0;
+  auto res = dict_apply_batch(get_root_cell(), key_bits, updates.data(), updates.data() + updates.size(), applied);
+  if (applied) {
+    set_root_cell(std::move(res));
+  }
+  return applied;
+}
+
 Ref<CellSlice> DictionaryFixed::dict_lookup_minmax(Ref<Cell> dict, td::BitPtr key_buffer, int n, int mode) const {
   if (dict.is_null()) {
     return {};
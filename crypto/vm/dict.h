@@ -185,6 +185,12 @@ class DictionaryFixed : public DictionaryBase {
   typedef std::function<bool(CellBuilder&, Ref<CellSlice>, Ref<CellSlice>, td::ConstBitPtr, int)> combine_func_t;
   typedef std::function<bool(Ref<CellSlice>, td::ConstBitPtr, int)> foreach_func_t;
   typedef std::function<bool(td::ConstBitPtr, int, Ref<CellSlice>, Ref<CellSlice>)> scan_diff_func_t;
+  // one element of apply_batch(): sets the value of `key` (respecting `mode`), or deletes `key` if `value` is null
+  struct BatchUpdate {
+    td::ConstBitPtr key;
+    Ref<CellSlice> value;
+    SetMode mode = SetMode::Set;
+  };
 
   DictionaryFixed(int _n, bool validate = true) : DictionaryBase(_n, validate) {
   }
@@ -214,6 +220,9 @@ class DictionaryFixed : public DictionaryBase {
   bool uint_key_exists(unsigned long long key);
   Ref<CellSlice> lookup(td::ConstBitPtr key, int key_len);
   Ref<CellSlice> lookup_delete(td::ConstBitPtr key, int key_len);
+  // Applies all updates in one bottom-up pass; keys must be strictly increasing.
+  // Returns the number of updates that took effect (as if they were applied one by one), or -1 if keys are not sorted.
+  int apply_batch(const std::vector<BatchUpdate>& updates);
   Ref<CellSlice> get_minmax_key(td::BitPtr key_buffer, int key_len, bool fetch_max = false, bool invert_first = false);
   Ref<CellSlice> extract_minmax_key(td::BitPtr key_buffer, int key_len, bool fetch_max = false,
                                     bool invert_first = false);
@@ -287,6 +296,11 @@ class DictionaryFixed : public DictionaryBase {
 
  private:
   std::pair<Ref<CellSlice>, Ref<Cell>> dict_lookup_delete(Ref<Cell> dict, td::ConstBitPtr key, int n) const;
+  Ref<Cell> dict_apply_batch(Ref<Cell> dict, int n, const BatchUpdate* from, const BatchUpdate* to, int& applied) const;
+  Ref<Cell> dict_apply_batch_node(Ref<Cell> dict, td::ConstBitPtr label, int l_bits, Ref<CellSlice> payload, int n,
+                                  const BatchUpdate* from, const BatchUpdate* to, int& applied) const;
+  Ref<Cell> dict_build_batch(int n, const BatchUpdate* from, const BatchUpdate* to, int& applied) const;
+  Ref<Cell> dict_batch_fork(td::ConstBitPtr label, int l_bits, Ref<Cell> c1, Ref<Cell> c2, int n) const;
   Ref<CellSlice> dict_lookup_minmax(Ref<Cell> dict, td::BitPtr key_buffer, int n, int mode) const;
   Ref<CellSlice> dict_lookup_nearest(Ref<Cell> dict, td::BitPtr key_buffer, int n, bool allow_eq, int mode) const;
   std::pair<Ref<Cell>, bool> extract_prefix_subdict_internal(Ref<Cell> dict, td::ConstBitPtr prefix, int prefix_len,
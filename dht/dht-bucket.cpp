@@ -31,73 +31,99 @@
 #include "dht-bucket.hpp"
 #include "dht.hpp"
 
-//#include <algorithm>
+#include <algorithm>
 
 namespace ton {
 
 namespace dht {
 
 void DhtBucket::get_nearest_nodes(DhtKeyId id, td::uint32 bit, DhtNodesList &vec, td::uint32 k) {
-  if (active_nodes_.size() == 0) {
+  if (active_cnt_ == 0 || vec.size() >= k) {
     return;
   }
-  std::map<DhtKeyId, size_t> list;
-
+  std::vector<std::pair<DhtKeyId, size_t>> list;
+  list.reserve(active_cnt_);
   for (size_t i = 0; i < active_nodes_.size(); i++) {
-    auto &node = active_nodes_[i];
-    if (node) {
-      list.emplace(id ^ node->get_key(), i);
+    if (active_nodes_[i]) {
+      list.emplace_back(id ^ active_keys_[i], i);
     }
   }
 
-  for (auto it = list.begin(); it != list.end() && vec.size() < k; it++) {
-    vec.push_back(active_nodes_[it->second]->get_node());
+  auto cnt = std::min<size_t>(list.size(), k - vec.size());
+  std::partial_sort(list.begin(), list.begin() + cnt, list.end());
+  for (size_t i = 0; i < cnt; i++) {
+    vec.push_back(active_nodes_[list[i].second]->get_node());
   }
 }
 
-td::uint32 DhtBucket::active_cnt() {
-  td::uint32 cnt = 0;
-  for (auto &node : active_nodes_) {
-    if (node) {
-      cnt++;
+size_t DhtBucket::find_node(const std::vector<DhtKeyId> &keys,
+                            const std::vector<std::unique_ptr<DhtRemoteNode>> &nodes, DhtKeyId id) {
+  for (size_t i = 0; i < keys.size(); i++) {
+    if (keys[i] == id && nodes[i]) {
+      return i;
     }
   }
-  return cnt;
+  return keys.size();
+}
+
+std::unique_ptr<DhtRemoteNode> DhtBucket::set_active_node(size_t idx, std::unique_ptr<DhtRemoteNode> node) {
+  auto &slot = active_nodes_[idx];
+  if (slot) {
+    active_cnt_--;
+  }
+  if (node) {
+    active_cnt_++;
+  }
+  active_keys_[idx] = node ? node->get_key() : DhtKeyId::zero();
+  std::swap(slot, node);
+  return node;
+}
+
+std::unique_ptr<DhtRemoteNode> DhtBucket::set_backup_node(size_t idx, std::unique_ptr<DhtRemoteNode> node) {
+  auto &slot = backup_nodes_[idx];
+  if (slot) {
+    backup_cnt_--;
+  }
+  if (node) {
+    backup_cnt_++;
+  }
+  backup_keys_[idx] = node ? node->get_key() : DhtKeyId::zero();
+  std::swap(slot, node);
+  return node;
 }
 
 td::Status DhtBucket::add_full_node(DhtKeyId id, DhtNode newnode, td::actor::ActorId<adnl::Adnl> adnl,
                                     adnl::AdnlNodeIdShort self_id, td::int32 our_network_id, bool set_active) {
-  for (auto &node : active_nodes_) {
-    if (node && node->get_key() == id) {
-      if (set_active) {
-        return node->receive_ping(std::move(newnode), adnl, self_id);
-      } else {
-        return node->update_value(std::move(newnode), adnl, self_id);
-      }
+  size_t i = find_node(active_keys_, active_nodes_, id);
+  if (i < active_nodes_.size()) {
+    auto &node = active_nodes_[i];
+    if (set_active) {
+      return node->receive_ping(std::move(newnode), adnl, self_id);
+    } else {
+      return node->update_value(std::move(newnode), adnl, self_id);
     }
   }
-  for (size_t i = 0; i < backup_nodes_.size(); ++i) {
+  i = find_node(backup_keys_, backup_nodes_, id);
+  if (i < backup_nodes_.size()) {
     auto &node = backup_nodes_[i];
-    if (node && node->get_key() == id) {
-      if (set_active) {
-        TRY_STATUS(node->receive_ping(std::move(newnode), adnl, self_id));
-        if (node->is_ready()) {
-          promote_node(i);
-        }
-        return td::Status::OK();
-      } else {
-        return node->update_value(std::move(newnode), adnl, self_id);
+    if (set_active) {
+      TRY_STATUS(node->receive_ping(std::move(newnode), adnl, self_id));
+      if (node->is_ready()) {
+        promote_node(i);
       }
+      return td::Status::OK();
+    } else {
+      return node->update_value(std::move(newnode), adnl, self_id);
     }
   }
 
   TRY_RESULT_PREFIX(N, DhtRemoteNode::create(std::move(newnode), max_missed_pings_, our_network_id),
                     "failed to add new node: ");
-  if (set_active) {
-    for (auto &node : active_nodes_) {
-      if (node == nullptr) {
-        node = std::move(N);
-        node->receive_ping();
+  if (set_active && active_cnt_ < active_nodes_.size()) {
+    for (size_t idx = 0; idx < active_nodes_.size(); idx++) {
+      if (active_nodes_[idx] == nullptr) {
+        N->receive_ping();
+        set_active_node(idx, std::move(N));
         return td::Status::OK();
       }
     }
@@ -105,7 +131,7 @@ td::Status DhtBucket::add_full_node(DhtKeyId id, DhtNode newnode, td::actor::Act
 
   size_t idx = select_backup_node_to_drop();
   if (idx < backup_nodes_.size()) {
-    backup_nodes_[idx] = std::move(N);
+    set_backup_node(idx, std::move(N));
   }
   return td::Status::OK();
 }
@@ -128,37 +154,35 @@ size_t DhtBucket::select_backup_node_to_drop() const {
 
 void DhtBucket::receive_ping(DhtKeyId id, DhtNode result, td::actor::ActorId<adnl::Adnl> adnl,
                              adnl::AdnlNodeIdShort self_id) {
-  for (auto &node : active_nodes_) {
-    if (node && node->get_key() == id) {
-      node->receive_ping(std::move(result), adnl, self_id);
-      return;
-    }
+  size_t i = find_node(active_keys_, active_nodes_, id);
+  if (i < active_nodes_.size()) {
+    active_nodes_[i]->receive_ping(std::move(result), adnl, self_id);
+    return;
   }
-  for (size_t i = 0; i < backup_nodes_.size(); i++) {
+  i = find_node(backup_keys_, backup_nodes_, id);
+  if (i < backup_nodes_.size()) {
     auto &node = backup_nodes_[i];
-    if (node && node->get_key() == id) {
-      node->receive_ping(std::move(result), adnl, self_id);
-      if (node->is_ready()) {
-        promote_node(i);
-      }
-      return;
+    node->receive_ping(std::move(result), adnl, self_id);
+    if (node->is_ready()) {
+      promote_node(i);
     }
   }
 }
 
 void DhtBucket::demote_node(size_t idx) {
+  auto node = set_active_node(idx, nullptr);
   size_t new_idx = select_backup_node_to_drop();
   if (new_idx < backup_nodes_.size()) {
-    backup_nodes_[new_idx] = std::move(active_nodes_[idx]);
+    set_backup_node(new_idx, std::move(node));
   }
-  active_nodes_[idx] = nullptr;
 }
 
 void DhtBucket::promote_node(size_t idx) {
   CHECK(backup_nodes_[idx]);
-  for (auto &node : active_nodes_) {
+  for (size_t i = 0; i < active_nodes_.size(); i++) {
+    auto &node = active_nodes_[i];
     if (node == nullptr) {
-      node = std::move(backup_nodes_[idx]);
+      set_active_node(i, set_backup_node(idx, nullptr));
       return;
     }
     CHECK(node->is_ready());
@@ -167,22 +191,23 @@ void DhtBucket::promote_node(size_t idx) {
 
 void DhtBucket::check(bool client_only, td::actor::ActorId<adnl::Adnl> adnl, td::actor::ActorId<DhtMember> dht,
                       adnl::AdnlNodeIdShort src) {
-  size_t have_space = 0;
+  if (empty()) {
+    return;
+  }
+  double now = td::Time::now_cached();
   for (size_t i = 0; i < active_nodes_.size(); i++) {
     auto &node = active_nodes_[i];
-    if (node && td::Time::now_cached() - node->last_ping_at() > node->ping_interval()) {
+    if (node && now - node->last_ping_at() > node->ping_interval()) {
       node->send_ping(client_only, adnl, dht, src);
       if (node->ready_from() == 0) {
         demote_node(i);
       }
     }
-    if (node == nullptr) {
-      have_space++;
-    }
   }
-  for (size_t i = 0; i < backup_nodes_.size(); i++) {
+  size_t have_space = active_nodes_.size() - active_cnt_;
+  for (size_t i = 0; i < backup_nodes_.size() && backup_cnt_ > 0; i++) {
     auto &node = backup_nodes_[i];
-    if (node && td::Time::now_cached() - node->last_ping_at() > node->ping_interval()) {
+    if (node && now - node->last_ping_at() > node->ping_interval()) {
       node->send_ping(client_only, adnl, dht, src);
     }
     if (node && have_space > 0 && node->is_ready()) {
@@ -35,6 +35,11 @@ class DhtBucket {
 
   std::vector<std::unique_ptr<DhtRemoteNode>> active_nodes_;
   std::vector<std::unique_ptr<DhtRemoteNode>> backup_nodes_;
+  // keys of active_nodes_ and backup_nodes_, kept in contiguous arrays to scan them without touching the nodes
+  std::vector<DhtKeyId> active_keys_;
+  std::vector<DhtKeyId> backup_keys_;
+  td::uint32 active_cnt_ = 0;
+  td::uint32 backup_cnt_ = 0;
 
   //std::map<td::UInt256, std::unique_ptr<DhtRemoteNode>> pending_nodes_;
   td::uint32 k_;
@@ -43,13 +48,24 @@ class DhtBucket {
   void demote_node(size_t idx);
   void promote_node(size_t idx);
   size_t select_backup_node_to_drop() const;
+  std::unique_ptr<DhtRemoteNode> set_active_node(size_t idx, std::unique_ptr<DhtRemoteNode> node);
+  std::unique_ptr<DhtRemoteNode> set_backup_node(size_t idx, std::unique_ptr<DhtRemoteNode> node);
+  static size_t find_node(const std::vector<DhtKeyId> &keys, const std::vector<std::unique_ptr<DhtRemoteNode>> &nodes,
+                          DhtKeyId id);
 
  public:
   DhtBucket(td::uint32 k) : k_(k) {
     active_nodes_.resize(k);
     backup_nodes_.resize(k);
+    active_keys_.resize(k, DhtKeyId::zero());
+    backup_keys_.resize(k, DhtKeyId::zero());
+  }
+  td::uint32 active_cnt() const {
+    return active_cnt_;
+  }
+  bool empty() const {
+    return active_cnt_ == 0 && backup_cnt_ == 0;
   }
-  td::uint32 active_cnt();
   td::Status add_full_node(DhtKeyId id, DhtNode node, td::actor::ActorId<adnl::Adnl> adnl,
                            adnl::AdnlNodeIdShort self_id, td::int32 our_network_id, bool set_active = false);
   void check(bool client_only, td::actor::ActorId<adnl::Adnl> adnl, td::actor::ActorId<DhtMember> node,
@@ -34,9 +34,10 @@ class DhtMemberImpl : public DhtMember {
  private:
   class DhtKeyValueLru : public td::ListNode {
    public:
-    DhtKeyValueLru(DhtValue value) : kv_(std::move(value)) {
+    DhtKeyValueLru(DhtValue value, td::Timestamp expire_at) : kv_(std::move(value)), expire_at_(expire_at) {
     }
     DhtValue kv_;
+    td::Timestamp expire_at_;
     static inline DhtKeyValueLru *from_list_node(ListNode *node) {
       return static_cast<DhtKeyValueLru *>(node);
     }
@@ -48,7 +49,7 @@ class DhtMemberImpl : public DhtMember {
   td::uint32 a_;
   td::int32 network_id_{-1};
   td::uint32 max_cache_time_ = 60;
-  td::uint32 max_cache_size_ = 100;
+  td::uint32 max_cache_size_ = 1024;
 
   std::vector<DhtBucket> buckets_;
 
@@ -57,8 +58,11 @@ class DhtMemberImpl : public DhtMember {
   // to be republished once in a while
   std::map<DhtKeyId, DhtValue> our_values_;
 
+  // values found by our own lookups, shared by all users of this node (adnl address discovery, overlays, etc.)
   std::map<DhtKeyId, DhtKeyValueLru> cached_values_;
   td::ListNode cached_values_lru_;
+  // lookups in progress: concurrent requests for the same key wait for the single query
+  std::map<DhtKeyId, std::vector<td::Promise<DhtValue>>> pending_get_value_;
 
   std::map<DhtKeyId, DhtValue> values_;
 
@@ -111,6 +115,8 @@ class DhtMemberImpl : public DhtMember {
   td::uint64 find_value_queries_{0};
   td::uint64 store_queries_{0};
   td::uint64 get_addr_list_queries_{0};
+  td::uint64 get_value_cache_hits_{0};
+  td::uint64 get_value_cache_misses_{0};
 
   using DbType = td::KeyValueAsync<td::Bits256, td::BufferSlice>;
   DbType db_;
@@ -179,6 +185,8 @@ class DhtMemberImpl : public DhtMember {
   void send_store(DhtValue value, td::Promise<td::Unit> promise);
 
   void get_value_in(DhtKeyId key, td::Promise<DhtValue> result) override;
+  void got_value(DhtKeyId key, td::Result<DhtValue> R);
+  void add_cached_value(DhtValue value);
   void get_value(DhtKey key, td::Promise<DhtValue> result) override {
     get_value_in(key.compute_key_id(), std::move(result));
   }
@@ -33,10 +33,20 @@ namespace ton {
 
 namespace dht {
 
+static const double QUERY_STALL_TIMEOUT = 0.5;
+
 void DhtQuery::send_queries() {
-  VLOG(DHT_EXTRA_DEBUG) << this << ": sending new queries. active=" << active_queries_ << " max_active=" << a_;
-  while (pending_ids_.size() > 0 && active_queries_ < a_) {
-    active_queries_++;
+  td::uint32 running = 0;
+  for (auto &q : active_queries_) {
+    if (!q.second.is_in_past()) {
+      running++;
+      alarm_timestamp().relax(q.second);
+    }
+  }
+  VLOG(DHT_EXTRA_DEBUG) << this << ": sending new queries. active=" << active_queries_.size()
+                        << " running=" << running << " max_active=" << a_;
+  while (pending_ids_.size() > 0 && running < a_ && active_queries_.size() < k_) {
+    running++;
     auto id_xor = *pending_ids_.begin();
     auto id = id_xor ^ key_;
     VLOG(DHT_EXTRA_DEBUG) << this << ": sending " << get_name() << " query to " << id;
@@ -45,9 +55,12 @@ void DhtQuery::send_queries() {
     auto it = list_.find(id_xor);
     CHECK(it != list_.end());
     td::actor::send_closure(adnl_, &adnl::Adnl::add_peer, get_src(), it->second.adnl_id(), it->second.addr_list());
+    auto stall_at = td::Timestamp::in(QUERY_STALL_TIMEOUT);
+    active_queries_.emplace(id.to_adnl(), stall_at);
+    alarm_timestamp().relax(stall_at);
     send_one_query(id.to_adnl());
   }
-  if (active_queries_ == 0) {
+  if (active_queries_.empty()) {
     CHECK(pending_ids_.size() == 0);
     DhtNodesList list;
     for (auto &node : list_) {
@@ -60,6 +73,13 @@ void DhtQuery::send_queries() {
   }
 }
 
+void DhtQuery::finish_query(adnl::AdnlNodeIdShort dst) {
+  auto it = active_queries_.find(dst);
+  CHECK(it != active_queries_.end());
+  active_queries_.erase(it);
+  send_queries();
+}
+
 void DhtQuery::add_nodes(DhtNodesList list) {
   VLOG(DHT_EXTRA_DEBUG) << this << ": " << get_name() << " query: received " << list.size() << " new dht nodes";
   for (auto &node : list.list()) {
@@ -111,7 +131,7 @@ void DhtQueryFindNodes::send_one_query(adnl::AdnlNodeIdShort id) {
 void DhtQueryFindNodes::on_result(td::Result<td::BufferSlice> R, adnl::AdnlNodeIdShort dst) {
   if (R.is_error()) {
     VLOG(DHT_INFO) << this << ": failed find nodes query " << get_src() << "->" << dst << ": " << R.move_as_error();
-    finish_query();
+    finish_query(dst);
     return;
   }
 
@@ -122,7 +142,7 @@ void DhtQueryFindNodes::on_result(td::Result<td::BufferSlice> R, adnl::AdnlNodeI
   } else {
     add_nodes(DhtNodesList{Res.move_as_ok(), our_network_id()});
   }
-  finish_query();
+  finish_query(dst);
 }
 
 void DhtQueryFindNodes::finish(DhtNodesList list) {
@@ -166,14 +186,14 @@ void DhtQueryFindValue::send_one_query_nodes(adnl::AdnlNodeIdShort id) {
 void DhtQueryFindValue::on_result(td::Result<td::BufferSlice> R, adnl::AdnlNodeIdShort dst) {
   if (R.is_error()) {
     VLOG(DHT_INFO) << this << ": failed find value query " << get_src() << "->" << dst << ": " << R.move_as_error();
-    finish_query();
+    finish_query(dst);
     return;
   }
   auto Res = fetch_tl_object<ton_api::dht_ValueResult>(R.move_as_ok(), true);
   if (Res.is_error()) {
     VLOG(DHT_WARNING) << this << ": dropping incorrect answer on dht.findValue query from " << dst << ": "
                       << Res.move_as_error();
-    finish_query();
+    finish_query(dst);
     return;
   }
 
@@ -210,26 +230,26 @@ void DhtQueryFindValue::on_result(td::Result<td::BufferSlice> R, adnl::AdnlNodeI
   } else if (send_get_nodes) {
     send_one_query_nodes(dst);
   } else {
-    finish_query();
+    finish_query(dst);
   }
 }
 
 void DhtQueryFindValue::on_result_nodes(td::Result<td::BufferSlice> R, adnl::AdnlNodeIdShort dst) {
   if (R.is_error()) {
     VLOG(DHT_INFO) << this << ": failed find nodes query " << get_src() << "->" << dst << ": " << R.move_as_error();
-    finish_query();
+    finish_query(dst);
     return;
   }
   auto Res = fetch_tl_object<ton_api::dht_nodes>(R.move_as_ok(), true);
   if (Res.is_error()) {
     VLOG(DHT_WARNING) << this << ": dropping incorrect answer on dht.findNodes query from " << dst << ": "
                       << Res.move_as_error();
-    finish_query();
+    finish_query(dst);
     return;
   }
   auto r = Res.move_as_ok();
   add_nodes(DhtNodesList{create_tl_object<ton_api::dht_nodes>(std::move(r->nodes_)), our_network_id()});
-  finish_query();
+  finish_query(dst);
 }
 
 void DhtQueryFindValue::finish(DhtNodesList list) {
@@ -422,14 +442,14 @@ void DhtQueryRequestReversePing::send_one_query(adnl::AdnlNodeIdShort id) {
 void DhtQueryRequestReversePing::on_result(td::Result<td::BufferSlice> R, adnl::AdnlNodeIdShort dst) {
   if (R.is_error()) {
     VLOG(DHT_INFO) << this << ": failed reverse ping query " << get_src() << "->" << dst << ": " << R.move_as_error();
-    finish_query();
+    finish_query(dst);
     return;
   }
   auto Res = fetch_tl_object<ton_api::dht_ReversePingResult>(R.move_as_ok(), true);
   if (Res.is_error()) {
     VLOG(DHT_WARNING) << this << ": dropping incorrect answer on dht.requestReversePing query from " << dst << ": "
                       << Res.move_as_error();
-    finish_query();
+    finish_query(dst);
     return;
   }
 
@@ -441,7 +461,7 @@ void DhtQueryRequestReversePing::on_result(td::Result<td::BufferSlice> R, adnl::
                                  },
                                  [&](ton_api::dht_clientNotFound &v) {
                                    add_nodes(DhtNodesList{std::move(v.nodes_), our_network_id()});
-                                   finish_query();
+                                   finish_query(dst);
                                  }));
 }
 
@@ -64,11 +64,7 @@ class DhtQuery : public td::actor::Actor {
   }
   void send_queries();
   void add_nodes(DhtNodesList list);
-  void finish_query() {
-    active_queries_--;
-    CHECK(active_queries_ <= k_);
-    send_queries();
-  }
+  void finish_query(adnl::AdnlNodeIdShort dst);
   DhtKeyId get_key() const {
     return key_;
   }
@@ -84,6 +80,9 @@ class DhtQuery : public td::actor::Actor {
   void start_up() override {
     send_queries();
   }
+  void alarm() override {
+    send_queries();
+  }
   virtual void send_one_query(adnl::AdnlNodeIdShort id) = 0;
   virtual void finish(DhtNodesList list) = 0;
   virtual std::string get_name() const = 0;
@@ -97,7 +96,9 @@ class DhtQuery : public td::actor::Actor {
   td::uint32 a_;
   td::int32 our_network_id_;
   td::actor::ActorId<DhtMember> node_;
-  td::uint32 active_queries_ = 0;
+  // Sent queries and the moments they become stalled. A stalled query still waits for the answer, but does not
+  // count towards the limit of a parallel queries, so that one slow node does not hold the whole lookup
+  std::multimap<adnl::AdnlNodeIdShort, td::Timestamp> active_queries_;
 
  protected:
   td::actor::ActorId<adnl::Adnl> adnl_;
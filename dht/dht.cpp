@@ -465,11 +465,32 @@ void DhtMemberImpl::set_value(DhtValue value, td::Promise<td::Unit> promise) {
 }
 
 void DhtMemberImpl::get_value_in(DhtKeyId key, td::Promise<DhtValue> result) {
-  auto P = td::PromiseCreator::lambda([key, promise = std::move(result), SelfId = actor_id(this), print_id = print_id(),
-                                       adnl = adnl_, list = get_nearest_nodes(key, k_), k = k_, a = a_,
-                                       network_id = network_id_, id = id_,
-                                       client_only = client_only_](td::Result<DhtNode> R) mutable {
+  auto it = cached_values_.find(key);
+  if (it != cached_values_.end()) {
+    if (!it->second.expire_at_.is_in_past() && !it->second.kv_.expired()) {
+      get_value_cache_hits_++;
+      it->second.remove();
+      cached_values_lru_.put(&it->second);
+      result.set_value(it->second.kv_.clone());
+      return;
+    }
+    cached_values_.erase(it);
+  }
+  get_value_cache_misses_++;
+
+  auto &waiting = pending_get_value_[key];
+  waiting.push_back(std::move(result));
+  if (waiting.size() > 1) {
+    return;
+  }
+
+  auto P = td::PromiseCreator::lambda([key, SelfId = actor_id(this), print_id = print_id(), adnl = adnl_,
+                                       list = get_nearest_nodes(key, k_), k = k_, a = a_, network_id = network_id_,
+                                       id = id_, client_only = client_only_](td::Result<DhtNode> R) mutable {
     R.ensure();
+    auto promise = td::PromiseCreator::lambda([SelfId, key](td::Result<DhtValue> R) {
+      td::actor::send_closure(SelfId, &DhtMemberImpl::got_value, key, std::move(R));
+    });
     td::actor::create_actor<DhtQueryFindValue>("FindValueQuery", key, print_id, id, std::move(list), k, a, network_id,
                                                R.move_as_ok(), client_only, SelfId, adnl, std::move(promise))
         .release();
@@ -478,6 +499,49 @@ void DhtMemberImpl::get_value_in(DhtKeyId key, td::Promise<DhtValue> result) {
   get_self_node(std::move(P));
 }
 
+void DhtMemberImpl::got_value(DhtKeyId key, td::Result<DhtValue> R) {
+  auto it = pending_get_value_.find(key);
+  CHECK(it != pending_get_value_.end());
+  auto promises = std::move(it->second);
+  pending_get_value_.erase(it);
+  if (R.is_error()) {
+    for (auto &promise : promises) {
+      promise.set_error(R.error().clone());
+    }
+    return;
+  }
+  auto value = R.move_as_ok();
+  for (auto &promise : promises) {
+    promise.set_value(value.clone());
+  }
+  add_cached_value(std::move(value));
+}
+
+void DhtMemberImpl::add_cached_value(DhtValue value) {
+  double now = td::Clocks::system();
+  if (value.ttl() <= now) {
+    return;
+  }
+  auto key = value.key_id();
+  auto expire_at = td::Timestamp::in(std::min<double>(max_cache_time_, value.ttl() - now));
+  auto it = cached_values_.find(key);
+  if (it != cached_values_.end()) {
+    it->second.kv_ = std::move(value);
+    it->second.expire_at_ = expire_at;
+    it->second.remove();
+  } else {
+    it = cached_values_.emplace(std::piecewise_construct, std::forward_as_tuple(key),
+                                std::forward_as_tuple(std::move(value), expire_at))
+             .first;
+  }
+  cached_values_lru_.put(&it->second);
+  while (cached_values_.size() > max_cache_size_) {
+    auto node = DhtKeyValueLru::from_list_node(cached_values_lru_.get());
+    CHECK(node);
+    cached_values_.erase(node->kv_.key_id());
+  }
+}
+
 void DhtMemberImpl::register_reverse_connection(adnl::AdnlNodeIdFull client, td::Promise<td::Unit> promise) {
   auto client_short = client.compute_short_id();
   td::uint32 ttl = (td::uint32)td::Clocks::system() + 300;
@@ -545,7 +609,8 @@ void DhtMemberImpl::request_reverse_ping_cont(adnl::AdnlNode target, td::BufferS
 void DhtMemberImpl::check() {
   VLOG(DHT_INFO) << this << ": ping=" << ping_queries_ << " fnode=" << find_node_queries_
                  << " fvalue=" << find_value_queries_ << " store=" << store_queries_
-                 << " addrlist=" << get_addr_list_queries_;
+                 << " addrlist=" << get_addr_list_queries_ << " cache_hits=" << get_value_cache_hits_
+                 << " cache_misses=" << get_value_cache_misses_;
   for (auto &bucket : buckets_) {
     bucket.check(client_only_, adnl_, actor_id(this), id_);
   }
@@ -68,44 +68,158 @@ void HttpClientImpl::send_request(
                           std::move(promise));
 }
 
+td::Result<td::actor::ActorOwn<HttpOutboundConnection>> HttpMultiClientImpl::create_connection(
+    std::shared_ptr<HttpClient::Callback> callback) {
+  if (domain_.size() > 0) {
+    TRY_STATUS(addr_.init_host_port(domain_));
+  }
+  TRY_RESULT(fd, td::SocketFd::open(addr_));
+  return td::actor::create_actor<HttpOutboundConnection>(td::actor::ActorOptions().with_name("outconn").with_poll(),
+                                                         std::move(fd), std::move(callback));
+}
+
 void HttpMultiClientImpl::send_request(
     std::unique_ptr<HttpRequest> request, std::shared_ptr<HttpPayload> payload, td::Timestamp timeout,
     td::Promise<std::pair<std::unique_ptr<HttpResponse>, std::shared_ptr<HttpPayload>>> promise) {
-  if (domain_.size() > 0) {
-    auto S = addr_.init_host_port(domain_);
-    if (S.is_error()) {
-      return answer_error(HttpStatusCode::status_bad_gateway, "", std::move(promise));
+  while (!idle_connections_.empty()) {
+    auto id = idle_connections_.back();
+    idle_connections_.pop_back();
+    auto it = connections_.find(id);
+    if (it == connections_.end() || !it->second.idle) {
+      continue;
     }
+    auto &conn = it->second;
+    conn.idle = false;
+    conn.requests++;
+    request->set_keep_alive(conn.requests < max_requests_per_connect_);
+    if (can_retry(*request, *payload)) {
+      // the server may have closed the idle connection just before the request was sent:
+      // if it fails before any response arrives, try once more on a fresh connection
+      auto P = td::PromiseCreator::lambda(
+          [SelfId = actor_id(this), retry_request = std::make_unique<HttpRequest>(*request), timeout,
+           promise = std::move(promise)](
+              td::Result<std::pair<std::unique_ptr<HttpResponse>, std::shared_ptr<HttpPayload>>> R) mutable {
+            if (R.is_ok()) {
+              promise.set_value(R.move_as_ok());
+              return;
+            }
+            LOG(INFO) << "request on idle connection failed: " << R.move_as_error() << ", retrying";
+            td::actor::send_closure(SelfId, &HttpMultiClientImpl::send_request_new_connection,
+                                    std::move(retry_request),
+                                    std::make_shared<HttpPayload>(HttpPayload::PayloadType::pt_empty), timeout,
+                                    std::move(promise));
+          });
+      td::actor::send_closure(conn.conn, &HttpOutboundConnection::send_query, std::move(request), std::move(payload),
+                              timeout, std::move(P));
+      return;
+    }
+    td::actor::send_closure(conn.conn, &HttpOutboundConnection::send_query, std::move(request), std::move(payload),
+                            timeout, std::move(promise));
+    return;
   }
+  send_request_new_connection(std::move(request), std::move(payload), timeout, std::move(promise));
+}
 
-  auto fd = td::SocketFd::open(addr_);
-  if (fd.is_error()) {
-    return answer_error(HttpStatusCode::status_bad_gateway, "", std::move(promise));
+bool HttpMultiClientImpl::can_retry(const HttpRequest &request, const HttpPayload &payload) {
+  if (payload.payload_type() != HttpPayload::PayloadType::pt_empty) {
+    return false;
+  }
+  const auto &method = request.method();
+  return method == "GET" || method == "HEAD" || method == "OPTIONS" || method == "PUT" || method == "DELETE" ||
+         method == "TRACE";
+}
+
+void HttpMultiClientImpl::send_request_new_connection(
+    std::unique_ptr<HttpRequest> request, std::shared_ptr<HttpPayload> payload, td::Timestamp timeout,
+    td::Promise<std::pair<std::unique_ptr<HttpResponse>, std::shared_ptr<HttpPayload>>> promise) {
+  if (timeout.is_in_past()) {
+    return answer_error(HttpStatusCode::status_gateway_timeout, "", std::move(promise));
   }
 
   class Cb : public HttpClient::Callback {
    public:
-    Cb(td::actor::ActorId<HttpMultiClientImpl> id) : id_(id) {
+    Cb(td::actor::ActorId<HttpMultiClientImpl> id, td::uint64 conn_id) : id_(id), conn_id_(conn_id) {
     }
-
     void on_ready() override {
     }
-
     void on_stop_ready() override {
+      if (conn_id_) {
+        td::actor::send_closure(id_, &HttpMultiClientImpl::connection_closed, conn_id_);
+      }
+    }
+    void on_idle() override {
+      if (conn_id_) {
+        td::actor::send_closure(id_, &HttpMultiClientImpl::connection_idle, conn_id_);
+      }
     }
 
    private:
     td::actor::ActorId<HttpMultiClientImpl> id_;
+    td::uint64 conn_id_;
   };
-  auto conn =
-      td::actor::create_actor<HttpOutboundConnection>(td::actor::ActorOptions().with_name("outconn").with_poll(),
-                                                      fd.move_as_ok(), std::make_shared<Cb>(actor_id(this)))
-          .release();
+
+  if (connections_.size() < max_connections_ && max_requests_per_connect_ > 1) {
+    auto id = ++next_connection_id_;
+    auto R = create_connection(std::make_shared<Cb>(actor_id(this), id));
+    if (R.is_error()) {
+      LOG(INFO) << "failed to connect to " << addr_ << ": " << R.move_as_error();
+      return answer_error(HttpStatusCode::status_bad_gateway, "", std::move(promise));
+    }
+    auto &conn = connections_[id];
+    conn.conn = R.move_as_ok();
+    conn.requests = 1;
+    request->set_keep_alive(true);
+    td::actor::send_closure(conn.conn, &HttpOutboundConnection::send_query, std::move(request), std::move(payload),
+                            timeout, std::move(promise));
+    return;
+  }
+
+  // all pooled connections are busy: use a one-time connection
+  auto R = create_connection(std::make_shared<Cb>(actor_id(this), 0));
+  if (R.is_error()) {
+    LOG(INFO) << "failed to connect to " << addr_ << ": " << R.move_as_error();
+    return answer_error(HttpStatusCode::status_bad_gateway, "", std::move(promise));
+  }
+  auto conn = R.move_as_ok().release();
   request->set_keep_alive(false);
   td::actor::send_closure(conn, &HttpOutboundConnection::send_query, std::move(request), std::move(payload), timeout,
                           std::move(promise));
 }
 
+void HttpMultiClientImpl::connection_idle(td::uint64 id) {
+  auto it = connections_.find(id);
+  if (it == connections_.end()) {
+    return;
+  }
+  auto &conn = it->second;
+  conn.idle = true;
+  conn.idle_since = td::Timestamp::now();
+  idle_connections_.push_back(id);
+  alarm_timestamp().relax(td::Timestamp::in(max_idle_time()));
+}
+
+void HttpMultiClientImpl::connection_closed(td::uint64 id) {
+  connections_.erase(id);
+}
+
+void HttpMultiClientImpl::alarm() {
+  // close connections that were idle for too long: the server is likely to close them soon on its side
+  auto close_before = td::Timestamp::in(-max_idle_time());
+  idle_connections_.clear();
+  for (auto it = connections_.begin(); it != connections_.end();) {
+    auto &conn = it->second;
+    if (conn.idle && conn.idle_since.at() <= close_before.at()) {
+      it = connections_.erase(it);
+      continue;
+    }
+    if (conn.idle) {
+      idle_connections_.push_back(it->first);
+      alarm_timestamp().relax(td::Timestamp::at(conn.idle_since.at() + max_idle_time()));
+    }
+    ++it;
+  }
+}
+
 td::actor::ActorOwn<HttpClient> HttpClient::create(std::string domain, td::IPAddress addr,
                                                    std::shared_ptr<HttpClient::Callback> callback) {
   return td::actor::create_actor<HttpClientImpl>("httpclient", std::move(domain), addr, std::move(callback));
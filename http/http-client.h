@@ -36,6 +36,9 @@ class HttpClient : public td::actor::Actor {
     virtual ~Callback() = default;
     virtual void on_ready() = 0;
     virtual void on_stop_ready() = 0;
+    // called by a keep-alive connection when it has finished all its queries and can take the next one
+    virtual void on_idle() {
+    }
   };
 
   virtual void check_ready(td::Promise<td::Unit> promise) = 0;
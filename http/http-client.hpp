@@ -21,6 +21,8 @@
 
 #include "td/utils/Random.h"
 
+#include <map>
+
 namespace ton {
 
 namespace http {
@@ -101,7 +103,21 @@ class HttpMultiClientImpl : public HttpClient {
       std::unique_ptr<HttpRequest> request, std::shared_ptr<HttpPayload> payload, td::Timestamp timeout,
       td::Promise<std::pair<std::unique_ptr<HttpResponse>, std::shared_ptr<HttpPayload>>> promise) override;
 
+  void connection_idle(td::uint64 id);
+  void connection_closed(td::uint64 id);
+  void alarm() override;
+
  private:
+  // below the keep-alive timeout of common servers (5s in apache and node.js)
+  static constexpr double max_idle_time() {
+    return 4.0;
+  }
+
+  static bool can_retry(const HttpRequest &request, const HttpPayload &payload);
+  void send_request_new_connection(
+      std::unique_ptr<HttpRequest> request, std::shared_ptr<HttpPayload> payload, td::Timestamp timeout,
+      td::Promise<std::pair<std::unique_ptr<HttpResponse>, std::shared_ptr<HttpPayload>>> promise);
+
   std::string domain_;
   td::IPAddress addr_;
 
@@ -111,6 +127,20 @@ class HttpMultiClientImpl : public HttpClient {
   td::Timestamp next_create_at_;
 
   std::shared_ptr<Callback> callback_;
+
+  // keep-alive connections; at most max_connections_ of them, each serves at most max_requests_per_connect_ requests
+  struct Connection {
+    td::actor::ActorOwn<HttpOutboundConnection> conn;
+    td::uint32 requests = 0;
+    bool idle = false;
+    td::Timestamp idle_since;
+  };
+  std::map<td::uint64, Connection> connections_;
+  std::vector<td::uint64> idle_connections_;
+  td::uint64 next_connection_id_ = 0;
+
+  td::Result<td::actor::ActorOwn<HttpOutboundConnection>> create_connection(
+      std::shared_ptr<HttpClient::Callback> callback);
 };
 
 }  // namespace http
@@ -84,7 +84,7 @@ class HttpOutboundConnection : public HttpConnection {
       std::shared_ptr<HttpClient::Callback> callback_;
     };
 
-    callback_ = std::make_unique<Cb>(std::move(http_callback_));
+    callback_ = std::make_unique<Cb>(http_callback_);
 
     HttpConnection::start_up();
   }
@@ -101,12 +101,19 @@ class HttpOutboundConnection : public HttpConnection {
     if (!close_after_read_) {
       alarm_timestamp() = td::Timestamp::never();
       send_next_query();
+      check_idle();
     } else {
       stop();
     }
   }
   void payload_written() override {
     writing_payload_ = nullptr;
+    check_idle();
+  }
+  void check_idle() {
+    if (!promise_ && !reading_payload_ && !writing_payload_ && next_.empty() && !close_after_read_) {
+      http_callback_->on_idle();
+    }
   }
 
  private:
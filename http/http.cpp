@@ -41,19 +41,19 @@ td::Result<std::string> get_line(td::ChainBufferReader &input, std::string &cur_
       if (cur_line.size() + S.size() > max_line_size) {
         return td::Status::Error("too big http header");
       }
-      cur_line += S.str();
+      cur_line.append(S.data(), S.size());
       input.confirm_read(S.size());
       continue;
     }
     if (f > 0) {
       if (S[f - 1] == '\r') {
-        cur_line += S.truncate(f - 1).str();
+        cur_line.append(S.data(), f - 1);
       } else {
-        cur_line += S.truncate(f).str();
+        cur_line.append(S.data(), f);
       }
     } else {
       if (cur_line.size() > 0 && cur_line[cur_line.size() - 1] == '\r') {
-        cur_line = cur_line.substr(0, cur_line.size() - 1);
+        cur_line.pop_back();
       }
     }
     input.confirm_read(f + 1);
@@ -297,13 +297,9 @@ td::Status HttpPayload::parse(td::ChainBufferReader &input) {
         if (input.size() == 0) {
           return td::Status::OK();
         }
-        auto S = get_read_slice();
-        auto s = input.size();
-        if (S.size() > s) {
-          S.truncate(s);
-        }
-        CHECK(input.advance(S.size(), S) == S.size());
-        confirm_read(S.size());
+        // body is forwarded as slices of the receive buffer, without copying
+        auto size = static_cast<size_t>(std::min<td::uint64>(input.size(), cur_chunk_size_));
+        add_chunk(input.read_as_buffer_slice(size));
       } break;
       case ParseState::reading_trailer: {
         bool read;
@@ -346,29 +342,6 @@ bool HttpPayload::parse_completed() const {
   return state_.load(std::memory_order_consume) == ParseState::completed;
 }
 
-td::MutableSlice HttpPayload::get_read_slice() {
-  const std::lock_guard<std::mutex> lock{mutex_};
-  if (last_chunk_free_ == 0) {
-    auto B = td::BufferSlice{chunk_size_};
-    last_chunk_free_ = B.size();
-    chunks_.push_back(std::move(B));
-  }
-  auto b = chunks_.back().as_slice();
-  b.remove_prefix(b.size() - last_chunk_free_);
-  if (b.size() > cur_chunk_size_) {
-    b.truncate(cur_chunk_size_);
-  }
-  return b;
-}
-
-void HttpPayload::confirm_read(size_t s) {
-  const std::lock_guard<std::mutex> lock{mutex_};
-  last_chunk_free_ -= s;
-  cur_chunk_size_ -= s;
-  ready_bytes_ += s;
-  run_callbacks();
-}
-
 void HttpPayload::add_trailer(HttpHeader header) {
   const std::lock_guard<std::mutex> lock{mutex_};
   ready_bytes_ += header.size();
@@ -378,34 +351,22 @@ void HttpPayload::add_trailer(HttpHeader header) {
 }
 
 void HttpPayload::add_chunk(td::BufferSlice data) {
-  //LOG(INFO) << "payload: added " << data.size() << " bytes";
-  while (data.size() > 0) {
-    if (!cur_chunk_size_) {
-      cur_chunk_size_ = data.size();
-    }
-    auto S = get_read_slice();
-    CHECK(S.size() > 0);
-    if (S.size() > data.size()) {
-      S.truncate(data.size());
-    }
-    S.copy_from(data.as_slice().truncate(S.size()));
-    data.confirm_read(S.size());
-    confirm_read(S.size());
+  if (data.empty()) {
+    return;
   }
+  const std::lock_guard<std::mutex> lock{mutex_};
+  auto s = data.size();
+  chunks_.push_back(std::move(data));
+  cur_chunk_size_ -= std::min<td::uint64>(cur_chunk_size_, s);
+  ready_bytes_ += s;
+  run_callbacks();
 }
 
 void HttpPayload::slice_gc() {
   const std::lock_guard<std::mutex> lock{mutex_};
   while (chunks_.size() > 0) {
     auto &x = chunks_.front();
-    if (state_ == ParseState::completed || state_ == ParseState::reading_trailer) {
-      if (chunks_.size() == 1) {
-        x.truncate(x.size() - last_chunk_free_);
-        last_chunk_free_ = 0;
-      }
-    }
     if (x.size() == 0) {
-      CHECK(chunks_.size() > 1 || !last_chunk_free_);
       chunks_.pop_front();
       continue;
     }
@@ -418,31 +379,17 @@ td::BufferSlice HttpPayload::get_slice(size_t max_size) {
   while (chunks_.size() > 0) {
     auto &x = chunks_.front();
     if (x.size() == 0) {
-      CHECK(chunks_.size() > 1 || !last_chunk_free_);
       chunks_.pop_front();
       continue;
     }
     td::BufferSlice b;
-    if (chunks_.size() > 1 || !last_chunk_free_) {
-      if (x.size() <= max_size) {
-        b = std::move(x);
-        chunks_.pop_front();
-      } else {
-        b = x.clone();
-        b.truncate(max_size);
-        x.confirm_read(max_size);
-      }
+    if (x.size() <= max_size) {
+      b = std::move(x);
+      chunks_.pop_front();
     } else {
       b = x.clone();
-      CHECK(b.size() >= last_chunk_free_);
-      if (b.size() == last_chunk_free_) {
-        return td::BufferSlice{};
-      }
-      b.truncate(b.size() - last_chunk_free_);
-      if (b.size() > max_size) {
-        b.truncate(max_size);
-      }
-      x.confirm_read(b.size());
+      b.truncate(max_size);
+      x.confirm_read(max_size);
     }
     ready_bytes_ -= b.size();
     run_callbacks();
@@ -559,11 +506,24 @@ tl_object_ptr<ton_api::http_payloadPart> HttpPayload::store_tl(size_t max_size)
     b = max_size;
   }
   max_size = b;
-  td::BufferSlice x{b};
-  auto S = x.as_slice();
-  auto obj = create_tl_object<ton_api::http_payloadPart>(std::move(x),
+  auto obj = create_tl_object<ton_api::http_payloadPart>(td::BufferSlice(),
                                                          std::vector<tl_object_ptr<ton_api::http_header>>(), false);
 
+  // a single slice is passed as is, several are glued together
+  std::vector<td::BufferSlice> parts;
+  size_t total = 0;
+  auto set_data = [&] {
+    if (parts.size() == 1) {
+      obj->data_ = std::move(parts[0]);
+    } else if (parts.size() > 1) {
+      obj->data_ = td::BufferSlice{total};
+      auto S = obj->data_.as_slice();
+      for (auto &part : parts) {
+        S.copy_from(part);
+        S.remove_prefix(part.size());
+      }
+    }
+  };
   slice_gc();
   while (chunks_.size() > 0 && max_size > 0) {
     auto cur_state = state_.load(std::memory_order_consume);
@@ -571,18 +531,18 @@ tl_object_ptr<ton_api::http_payloadPart> HttpPayload::store_tl(size_t max_size)
     if (s.size() == 0) {
       if (cur_state != ParseState::reading_trailer && cur_state != ParseState::completed) {
         LOG(INFO) << "state not trailer/completed";
-        obj->data_.truncate(obj->data_.size() - S.size());
+        set_data();
         return obj;
       } else {
         break;
       }
     }
     CHECK(s.size() <= max_size);
-    S.copy_from(s);
-    S.remove_prefix(s.size());
     max_size -= s.size();
+    total += s.size();
+    parts.push_back(std::move(s));
   }
-  obj->data_.truncate(obj->data_.size() - S.size());
+  set_data();
   auto cur_state = state_.load(std::memory_order_consume);
   if (chunks_.size() != 0 || (cur_state != ParseState::reading_trailer && cur_state != ParseState::completed)) {
     return obj;
@@ -872,6 +832,10 @@ td::Status HttpHeader::basic_check() {
   return td::Status::OK();
 }
 
+double payload_part_timeout(double part_timeout, td::uint32 queued_parts) {
+  return part_timeout * (queued_parts + 1);
+}
+
 void answer_error(HttpStatusCode code, std::string reason,
                   td::Promise<std::pair<std::unique_ptr<HttpResponse>, std::shared_ptr<HttpPayload>>> promise) {
   if (reason.empty()) {
@@ -126,8 +126,6 @@ class HttpPayload {
   PayloadType payload_type() const {
     return type_;
   }
-  td::MutableSlice get_read_slice();
-  void confirm_read(size_t s);
   void add_trailer(HttpHeader header);
   void add_chunk(td::BufferSlice data);
   td::BufferSlice get_slice(size_t max_size);
@@ -152,8 +150,6 @@ class HttpPayload {
   size_t trailer_size_ = 0;
   size_t ready_bytes_ = 0;
   td::uint64 cur_chunk_size_ = 0;
-  size_t last_chunk_free_ = 0;
-  size_t chunk_size_ = 1 << 14;
   bool written_zero_chunk_ = false;
   bool written_trailer_ = false;
   bool error_ = false;
@@ -329,6 +325,9 @@ class HttpResponse {
 void answer_error(HttpStatusCode code, std::string reason,
                   td::Promise<std::pair<std::unique_ptr<HttpResponse>, std::shared_ptr<HttpPayload>>> promise);
 
+// timeout of a query for a payload part when the parts are served one by one: the queued parts go first
+double payload_part_timeout(double part_timeout, td::uint32 queued_parts);
+
 }  // namespace http
 
 }  // namespace ton
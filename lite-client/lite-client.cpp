@@ -923,6 +923,8 @@ bool TestNode::show_help(std::string command) {
          "status\tShow connection and local database status\n"
          "getaccount <addr> [<block-id-ext>]\tLoads the most recent state of specified account; <addr> is in "
          "[<workchain>:]<hex-or-base64-addr> format\n"
+         "getaccounts <addr> [<addr>...]\tLoads the most recent states of several accounts of one shard with a single "
+         "query\n"
          "saveaccount[code|data] <filename> <addr> [<block-id-ext>]\tSaves into specified file the most recent state "
          "(StateInit) or just the code or data of specified account; <addr> is in "
          "[<workchain>:]<hex-or-base64-addr> format\n"
@@ -934,6 +936,8 @@ bool TestNode::show_help(std::string command) {
          "<addr>\n"
          "allshards [<block-id-ext>]\tShows shard configuration from the most recent masterchain "
          "state or from masterchain state corresponding to <block-id-ext>\n"
+         "subscribe [<count>]\tWaits for the next <count> (10 by default) masterchain blocks and shows each of them "
+         "together with the shardchain blocks it registers\n"
          "getconfig [<param>...]\tShows specified or all configuration parameters from the latest masterchain state\n"
          "getconfigfrom <block-id-ext> [<param>...]\tShows specified or all configuration parameters from the "
          "masterchain state of <block-id-ext>\n"
@@ -1011,6 +1015,8 @@ bool TestNode::do_parse_line() {
            (seekeoln() ? get_account_state(workchain, addr, mc_last_id_, addr_ext, "", -1, prunned)
                        : parse_block_id_ext(blkid) && seekeoln() &&
                              get_account_state(workchain, addr, blkid, addr_ext, "", -1, prunned));
+  } else if (word == "getaccounts") {
+    return parse_account_addr(workchain, addr) && parse_get_account_states(workchain, addr);
   } else if (word == "saveaccount" || word == "saveaccountcode" || word == "saveaccountdata") {
     std::string filename;
     int mode = ((word.c_str()[11] >> 1) & 3);
@@ -1039,6 +1045,11 @@ bool TestNode::do_parse_line() {
     return (word.size() <= 9 || get_word_to(filename)) &&
            (seekeoln() ? get_all_shards(filename)
                        : (parse_block_id_ext(blkid) && seekeoln() && get_all_shards(filename, false, blkid)));
+  } else if (word == "subscribe") {
+    count = 10;
+    return (seekeoln() || parse_uint32(count)) && seekeoln() &&
+           (mc_last_id_.is_valid() ? get_mc_block_updates(mc_last_id_, count)
+                                   : set_error("must obtain last block information before making other queries"));
   } else if (word == "saveconfig") {
     blkid = mc_last_id_;
     std::string filename;
@@ -1222,6 +1233,94 @@ bool TestNode::get_account_state(ton::WorkchainId workchain, ton::StdSmcAddress
   });
 }
 
+bool TestNode::parse_get_account_states(ton::WorkchainId workchain, ton::StdSmcAddress addr) {
+  std::vector<ton::StdSmcAddress> addrs{addr};
+  while (!seekeoln()) {
+    ton::WorkchainId wc;
+    if (!parse_account_addr(wc, addr)) {
+      return false;
+    }
+    if (wc != workchain) {
+      return set_error("all accounts must belong to the same workchain");
+    }
+    addrs.push_back(addr);
+  }
+  return get_account_states(workchain, std::move(addrs), mc_last_id_);
+}
+
+bool TestNode::get_account_states(ton::WorkchainId workchain, std::vector<ton::StdSmcAddress> addrs,
+                                  ton::BlockIdExt ref_blkid) {
+  if (!ref_blkid.is_valid()) {
+    return set_error("must obtain last block information before making other queries");
+  }
+  if (!(ready_ && !client_.empty())) {
+    return set_error("server connection not ready");
+  }
+  auto b = ton::serialize_tl_object(ton::create_tl_object<ton::lite_api::liteServer_getAccountStates>(
+                                        ton::create_tl_lite_block_id(ref_blkid), workchain,
+                                        std::vector<ton::StdSmcAddress>(addrs)),
+                                    true);
+  LOG(INFO) << "requesting account states for " << addrs.size() << " accounts of workchain " << workchain
+            << " with respect to " << ref_blkid.to_str();
+  return envelope_send_query(
+      std::move(b), [Self = actor_id(this), workchain, addrs = std::move(addrs),
+                     ref_blkid](td::Result<td::BufferSlice> R) mutable {
+        if (R.is_error()) {
+          return;
+        }
+        auto F = ton::fetch_tl_object<ton::lite_api::liteServer_accountStates>(R.move_as_ok(), true);
+        if (F.is_error()) {
+          LOG(ERROR) << "cannot parse answer to liteServer.getAccountStates";
+        } else {
+          auto f = F.move_as_ok();
+          block::AccountStateList account_states;
+          account_states.blk = ton::create_block_id(f->id_);
+          account_states.shard_blk = ton::create_block_id(f->shardblk_);
+          account_states.shard_proof = std::move(f->shard_proof_);
+          account_states.proof = std::move(f->proof_);
+          account_states.states = std::move(f->states_);
+          account_states.count = static_cast<td::uint32>(f->count_);
+          td::actor::send_closure_later(Self, &TestNode::got_account_states, ref_blkid, workchain, std::move(addrs),
+                                        std::move(account_states));
+        }
+      });
+}
+
+void TestNode::got_account_states(ton::BlockIdExt ref_blk, ton::WorkchainId workchain,
+                                  std::vector<ton::StdSmcAddress> addrs, block::AccountStateList account_states) {
+  const auto& blk = account_states.blk;
+  const auto& shard_blk = account_states.shard_blk;
+  LOG(INFO) << "got account states for " << addrs.size() << " accounts with respect to blocks " << blk.to_str()
+            << (shard_blk == blk ? "" : std::string{" and "} + shard_blk.to_str());
+  auto r_infos = account_states.validate(ref_blk, workchain, addrs);
+  if (r_infos.is_error()) {
+    LOG(ERROR) << r_infos.error().message();
+    return;
+  }
+  auto infos = r_infos.move_as_ok();
+  auto out = td::TerminalIO::out();
+  for (std::size_t i = 0; i < infos.size(); i++) {
+    out << "account " << workchain << ":" << addrs[i].to_hex() << ": ";
+    const auto& info = infos[i];
+    if (info.root.is_null()) {
+      out << "empty" << std::endl;
+      continue;
+    }
+    block::gen::Account::Record_account acc;
+    block::gen::AccountStorage::Record store;
+    block::CurrencyCollection balance;
+    if (tlb::unpack_cell(info.root, acc) && tlb::csr_unpack(acc.storage, store) && balance.unpack(store.balance)) {
+      out << "balance " << balance.to_str() << ", ";
+    }
+    out << "last transaction lt = " << info.last_trans_lt << " hash = " << info.last_trans_hash.to_hex() << std::endl;
+  }
+  if (infos.size() < addrs.size()) {
+    // the server answers only a part of the accounts if their states are too large
+    addrs.erase(addrs.begin(), addrs.begin() + infos.size());
+    get_account_states(workchain, std::move(addrs), ref_blk);
+  }
+}
+
 td::int64 TestNode::compute_method_id(std::string method) {
   td::int64 method_id;
   if (!convert_int64(method, method_id)) {
@@ -2511,6 +2610,116 @@ bool TestNode::get_all_shards(std::string filename, bool use_last, ton::BlockIdE
   });
 }
 
+bool TestNode::get_mc_block_updates(ton::BlockIdExt trusted, unsigned count) {
+  if (!count) {
+    return true;
+  }
+  if (!(ready_ && !client_.empty())) {
+    return set_error("server connection not ready");
+  }
+  auto seqno = trusted.seqno() + 1;
+  // the liteserver holds the query until masterchain block seqno is applied, so no polling is necessary
+  auto prefix = ton::serialize_tl_object(
+      ton::create_tl_object<ton::lite_api::liteServer_waitMasterchainSeqno>(seqno, mc_block_wait_timeout_ms), true);
+  auto q = ton::serialize_tl_object(ton::create_tl_object<ton::lite_api::liteServer_getMasterchainBlockUpdate>(seqno),
+                                    true);
+  LOG(INFO) << "waiting for masterchain block " << seqno;
+  return envelope_send_query(td::BufferSlice(PSLICE() << prefix.as_slice() << q.as_slice()),
+                             [Self = actor_id(this), trusted, count](td::Result<td::BufferSlice> R) -> void {
+                               if (R.is_error()) {
+                                 return;
+                               }
+                               auto F = ton::fetch_tl_object<ton::lite_api::liteServer_masterchainBlockUpdate>(
+                                   R.move_as_ok(), true);
+                               if (F.is_error()) {
+                                 LOG(ERROR) << "cannot parse answer to liteServer.getMasterchainBlockUpdate";
+                                 return;
+                               }
+                               auto f = F.move_as_ok();
+                               std::vector<ton::BlockIdExt> shard_blocks;
+                               for (const auto& id : f->shard_blocks_) {
+                                 shard_blocks.push_back(ton::create_block_id(id));
+                               }
+                               td::actor::send_closure_later(Self, &TestNode::got_mc_block_update, trusted,
+                                                             ton::create_block_id(f->id_), std::move(shard_blocks),
+                                                             std::move(f->proof_), count);
+                             });
+}
+
+void TestNode::got_mc_block_update(ton::BlockIdExt trusted, ton::BlockIdExt blk,
+                                   std::vector<ton::BlockIdExt> shard_blocks, td::BufferSlice proof, unsigned count) {
+  LOG(INFO) << "got update for masterchain block " << blk.to_str();
+  if (!blk.is_masterchain_ext() || blk.seqno() != trusted.seqno() + 1) {
+    LOG(ERROR) << "invalid masterchain block update: got block " << blk.to_str() << " instead of the successor of "
+               << trusted.to_str();
+    return;
+  }
+  auto S = block::check_new_shard_blocks_proof(blk, shard_blocks, proof.as_slice());
+  if (S.is_error()) {
+    LOG(ERROR) << "invalid masterchain block update: " << S.move_as_error();
+    return;
+  }
+  // the shard blocks are proven with respect to blk, which itself must be linked to the previous trusted block
+  check_mc_block_update(trusted, blk, std::move(shard_blocks), count);
+}
+
+void TestNode::check_mc_block_update(ton::BlockIdExt from, ton::BlockIdExt blk,
+                                     std::vector<ton::BlockIdExt> shard_blocks, unsigned count) {
+  auto b = ton::serialize_tl_object(ton::create_tl_object<ton::lite_api::liteServer_getBlockProof>(
+                                        1, ton::create_tl_lite_block_id(from), ton::create_tl_lite_block_id(blk)),
+                                    true);
+  envelope_send_query(std::move(b), [Self = actor_id(this), from, blk, shard_blocks = std::move(shard_blocks),
+                                     count](td::Result<td::BufferSlice> R) mutable {
+    if (R.is_error()) {
+      return;
+    }
+    td::actor::send_closure_later(Self, &TestNode::got_mc_block_update_proof, from, blk, std::move(shard_blocks),
+                                  count, R.move_as_ok());
+  });
+}
+
+void TestNode::got_mc_block_update_proof(ton::BlockIdExt from, ton::BlockIdExt blk,
+                                         std::vector<ton::BlockIdExt> shard_blocks, unsigned count,
+                                         td::BufferSlice pchain) {
+  auto r_f = ton::fetch_tl_object<ton::lite_api::liteServer_partialBlockProof>(std::move(pchain), true);
+  if (r_f.is_error()) {
+    LOG(ERROR) << "cannot deserialize liteServer.partialBlockProof: " << r_f.move_as_error();
+    return;
+  }
+  auto res = liteclient::deserialize_proof_chain(r_f.move_as_ok());
+  if (res.is_error()) {
+    LOG(ERROR) << "cannot deserialize liteServer.partialBlockProof: " << res.move_as_error();
+    return;
+  }
+  auto chain = res.move_as_ok();
+  if (chain->from != from) {
+    LOG(ERROR) << "block proof chain starts from block " << chain->from.to_str() << ", not from requested block "
+               << from.to_str();
+    return;
+  }
+  auto err = chain->validate();
+  if (err.is_error()) {
+    LOG(ERROR) << "block proof chain for masterchain block update is invalid: " << err;
+    return;
+  }
+  if (!chain->complete) {
+    check_mc_block_update(chain->to, blk, std::move(shard_blocks), count);
+    return;
+  }
+  if (chain->to != blk) {
+    LOG(ERROR) << "block proof chain ends at block " << chain->to.to_str() << ", not at " << blk.to_str();
+    return;
+  }
+  register_blkid(blk);
+  auto out = td::TerminalIO::out();
+  out << "masterchain block " << blk.to_str() << " registers " << shard_blocks.size() << " new shard blocks\n";
+  for (const auto& id : shard_blocks) {
+    register_blkid(id);
+    out << "  " << id.to_str() << std::endl;
+  }
+  get_mc_block_updates(blk, count - 1);
+}
+
 void TestNode::got_all_shards(ton::BlockIdExt blk, td::BufferSlice proof, td::BufferSlice data, std::string filename) {
   LOG(INFO) << "got shard configuration with respect to block " << blk.to_str();
   if (data.empty()) {
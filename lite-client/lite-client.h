@@ -34,6 +34,7 @@
 #include "vm/stack.hpp"
 #include "block/block.h"
 #include "block/mc-config.h"
+#include "block/check-proof.h"
 #include "td/utils/filesystem.h"
 
 using td::Ref;
@@ -45,6 +46,7 @@ class TestNode : public td::actor::Actor {
     min_ls_version = 0x101,
     min_ls_capabilities = 1
   };  // server version >= 1.1, capabilities at least +1 = build proof chains
+  enum { mc_block_wait_timeout_ms = 8000 };  // must be below the 10 s timeout of a liteserver query
   td::actor::ActorOwn<ton::adnl::AdnlExtClient> client_;
   td::actor::ActorOwn<td::TerminalIO> io_;
 
@@ -196,6 +198,10 @@ class TestNode : public td::actor::Actor {
                          td::BufferSlice shard_proof, td::BufferSlice proof, td::BufferSlice state,
                          ton::WorkchainId workchain, ton::StdSmcAddress addr, std::string filename, int mode,
                          bool prunned);
+  bool parse_get_account_states(ton::WorkchainId workchain, ton::StdSmcAddress addr);
+  bool get_account_states(ton::WorkchainId workchain, std::vector<ton::StdSmcAddress> addrs, ton::BlockIdExt ref_blkid);
+  void got_account_states(ton::BlockIdExt ref_blk, ton::WorkchainId workchain, std::vector<ton::StdSmcAddress> addrs,
+                          block::AccountStateList account_states);
   bool parse_run_method(ton::WorkchainId workchain, ton::StdSmcAddress addr, ton::BlockIdExt ref_blkid, int addr_ext,
                         std::string method_name, bool ext_mode);
   bool after_parse_run_method(ton::WorkchainId workchain, ton::StdSmcAddress addr, ton::BlockIdExt ref_blkid,
@@ -223,6 +229,13 @@ class TestNode : public td::actor::Actor {
   bool show_dns_record(std::ostream& os, td::Bits256 cat, Ref<vm::CellSlice> value, bool raw_dump);
   bool get_all_shards(std::string filename = "", bool use_last = true, ton::BlockIdExt blkid = {});
   void got_all_shards(ton::BlockIdExt blk, td::BufferSlice proof, td::BufferSlice data, std::string filename);
+  bool get_mc_block_updates(ton::BlockIdExt trusted, unsigned count);
+  void got_mc_block_update(ton::BlockIdExt trusted, ton::BlockIdExt blk, std::vector<ton::BlockIdExt> shard_blocks,
+                           td::BufferSlice proof, unsigned count);
+  void check_mc_block_update(ton::BlockIdExt from, ton::BlockIdExt blk, std::vector<ton::BlockIdExt> shard_blocks,
+                             unsigned count);
+  void got_mc_block_update_proof(ton::BlockIdExt from, ton::BlockIdExt blk, std::vector<ton::BlockIdExt> shard_blocks,
+                                 unsigned count, td::BufferSlice pchain);
   bool parse_get_config_params(ton::BlockIdExt blkid, int mode = 0, std::string filename = "",
                                std::vector<int> params = {});
   bool get_config_params(ton::BlockIdExt blkid, td::Promise<std::unique_ptr<block::Config>> promise, int mode = 0,
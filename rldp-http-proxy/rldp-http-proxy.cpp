@@ -137,6 +137,9 @@ const std::string PROXY_SITE_VERISON_HEADER_NAME = "Ton-Proxy-Site-Version";
 const std::string PROXY_ENTRY_VERISON_HEADER_NAME = "Ton-Proxy-Entry-Version";
 const std::string PROXY_VERSION_HEADER = PSTRING() << "Commit: " << GitMetadata::CommitSHA1()
                                                    << ", Date: " << GitMetadata::CommitDate();
+// Sent by the proxy that serves a payload: the number of http.getNextPayloadPart queries it accepts in parallel.
+// Proxies that do not send it accept only one query at a time.
+const std::string PROXY_PAYLOAD_WINDOW_HEADER_NAME = "Ton-Proxy-Payload-Window";
 
 using RegisteredPayloadSenderGuard =
     std::unique_ptr<std::pair<td::actor::ActorId<RldpHttpProxy>, td::Bits256>,
@@ -147,14 +150,15 @@ class HttpRldpPayloadReceiver : public td::actor::Actor {
   HttpRldpPayloadReceiver(std::shared_ptr<ton::http::HttpPayload> payload, td::Bits256 transfer_id,
                           ton::adnl::AdnlNodeIdShort src, ton::adnl::AdnlNodeIdShort local_id,
                           td::actor::ActorId<ton::adnl::Adnl> adnl, td::actor::ActorId<ton::rldp::Rldp> rldp,
-                          bool is_tunnel = false)
+                          bool is_tunnel = false, td::uint32 window = 1)
       : payload_(std::move(payload))
       , id_(transfer_id)
       , src_(src)
       , local_id_(local_id)
       , adnl_(adnl)
       , rldp_(rldp)
-      , is_tunnel_(is_tunnel) {
+      , is_tunnel_(is_tunnel)
+      , window_(is_tunnel ? 1 : std::max<td::uint32>(window, 1)) {
   }
 
   void start_up() override {
@@ -184,36 +188,47 @@ class HttpRldpPayloadReceiver : public td::actor::Actor {
   }
 
   void request_more_data() {
-    LOG(INFO) << "HttpPayloadReceiver: sent=" << sent_ << " completed=" << payload_->parse_completed()
+    LOG(INFO) << "HttpPayloadReceiver: sent=" << seqno_ - received_seqno_ << " completed=" << payload_->parse_completed()
               << " ready=" << payload_->ready_bytes() << " watermark=" << watermark();
-    if (sent_ || payload_->parse_completed()) {
-      return;
-    }
-    if (payload_->ready_bytes() >= watermark()) {
-      return;
+    // up to window_ queries are in flight, answers are applied in the order of seqno
+    while (static_cast<td::uint32>(seqno_ - received_seqno_) < window_ && !payload_->parse_completed() &&
+           payload_->ready_bytes() < watermark()) {
+      auto P = td::PromiseCreator::lambda([SelfId = actor_id(this), seqno = seqno_](td::Result<td::BufferSlice> R) {
+        td::actor::send_closure(SelfId, &HttpRldpPayloadReceiver::got_answer, seqno, std::move(R));
+      });
+
+      auto queued = static_cast<td::uint32>(seqno_ - received_seqno_);
+      auto timeout = td::Timestamp::in(ton::http::payload_part_timeout(is_tunnel_ ? 60.0 : 15.0, queued));
+      auto f = ton::create_serialize_tl_object<ton::ton_api::http_getNextPayloadPart>(
+          id_, seqno_++, static_cast<td::int32>(chunk_size()));
+      td::actor::send_closure(rldp_, &ton::rldp::Rldp::send_query_ex, local_id_, src_, "payload part", std::move(P),
+                              timeout, std::move(f), 2 * chunk_size() + 1024);
     }
-    sent_ = true;
-    auto P = td::PromiseCreator::lambda([SelfId = actor_id(this)](td::Result<td::BufferSlice> R) {
-      if (R.is_error()) {
-        td::actor::send_closure(SelfId, &HttpRldpPayloadReceiver::abort_query, R.move_as_error());
-      } else {
-        td::actor::send_closure(SelfId, &HttpRldpPayloadReceiver::add_data, R.move_as_ok());
-      }
-    });
+  }
 
-    auto f = ton::create_serialize_tl_object<ton::ton_api::http_getNextPayloadPart>(
-        id_, seqno_++, static_cast<td::int32>(chunk_size()));
-    auto timeout = td::Timestamp::in(is_tunnel_ ? 60.0 : 15.0);
-    td::actor::send_closure(rldp_, &ton::rldp::Rldp::send_query_ex, local_id_, src_, "payload part", std::move(P),
-                            timeout, std::move(f), 2 * chunk_size() + 1024);
+  void got_answer(td::int32 seqno, td::Result<td::BufferSlice> R) {
+    answers_.emplace(seqno, std::move(R));
+    while (!answers_.empty() && answers_.begin()->first == received_seqno_) {
+      auto answer = std::move(answers_.begin()->second);
+      answers_.erase(answers_.begin());
+      received_seqno_++;
+      if (answer.is_error()) {
+        abort_query(answer.move_as_error());
+        return;
+      }
+      if (!add_data(answer.move_as_ok())) {
+        return;
+      }
+    }
+    request_more_data();
   }
 
-  void add_data(td::BufferSlice data) {
+  bool add_data(td::BufferSlice data) {
     LOG(INFO) << "HttpPayloadReceiver: received answer (size " << data.size() << ")";
     auto F = ton::fetch_tl_object<ton::ton_api::http_payloadPart>(data, true);
     if (F.is_error()) {
       abort_query(F.move_as_error());
-      return;
+      return false;
     }
     auto f = F.move_as_ok();
     LOG(INFO) << "HttpPayloadReceiver: received answer datasize=" << f->data_.size()
@@ -226,20 +241,17 @@ class HttpRldpPayloadReceiver : public td::actor::Actor {
       auto S = h.basic_check();
       if (S.is_error()) {
         abort_query(S.move_as_error());
-        return;
+        return false;
       }
       payload_->add_trailer(std::move(h));
     }
-    sent_ = false;
     if (f->last_) {
       payload_->complete_parse();
       LOG(INFO) << "received HTTP payload";
       stop();
-    } else {
-      if (payload_->ready_bytes() < watermark()) {
-        request_more_data();
-      }
+      return false;
     }
+    return true;
   }
 
   void abort_query(td::Status error) {
@@ -267,9 +279,11 @@ class HttpRldpPayloadReceiver : public td::actor::Actor {
   td::actor::ActorId<ton::adnl::Adnl> adnl_;
   td::actor::ActorId<ton::rldp::Rldp> rldp_;
 
-  bool sent_ = false;
   td::int32 seqno_ = 0;
+  td::int32 received_seqno_ = 0;
+  std::map<td::int32, td::Result<td::BufferSlice>> answers_;
   bool is_tunnel_;
+  td::uint32 window_;
 };
 
 class HttpRldpPayloadSender : public td::actor::Actor {
@@ -309,51 +323,54 @@ class HttpRldpPayloadSender : public td::actor::Actor {
     if (from_timer) {
       active_timer_ = false;
     }
-    if (!cur_query_promise_) {
-      return;
-    }
-    if (payload_->is_error()) {
-      return;
-    }
-    if (payload_->parse_completed() || payload_->ready_bytes() >= ton::http::HttpRequest::low_watermark()) {
-      answer_query();
-    } else if (!is_tunnel_ || payload_->ready_bytes() == 0) {
-      return;
-    } else if (from_timer) {
-      answer_query();
-    } else if (!active_timer_) {
-      active_timer_ = true;
-      ton::delay_action(
-          [SelfId = actor_id(this)]() {
-            td::actor::send_closure(SelfId, &HttpRldpPayloadSender::try_answer_query, true);
-          },
-          td::Timestamp::in(0.001));
+    while (queries_.count(seqno_) && !payload_->written()) {
+      if (payload_->is_error()) {
+        return;
+      }
+      if (payload_->parse_completed() || payload_->ready_bytes() >= ton::http::HttpRequest::low_watermark()) {
+        answer_query();
+      } else if (!is_tunnel_ || payload_->ready_bytes() == 0) {
+        return;
+      } else if (from_timer) {
+        answer_query();
+        return;
+      } else {
+        if (!active_timer_) {
+          active_timer_ = true;
+          ton::delay_action(
+              [SelfId = actor_id(this)]() {
+                td::actor::send_closure(SelfId, &HttpRldpPayloadSender::try_answer_query, true);
+              },
+              td::Timestamp::in(0.001));
+        }
+        return;
+      }
     }
   }
 
   void send_data(ton::tl_object_ptr<ton::ton_api::http_getNextPayloadPart> query,
                  td::Promise<td::BufferSlice> promise) {
     CHECK(query->id_ == id_);
-    if (query->seqno_ != seqno_) {
+    if (query->seqno_ < seqno_ || query->seqno_ - seqno_ >= static_cast<td::int32>(max_window())) {
       LOG(INFO) << "seqno mismatch. closing http transfer";
       stop();
       return;
     }
 
-    if (cur_query_promise_) {
+    if (queries_.count(query->seqno_)) {
       LOG(INFO) << "duplicate http query. closing http transfer";
       stop();
       return;
     }
 
-    cur_query_size_ = query->max_chunk_size_;
-    if (cur_query_size_ > watermark()) {
-      cur_query_size_ = watermark();
+    size_t size = query->max_chunk_size_;
+    if (size > watermark()) {
+      size = watermark();
     }
-    cur_query_promise_ = std::move(promise);
+    queries_[query->seqno_] = Query{size, std::move(promise)};
 
-    LOG(INFO) << "received request. size=" << cur_query_size_ << " parse_completed=" << payload_->parse_completed()
-              << " ready_bytes=" << payload_->ready_bytes();
+    LOG(INFO) << "received request. seqno=" << query->seqno_ << " size=" << size
+              << " parse_completed=" << payload_->parse_completed() << " ready_bytes=" << payload_->ready_bytes();
 
     alarm_timestamp() = td::Timestamp::in(is_tunnel_ ? 50.0 : 10.0);
     try_answer_query(false);
@@ -365,7 +382,7 @@ class HttpRldpPayloadSender : public td::actor::Actor {
   }
 
   void alarm() override {
-    if (cur_query_promise_) {
+    if (queries_.count(seqno_)) {
       if (is_tunnel_) {
         answer_query();
         return;
@@ -378,14 +395,18 @@ class HttpRldpPayloadSender : public td::actor::Actor {
   }
 
   void answer_query() {
-    cur_query_promise_.set_value(ton::serialize_tl_object(payload_->store_tl(cur_query_size_), true));
+    auto it = queries_.find(seqno_);
+    CHECK(it != queries_.end());
+    auto query = std::move(it->second);
+    queries_.erase(it);
+    query.promise.set_value(ton::serialize_tl_object(payload_->store_tl(query.size), true));
     if (payload_->written()) {
       LOG(INFO) << "sent HTTP payload";
       stop();
     }
     seqno_++;
 
-    alarm_timestamp() = td::Timestamp::in(is_tunnel_ ? 60.0 : 30.0);
+    alarm_timestamp() = td::Timestamp::in(is_tunnel_ ? 60.0 : (queries_.empty() ? 30.0 : 10.0));
   }
 
   void abort_query(td::Status error) {
@@ -393,6 +414,10 @@ class HttpRldpPayloadSender : public td::actor::Actor {
     stop();
   }
 
+  static constexpr td::uint32 max_window() {
+    return 16;
+  }
+
  private:
   static constexpr size_t watermark() {
     return (1 << 21) - (1 << 11);
@@ -410,8 +435,12 @@ class HttpRldpPayloadSender : public td::actor::Actor {
   td::actor::ActorId<ton::rldp::Rldp> rldp_;
   td::actor::ActorId<RldpHttpProxy> proxy_;
 
-  size_t cur_query_size_;
-  td::Promise<td::BufferSlice> cur_query_promise_;
+  struct Query {
+    size_t size;
+    td::Promise<td::BufferSlice> promise;
+  };
+  // queries that are not answered yet, by seqno; they are answered strictly in order
+  std::map<td::int32, Query> queries_;
   bool is_tunnel_, active_timer_ = false;
 };
 
@@ -426,7 +455,7 @@ class TcpToRldpRequestSender : public td::actor::Actor {
       td::actor::ActorId<ton::adnl::Adnl> adnl, td::actor::ActorId<ton::dht::Dht> dht,
       td::actor::ActorId<ton::rldp::Rldp> rldp, td::actor::ActorId<RldpHttpProxy> proxy,
       td::actor::ActorId<DNSResolver> dns_resolver,
-      ton::adnl::AdnlNodeIdShort storage_gateway)
+      ton::adnl::AdnlNodeIdShort storage_gateway, td::uint32 payload_window)
       : local_id_(local_id)
       , host_(std::move(host))
       , request_(std::move(request))
@@ -437,7 +466,8 @@ class TcpToRldpRequestSender : public td::actor::Actor {
       , rldp_(rldp)
       , proxy_(proxy)
       , dns_resolver_(dns_resolver)
-      , storage_gateway_(storage_gateway) {
+      , storage_gateway_(storage_gateway)
+      , payload_window_(payload_window) {
   }
 
   void start_up() override {
@@ -482,7 +512,15 @@ class TcpToRldpRequestSender : public td::actor::Actor {
       return;
     }
     response_ = R.move_as_ok();
+    td::uint32 remote_window = 0;
     for (auto &e : f->headers_) {
+      if (td::to_lower(e->name_) == td::to_lower(PROXY_PAYLOAD_WINDOW_HEADER_NAME)) {
+        auto r = td::to_integer_safe<td::uint32>(e->value_);
+        if (r.is_ok() && (remote_window == 0 || r.ok() < remote_window)) {
+          remote_window = r.ok();
+        }
+        continue;
+      }
       ton::http::HttpHeader h{e->name_, e->value_};
       auto S = h.basic_check();
       if (S.is_error()) {
@@ -511,7 +549,8 @@ class TcpToRldpRequestSender : public td::actor::Actor {
       response_payload_->complete_parse();
     } else {
       td::actor::create_actor<HttpRldpPayloadReceiver>("HttpPayloadReceiver", response_payload_, id_, dst_, local_id_,
-                                                       adnl_, rldp_, is_tunnel())
+                                                       adnl_, rldp_, is_tunnel(),
+                                                       remote_window ? std::min(remote_window, payload_window_) : 1)
           .release();
     }
 
@@ -552,6 +591,7 @@ class TcpToRldpRequestSender : public td::actor::Actor {
   td::actor::ActorId<RldpHttpProxy> proxy_;
   td::actor::ActorId<DNSResolver> dns_resolver_;
   ton::adnl::AdnlNodeIdShort storage_gateway_ = ton::adnl::AdnlNodeIdShort::zero();
+  td::uint32 payload_window_;
 
   bool dns_resolve_sent_ = false;
 
@@ -782,6 +822,7 @@ class RldpToTcpRequestSender : public td::actor::Actor {
                                                    rldp_, proxy_)
         .release();
     R.first->add_header({PROXY_SITE_VERISON_HEADER_NAME, PROXY_VERSION_HEADER});
+    R.first->add_header({PROXY_PAYLOAD_WINDOW_HEADER_NAME, PSTRING() << HttpRldpPayloadSender::max_window()});
     auto f = ton::serialize_tl_object(R.first->store_tl(), true);
     promise_.set_value(std::move(f));
     stop();
@@ -1119,7 +1160,8 @@ class RldpHttpProxy : public td::actor::Actor {
 
     td::actor::create_actor<TcpToRldpRequestSender>("outboundreq", local_id_, host, std::move(request),
                                                     std::move(payload), std::move(promise), adnl_.get(), dht_.get(),
-                                                    rldp_.get(), actor_id(this), dns_resolver_.get(), storage_gateway_)
+                                                    rldp_.get(), actor_id(this), dns_resolver_.get(), storage_gateway_,
+                                                    payload_window_)
         .release();
   }
 
@@ -1291,6 +1333,10 @@ class RldpHttpProxy : public td::actor::Actor {
     storage_gateway_ = id;
   }
 
+  void set_payload_window(td::uint32 value) {
+    payload_window_ = value;
+  }
+
  private:
   struct Host {
     struct Server {
@@ -1329,6 +1375,7 @@ class RldpHttpProxy : public td::actor::Actor {
   td::actor::ActorOwn<tonlib::TonlibClientWrapper> tonlib_client_;
   td::actor::ActorOwn<DNSResolver> dns_resolver_;
   ton::adnl::AdnlNodeIdShort storage_gateway_ = ton::adnl::AdnlNodeIdShort::zero();
+  td::uint32 payload_window_ = 8;
 
   std::map<td::Bits256,
            std::function<void(ton::tl_object_ptr<ton::ton_api::http_getNextPayloadPart>, td::Promise<td::BufferSlice>)>>
@@ -1594,6 +1641,17 @@ int main(int argc, char *argv[]) {
                          return td::Status::OK();
                        });
 
+  p.add_checked_option('w', "payload-window",
+                       "number of parallel payload part queries for responses from TON Sites (default: 8)",
+                       [&](td::Slice arg) -> td::Status {
+                         TRY_RESULT(value, td::to_integer_safe<td::uint32>(arg));
+                         if (value < 1 || value > HttpRldpPayloadSender::max_window()) {
+                           return td::Status::Error(PSTRING() << "--payload-window should be in range [1.."
+                                                              << HttpRldpPayloadSender::max_window() << "]");
+                         }
+                         td::actor::send_closure(x, &RldpHttpProxy::set_payload_window, value);
+                         return td::Status::OK();
+                       });
   td::actor::Scheduler scheduler({7});
 
   scheduler.run_in_context([&] { x = td::actor::create_actor<RldpHttpProxy>("proxymain"); });
@@ -21,6 +21,7 @@
 
 #include "common/bitstring.h"
 #include "td/utils/UInt.h"
+#include "td/utils/port/thread.h"
 
 #include "vm/cells/CellSlice.h"
 #include "vm/cells/MerkleProof.h"
@@ -55,7 +56,7 @@ static td::Ref<vm::Cell> build_tree(td::Bits256 *hashes, size_t len) {
   return vm::CellBuilder().store_ref(l).store_ref(r).finalize();
 };
 
-MerkleTree::MerkleTree(std::vector<td::Bits256> hashes) : pieces_count_(hashes.size()) {
+MerkleTree::MerkleTree(std::vector<td::Bits256> hashes, size_t threads) : pieces_count_(hashes.size()) {
   depth_ = 0;
   n_ = 1;
   while (n_ < pieces_count_) {
@@ -63,7 +64,35 @@ MerkleTree::MerkleTree(std::vector<td::Bits256> hashes) : pieces_count_(hashes.s
     n_ <<= 1;
   }
   hashes.resize(n_, td::Bits256::zero());
-  td::Ref<vm::Cell> root = build_tree(hashes.data(), n_);
+  // Split the tree into 2^k subtrees of equal size (at least min_subtree_size leaves each), build them concurrently
+  // and then join the top k levels. The resulting cells are exactly the same as in the sequential case.
+  const size_t min_subtree_size = 1024;
+  size_t subtrees = 1;
+  while (subtrees < threads && n_ / subtrees >= 2 * min_subtree_size) {
+    subtrees <<= 1;
+  }
+  td::Ref<vm::Cell> root;
+  if (subtrees == 1) {
+    root = build_tree(hashes.data(), n_);
+  } else {
+    size_t subtree_size = n_ / subtrees;
+    std::vector<td::Ref<vm::Cell>> level(subtrees);
+    std::vector<td::thread> workers;
+    for (size_t i = 0; i < subtrees; ++i) {
+      workers.emplace_back([&, i] { level[i] = build_tree(hashes.data() + i * subtree_size, subtree_size); });
+    }
+    for (auto &worker : workers) {
+      worker.join();
+    }
+    while (level.size() > 1) {
+      std::vector<td::Ref<vm::Cell>> next(level.size() / 2);
+      for (size_t i = 0; i < next.size(); ++i) {
+        next[i] = vm::CellBuilder().store_ref(level[2 * i]).store_ref(level[2 * i + 1]).finalize();
+      }
+      level = std::move(next);
+    }
+    root = std::move(level[0]);
+  }
   root_hash_ = root->get_hash().bits();
   root_proof_ = vm::CellBuilder::create_merkle_proof(std::move(root));
 }
@@ -34,7 +34,8 @@ class MerkleTree {
  public:
   MerkleTree() = default;
   MerkleTree(size_t pieces_count, td::Bits256 root_hash);
-  explicit MerkleTree(std::vector<td::Bits256> hashes);
+  // Subtrees are built in up to `threads` threads; the result does not depend on the number of threads
+  explicit MerkleTree(std::vector<td::Bits256> hashes, size_t threads = 1);
 
   td::Status add_proof(td::Ref<vm::Cell> proof);
   td::Result<td::Bits256> get_piece_hash(size_t idx) const;
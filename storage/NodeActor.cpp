@@ -78,6 +78,7 @@ void NodeActor::on_signal_from_peer(PeerId peer_id) {
 
 void NodeActor::start_up() {
   node_callback_->register_self(actor_id(this));
+  piece_cache_ = node_callback_->get_piece_cache();
   db_store_torrent();
   if (torrent_.inited_info()) {
     init_torrent();
@@ -272,7 +273,7 @@ std::string NodeActor::get_stats_str() {
         sb << "\tcnt:" << parts_helper_.get_want_download_count(it.second.peer_token);
       }
     }
-    sb << "\toutq:" << state->node_queries_active_.size();
+    sb << "\toutq:" << state->node_queries_active_.size() << "/" << get_peer_max_queries(it.second);
     auto node_state = state->node_state_.load();
     sb << "\tNup:" << node_state.will_upload;
     sb << "\tNdown:" << node_state.want_download;
@@ -503,6 +504,7 @@ void NodeActor::loop_queries() {
   if (!should_download_) {
     return;
   }
+  size_t capacity = 0;
   for (auto &it : peers_) {
     auto peer_token = it.second.peer_token;
     auto &state = it.second.state;
@@ -514,27 +516,100 @@ void NodeActor::loop_queries() {
       parts_helper_.set_peer_limit(peer_token, 0);
       continue;
     }
-    parts_helper_.set_peer_limit(
-        peer_token, td::narrow_cast<td::uint32>(MAX_PEER_TOTAL_QUERIES - state->node_queries_active_.size()));
+    size_t max_queries = get_peer_max_queries(it.second);
+    size_t active_queries = state->node_queries_active_.size();
+    size_t limit = max_queries > active_queries ? max_queries - active_queries : 0;
+    parts_helper_.set_peer_limit(peer_token, td::narrow_cast<td::uint32>(limit));
+    capacity += limit;
   }
 
-  auto parts = parts_helper_.get_rarest_parts(MAX_TOTAL_QUERIES);
+  capacity = td::min(capacity, MAX_TOTAL_QUERIES > parts_.total_queries ? MAX_TOTAL_QUERIES - parts_.total_queries : 0);
+  if (capacity == 0) {
+    return;
+  }
+  auto parts = parts_helper_.get_rarest_parts(capacity);
   for (auto &part : parts) {
     auto it = peers_.find(part.peer_id);
     CHECK(it != peers_.end());
     auto &state = it->second.state;
     CHECK(state->peer_state_ready_);
     CHECK(state->peer_state_.load().will_upload);
-    CHECK(state->node_queries_active_.size() < MAX_PEER_TOTAL_QUERIES);
-    auto part_id = part.part_id;
-    if (state->node_queries_active_.insert(static_cast<td::uint32>(part_id)).second) {
-      state->node_queries_.add_element(static_cast<td::uint32>(part_id));
+    send_part_query(part.part_id, it->second);
+  }
+
+  // Endgame: every remaining part is already requested, so the free capacity of other peers is used to request
+  // the same parts again. Whichever answer comes first is used, the rest are dropped.
+  if (parts.size() >= capacity || parts_.active_parts.empty() || parts_.active_parts.size() > ENDGAME_MAX_PARTS) {
+    return;
+  }
+  for (PartId part_id : parts_.active_parts) {
+    auto &part = parts_.parts[part_id];
+    if (part.ready || parts_helper_.get_part_priority(part_id) == 0) {
+      continue;
     }
+    for (auto &it : peers_) {
+      if (part.queries >= ENDGAME_MAX_PART_QUERIES || parts_.total_queries >= MAX_TOTAL_QUERIES) {
+        break;
+      }
+      auto &peer = it.second;
+      auto &state = peer.state;
+      if (!state->peer_state_ready_ || !state->peer_state_.load().will_upload) {
+        continue;
+      }
+      if (state->node_queries_active_.size() >= get_peer_max_queries(peer) ||
+          state->node_queries_active_.count(part_id) || !parts_helper_.get_ready_parts(peer.peer_token).get(part_id)) {
+        continue;
+      }
+      send_part_query(part_id, peer);
+    }
+  }
+}
+
+size_t NodeActor::get_peer_max_queries(const Peer &peer) const {
+  if (peer.min_rtt <= 0) {
+    return MIN_PEER_QUERIES;
+  }
+  // Keep about twice the bandwidth-delay product in flight, so the pipeline can grow while the speed is measured
+  double in_flight = 2 * peer.download_speed.speed() * peer.min_rtt / torrent_.get_info().piece_size;
+  return td::clamp(static_cast<size_t>(in_flight) + MIN_PEER_QUERIES, MIN_PEER_QUERIES, MAX_PEER_QUERIES);
+}
+
+void NodeActor::send_part_query(PartId part_id, Peer &peer) {
+  auto &state = peer.state;
+  if (!state->node_queries_active_.insert(part_id).second) {
+    return;
+  }
+  state->node_queries_.add_element(part_id);
+  peer.query_sent_at[part_id] = td::Timestamp::now();
+  auto &part = parts_.parts[part_id];
+  if (part.queries++ == 0) {
     parts_helper_.lock_part(part_id);
-    parts_.total_queries++;
-    parts_.parts[part_id].query_to_peer = part.peer_id;
-    state->notify_peer();
+    parts_.active_parts.insert(part_id);
+  }
+  parts_.total_queries++;
+  state->notify_peer();
+}
+
+void NodeActor::finish_part_query(PartId part_id, Peer &peer, bool ok) {
+  auto it = peer.query_sent_at.find(part_id);
+  if (it != peer.query_sent_at.end()) {
+    if (ok) {
+      double rtt = td::Time::now() - it->second.at();
+      if (peer.min_rtt <= 0 || rtt < peer.min_rtt || peer.min_rtt_expires_at.is_in_past()) {
+        peer.min_rtt = rtt;
+        peer.min_rtt_expires_at = td::Timestamp::in(MIN_RTT_WINDOW);
+      }
+    }
+    peer.query_sent_at.erase(it);
   }
+  peer.state->node_queries_active_.erase(part_id);
+  auto &part = parts_.parts[part_id];
+  CHECK(part.queries > 0);
+  if (--part.queries == 0) {
+    parts_helper_.unlock_part(part_id);
+    parts_.active_parts.erase(part_id);
+  }
+  parts_.total_queries--;
 }
 
 void NodeActor::loop_get_peers() {
@@ -594,12 +669,7 @@ void NodeActor::loop_peer(const PeerId &peer_id, Peer &peer) {
       if (!node_state.will_upload || !should_upload_) {
         return td::Status::Error("Won't upload");
       }
-      TRY_RESULT(proof, torrent_.get_piece_proof(part_id));
-      TRY_RESULT(data, torrent_.get_piece_data(part_id));
-      PeerState::Part res;
-      TRY_RESULT(proof_serialized, vm::std_boc_serialize(std::move(proof)));
-      res.proof = std::move(proof_serialized);
-      res.data = td::BufferSlice(std::move(data));
+      TRY_RESULT(res, get_part_for_upload(part_id, peer));
       td::uint64 size = res.data.size() + res.proof.size();
       upload_speed_.add(size);
       peer.upload_speed.add(size);
@@ -615,21 +685,23 @@ void NodeActor::loop_peer(const PeerId &peer_id, Peer &peer) {
     if (!state->node_queries_active_.count(part_id)) {
       continue;
     }
-    auto r_unit = p.second.move_fmap([&](PeerState::Part part) -> td::Result<td::Unit> {
-      TRY_RESULT(proof, vm::std_boc_deserialize(part.proof));
-      TRY_STATUS(torrent_.add_piece(part_id, part.data.as_slice(), std::move(proof)));
-      update_pieces_in_db(part_id, part_id + 1);
-      download_speed_.add(part.data.size());
-      peer.download_speed.add(part.data.size());
-      return td::Unit();
-    });
-
-    parts_.parts[part_id].query_to_peer = {};
-    parts_.total_queries--;
-    state->node_queries_active_.erase(part_id);
-    parts_helper_.unlock_part(part_id);
+    bool got_answer = p.second.is_ok();
+    bool was_ready = parts_.parts[part_id].ready;  // a duplicate answer in endgame mode
+    td::Result<td::Unit> r_unit = td::Unit();
+    if (!was_ready) {
+      r_unit = p.second.move_fmap([&](PeerState::Part part) -> td::Result<td::Unit> {
+        TRY_RESULT(proof, vm::std_boc_deserialize(part.proof));
+        TRY_STATUS(torrent_.add_piece(part_id, part.data.as_slice(), std::move(proof)));
+        update_pieces_in_db(part_id, part_id + 1);
+        download_speed_.add(part.data.size());
+        peer.download_speed.add(part.data.size());
+        return td::Unit();
+      });
+    }
 
-    if (r_unit.is_ok()) {
+    finish_part_query(part_id, peer, got_answer);
+
+    if (r_unit.is_ok() && !was_ready) {
       on_part_ready(part_id);
     }
   }
@@ -645,6 +717,38 @@ void NodeActor::loop_peer(const PeerId &peer_id, Peer &peer) {
   yield();
 }
 
+td::Result<PeerState::Part> NodeActor::get_part_for_upload(PartId part_id, Peer &peer) {
+  if (part_id >= parts_.parts.size() || !torrent_.is_piece_ready(part_id)) {
+    return td::Status::Error("Piece is not ready");
+  }
+  if (part_id == peer.next_upload_part && part_id + READAHEAD_PARTS / 2 >= peer.readahead_till) {
+    auto begin = td::max<td::uint64>(part_id + 1, peer.readahead_till);
+    peer.readahead_till = part_id + 1 + READAHEAD_PARTS;
+    torrent_.readahead_pieces(begin, peer.readahead_till);
+  }
+  peer.next_upload_part = part_id + 1;
+
+  if (piece_cache_) {
+    auto cached = piece_cache_->get(torrent_.get_hash(), part_id);
+    if (cached) {
+      PeerState::Part res;
+      res.proof = std::move(cached.value().proof);
+      res.data = std::move(cached.value().data);
+      return std::move(res);
+    }
+  }
+  TRY_RESULT(proof, torrent_.get_piece_proof(part_id));
+  TRY_RESULT(data, torrent_.get_piece_buffer(part_id));
+  PeerState::Part res;
+  TRY_RESULT(proof_serialized, vm::std_boc_serialize(std::move(proof)));
+  res.proof = std::move(proof_serialized);
+  res.data = std::move(data);
+  if (piece_cache_) {
+    piece_cache_->add(torrent_.get_hash(), part_id, PieceCache::Piece{res.data.clone(), res.proof.clone()});
+  }
+  return std::move(res);
+}
+
 void NodeActor::on_part_ready(PartId part_id) {
   parts_helper_.on_self_part_ready(part_id);
   CHECK(!parts_.parts[part_id].ready);
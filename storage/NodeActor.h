@@ -22,6 +22,7 @@
 #include "LoadSpeed.h"
 #include "PartsHelper.h"
 #include "PeerActor.h"
+#include "PieceCache.h"
 #include "Torrent.h"
 
 #include "td/utils/Random.h"
@@ -43,6 +44,10 @@ class NodeActor : public td::actor::Actor {
     virtual void get_peer_info(PeerId src, PeerId peer, td::Promise<std::pair<td::Bits256, std::string>> promise) {
       promise.set_error(td::Status::Error("Not implemented"));
     }
+    // Cache of pieces served to peers, may be shared between torrents. Pieces are not cached if it is null.
+    virtual std::shared_ptr<PieceCache> get_piece_cache() {
+      return nullptr;
+    }
   };
 
   class Callback {
@@ -109,6 +114,7 @@ class NodeActor : public td::actor::Actor {
   std::vector<td::uint8> file_priority_;
   td::unique_ptr<Callback> callback_;
   td::unique_ptr<NodeCallback> node_callback_;
+  std::shared_ptr<PieceCache> piece_cache_;
   std::shared_ptr<db::DbType> db_;
   bool should_download_{false};
   bool should_upload_{false};
@@ -133,16 +139,26 @@ class NodeActor : public td::actor::Actor {
     std::shared_ptr<PeerState> state;
     PartsHelper::PeerToken peer_token;
     LoadSpeed download_speed, upload_speed;
+
+    // Round-trip time of getPiece queries is used to size the pipeline of queries to this peer
+    std::map<PartId, td::Timestamp> query_sent_at;
+    double min_rtt{0};
+    td::Timestamp min_rtt_expires_at;
+
+    // Pieces requested by this peer one after another are read ahead
+    td::uint64 next_upload_part{0};
+    td::uint64 readahead_till{0};
   };
 
   std::map<PeerId, Peer> peers_;
 
   struct PartsSet {
     struct Info {
-      td::optional<PeerId> query_to_peer;
+      td::uint32 queries{0};  // may be greater than one only in endgame mode
       bool ready{false};
     };
     size_t total_queries{0};
+    std::set<PartId> active_parts;  // parts with queries > 0
     std::vector<Info> parts;
   };
 
@@ -183,13 +199,23 @@ class NodeActor : public td::actor::Actor {
 
   void loop_start_stop_peers();
 
-  static constexpr size_t MAX_TOTAL_QUERIES = 20;
-  static constexpr size_t MAX_PEER_TOTAL_QUERIES = 5;
+  static constexpr size_t MAX_TOTAL_QUERIES = 512;
+  static constexpr size_t MIN_PEER_QUERIES = 5;
+  static constexpr size_t MAX_PEER_QUERIES = 64;
+  static constexpr double MIN_RTT_WINDOW = 10.0;
+  // Endgame mode starts when all remaining parts are requested and there are at most ENDGAME_MAX_PARTS of them
+  static constexpr size_t ENDGAME_MAX_PARTS = 32;
+  static constexpr td::uint32 ENDGAME_MAX_PART_QUERIES = 3;
   void loop_queries();
+  size_t get_peer_max_queries(const Peer &peer) const;
+  void send_part_query(PartId part_id, Peer &peer);
+  void finish_part_query(PartId part_id, Peer &peer, bool ok);
   void loop_get_peers();
   void got_peers(td::Result<std::vector<PeerId>> r_peers);
   void loop_peer(const PeerId &peer_id, Peer &peer);
   void on_part_ready(PartId part_id);
+  static constexpr td::uint64 READAHEAD_PARTS = 16;
+  td::Result<PeerState::Part> get_part_for_upload(PartId part_id, Peer &peer);
 
   void loop_will_upload();
 
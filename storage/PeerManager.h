@@ -180,10 +180,12 @@ class PeerManager : public td::actor::Actor {
         promise.wrap([peer_id](std::string s) { return std::make_pair(peer_id.bits256_value(), std::move(s)); }));
   }
 
-  static td::unique_ptr<ton::NodeActor::NodeCallback> create_callback(td::actor::ActorId<PeerManager> peer_manager) {
+  static td::unique_ptr<ton::NodeActor::NodeCallback> create_callback(
+      td::actor::ActorId<PeerManager> peer_manager, std::shared_ptr<ton::PieceCache> piece_cache = nullptr) {
     class Context : public ton::NodeActor::NodeCallback {
      public:
-      Context(td::actor::ActorId<PeerManager> peer_manager) : peer_manager_(peer_manager) {
+      Context(td::actor::ActorId<PeerManager> peer_manager, std::shared_ptr<ton::PieceCache> piece_cache)
+          : peer_manager_(peer_manager), piece_cache_(std::move(piece_cache)) {
       }
       void get_peers(ton::PeerId src, td::Promise<std::vector<ton::PeerId>> promise) override {
         send_closure(peer_manager_, &PeerManager::get_peers, src, std::move(promise));
@@ -238,12 +240,17 @@ class PeerManager : public td::actor::Actor {
         td::actor::send_closure(peer_manager_, &PeerManager::get_peer_info, src, peer, std::move(promise));
       }
 
+      std::shared_ptr<ton::PieceCache> get_piece_cache() override {
+        return piece_cache_;
+      }
+
      private:
       td::actor::ActorId<PeerManager> peer_manager_;
+      std::shared_ptr<ton::PieceCache> piece_cache_;
       std::vector<ton::PeerId> peers_;
       td::actor::ActorId<ton::NodeActor> self_;
     };
-    return td::make_unique<Context>(std::move(peer_manager));
+    return td::make_unique<Context>(std::move(peer_manager), std::move(piece_cache));
   }
 
  private:
@@ -0,0 +1,82 @@
+/*
+    This file is part of TON Blockchain Library.
+
+    TON Blockchain Library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    TON Blockchain Library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with TON Blockchain Library.  If not, see <http://www.gnu.org/licenses/>.
+
+    Copyright 2017-2020 Telegram Systems LLP
+*/
+
+#include "PieceCache.h"
+
+namespace ton {
+td::optional<PieceCache::Piece> PieceCache::get(const td::Bits256 &torrent_hash, td::uint64 piece_i) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  auto it = entries_.find(Key{torrent_hash, piece_i});
+  if (it == entries_.end()) {
+    ++misses_;
+    return {};
+  }
+  ++hits_;
+  auto entry = it->second.get();
+  entry->remove();
+  lru_.put(entry);
+  return Piece{entry->piece.data.clone(), entry->piece.proof.clone()};
+}
+
+void PieceCache::add(const td::Bits256 &torrent_hash, td::uint64 piece_i, Piece piece) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  td::uint64 size = piece.data.size() + piece.proof.size();
+  if (size > max_size_) {
+    return;
+  }
+  auto &entry = entries_[Key{torrent_hash, piece_i}];
+  if (entry) {
+    size_ -= entry->size;
+    entry->remove();
+  } else {
+    entry = std::make_unique<Entry>();
+    entry->key = Key{torrent_hash, piece_i};
+  }
+  entry->piece = std::move(piece);
+  entry->size = size;
+  size_ += size;
+  lru_.put(entry.get());
+  shrink();
+}
+
+void PieceCache::set_max_size(td::uint64 max_size) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  max_size_ = max_size;
+  shrink();
+}
+
+PieceCache::Stats PieceCache::get_stats() {
+  std::lock_guard<std::mutex> guard(mutex_);
+  Stats stats;
+  stats.size = size_;
+  stats.pieces = entries_.size();
+  stats.hits = hits_;
+  stats.misses = misses_;
+  return stats;
+}
+
+void PieceCache::shrink() {
+  while (size_ > max_size_) {
+    auto entry = static_cast<Entry *>(lru_.get());
+    CHECK(entry != nullptr);
+    size_ -= entry->size;
+    entries_.erase(entry->key);
+  }
+}
+}  // namespace ton
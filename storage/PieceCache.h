@@ -0,0 +1,73 @@
+/*
+    This file is part of TON Blockchain Library.
+
+    TON Blockchain Library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    TON Blockchain Library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with TON Blockchain Library.  If not, see <http://www.gnu.org/licenses/>.
+
+    Copyright 2017-2020 Telegram Systems LLP
+*/
+
+#pragma once
+
+#include "common/bitstring.h"
+#include "td/utils/buffer.h"
+#include "td/utils/List.h"
+#include "td/utils/optional.h"
+
+#include <map>
+#include <memory>
+#include <mutex>
+
+namespace ton {
+// Thread-safe LRU cache of pieces which are served to peers, shared by all torrents of a node.
+// Pieces are stored as BufferSlices, so a cached piece is sent without copying it.
+class PieceCache {
+ public:
+  struct Piece {
+    td::BufferSlice data;
+    td::BufferSlice proof;  // serialized merkle proof
+  };
+
+  explicit PieceCache(td::uint64 max_size) : max_size_(max_size) {
+  }
+
+  td::optional<Piece> get(const td::Bits256 &torrent_hash, td::uint64 piece_i);
+  void add(const td::Bits256 &torrent_hash, td::uint64 piece_i, Piece piece);
+  void set_max_size(td::uint64 max_size);
+
+  struct Stats {
+    td::uint64 size{0};
+    td::uint64 pieces{0};
+    td::uint64 hits{0};
+    td::uint64 misses{0};
+  };
+  Stats get_stats();
+
+ private:
+  using Key = std::pair<td::Bits256, td::uint64>;
+  struct Entry : td::ListNode {
+    Key key;
+    Piece piece;
+    td::uint64 size;
+  };
+
+  std::mutex mutex_;
+  td::uint64 max_size_;
+  td::uint64 size_{0};
+  td::uint64 hits_{0}, misses_{0};
+  td::ListNode lru_;
+  std::map<Key, std::unique_ptr<Entry>> entries_;
+
+  void shrink();
+};
+}  // namespace ton
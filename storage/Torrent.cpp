@@ -287,6 +287,50 @@ td::Result<std::string> Torrent::get_piece_data(td::uint64 piece_i) {
   return res;
 }
 
+td::Result<td::BufferSlice> Torrent::get_piece_buffer(td::uint64 piece_i) {
+  if (!inited_info_) {
+    return td::Status::Error("Torrent info not inited");
+  }
+  CHECK(piece_i < info_.pieces_count());
+  if (!piece_is_ready_[piece_i]) {
+    return td::Status::Error("Piece is not ready");
+  }
+  auto it = pending_pieces_.find(piece_i);
+  if (it != pending_pieces_.end()) {
+    return td::BufferSlice(it->second);
+  }
+  auto it2 = in_memory_pieces_.find(piece_i);
+  if (it2 != in_memory_pieces_.end()) {
+    return td::BufferSlice(it2->second.data);
+  }
+  auto piece = info_.get_piece_info(piece_i);
+
+  td::BufferSlice res(piece.size);
+  TRY_STATUS(iterate_piece(piece, [&](auto it, auto info) {
+    return it->get_piece(res.as_slice().substr(info.piece_offset, info.size), info.chunk_offset);
+  }));
+  return std::move(res);
+}
+
+void Torrent::readahead_pieces(td::uint64 begin, td::uint64 end) {
+  if (!inited_info_ || chunks_.empty()) {
+    return;
+  }
+  end = td::min(end, info_.pieces_count());
+  if (begin >= end) {
+    return;
+  }
+  auto first = info_.get_piece_info(begin);
+  auto last = info_.get_piece_info(end - 1);
+  Info::PieceInfo range{first.offset, last.offset + last.size - first.offset};
+  iterate_piece(range, [&](auto it, auto info) {
+    if (it->data && !it->excluded) {
+      it->data.readahead(info.chunk_offset, info.size);
+    }
+    return td::Status::OK();
+  }).ignore();
+}
+
 td::Result<td::Ref<vm::Cell>> Torrent::get_piece_proof(td::uint64 piece_i) {
   if (!inited_info_) {
     return td::Status::Error("Torrent info not inited");
@@ -52,7 +52,10 @@ class Torrent {
 
   // get piece and proof
   td::Result<std::string> get_piece_data(td::uint64 piece_i);
+  td::Result<td::BufferSlice> get_piece_buffer(td::uint64 piece_i);
   td::Result<td::Ref<vm::Cell>> get_piece_proof(td::uint64 piece_i);
+  // hint that pieces [begin, end) will be read soon
+  void readahead_pieces(td::uint64 begin, td::uint64 end);
 
   // add piece (with an optional proof)
   td::Status add_piece(td::uint64 piece_i, td::Slice data, td::Ref<vm::Cell> proof);
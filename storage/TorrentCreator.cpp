@@ -19,15 +19,17 @@
 
 #include "TorrentCreator.h"
 
-#include "td/db/utils/CyclicBuffer.h"
-
 #include "td/utils/crypto.h"
 #include "td/utils/PathView.h"
 #include "td/utils/port/path.h"
+#include "td/utils/port/thread.h"
 #include "td/utils/tl_helpers.h"
 #include "MicrochunkTree.h"
 #include "TorrentHeader.hpp"
 
+#include <algorithm>
+#include <atomic>
+
 namespace ton {
 td::Result<Torrent> Torrent::Creator::create_from_path(Options options, td::CSlice raw_path) {
   TRY_RESULT(path, td::realpath(raw_path));
@@ -118,49 +120,19 @@ td::Result<Torrent> Torrent::Creator::finalize() {
     header.dir_name = options_.dir_name.value();
   }
 
-  // Now we should stream all data to calculate sha256 of all pieces
-
-  std::string buffer;
-  td::CyclicBuffer::Options cb_options;
-  cb_options.chunk_size = td::max(options_.piece_size * 16, (1 << 20) / options_.piece_size * options_.piece_size);
-  cb_options.count = 2;
-
-  auto reader_writer = td::CyclicBuffer::create(cb_options);
-  auto reader = std::move(reader_writer.first);
-  auto writer = std::move(reader_writer.second);
-
   auto header_size = header.serialization_size();
   auto file_size = header_size + data_offset;
   auto pieces_count = (file_size + options_.piece_size - 1) / options_.piece_size;
+
+  Torrent::Info info;
+  auto header_str = td::serialize(header);
+  CHECK(header_size == header_str.size());
+  info.header_size = header_str.size();
+  td::sha256(header_str, info.header_hash.as_slice());
+
   std::vector<Torrent::ChunkState> chunks;
-  std::vector<td::Bits256> pieces;
-  auto flush_reader = [&](bool force) {
-    while (true) {
-      auto slice = reader.prepare_read();
-      slice.truncate(options_.piece_size);
-      if (slice.empty() || (slice.size() != options_.piece_size && !force)) {
-        break;
-      }
-      td::Bits256 hash;
-      sha256(slice, hash.as_slice());
-      pieces.push_back(hash);
-      reader.confirm_read(slice.size());
-    }
-  };
   td::uint64 offset = 0;
-  auto add_blob = [&](auto data, td::Slice name) {
-    td::uint64 data_offset = 0;
-    while (data_offset < data.size()) {
-      auto dest = writer.prepare_write();
-      CHECK(dest.size() != 0);
-      dest.truncate(data.size() - data_offset);
-      TRY_RESULT(got_size, data.view_copy(dest, data_offset));
-      CHECK(got_size != 0);
-      data_offset += got_size;
-      writer.confirm_write(got_size);
-      flush_reader(false);
-    }
-
+  auto add_chunk = [&](td::BlobView data, td::Slice name) {
     Torrent::ChunkState chunk;
     chunk.name = name.str();
     chunk.offset = offset;
@@ -170,23 +142,72 @@ td::Result<Torrent> Torrent::Creator::finalize() {
 
     offset += chunk.size;
     chunks.push_back(std::move(chunk));
-    return td::Status::OK();
   };
-
-  Torrent::Info info;
-  auto header_str = td::serialize(header);
-  CHECK(header_size == header_str.size());
-  info.header_size = header_str.size();
-  td::sha256(header_str, info.header_hash.as_slice());
-
-  add_blob(td::BufferSliceBlobView::create(td::BufferSlice(header_str)), "").ensure();
+  add_chunk(td::BufferSliceBlobView::create(td::BufferSlice(header_str)), "");
   for (auto& file : files_) {
-    add_blob(std::move(file.data), file.name).ensure();
+    add_chunk(std::move(file.data), file.name);
   }
-  flush_reader(true);
-  CHECK(pieces.size() == pieces_count);
   CHECK(offset == file_size);
-  MerkleTree tree(std::move(pieces));
+
+  // Now we should read all data to calculate sha256 of all pieces.
+  // Pieces are split into batches of ~4Mb which are read sequentially and hashed by worker threads.
+  std::vector<td::Bits256> pieces(pieces_count);
+  td::uint64 batch_pieces = td::max<td::uint64>(1, (4 << 20) / options_.piece_size);
+  td::uint64 batches_count = (pieces_count + batch_pieces - 1) / batch_pieces;
+  std::atomic<td::uint64> next_batch{0};
+  auto hash_pieces = [&]() -> td::Status {
+    std::string buffer(td::narrow_cast<size_t>(batch_pieces * options_.piece_size), '\0');
+    while (true) {
+      td::uint64 batch = next_batch.fetch_add(1, std::memory_order_relaxed);
+      if (batch >= batches_count) {
+        return td::Status::OK();
+      }
+      td::uint64 begin = batch * batch_pieces * options_.piece_size;
+      td::uint64 end = td::min(begin + batch_pieces * options_.piece_size, file_size);
+      auto it = std::upper_bound(chunks.begin(), chunks.end(), begin,
+                                 [](td::uint64 x, const Torrent::ChunkState& chunk) { return x < chunk.offset; });
+      CHECK(it != chunks.begin());
+      --it;
+      for (td::uint64 pos = begin; pos < end;) {
+        CHECK(it != chunks.end());
+        if (pos >= it->offset + it->size) {
+          ++it;
+          continue;
+        }
+        td::uint64 chunk_end = td::min(end, it->offset + it->size);
+        td::MutableSlice dest(&buffer[td::narrow_cast<size_t>(pos - begin)], td::narrow_cast<size_t>(chunk_end - pos));
+        TRY_RESULT(got_size, it->data.view_copy(dest, pos - it->offset));
+        if (got_size == 0) {
+          return td::Status::Error(PSLICE() << "Failed to read " << it->name);
+        }
+        pos += got_size;
+      }
+      for (td::uint64 piece = begin / options_.piece_size; piece * options_.piece_size < end; ++piece) {
+        td::uint64 l = piece * options_.piece_size;
+        td::uint64 r = td::min(l + options_.piece_size, end);
+        td::sha256(td::Slice(buffer).substr(td::narrow_cast<size_t>(l - begin), td::narrow_cast<size_t>(r - l)),
+                   pieces[td::narrow_cast<size_t>(piece)].as_slice());
+      }
+    }
+  };
+  size_t threads_count = td::narrow_cast<size_t>(
+      td::min<td::uint64>(td::max<td::uint32>(options_.threads, 1), td::max<td::uint64>(batches_count, 1)));
+  std::vector<td::Status> statuses(threads_count);
+  if (threads_count == 1) {
+    statuses[0] = hash_pieces();
+  } else {
+    std::vector<td::thread> workers;
+    for (size_t i = 0; i < threads_count; ++i) {
+      workers.emplace_back([&, i] { statuses[i] = hash_pieces(); });
+    }
+    for (auto& worker : workers) {
+      worker.join();
+    }
+  }
+  for (auto& status : statuses) {
+    TRY_STATUS_PREFIX(std::move(status), "Failed to hash torrent data: ");
+  }
+  MerkleTree tree(std::move(pieces), threads_count);
 
   info.header_size = header.serialization_size();
   info.piece_size = options_.piece_size;
@@ -35,6 +35,9 @@ class Torrent::Creator {
     td::optional<std::string> dir_name;
 
     std::string description;
+
+    // number of threads used to hash pieces and to build the merkle tree
+    td::uint32 threads{1};
   };
 
   // If path is a file create a torrent with one file in it.
@@ -78,7 +78,8 @@ void StorageManager::load_torrents_from_db(std::vector<td::Bits256> torrents) {
     entry.peer_manager = td::actor::create_actor<PeerManager>("PeerManager", local_id_, get_overlay_id(hash),
                                                               client_mode_, overlays_, adnl_, rldp_);
     NodeActor::load_from_db(
-        db_, hash, create_callback(hash, entry.closing_state), PeerManager::create_callback(entry.peer_manager.get()),
+        db_, hash, create_callback(hash, entry.closing_state),
+        PeerManager::create_callback(entry.peer_manager.get(), piece_cache_),
         [SelfId = actor_id(this), hash,
          promise = ig.get_promise()](td::Result<td::actor::ActorOwn<NodeActor>> R) mutable {
           td::actor::send_closure(SelfId, &StorageManager::loaded_torrent_from_db, hash, std::move(R));
@@ -160,7 +161,7 @@ td::Status StorageManager::add_torrent_impl(Torrent torrent, bool start_download
   entry.hash = hash;
   entry.peer_manager = td::actor::create_actor<PeerManager>("PeerManager", local_id_, get_overlay_id(hash),
                                                             client_mode_, overlays_, adnl_, rldp_);
-  auto context = PeerManager::create_callback(entry.peer_manager.get());
+  auto context = PeerManager::create_callback(entry.peer_manager.get(), piece_cache_);
   LOG(INFO) << "Added torrent " << hash.to_hex() << " , root_dir = " << torrent.get_root_dir();
   entry.actor =
       td::actor::create_actor<NodeActor>("Node", 1, std::move(torrent), create_callback(hash, entry.closing_state),
@@ -74,6 +74,9 @@ class StorageManager : public td::actor::Actor {
 
   std::shared_ptr<db::DbType> db_;
 
+  // Pieces recently served to peers (up to 256Mb), shared by all torrents
+  std::shared_ptr<PieceCache> piece_cache_ = std::make_shared<PieceCache>(256 << 20);
+
   struct TorrentEntry {
     td::Bits256 hash;
     td::actor::ActorOwn<NodeActor> actor;
@@ -301,6 +301,7 @@ class StorageDaemonCli : public td::actor::Actor {
       bool upload = true;
       bool copy = false;
       std::string description;
+      td::uint32 threads = 1;
       bool json = false;
       bool no_more_flags = false;
       for (size_t i = 1; i < tokens.size(); ++i) {
@@ -313,6 +314,17 @@ class StorageDaemonCli : public td::actor::Actor {
             description = tokens[i];
             continue;
           }
+          if (tokens[i] == "--threads") {
+            ++i;
+            if (i == tokens.size()) {
+              return td::Status::Error("Unexpected EOLN");
+            }
+            TRY_RESULT_PREFIX_ASSIGN(threads, td::to_integer_safe<td::uint32>(tokens[i]), "Invalid threads: ");
+            if (threads == 0 || threads > 256) {
+              return td::Status::Error("Invalid threads: expected 1..256");
+            }
+            continue;
+          }
           if (tokens[i] == "--no-upload") {
             upload = false;
             continue;
@@ -340,7 +352,7 @@ class StorageDaemonCli : public td::actor::Actor {
       if (!found_path) {
         return td::Status::Error("Unexpected EOLN");
       }
-      return execute_create(std::move(path), std::move(description), upload, copy, json);
+      return execute_create(std::move(path), std::move(description), upload, copy, threads, json);
     } else if (tokens[0] == "add-by-hash" || tokens[0] == "add-by-meta") {
       td::optional<std::string> param;
       std::string root_dir;
@@ -768,10 +780,12 @@ class StorageDaemonCli : public td::actor::Actor {
   td::Status execute_help() {
     td::TerminalIO::out() << "help\tPrint this help\n";
     td::TerminalIO::out()
-        << "create [-d description] [--no-upload] [--copy] [--json] <file/dir>\tCreate bag of files from <file/dir>\n";
+        << "create [-d description] [--no-upload] [--copy] [--threads n] [--json] <file/dir>\tCreate bag of files from "
+           "<file/dir>\n";
     td::TerminalIO::out() << "\t-d\tDescription will be stored in torrent info\n";
     td::TerminalIO::out() << "\t--no-upload\tDon't share bag with peers\n";
     td::TerminalIO::out() << "\t--copy\tFiles will be copied to an internal directory of storage-daemon\n";
+    td::TerminalIO::out() << "\t--threads\tNumber of threads used to hash files (default: 1)\n";
     td::TerminalIO::out() << "\t--json\tOutput in json\n";
     td::TerminalIO::out() << "add-by-hash <bag-id> [-d root_dir] [--paused] [--no-upload] [--json] [--partial file1 "
                              "file2 ...]\tAdd bag with given BagID (in hex)\n";
@@ -869,23 +883,30 @@ class StorageDaemonCli : public td::actor::Actor {
     return td::Status::OK();
   }
 
-  td::Status execute_create(std::string path, std::string description, bool upload, bool copy, bool json) {
+  td::Status execute_create(std::string path, std::string description, bool upload, bool copy, td::uint32 threads,
+                            bool json) {
     TRY_RESULT_PREFIX_ASSIGN(path, td::realpath(path), "Invalid path: ");
-    auto query = create_tl_object<ton_api::storage_daemon_createTorrent>(path, description, upload, copy);
-    send_query(std::move(query),
-               [=, SelfId = actor_id(this)](td::Result<tl_object_ptr<ton_api::storage_daemon_torrentFull>> R) {
-                 if (R.is_error()) {
-                   return;
-                 }
-                 if (json) {
-                   print_json(R.ok());
-                   td::actor::send_closure(SelfId, &StorageDaemonCli::command_finished, td::Status::OK());
-                   return;
-                 }
-                 td::TerminalIO::out() << "Bag created\n";
-                 td::actor::send_closure(SelfId, &StorageDaemonCli::print_torrent_full, R.move_as_ok());
-                 td::actor::send_closure(SelfId, &StorageDaemonCli::command_finished, td::Status::OK());
-               });
+    td::Promise<tl_object_ptr<ton_api::storage_daemon_torrentFull>> P =
+        [=, SelfId = actor_id(this)](td::Result<tl_object_ptr<ton_api::storage_daemon_torrentFull>> R) {
+          if (R.is_error()) {
+            return;
+          }
+          if (json) {
+            print_json(R.ok());
+            td::actor::send_closure(SelfId, &StorageDaemonCli::command_finished, td::Status::OK());
+            return;
+          }
+          td::TerminalIO::out() << "Bag created\n";
+          td::actor::send_closure(SelfId, &StorageDaemonCli::print_torrent_full, R.move_as_ok());
+          td::actor::send_closure(SelfId, &StorageDaemonCli::command_finished, td::Status::OK());
+        };
+    // createTorrentEx is not supported by older daemons, so it is used only when needed
+    if (threads == 1) {
+      send_query(create_tl_object<ton_api::storage_daemon_createTorrent>(path, description, upload, copy), std::move(P));
+    } else {
+      send_query(create_tl_object<ton_api::storage_daemon_createTorrentEx>(path, description, upload, copy, threads),
+                 std::move(P));
+    }
     return td::Status::OK();
   }
 
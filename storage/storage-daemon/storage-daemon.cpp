@@ -284,17 +284,29 @@ class StorageDaemon : public td::actor::Actor {
   }
 
   void run_control_query(ton_api::storage_daemon_createTorrent &query, td::Promise<td::BufferSlice> promise) {
+    create_torrent(std::move(query.path_), std::move(query.description_), query.allow_upload_, query.copy_inside_, 1,
+                   std::move(promise));
+  }
+
+  void run_control_query(ton_api::storage_daemon_createTorrentEx &query, td::Promise<td::BufferSlice> promise) {
+    create_torrent(std::move(query.path_), std::move(query.description_), query.allow_upload_, query.copy_inside_,
+                   td::clamp(query.threads_, 1, 256), std::move(promise));
+  }
+
+  void create_torrent(std::string path, std::string description, bool allow_upload, bool copy_inside, int threads,
+                      td::Promise<td::BufferSlice> promise) {
     // Run in a separate thread
     delay_action(
-        [promise = std::move(promise), manager = manager_.get(), db_root = db_root_,
-         query = std::move(query)]() mutable {
+        [promise = std::move(promise), manager = manager_.get(), path = std::move(path),
+         description = std::move(description), allow_upload, copy_inside, threads]() mutable {
           Torrent::Creator::Options options;
           options.piece_size = 128 * 1024;
-          options.description = std::move(query.description_);
-          TRY_RESULT_PROMISE(promise, torrent, Torrent::Creator::create_from_path(std::move(options), query.path_));
+          options.description = std::move(description);
+          options.threads = threads;
+          TRY_RESULT_PROMISE(promise, torrent, Torrent::Creator::create_from_path(std::move(options), path));
           td::Bits256 hash = torrent.get_hash();
-          td::actor::send_closure(manager, &StorageManager::add_torrent, std::move(torrent), false, query.allow_upload_,
-                                  query.copy_inside_,
+          td::actor::send_closure(manager, &StorageManager::add_torrent, std::move(torrent), false, allow_upload,
+                                  copy_inside,
                                   [manager, hash, promise = std::move(promise)](td::Result<td::Unit> R) mutable {
                                     if (R.is_error()) {
                                       promise.set_error(R.move_as_error());
@@ -65,6 +65,7 @@
 #include "PeerActor.h"
 
 #include "MerkleTree.h"
+#include "PieceCache.h"
 
 constexpr td::uint64 Byte = 1;
 constexpr td::uint64 KiloByte = (1 << 10) * Byte;
@@ -1048,6 +1049,132 @@ TEST(Torrent, OneFile) {
   }
 };
 
+class TorrentCreatorBench : public td::Benchmark {
+ public:
+  TorrentCreatorBench(std::string data, td::uint32 threads) : data_(std::move(data)), threads_(threads) {
+  }
+  std::string get_description() const override {
+    return PSTRING() << "TorrentCreator " << (data_.size() >> 20) << "Mb threads=" << threads_;
+  }
+  void run(int n) override {
+    for (int i = 0; i < n; i++) {
+      ton::Torrent::Creator::Options options;
+      options.piece_size = 128 * 1024;
+      options.threads = threads_;
+      std::vector<ton::Torrent::Creator::Blob> blobs{{"data.bin", data_}};
+      auto torrent = ton::Torrent::Creator::create_from_blobs(options, blobs).move_as_ok();
+      td::do_not_optimize_away(torrent.get_hash().bits().get_uint(64));
+    }
+  }
+
+ private:
+  std::string data_;
+  td::uint32 threads_;
+};
+
+TEST(Torrent, CreatorThreads) {
+  td::Random::Xorshift128plus rnd(123);
+  for (size_t size : {0, 1, 1000, 128 * 1024, 5 << 20, (1 << 20) * 8 + 12345}) {
+    std::string first = td::rand_string('a', 'z', td::narrow_cast<int>(size));
+    std::string second = td::rand_string('a', 'z', td::narrow_cast<int>(rnd.fast(0, 100000)));
+    std::vector<ton::Torrent::Creator::Blob> blobs{{"a.txt", first}, {"b/empty.txt", ""}, {"b/c.txt", second}};
+    td::optional<td::Bits256> expected_hash;
+    for (td::uint32 threads : {1, 2, 3, 8}) {
+      ton::Torrent::Creator::Options options;
+      options.piece_size = 1024;
+      options.threads = threads;
+      auto torrent = ton::Torrent::Creator::create_from_blobs(options, blobs).move_as_ok();
+      CHECK(torrent.is_completed());
+      if (!expected_hash) {
+        expected_hash = torrent.get_hash();
+      } else {
+        CHECK(expected_hash.value() == torrent.get_hash());
+      }
+    }
+  }
+
+  std::vector<td::Bits256> hashes(100000);
+  for (auto &hash : hashes) {
+    for (auto &c : hash.as_slice()) {
+      c = static_cast<char>(rnd.fast(0, 255));
+    }
+  }
+  auto expected_root = ton::MerkleTree(hashes).get_root_hash();
+  for (size_t threads : {2, 4, 7, 16}) {
+    CHECK(expected_root == ton::MerkleTree(hashes, threads).get_root_hash());
+  }
+
+  std::string data = td::rand_string('a', 'z', 64 << 20);
+  for (td::uint32 threads : {1, 2, 4, 8}) {
+    td::bench(TorrentCreatorBench(data, threads));
+  }
+}
+
+class PieceServeBench : public td::Benchmark {
+ public:
+  PieceServeBench(ton::Torrent &torrent, std::shared_ptr<ton::PieceCache> cache) : torrent_(torrent), cache_(cache) {
+  }
+  std::string get_description() const override {
+    return PSTRING() << "Serve pieces " << (cache_ ? "with" : "without") << " cache";
+  }
+  void run(int n) override {
+    td::Random::Xorshift128plus rnd(123);
+    td::uint64 total_size = 0;
+    auto pieces_count = td::narrow_cast<int>(torrent_.get_info().pieces_count());
+    for (int i = 0; i < n; i++) {
+      // a popular bag: most requests are for the same few pieces
+      td::uint64 piece_i = rnd.fast(0, td::min(pieces_count, 32) - 1);
+      td::optional<ton::PieceCache::Piece> piece;
+      if (cache_) {
+        piece = cache_->get(torrent_.get_hash(), piece_i);
+      }
+      if (!piece) {
+        ton::PieceCache::Piece new_piece;
+        new_piece.proof = vm::std_boc_serialize(torrent_.get_piece_proof(piece_i).move_as_ok()).move_as_ok();
+        new_piece.data = td::BufferSlice(torrent_.get_piece_data(piece_i).move_as_ok());
+        if (cache_) {
+          cache_->add(torrent_.get_hash(), piece_i, {new_piece.data.clone(), new_piece.proof.clone()});
+        }
+        piece = std::move(new_piece);
+      }
+      total_size += piece.value().data.size() + piece.value().proof.size();
+    }
+    td::do_not_optimize_away(total_size);
+  }
+
+ private:
+  ton::Torrent &torrent_;
+  std::shared_ptr<ton::PieceCache> cache_;
+};
+
+TEST(Torrent, PieceCache) {
+  td::rmrf("piece_cache").ignore();
+  td::mkdir("piece_cache").ensure();
+  td::write_file("piece_cache/data.bin", td::rand_string('a', 'z', 16 * MegaByte)).ensure();
+  ton::Torrent::Creator::Options options;
+  options.piece_size = 128 * KiloByte;
+  auto torrent = ton::Torrent::Creator::create_from_path(options, "piece_cache/data.bin").move_as_ok();
+  auto pieces_count = torrent.get_info().pieces_count();
+
+  ton::PieceCache cache(10 * 128 * KiloByte);
+  for (td::uint64 i = 0; i < pieces_count; i++) {
+    auto data = torrent.get_piece_buffer(i).move_as_ok();
+    ASSERT_EQ(torrent.get_piece_data(i).move_as_ok(), data.as_slice());
+    auto proof = vm::std_boc_serialize(torrent.get_piece_proof(i).move_as_ok()).move_as_ok();
+    cache.add(torrent.get_hash(), i, {std::move(data), std::move(proof)});
+    CHECK(cache.get_stats().size <= 10 * 128 * KiloByte);
+  }
+  CHECK(!cache.get(torrent.get_hash(), 0));
+  auto piece = cache.get(torrent.get_hash(), pieces_count - 1);
+  CHECK(piece);
+  ASSERT_EQ(torrent.get_piece_data(pieces_count - 1).move_as_ok(), piece.value().data.as_slice());
+  torrent.readahead_pieces(0, pieces_count);
+
+  td::bench(PieceServeBench(torrent, nullptr));
+  td::bench(PieceServeBench(torrent, std::make_shared<ton::PieceCache>(64 * MegaByte)));
+  td::rmrf("piece_cache").ignore();
+}
+
 TEST(Torrent, PartsHelper) {
   int parts_count = 100;
   ton::PartsHelper parts(parts_count);
@@ -1076,208 +1203,223 @@ void print_debug(ton::Torrent *torrent) {
   LOG(ERROR) << torrent->get_stats_str();
 }
 
-TEST(Torrent, Peer) {
-  class PeerManager : public td::actor::Actor {
-   public:
-    void send_query(ton::PeerId src, ton::PeerId dst, td::BufferSlice query, td::Promise<td::BufferSlice> promise) {
-      send_closure(get_outbound_channel(src), &NetChannel::send, query.size(),
-                   promise.send_closure(actor_id(this), &PeerManager::do_send_query, src, dst, std::move(query)));
-    }
+class TestPeerManager : public td::actor::Actor {
+ public:
+  static NetChannel::Options fast_channel() {
+    NetChannel::Options options;
+    options.speed = 1000 * MegaByte;
+    options.buffer = 1000 * MegaByte;
+    options.rtt = 0;
+    return options;
+  }
+  explicit TestPeerManager(NetChannel::Options outbound_options = fast_channel(),
+                           NetChannel::Options inbound_options = fast_channel(),
+                           std::map<ton::PeerId, NetChannel::Options> peer_outbound_options = {})
+      : outbound_options_(outbound_options)
+      , inbound_options_(inbound_options)
+      , peer_outbound_options_(std::move(peer_outbound_options)) {
+  }
 
-    void do_send_query(ton::PeerId src, ton::PeerId dst, td::BufferSlice query, td::Result<td::Unit> res,
-                       td::Promise<td::BufferSlice> promise) {
-      TRY_RESULT_PROMISE(promise, x, std::move(res));
-      (void)x;
-      send_closure(get_inbound_channel(dst), &NetChannel::send, query.size(),
-                   promise.send_closure(actor_id(this), &PeerManager::execute_query, src, dst, std::move(query)));
-    }
+  void send_query(ton::PeerId src, ton::PeerId dst, td::BufferSlice query, td::Promise<td::BufferSlice> promise) {
+    auto size = query.size();
+    send_closure(get_outbound_channel(src), &NetChannel::send, size,
+                 promise.send_closure(actor_id(this), &TestPeerManager::do_send_query, src, dst, std::move(query)));
+  }
 
-    void execute_query(ton::PeerId src, ton::PeerId dst, td::BufferSlice query, td::Result<td::Unit> res,
-                       td::Promise<td::BufferSlice> promise) {
-      TRY_RESULT_PROMISE(promise, x, std::move(res));
-      (void)x;
-      promise = promise.send_closure(actor_id(this), &PeerManager::send_response, src, dst);
-      auto it = peers_.find(std::make_pair(dst, src));
-      if (it == peers_.end()) {
-        LOG(ERROR) << "No such peer";
-        auto node_it = nodes_.find(dst);
-        if (node_it == nodes_.end()) {
-          LOG(ERROR) << "Unknown query destination";
-          promise.set_error(td::Status::Error("Unknown query destination"));
-          return;
-        }
-        send_closure(node_it->second, &ton::NodeActor::start_peer, src,
-                     [promise = std::move(promise),
-                      query = std::move(query)](td::Result<td::actor::ActorId<ton::PeerActor>> r_peer) mutable {
-                       TRY_RESULT_PROMISE(promise, peer, std::move(r_peer));
-                       send_closure(peer, &ton::PeerActor::execute_query, std::move(query), std::move(promise));
-                     });
+  void do_send_query(ton::PeerId src, ton::PeerId dst, td::BufferSlice query, td::Result<td::Unit> res,
+                     td::Promise<td::BufferSlice> promise) {
+    TRY_RESULT_PROMISE(promise, x, std::move(res));
+    (void)x;
+    auto size = query.size();
+    send_closure(get_inbound_channel(dst), &NetChannel::send, size,
+                 promise.send_closure(actor_id(this), &TestPeerManager::execute_query, src, dst, std::move(query)));
+  }
+
+  void execute_query(ton::PeerId src, ton::PeerId dst, td::BufferSlice query, td::Result<td::Unit> res,
+                     td::Promise<td::BufferSlice> promise) {
+    TRY_RESULT_PROMISE(promise, x, std::move(res));
+    (void)x;
+    promise = promise.send_closure(actor_id(this), &TestPeerManager::send_response, src, dst);
+    auto it = peers_.find(std::make_pair(dst, src));
+    if (it == peers_.end()) {
+      LOG(ERROR) << "No such peer";
+      auto node_it = nodes_.find(dst);
+      if (node_it == nodes_.end()) {
+        LOG(ERROR) << "Unknown query destination";
+        promise.set_error(td::Status::Error("Unknown query destination"));
         return;
       }
-      send_closure(it->second, &ton::PeerActor::execute_query, std::move(query), std::move(promise));
+      send_closure(node_it->second, &ton::NodeActor::start_peer, src,
+                   [promise = std::move(promise),
+                    query = std::move(query)](td::Result<td::actor::ActorId<ton::PeerActor>> r_peer) mutable {
+                     TRY_RESULT_PROMISE(promise, peer, std::move(r_peer));
+                     send_closure(peer, &ton::PeerActor::execute_query, std::move(query), std::move(promise));
+                   });
+      return;
     }
+    send_closure(it->second, &ton::PeerActor::execute_query, std::move(query), std::move(promise));
+  }
 
-    void send_response(ton::PeerId src, ton::PeerId dst, td::Result<td::BufferSlice> r_response,
-                       td::Promise<td::BufferSlice> promise) {
-      TRY_RESULT_PROMISE(promise, response, std::move(r_response));
-      send_closure(get_outbound_channel(dst), &NetChannel::send, response.size(),
-                   promise.send_closure(actor_id(this), &PeerManager::do_send_response, src, dst, std::move(response)));
-    }
+  void send_response(ton::PeerId src, ton::PeerId dst, td::Result<td::BufferSlice> r_response,
+                     td::Promise<td::BufferSlice> promise) {
+    TRY_RESULT_PROMISE(promise, response, std::move(r_response));
+    auto size = response.size();
+    send_closure(get_outbound_channel(dst), &NetChannel::send, size,
+                 promise.send_closure(actor_id(this), &TestPeerManager::do_send_response, src, dst, std::move(response)));
+  }
 
-    void do_send_response(ton::PeerId src, ton::PeerId dst, td::BufferSlice response, td::Result<td::Unit> res,
-                          td::Promise<td::BufferSlice> promise) {
-      TRY_RESULT_PROMISE(promise, x, std::move(res));
-      (void)x;
-      send_closure(
-          get_inbound_channel(src), &NetChannel::send, response.size(),
-          promise.send_closure(actor_id(this), &PeerManager::do_execute_response, src, dst, std::move(response)));
-    }
+  void do_send_response(ton::PeerId src, ton::PeerId dst, td::BufferSlice response, td::Result<td::Unit> res,
+                        td::Promise<td::BufferSlice> promise) {
+    TRY_RESULT_PROMISE(promise, x, std::move(res));
+    (void)x;
+    auto size = response.size();
+    send_closure(
+        get_inbound_channel(src), &NetChannel::send, size,
+        promise.send_closure(actor_id(this), &TestPeerManager::do_execute_response, src, dst, std::move(response)));
+  }
 
-    void do_execute_response(ton::PeerId src, ton::PeerId dst, td::BufferSlice response, td::Result<td::Unit> res,
-                             td::Promise<td::BufferSlice> promise) {
-      TRY_RESULT_PROMISE(promise, x, std::move(res));
-      (void)x;
-      promise.set_value(std::move(response));
-    }
+  void do_execute_response(ton::PeerId src, ton::PeerId dst, td::BufferSlice response, td::Result<td::Unit> res,
+                           td::Promise<td::BufferSlice> promise) {
+    TRY_RESULT_PROMISE(promise, x, std::move(res));
+    (void)x;
+    promise.set_value(std::move(response));
+  }
 
-    void register_peer(ton::PeerId src, ton::PeerId dst, td::actor::ActorId<ton::PeerActor> peer) {
-      peers_[std::make_pair(src, dst)] = std::move(peer);
-    }
+  void register_peer(ton::PeerId src, ton::PeerId dst, td::actor::ActorId<ton::PeerActor> peer) {
+    peers_[std::make_pair(src, dst)] = std::move(peer);
+  }
 
-    void register_node(ton::PeerId src, td::actor::ActorId<ton::NodeActor> node) {
-      nodes_[src] = std::move(node);
+  void register_node(ton::PeerId src, td::actor::ActorId<ton::NodeActor> node) {
+    nodes_[src] = std::move(node);
+  }
+  ~TestPeerManager() {
+    for (auto &it : inbound_channel_) {
+      LOG(ERROR) << it.first << " received " << td::format::as_size(it.second.get_actor_unsafe().total_sent());
     }
-    ~PeerManager() {
-      for (auto &it : inbound_channel_) {
-        LOG(ERROR) << it.first << " received " << td::format::as_size(it.second.get_actor_unsafe().total_sent());
-      }
-      for (auto &it : outbound_channel_) {
-        LOG(ERROR) << it.first << " sent " << td::format::as_size(it.second.get_actor_unsafe().total_sent());
-      }
+    for (auto &it : outbound_channel_) {
+      LOG(ERROR) << it.first << " sent " << td::format::as_size(it.second.get_actor_unsafe().total_sent());
     }
+  }
 
-   private:
-    std::map<std::pair<ton::PeerId, ton::PeerId>, td::actor::ActorId<ton::PeerActor>> peers_;
-    std::map<ton::PeerId, td::actor::ActorId<ton::NodeActor>> nodes_;
-    std::map<ton::PeerId, td::actor::ActorOwn<NetChannel>> inbound_channel_;
-    std::map<ton::PeerId, td::actor::ActorOwn<NetChannel>> outbound_channel_;
+ private:
+  std::map<std::pair<ton::PeerId, ton::PeerId>, td::actor::ActorId<ton::PeerActor>> peers_;
+  std::map<ton::PeerId, td::actor::ActorId<ton::NodeActor>> nodes_;
+  std::map<ton::PeerId, td::actor::ActorOwn<NetChannel>> inbound_channel_;
+  std::map<ton::PeerId, td::actor::ActorOwn<NetChannel>> outbound_channel_;
+  NetChannel::Options outbound_options_;
+  NetChannel::Options inbound_options_;
+  std::map<ton::PeerId, NetChannel::Options> peer_outbound_options_;
+
+  td::actor::ActorOwn<Sleep> sleep_;
+  void start_up() override {
+    sleep_ = Sleep::create();
+  }
 
-    td::actor::ActorOwn<Sleep> sleep_;
-    void start_up() override {
-      sleep_ = Sleep::create();
+  td::actor::ActorId<NetChannel> get_outbound_channel(ton::PeerId peer_id) {
+    auto &res = outbound_channel_[peer_id];
+    if (res.empty()) {
+      auto it = peer_outbound_options_.find(peer_id);
+      res = NetChannel::create(it == peer_outbound_options_.end() ? outbound_options_ : it->second, sleep_.get());
+    }
+    return res.get();
+  }
+  td::actor::ActorId<NetChannel> get_inbound_channel(ton::PeerId peer_id) {
+    auto &res = inbound_channel_[peer_id];
+    if (res.empty()) {
+      res = NetChannel::create(inbound_options_, sleep_.get());
     }
+    return res.get();
+  }
+};
 
-    td::actor::ActorId<NetChannel> get_outbound_channel(ton::PeerId peer_id) {
-      auto &res = outbound_channel_[peer_id];
-      if (res.empty()) {
-        NetChannel::Options options;
-        options.speed = 1000 * MegaByte;
-        options.buffer = 1000 * MegaByte;
-        options.rtt = 0;
-        res = NetChannel::create(options, sleep_.get());
+class PeerCreator : public ton::NodeActor::NodeCallback {
+ public:
+  PeerCreator(td::actor::ActorId<TestPeerManager> peer_manager, ton::PeerId self_id, std::vector<ton::PeerId> peers)
+      : peer_manager_(std::move(peer_manager)), peers_(std::move(peers)), self_id_(self_id) {
+  }
+  void get_peers(ton::PeerId src, td::Promise<std::vector<ton::PeerId>> promise) override {
+    auto peers = peers_;
+    promise.set_value(std::move(peers));
+  }
+  void register_self(td::actor::ActorId<ton::NodeActor> self) override {
+    self_ = self;
+    send_closure(peer_manager_, &TestPeerManager::register_node, self_id_, self_);
+  }
+  td::actor::ActorOwn<ton::PeerActor> create_peer(ton::PeerId self_id, ton::PeerId peer_id,
+                                                  std::shared_ptr<ton::PeerState> state) override {
+    class PeerCallback : public ton::PeerActor::Callback {
+     public:
+      PeerCallback(ton::PeerId self_id, ton::PeerId peer_id, td::actor::ActorId<TestPeerManager> peer_manager)
+          : self_id_{self_id}, peer_id_{peer_id}, peer_manager_(peer_manager) {
       }
-      return res.get();
-    }
-    td::actor::ActorId<NetChannel> get_inbound_channel(ton::PeerId peer_id) {
-      auto &res = inbound_channel_[peer_id];
-      if (res.empty()) {
-        NetChannel::Options options;
-        options.speed = 1000 * MegaByte;
-        options.buffer = 1000 * MegaByte;
-        options.rtt = 0;
-        res = NetChannel::create(options, sleep_.get());
+      void register_self(td::actor::ActorId<ton::PeerActor> self) override {
+        self_ = std::move(self);
+        send_closure(peer_manager_, &TestPeerManager::register_peer, self_id_, peer_id_, self_);
+      }
+      void send_query(td::uint64 query_id, td::BufferSlice query) override {
+        CHECK(!self_.empty());
+        class X : public td::actor::Actor {
+         public:
+          void start_up() override {
+            //LOG(ERROR) << "start";
+            alarm_timestamp() = td::Timestamp::in(4);
+          }
+          void tear_down() override {
+            //LOG(ERROR) << "finish";
+          }
+          void alarm() override {
+            //LOG(FATAL) << "WTF?";
+            alarm_timestamp() = td::Timestamp::in(4);
+          }
+        };
+        send_closure(
+            peer_manager_, &TestPeerManager::send_query, self_id_, peer_id_, std::move(query),
+            [self = self_, query_id,
+             tmp = td::actor::create_actor<X>(PSLICE() << self_id_ << "->" << peer_id_ << " : " << query_id)](
+                auto x) { promise_send_closure(self, &ton::PeerActor::on_query_result, query_id)(std::move(x)); });
       }
-      return res.get();
-    }
-  };
-
-  class PeerCreator : public ton::NodeActor::NodeCallback {
-   public:
-    PeerCreator(td::actor::ActorId<PeerManager> peer_manager, ton::PeerId self_id, std::vector<ton::PeerId> peers)
-        : peer_manager_(std::move(peer_manager)), peers_(std::move(peers)), self_id_(self_id) {
-    }
-    void get_peers(ton::PeerId src, td::Promise<std::vector<ton::PeerId>> promise) override {
-      auto peers = peers_;
-      promise.set_value(std::move(peers));
-    }
-    void register_self(td::actor::ActorId<ton::NodeActor> self) override {
-      self_ = self;
-      send_closure(peer_manager_, &PeerManager::register_node, self_id_, self_);
-    }
-    td::actor::ActorOwn<ton::PeerActor> create_peer(ton::PeerId self_id, ton::PeerId peer_id,
-                                                    std::shared_ptr<ton::PeerState> state) override {
-      class PeerCallback : public ton::PeerActor::Callback {
-       public:
-        PeerCallback(ton::PeerId self_id, ton::PeerId peer_id, td::actor::ActorId<PeerManager> peer_manager)
-            : self_id_{self_id}, peer_id_{peer_id}, peer_manager_(peer_manager) {
-        }
-        void register_self(td::actor::ActorId<ton::PeerActor> self) override {
-          self_ = std::move(self);
-          send_closure(peer_manager_, &PeerManager::register_peer, self_id_, peer_id_, self_);
-        }
-        void send_query(td::uint64 query_id, td::BufferSlice query) override {
-          CHECK(!self_.empty());
-          class X : public td::actor::Actor {
-           public:
-            void start_up() override {
-              //LOG(ERROR) << "start";
-              alarm_timestamp() = td::Timestamp::in(4);
-            }
-            void tear_down() override {
-              //LOG(ERROR) << "finish";
-            }
-            void alarm() override {
-              //LOG(FATAL) << "WTF?";
-              alarm_timestamp() = td::Timestamp::in(4);
-            }
-          };
-          send_closure(
-              peer_manager_, &PeerManager::send_query, self_id_, peer_id_, std::move(query),
-              [self = self_, query_id,
-               tmp = td::actor::create_actor<X>(PSLICE() << self_id_ << "->" << peer_id_ << " : " << query_id)](
-                  auto x) { promise_send_closure(self, &ton::PeerActor::on_query_result, query_id)(std::move(x)); });
-        }
 
-       private:
-        ton::PeerId self_id_;
-        ton::PeerId peer_id_;
-        td::actor::ActorId<ton::PeerActor> self_;
-        td::actor::ActorId<PeerManager> peer_manager_;
-      };
+     private:
+      ton::PeerId self_id_;
+      ton::PeerId peer_id_;
+      td::actor::ActorId<ton::PeerActor> self_;
+      td::actor::ActorId<TestPeerManager> peer_manager_;
+    };
 
-      return td::actor::create_actor<ton::PeerActor>(PSLICE() << "ton::PeerActor " << self_id << "->" << peer_id,
-                                                     td::make_unique<PeerCallback>(self_id, peer_id, peer_manager_),
-                                                     std::move(state));
-    }
+    return td::actor::create_actor<ton::PeerActor>(PSLICE() << "ton::PeerActor " << self_id << "->" << peer_id,
+                                                   td::make_unique<PeerCallback>(self_id, peer_id, peer_manager_),
+                                                   std::move(state));
+  }
 
-   private:
-    td::actor::ActorId<PeerManager> peer_manager_;
-    std::vector<ton::PeerId> peers_;
-    ton::PeerId self_id_;
-    td::actor::ActorId<ton::NodeActor> self_;
-  };
+ private:
+  td::actor::ActorId<TestPeerManager> peer_manager_;
+  std::vector<ton::PeerId> peers_;
+  ton::PeerId self_id_;
+  td::actor::ActorId<ton::NodeActor> self_;
+};
 
-  class TorrentCallback : public ton::NodeActor::Callback {
-   public:
-    TorrentCallback(std::shared_ptr<td::Destructor> stop_watcher, std::shared_ptr<td::Destructor> complete_watcher)
-        : stop_watcher_(stop_watcher), complete_watcher_(complete_watcher) {
-    }
+class TorrentCallback : public ton::NodeActor::Callback {
+ public:
+  TorrentCallback(std::shared_ptr<td::Destructor> stop_watcher, std::shared_ptr<td::Destructor> complete_watcher)
+      : stop_watcher_(stop_watcher), complete_watcher_(complete_watcher) {
+  }
 
-    void on_completed() override {
-      complete_watcher_.reset();
-    }
+  void on_completed() override {
+    complete_watcher_.reset();
+  }
 
-    void on_closed(ton::Torrent torrent) override {
-      CHECK(torrent.is_completed());
-      //TODO: validate torrent
-      stop_watcher_.reset();
-    }
+  void on_closed(ton::Torrent torrent) override {
+    CHECK(torrent.is_completed());
+    //TODO: validate torrent
+    stop_watcher_.reset();
+  }
 
-   private:
-    std::shared_ptr<td::Destructor> stop_watcher_;
-    std::shared_ptr<td::Destructor> complete_watcher_;
-  };
+ private:
+  std::shared_ptr<td::Destructor> stop_watcher_;
+  std::shared_ptr<td::Destructor> complete_watcher_;
+};
 
+TEST(Torrent, Peer) {
   size_t peers_n = 20;
   td::uint64 file_size = 200 * MegaByte;
   td::Random::Xorshift128plus rnd(123);
@@ -1338,7 +1480,7 @@ TEST(Torrent, Peer) {
   td::actor::Scheduler scheduler({0}, true);
 
   scheduler.run_in_context([&] {
-    auto peer_manager = td::actor::create_actor<PeerManager>("PeerManager");
+    auto peer_manager = td::actor::create_actor<TestPeerManager>("TestPeerManager");
     guard->push_back(td::actor::create_actor<ton::NodeActor>(
         "Node#1", 1, std::move(torrent),
         td::make_unique<TorrentCallback>(stop_watcher, complete_watcher),
@@ -1365,3 +1507,56 @@ TEST(Torrent, Peer) {
   complete_watcher.reset();
   scheduler.run();
 }
+
+TEST(Torrent, EndgameSlowSeeder) {
+  auto dir = td::mkdtemp("", "seeders").move_as_ok() + TD_DIR_SLASH;
+  auto path = dir + "data.bin";
+  td::write_file(path, td::rand_string('a', 'z', 1 * MegaByte)).ensure();
+  ton::Torrent::Creator::Options creator_options;
+  creator_options.piece_size = 64 * KiloByte;
+  auto info = ton::Torrent::Creator::create_from_path(creator_options, path).move_as_ok().get_info();
+
+  // one of the seeders would need 16 seconds for each piece, so the download finishes in time only if
+  // the pieces queued to it are requested again from the fast seeders
+  ton::PeerId slow_seeder = 2;
+  std::vector<ton::PeerId> seeders{slow_seeder, 3, 4};
+  auto channel = TestPeerManager::fast_channel().with_rtt(0.05);
+  auto slow_channel = TestPeerManager::fast_channel().with_rtt(0.05).with_speed(4 * KiloByte);
+
+  td::Timer timer;
+  double download_time = 0;
+  auto stop_watcher = td::create_shared_destructor([] { td::actor::SchedulerContext::get()->stop(); });
+  auto guard = std::make_shared<std::vector<td::actor::ActorOwn<>>>();
+  auto complete_watcher =
+      td::create_shared_destructor([guard, &timer, &download_time] { download_time = timer.elapsed(); });
+
+  td::actor::Scheduler scheduler({0}, true);
+  scheduler.run_in_context([&] {
+    auto peer_manager = td::actor::create_actor<TestPeerManager>(
+        "TestPeerManager", channel, channel, std::map<ton::PeerId, NetChannel::Options>{{slow_seeder, slow_channel}});
+    ton::Torrent::Options options;
+    options.in_memory = true;
+    guard->push_back(td::actor::create_actor<ton::NodeActor>(
+        "Leecher", 1, ton::Torrent::open(options, ton::TorrentMeta(info)).move_as_ok(),
+        td::make_unique<TorrentCallback>(stop_watcher, complete_watcher),
+        td::make_unique<PeerCreator>(peer_manager.get(), 1, seeders), nullptr));
+    for (auto seeder_id : seeders) {
+      guard->push_back(td::actor::create_actor<ton::NodeActor>(
+          PSLICE() << "Seeder#" << seeder_id, seeder_id,
+          ton::Torrent::Creator::create_from_path(creator_options, path).move_as_ok(),
+          td::make_unique<TorrentCallback>(stop_watcher, nullptr),
+          td::make_unique<PeerCreator>(peer_manager.get(), seeder_id, std::vector<ton::PeerId>()), nullptr));
+    }
+    guard->push_back(std::move(peer_manager));
+  });
+  stop_watcher.reset();
+  guard.reset();
+  complete_watcher.reset();
+  timer = {};
+  scheduler.run();
+
+  LOG(INFO) << "Downloaded from " << seeders.size() << " seeders in " << td::format::as_time(download_time);
+  ASSERT_TRUE(download_time > 0);
+  ASSERT_TRUE(download_time < 10);
+  td::rmrf(dir).ignore();
+}
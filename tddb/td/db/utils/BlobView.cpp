@@ -28,6 +28,10 @@
 #include <limits>
 #include <mutex>
 
+#if TD_LINUX || TD_ANDROID || TD_FREEBSD
+#include <fcntl.h>
+#endif
+
 namespace td {
 
 class BlobViewImpl {
@@ -40,6 +44,8 @@ class BlobViewImpl {
   virtual td::Status sync() {
     return td::Status::OK();
   }
+  virtual void readahead(td::uint64 offset, td::uint64 size) {
+  }
   virtual td::uint64 size() = 0;
 
  private:
@@ -70,6 +76,11 @@ td::Result<size_t> BlobView::write(td::Slice data, td::uint64 offset) {
   return impl_->write(data, offset);
 }
 
+void BlobView::readahead(td::uint64 offset, td::uint64 size) {
+  CHECK(impl_);
+  impl_->readahead(offset, size);
+}
+
 td::Result<td::BufferSlice> BlobView::to_buffer_slice() {
   td::BufferSlice res(size());
   TRY_RESULT(read_size, view_copy(res.as_slice(), 0));
@@ -248,6 +259,12 @@ class FileNoCacheBlobViewImpl : public BlobViewImpl {
     return fd_.pwrite(data, offset);
   }
 
+  void readahead(td::uint64 offset, td::uint64 size) override {
+#if TD_LINUX || TD_ANDROID || TD_FREEBSD
+    posix_fadvise(fd_.get_native_fd().fd(), static_cast<off_t>(offset), static_cast<off_t>(size), POSIX_FADV_WILLNEED);
+#endif
+  }
+
   ~FileNoCacheBlobViewImpl() {
   }
 
@@ -34,6 +34,8 @@ class BlobView {
   td::Result<td::Slice> view(td::MutableSlice slice, td::uint64 offset);
   td::Result<size_t> view_copy(td::MutableSlice slice, td::uint64 offset);
   td::Result<size_t> write(td::Slice data, td::uint64 offset);
+  // Hint that the range will be read soon (no-op for blobs that are not backed by a file)
+  void readahead(td::uint64 offset, td::uint64 size);
   td::uint64 size();
 
   explicit operator bool() const {
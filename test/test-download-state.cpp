@@ -0,0 +1,105 @@
+/*
+    This file is part of TON Blockchain Library.
+
+    TON Blockchain Library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    TON Blockchain Library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with TON Blockchain Library.  If not, see <http://www.gnu.org/licenses/>.
+
+    Copyright 2017-2020 Telegram Systems LLP
+*/
+#include "td/utils/tests.h"
+#include "td/utils/Random.h"
+#include "td/utils/port/path.h"
+#include "td/utils/port/Stat.h"
+
+#include "validator/net/state-staging.hpp"
+
+using ton::validator::fullnode::StateStagingFile;
+
+namespace {
+
+ton::BlockIdExt random_block_id(ton::BlockSeqno seqno) {
+  ton::RootHash root_hash;
+  ton::FileHash file_hash;
+  td::Random::secure_bytes(root_hash.as_slice());
+  td::Random::secure_bytes(file_hash.as_slice());
+  return ton::BlockIdExt{ton::masterchainId, ton::shardIdAll, seqno, root_hash, file_hash};
+}
+
+std::string random_part(size_t size) {
+  std::string data(size, '\0');
+  td::Random::secure_bytes(data);
+  return data;
+}
+
+}  // namespace
+
+TEST(DownloadState, ResumeAfterAbort) {
+  auto tmp_dir = td::mkdtemp("", "state-staging").move_as_ok() + TD_DIR_SLASH;
+  auto block_id = random_block_id(100);
+  auto mc_block_id = random_block_id(200);
+  auto part1 = random_part(1000);
+  auto part2 = random_part(2000);
+  auto part3 = random_part(500);
+
+  std::string name;
+  {
+    auto staging = StateStagingFile::open(tmp_dir, block_id, mc_block_id).move_as_ok();
+    ASSERT_EQ(0u, staging.size());
+    staging.append(part1).ensure();
+    staging.append(part2).ensure();
+    name = staging.name();
+    // the download is aborted here: the file is closed, but kept
+  }
+  ASSERT_TRUE(td::stat(name).is_ok());
+
+  {
+    auto staging = StateStagingFile::open(tmp_dir, block_id, mc_block_id).move_as_ok();
+    ASSERT_EQ(part1.size() + part2.size(), staging.size());
+    staging.append(part3).ensure();
+    auto data = staging.finish().move_as_ok();
+    ASSERT_EQ(part1 + part2 + part3, data.as_slice().str());
+  }
+  ASSERT_TRUE(td::stat(name).is_error());
+
+  td::rmrf(tmp_dir).ensure();
+}
+
+TEST(DownloadState, RemoveStaleStaging) {
+  auto tmp_dir = td::mkdtemp("", "state-staging").move_as_ok() + TD_DIR_SLASH;
+  auto block_id = random_block_id(100);
+  auto old_mc_block_id = random_block_id(200);
+  auto new_mc_block_id = random_block_id(300);
+  auto other_block_id = random_block_id(101);
+
+  std::string old_name, other_name;
+  {
+    auto staging = StateStagingFile::open(tmp_dir, block_id, old_mc_block_id).move_as_ok();
+    staging.append(random_part(1000)).ensure();
+    old_name = staging.name();
+  }
+  {
+    auto staging = StateStagingFile::open(tmp_dir, other_block_id, old_mc_block_id).move_as_ok();
+    staging.append(random_part(1000)).ensure();
+    other_name = staging.name();
+  }
+
+  // the state is now downloaded for a newer masterchain block: the older partial download is useless
+  {
+    auto staging = StateStagingFile::open(tmp_dir, block_id, new_mc_block_id).move_as_ok();
+    ASSERT_EQ(0u, staging.size());
+  }
+  ASSERT_TRUE(td::stat(old_name).is_error());
+  ASSERT_TRUE(td::stat(other_name).is_ok());
+
+  td::rmrf(tmp_dir).ensure();
+}
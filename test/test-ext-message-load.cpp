@@ -0,0 +1,266 @@
+/* 
+    This file is part of TON Blockchain source code.
+
+    TON Blockchain is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    TON Blockchain is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with TON Blockchain.  If not, see <http://www.gnu.org/licenses/>.
+
+    In addition, as a special exception, the copyright holders give permission 
+    to link the code of portions of this program with the OpenSSL library. 
+    You must obey the GNU General Public License in all respects for all 
+    of the code used other than OpenSSL. If you modify file(s) with this 
+    exception, you may extend this exception to your version of the file(s), 
+    but you are not obligated to do so. If you do not wish to do so, delete this 
+    exception statement from your version. If you delete this exception statement 
+    from all source files in the program, then also delete it here.
+
+    Copyright 2017-2020 Telegram Systems LLP
+*/
+#include "adnl/adnl-ext-client.h"
+#include "auto/tl/lite_api.h"
+#include "auto/tl/ton_api_json.h"
+#include "tl-utils/lite-utils.hpp"
+#include "td/utils/JsonBuilder.h"
+#include "td/utils/OptionParser.h"
+#include "td/utils/Time.h"
+#include "td/utils/filesystem.h"
+#include "td/utils/port/signals.h"
+
+#include <iostream>
+
+// Sends external messages to a liteserver at a fixed rate, so every message goes through
+// ValidatorManager::check_external_message, and reports how many were accepted and how long the checks took.
+// Messages are read from bag-of-cells files and sent in turn; resending the same message exercises the cache of
+// recent check results, different messages to the same account exercise the per-account batching.
+class ExtMessageLoad : public td::actor::Actor {
+ public:
+  void set_global_config(std::string str) {
+    global_config_ = std::move(str);
+  }
+  void set_liteserver_idx(int idx) {
+    liteserver_idx_ = idx;
+  }
+  void add_message_file(std::string str) {
+    message_files_.push_back(std::move(str));
+  }
+  void set_rate(double rate) {
+    rate_ = rate;
+  }
+  void set_duration(double duration) {
+    duration_ = duration;
+  }
+
+  void run() {
+    for (auto& fname : message_files_) {
+      auto R = td::read_file(fname);
+      if (R.is_error()) {
+        LOG(FATAL) << "cannot read message from " << fname << " : " << R.move_as_error();
+      }
+      messages_.push_back(R.move_as_ok());
+    }
+    if (messages_.empty()) {
+      LOG(FATAL) << "no messages to send, use -f to add message files";
+    }
+    auto G = td::read_file(global_config_).move_as_ok();
+    auto gc_j = td::json_decode(G.as_slice()).move_as_ok();
+    ton::ton_api::liteclient_config_global gc;
+    ton::ton_api::from_json(gc, gc_j.get_object()).ensure();
+    CHECK(gc.liteservers_.size() > 0);
+    CHECK(liteserver_idx_ >= 0 && static_cast<size_t>(liteserver_idx_) < gc.liteservers_.size());
+    auto& cli = gc.liteservers_[liteserver_idx_];
+    td::IPAddress addr;
+    addr.init_host_port(td::IPAddress::ipv4_to_str(cli->ip_), cli->port_).ensure();
+    client_ = ton::adnl::AdnlExtClient::create(ton::adnl::AdnlNodeIdFull{ton::PublicKey{cli->id_}}, addr,
+                                               make_callback());
+  }
+
+  void conn_ready() {
+    if (ready_) {
+      return;
+    }
+    ready_ = true;
+    start_ = td::Time::now();
+    last_report_ = start_;
+    LOG(ERROR) << "connected, sending " << rate_ << " messages per second for " << duration_ << " seconds";
+    alarm_timestamp() = td::Timestamp::now();
+  }
+  void conn_closed() {
+    LOG(ERROR) << "connection closed";
+  }
+
+  void alarm() override {
+    auto now = td::Time::now();
+    bool sending = now < start_ + duration_;
+    if (sending) {
+      auto due = static_cast<td::uint64>((now - start_) * rate_);
+      while (sent_ < due) {
+        send_message();
+      }
+    }
+    if (now >= last_report_ + 1.0) {
+      report(period_, "last second");
+      period_ = Stats{};
+      last_report_ = now;
+    }
+    if (!sending && in_flight_ == 0) {
+      report(total_, "total");
+      std::cout.flush();
+      std::_Exit(0);
+    }
+    alarm_timestamp() = td::Timestamp::in(0.01);
+  }
+
+ private:
+  struct Stats {
+    td::uint64 accepted = 0;
+    td::uint64 rejected = 0;
+    td::uint64 failed = 0;
+    double latency_sum = 0;
+    double latency_max = 0;
+    void add(int result, double latency) {
+      (result > 0 ? accepted : result == 0 ? rejected : failed)++;
+      latency_sum += latency;
+      latency_max = std::max(latency_max, latency);
+    }
+  };
+
+  std::string global_config_ = "ton-global.config";
+  int liteserver_idx_ = 0;
+  std::vector<std::string> message_files_;
+  std::vector<td::BufferSlice> messages_;
+  double rate_ = 100;
+  double duration_ = 10;
+  td::actor::ActorOwn<ton::adnl::AdnlExtClient> client_;
+  bool ready_ = false;
+  double start_ = 0;
+  double last_report_ = 0;
+  td::uint64 sent_ = 0;
+  td::uint64 in_flight_ = 0;
+  Stats period_, total_;
+  std::string last_error_;
+
+  std::unique_ptr<ton::adnl::AdnlExtClient::Callback> make_callback() {
+    class Callback : public ton::adnl::AdnlExtClient::Callback {
+     public:
+      void on_ready() override {
+        td::actor::send_closure(id_, &ExtMessageLoad::conn_ready);
+      }
+      void on_stop_ready() override {
+        td::actor::send_closure(id_, &ExtMessageLoad::conn_closed);
+      }
+      Callback(td::actor::ActorId<ExtMessageLoad> id) : id_(std::move(id)) {
+      }
+
+     private:
+      td::actor::ActorId<ExtMessageLoad> id_;
+    };
+    return std::make_unique<Callback>(actor_id(this));
+  }
+
+  void send_message() {
+    auto query = ton::serialize_tl_object(
+        ton::create_tl_object<ton::lite_api::liteServer_sendMessage>(messages_[sent_ % messages_.size()].clone()),
+        true);
+    auto b = ton::serialize_tl_object(ton::create_tl_object<ton::lite_api::liteServer_query>(std::move(query)), true);
+    sent_++;
+    in_flight_++;
+    td::actor::send_closure(client_, &ton::adnl::AdnlExtClient::send_query, "query", std::move(b),
+                            td::Timestamp::in(10.0),
+                            [SelfId = actor_id(this), sent_at = td::Time::now()](td::Result<td::BufferSlice> R) {
+                              td::actor::send_closure(SelfId, &ExtMessageLoad::got_answer, std::move(R), sent_at);
+                            });
+  }
+
+  void got_answer(td::Result<td::BufferSlice> R, double sent_at) {
+    in_flight_--;
+    int result = -1;
+    if (R.is_error()) {
+      last_error_ = R.error().to_string();
+    } else {
+      auto E = ton::fetch_tl_object<ton::lite_api::liteServer_error>(R.ok().clone(), true);
+      if (E.is_ok()) {
+        result = 0;
+        last_error_ = E.ok()->message_;
+      } else if (ton::fetch_tl_object<ton::lite_api::liteServer_sendMsgStatus>(R.move_as_ok(), true).is_ok()) {
+        result = 1;
+      } else {
+        last_error_ = "cannot parse answer to liteServer.sendMessage";
+      }
+    }
+    auto latency = td::Time::now() - sent_at;
+    period_.add(result, latency);
+    total_.add(result, latency);
+  }
+
+  void report(const Stats& stats, td::Slice what) {
+    auto answered = stats.accepted + stats.rejected + stats.failed;
+    std::cout << what.str() << ": sent " << sent_ << ", in flight " << in_flight_ << ", answered " << answered
+              << " (accepted " << stats.accepted << ", rejected " << stats.rejected << ", failed " << stats.failed
+              << "), latency avg " << (answered ? stats.latency_sum / static_cast<double>(answered) * 1e3 : 0.0)
+              << "ms max " << stats.latency_max * 1e3 << "ms" << std::endl;
+    if (stats.rejected + stats.failed > 0 && !last_error_.empty()) {
+      std::cout << "  last error: " << last_error_ << std::endl;
+    }
+  }
+};
+
+int main(int argc, char* argv[]) {
+  SET_VERBOSITY_LEVEL(verbosity_ERROR);
+  td::set_default_failure_signal_handler().ensure();
+
+  td::actor::ActorOwn<ExtMessageLoad> x;
+  td::uint32 threads = 2;
+
+  td::OptionParser p;
+  p.set_description("sends external messages to a liteserver at a fixed rate and measures how they are checked");
+  p.add_option('h', "help", "prints_help", [&]() {
+    char b[10240];
+    td::StringBuilder sb(td::MutableSlice{b, 10000});
+    sb << p;
+    std::cout << sb.as_cslice().c_str();
+    std::exit(2);
+  });
+  p.add_option('C', "global-config", "file to read global config", [&](td::Slice fname) {
+    td::actor::send_closure(x, &ExtMessageLoad::set_global_config, fname.str());
+  });
+  p.add_checked_option('i', "idx", "index of the liteserver in the global config (default 0)", [&](td::Slice arg) {
+    TRY_RESULT(idx, td::to_integer_safe<int>(arg));
+    td::actor::send_closure(x, &ExtMessageLoad::set_liteserver_idx, idx);
+    return td::Status::OK();
+  });
+  p.add_option('f', "file", "bag of cells with an external message, may be repeated", [&](td::Slice fname) {
+    td::actor::send_closure(x, &ExtMessageLoad::add_message_file, fname.str());
+  });
+  p.add_checked_option('r', "rate", "messages per second (default 100)", [&](td::Slice arg) {
+    TRY_RESULT(rate, td::to_integer_safe<td::uint32>(arg));
+    td::actor::send_closure(x, &ExtMessageLoad::set_rate, static_cast<double>(rate));
+    return td::Status::OK();
+  });
+  p.add_checked_option('T', "time", "duration of the test in seconds (default 10)", [&](td::Slice arg) {
+    TRY_RESULT(duration, td::to_integer_safe<td::uint32>(arg));
+    td::actor::send_closure(x, &ExtMessageLoad::set_duration, static_cast<double>(duration));
+    return td::Status::OK();
+  });
+  p.add_checked_option('t', "threads", "number of threads (default 2)", [&](td::Slice arg) {
+    TRY_RESULT_ASSIGN(threads, td::to_integer_safe<td::uint32>(arg));
+    return td::Status::OK();
+  });
+
+  td::actor::Scheduler scheduler({threads});
+
+  scheduler.run_in_context([&] { x = td::actor::create_actor<ExtMessageLoad>("extmsgload"); });
+  scheduler.run_in_context([&] { p.run(argc, argv).ensure(); });
+  scheduler.run_in_context([&] { td::actor::send_closure(x, &ExtMessageLoad::run); });
+  scheduler.run();
+
+  return 0;
+}
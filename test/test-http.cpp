@@ -36,12 +36,19 @@
 #include "td/utils/overloaded.h"
 #include "common/errorlog.h"
 #include "http/http.h"
+#include "http/http-client.h"
+#include "td/actor/actor.h"
 
 #if TD_DARWIN || TD_LINUX
 #include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
 #endif
+#include <atomic>
 #include <iostream>
 #include <sstream>
+#include <thread>
 
 #include <set>
 
@@ -50,10 +57,167 @@ void dump_reader(td::ChainBufferReader &reader) {
   LOG(INFO) << b.as_slice();
 }
 
+#if TD_DARWIN || TD_LINUX
+// keep-alive backend on a blocking socket, counts accepted connections
+// with drop_second_request it closes a connection instead of answering its second request, like a server whose
+// keep-alive timeout expired just as the request was sent
+class TestBackend {
+ public:
+  explicit TestBackend(bool drop_second_request) : drop_second_request_(drop_second_request) {
+    fd_ = socket(AF_INET, SOCK_STREAM, 0);
+    CHECK(fd_ >= 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    CHECK(bind(fd_, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == 0);
+    CHECK(listen(fd_, 16) == 0);
+    socklen_t len = sizeof(addr);
+    CHECK(getsockname(fd_, reinterpret_cast<sockaddr *>(&addr), &len) == 0);
+    port_ = ntohs(addr.sin_port);
+    std::thread([this] { accept_loop(); }).detach();
+  }
+
+  td::IPAddress address() const {
+    td::IPAddress addr;
+    addr.init_ipv4_port("127.0.0.1", port_).ensure();
+    return addr;
+  }
+  int connections() const {
+    return connections_.load();
+  }
+
+ private:
+  void accept_loop() {
+    while (true) {
+      int conn = accept(fd_, nullptr, nullptr);
+      if (conn < 0) {
+        return;
+      }
+      connections_++;
+      std::thread([this, conn] { serve(conn); }).detach();
+    }
+  }
+
+  void serve(int conn) {
+    std::string buf;
+    int requests = 0;
+    char tmp[4096];
+    while (true) {
+      auto r = read(conn, tmp, sizeof(tmp));
+      if (r <= 0) {
+        break;
+      }
+      buf.append(tmp, r);
+      size_t pos;
+      while ((pos = buf.find("\r\n\r\n")) != std::string::npos) {
+        buf.erase(0, pos + 4);
+        if (++requests == 2 && drop_second_request_) {
+          close(conn);
+          return;
+        }
+        td::Slice response = "HTTP/1.1 200 OK\r\nContent-Length: 2\r\nConnection: keep-alive\r\n\r\nok";
+        CHECK(write(conn, response.data(), response.size()) == static_cast<ssize_t>(response.size()));
+      }
+    }
+    close(conn);
+  }
+
+  int fd_;
+  td::uint16 port_;
+  bool drop_second_request_;
+  std::atomic<int> connections_{0};
+};
+
+// sends GET requests one after another through a pooled client and checks the answers
+class SequentialRequests : public td::actor::Actor {
+ public:
+  SequentialRequests(td::IPAddress addr, int count, td::Promise<td::Unit> promise)
+      : addr_(addr), count_(count), promise_(std::move(promise)) {
+  }
+
+  void start_up() override {
+    class Cb : public ton::http::HttpClient::Callback {
+     public:
+      void on_ready() override {
+      }
+      void on_stop_ready() override {
+      }
+    };
+    client_ = ton::http::HttpClient::create_multi("", addr_, 4, 100, std::make_shared<Cb>());
+    send_next();
+  }
+
+  void send_next() {
+    if (count_-- == 0) {
+      promise_.set_value(td::Unit());
+      stop();
+      return;
+    }
+    auto request = ton::http::HttpRequest::create("GET", "/", "HTTP/1.1").move_as_ok();
+    request->add_header({"Host", "localhost"}).ensure();
+    request->complete_parse_header().ensure();
+    auto payload = request->create_empty_payload().move_as_ok();
+    td::actor::send_closure(
+        client_, &ton::http::HttpClient::send_request, std::move(request), std::move(payload), td::Timestamp::in(5.0),
+        [SelfId = actor_id(this)](
+            td::Result<std::pair<std::unique_ptr<ton::http::HttpResponse>, std::shared_ptr<ton::http::HttpPayload>>>
+                R) { td::actor::send_closure(SelfId, &SequentialRequests::got_response, std::move(R)); });
+  }
+
+  void got_response(
+      td::Result<std::pair<std::unique_ptr<ton::http::HttpResponse>, std::shared_ptr<ton::http::HttpPayload>>> R) {
+    R.ensure();
+    CHECK(R.ok().first->code() == 200);
+    // the connection takes the next request only when the response is read, give it a moment
+    alarm_timestamp() = td::Timestamp::in(0.1);
+  }
+
+  void alarm() override {
+    send_next();
+  }
+
+ private:
+  td::IPAddress addr_;
+  int count_;
+  td::Promise<td::Unit> promise_;
+  td::actor::ActorOwn<ton::http::HttpClient> client_;
+};
+
+void run_sequential_requests(const TestBackend &backend, int count) {
+  td::actor::Scheduler scheduler({1});
+  scheduler.run_in_context([&] {
+    td::actor::create_actor<SequentialRequests>("requests", backend.address(), count, [](td::Result<td::Unit> R) {
+      R.ensure();
+      td::actor::SchedulerContext::get()->stop();
+    }).release();
+  });
+  scheduler.run();
+}
+#endif
+
 int main(int argc, char *argv[]) {
   SET_VERBOSITY_LEVEL(verbosity_INFO);
   td::set_default_failure_signal_handler().ensure();
 
+  CHECK(ton::http::payload_part_timeout(15.0, 0) == 15.0);
+  CHECK(ton::http::payload_part_timeout(15.0, 7) == 120.0);
+
+#if TD_DARWIN || TD_LINUX
+  {
+    // sequential requests reuse one keep-alive connection
+    TestBackend backend(false);
+    run_sequential_requests(backend, 3);
+    CHECK(backend.connections() == 1);
+  }
+
+  {
+    // the second request is sent on an idle connection that the backend has closed, it is retried on a new one
+    TestBackend backend(true);
+    run_sequential_requests(backend, 2);
+    CHECK(backend.connections() == 2);
+  }
+#endif
+
   {
     const auto request =
         "GET /pub/WWW/TheProject.html HTTP/1.1\r\n"
@@ -303,6 +467,92 @@ int main(int argc, char *argv[]) {
     dump_reader(ro);
   }
 
+  {
+    const auto header =
+        "POST /upload HTTP/1.1\r\n"
+        "Host: www.example.org:8080\r\n"
+        "Transfer-Encoding: chunked\r\n"
+        "\r\n";
+    const size_t chunk = 1 << 16;
+    const size_t chunks = 256;
+    std::string body(chunk, 'a');
+    for (size_t i = 0; i < body.size(); i++) {
+      body[i] = static_cast<char>('a' + i % 26);
+    }
+
+    td::ChainBufferWriter w;
+    w.init(0);
+    auto r = w.extract_reader();
+    w.append(td::Slice(header, std::strlen(header)));
+    r.sync_with_writer();
+
+    bool exit_loop = false;
+    std::string cur_line = "";
+    auto R = ton::http::HttpRequest::parse(nullptr, cur_line, exit_loop, r);
+    R.ensure();
+    auto req = R.move_as_ok();
+    CHECK(req->check_parse_header_completed());
+    auto payload = req->create_empty_payload().move_as_ok();
+
+    auto start = td::Time::now();
+    size_t received = 0;
+    for (size_t i = 0; i <= chunks; i++) {
+      if (i < chunks) {
+        w.append("10000\r\n");
+        w.append(body);
+        w.append("\r\n");
+      } else {
+        w.append("0\r\n\r\n");
+      }
+      r.sync_with_writer();
+      payload->parse(r).ensure();
+      while (true) {
+        auto part = payload->store_tl(1 << 17);
+        if (part->data_.empty()) {
+          break;
+        }
+        CHECK(part->data_.as_slice() == td::Slice(body).substr(received % chunk, part->data_.size()));
+        received += part->data_.size();
+      }
+    }
+    CHECK(payload->parse_completed());
+    CHECK(received == chunk * chunks);
+    auto elapsed = td::Time::now() - start;
+    LOG(ERROR) << "chunked body: " << td::format::as_size(received) << " in " << elapsed << "s, "
+               << static_cast<double>(received) / elapsed / (1 << 20) << " MB/s";
+  }
+
+  {
+    const auto request =
+        "GET /pub/WWW/TheProject.html HTTP/1.1\r\n"
+        "Host: www.example.org:8080\r\n"
+        "Content-Length: 16\r\n"
+        "\r\n"
+        "0123456789abcdef";
+    const size_t n = 100000;
+    auto start = td::Time::now();
+    td::ChainBufferWriter w;
+    w.init(0);
+    auto r = w.extract_reader();
+    for (size_t i = 0; i < n; i++) {
+      w.append(td::Slice(request, std::strlen(request)));
+      r.sync_with_writer();
+      bool exit_loop = false;
+      std::string cur_line = "";
+      auto R = ton::http::HttpRequest::parse(nullptr, cur_line, exit_loop, r);
+      R.ensure();
+      auto req = R.move_as_ok();
+      CHECK(req->check_parse_header_completed());
+      auto payload = req->create_empty_payload().move_as_ok();
+      payload->parse(r).ensure();
+      CHECK(payload->parse_completed());
+      CHECK(payload->store_tl(1 << 10)->data_.as_slice() == "0123456789abcdef");
+    }
+    auto elapsed = td::Time::now() - start;
+    LOG(ERROR) << "parsed " << n << " requests in " << elapsed << "s, " << static_cast<double>(n) / elapsed
+               << " requests/s";
+  }
+
   std::_Exit(0);
   return 0;
 }
@@ -28,9 +28,12 @@
 #include "tonlib/utils.h"
 #include "tonlib/TonlibClient.h"
 #include "tonlib/Client.h"
+#include "tonlib/ExtClientLazy.h"
 
 #include "auto/tl/ton_api_json.h"
 #include "auto/tl/tonlib_api_json.h"
+#include "auto/tl/lite_api.h"
+#include "tl-utils/lite-utils.hpp"
 
 #include "td/utils/benchmark.h"
 #include "td/utils/filesystem.h"
@@ -47,6 +50,9 @@
 #include "tonlib/keys/Mnemonic.h"
 #include "tonlib/keys/SimpleEncryption.h"
 
+#include <atomic>
+#include <list>
+
 TEST(Tonlib, CellString) {
   for (unsigned size :
        {0, 1, 7, 8, 35, 127, 128, 255, 256, (int)vm::CellString::max_bytes - 1, (int)vm::CellString::max_bytes}) {
@@ -664,3 +670,190 @@ TEST(Tonlib, ConfigCache) {
                         make_object<tonlib_api::config>(custom, "testnet", true, false)))
       .ensure_error();
 }
+
+namespace {
+struct FakeLiteServer {
+  double delay;
+  bool fail;
+  std::shared_ptr<std::atomic<int>> queries = std::make_shared<std::atomic<int>>(0);
+};
+
+// answers every query with its own index after a fixed delay, or fails it at once
+class FakeLiteServerClient : public ton::adnl::AdnlExtClient {
+ public:
+  FakeLiteServerClient(int idx, FakeLiteServer server, std::unique_ptr<Callback> callback)
+      : idx_(idx), server_(std::move(server)), callback_(std::move(callback)) {
+  }
+  void start_up() override {
+    callback_->on_ready();
+  }
+  void check_ready(td::Promise<td::Unit> promise) override {
+    promise.set_value(td::Unit());
+  }
+  void send_query(std::string name, td::BufferSlice data, td::Timestamp timeout,
+                  td::Promise<td::BufferSlice> promise) override {
+    ++*server_.queries;
+    if (server_.fail) {
+      return promise.set_error(td::Status::Error("query failed"));
+    }
+    pending_.emplace_back(td::Timestamp::in(server_.delay), std::move(promise));
+    alarm_timestamp().relax(pending_.back().first);
+  }
+  void alarm() override {
+    td::Timestamp next;
+    for (auto it = pending_.begin(); it != pending_.end();) {
+      if (it->first.is_in_past()) {
+        it->second.set_value(td::BufferSlice(PSLICE() << idx_));
+        it = pending_.erase(it);
+      } else {
+        next.relax(it->first);
+        ++it;
+      }
+    }
+    alarm_timestamp() = next;
+  }
+
+ private:
+  int idx_;
+  FakeLiteServer server_;
+  std::unique_ptr<Callback> callback_;
+  std::list<std::pair<td::Timestamp, td::Promise<td::BufferSlice>>> pending_;
+};
+
+struct PoolAnswer {
+  td::Result<int> server;
+  double elapsed;
+};
+
+// sends the queries one after another through an ExtClientLazy pool over the fake liteservers
+std::vector<PoolAnswer> run_ext_client_pool(std::vector<FakeLiteServer> servers, std::vector<td::BufferSlice> queries) {
+  class Runner : public td::actor::Actor {
+   public:
+    Runner(std::vector<FakeLiteServer> servers, std::vector<td::BufferSlice> queries, std::vector<PoolAnswer>& answers)
+        : servers_(std::move(servers)), queries_(std::move(queries)), answers_(answers) {
+    }
+    void start_up() override {
+      std::vector<std::pair<ton::adnl::AdnlNodeIdFull, td::IPAddress>> ids;
+      for (size_t i = 0; i < servers_.size(); i++) {
+        td::IPAddress addr;
+        addr.init_host_port("127.0.0.1", static_cast<int>(1000 + i)).ensure();
+        ids.emplace_back(ton::adnl::AdnlNodeIdFull{ton::PublicKey{ton::pubkeys::Ed25519{td::Bits256::zero()}}}, addr);
+      }
+      client_ = tonlib::ExtClientLazy::create(
+          std::move(ids), td::make_unique<tonlib::ExtClientLazy::Callback>(),
+          [servers = servers_](ton::adnl::AdnlNodeIdFull, td::IPAddress addr,
+                               std::unique_ptr<ton::adnl::AdnlExtClient::Callback> callback) {
+            auto idx = addr.get_port() - 1000;
+            return td::actor::create_actor<FakeLiteServerClient>("FakeLiteServer", idx, servers.at(idx),
+                                                                 std::move(callback));
+          });
+      send_next();
+    }
+
+   private:
+    std::vector<FakeLiteServer> servers_;
+    std::vector<td::BufferSlice> queries_;
+    std::vector<PoolAnswer>& answers_;
+    td::actor::ActorOwn<tonlib::ExtClientLazy> client_;
+
+    void send_next() {
+      if (answers_.size() == queries_.size()) {
+        client_.reset();
+        td::actor::SchedulerContext::get()->stop();
+        stop();
+        return;
+      }
+      auto query = ton::serialize_tl_object(
+          ton::create_tl_object<ton::lite_api::liteServer_query>(queries_[answers_.size()].clone()), true);
+      td::actor::send_closure(client_, &ton::adnl::AdnlExtClient::send_query, "query", std::move(query),
+                              td::Timestamp::in(10.0),
+                              [SelfId = actor_id(this), sent_at = td::Timestamp::now()](td::Result<td::BufferSlice> R) {
+                                td::actor::send_closure(SelfId, &Runner::got_answer, std::move(R), sent_at);
+                              });
+    }
+    void got_answer(td::Result<td::BufferSlice> R, td::Timestamp sent_at) {
+      PoolAnswer answer{R.is_ok() ? td::to_integer_safe<int>(R.ok().as_slice()) : R.move_as_error(),
+                        td::Timestamp::now().at() - sent_at.at()};
+      answers_.push_back(std::move(answer));
+      send_next();
+    }
+  };
+  std::vector<PoolAnswer> answers;
+  td::actor::Scheduler scheduler({1});
+  scheduler.run_in_context([&] {
+    td::actor::create_actor<Runner>("Runner", std::move(servers), std::move(queries), answers).release();
+  });
+  scheduler.run();
+  return answers;
+}
+
+td::BufferSlice lite_query(ton::lite_api::Function&& f, td::int32 wait_seqno = -1) {
+  auto q = ton::serialize_tl_object(&f, true);
+  if (wait_seqno < 0) {
+    return q;
+  }
+  auto prefix = ton::serialize_tl_object(
+      ton::create_tl_object<ton::lite_api::liteServer_waitMasterchainSeqno>(wait_seqno, 5000), true);
+  return td::BufferSlice(PSLICE() << prefix.as_slice() << q.as_slice());
+}
+}  // namespace
+
+TEST(Tonlib, ExtClientPoolRouting) {
+  // the fast server is found after at most two slow answers and then gets the queries
+  std::vector<FakeLiteServer> servers{{1.0, false}, {0.01, false}, {1.0, false}};
+  std::vector<td::BufferSlice> queries;
+  for (int i = 0; i < 20; i++) {
+    queries.push_back(lite_query(ton::lite_api::liteServer_getTime(), i));
+  }
+  auto answers = run_ext_client_pool(servers, std::move(queries));
+  ASSERT_EQ(20u, answers.size());
+  for (auto& answer : answers) {
+    answer.server.ensure();
+  }
+  ASSERT_TRUE(servers[1].queries->load() >= 18);
+}
+
+TEST(Tonlib, ExtClientPoolFailover) {
+  std::vector<FakeLiteServer> servers{{0.01, true}, {0.01, false}, {0.01, false}};
+  std::vector<td::BufferSlice> queries;
+  for (int i = 0; i < 10; i++) {
+    queries.push_back(lite_query(ton::lite_api::liteServer_getTime()));
+  }
+  auto answers = run_ext_client_pool(servers, std::move(queries));
+  ASSERT_EQ(10u, answers.size());
+  for (auto& answer : answers) {
+    ASSERT_TRUE(answer.server.move_as_ok() != 0);
+  }
+}
+
+TEST(Tonlib, ExtClientPoolHedging) {
+  // an unanswered query is duplicated to the other server after 2 seconds, even behind a waitMasterchainSeqno prefix
+  {
+    std::vector<FakeLiteServer> servers{{3.0, false}, {3.0, false}};
+    std::vector<td::BufferSlice> queries;
+    queries.push_back(lite_query(ton::lite_api::liteServer_getTime(), 10));
+    auto answers = run_ext_client_pool(servers, std::move(queries));
+    ASSERT_EQ(1u, answers.size());
+    answers[0].server.ensure();
+    ASSERT_EQ(2, servers[0].queries->load() + servers[1].queries->load());
+  }
+  {
+    std::vector<FakeLiteServer> servers{{3.0, false}, {0.01, false}};
+    std::vector<td::BufferSlice> queries;
+    queries.push_back(lite_query(ton::lite_api::liteServer_getTime()));
+    auto answers = run_ext_client_pool(servers, std::move(queries));
+    ASSERT_EQ(1u, answers.size());
+    ASSERT_EQ(1, answers[0].server.move_as_ok());
+    ASSERT_TRUE(answers[0].elapsed < 2.9);
+  }
+  // long-polling queries are never duplicated
+  {
+    std::vector<FakeLiteServer> servers{{3.0, false}, {3.0, false}};
+    std::vector<td::BufferSlice> queries;
+    queries.push_back(lite_query(ton::lite_api::liteServer_getMasterchainBlockUpdate(10), 10));
+    auto answers = run_ext_client_pool(servers, std::move(queries));
+    ASSERT_EQ(1u, answers.size());
+    answers[0].server.ensure();
+    ASSERT_EQ(1, servers[0].queries->load() + servers[1].queries->load());
+  }
+}
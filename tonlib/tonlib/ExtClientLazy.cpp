@@ -18,15 +18,37 @@
 */
 #include "ExtClientLazy.h"
 #include "TonlibError.h"
+
+#include "tl-utils/lite-utils.hpp"
+#include "auto/tl/lite_api.h"
+
 #include "td/utils/Random.h"
+#include "td/utils/tl_parsers.h"
+
+#include <cmath>
+#include <map>
+
 namespace tonlib {
 
+// Keeps connections to up to MAX_CONNECTIONS liteservers at once. Each query goes to the connected server with
+// the lowest expected latency; masterchain info queries go to the server that has reported the most recent
+// masterchain block. If a query is not answered within the estimated 95th percentile of its server's latency,
+// a duplicate is sent to another server and whichever answer comes first is used.
 class ExtClientLazyImp : public ExtClientLazy {
  public:
   ExtClientLazyImp(std::vector<std::pair<ton::adnl::AdnlNodeIdFull, td::IPAddress>> servers,
-                   td::unique_ptr<ExtClientLazy::Callback> callback)
-      : servers_(std::move(servers)), callback_(std::move(callback)) {
-    CHECK(!servers_.empty());
+                   td::unique_ptr<ExtClientLazy::Callback> callback, ClientFactory client_factory)
+      : callback_(std::move(callback)), client_factory_(std::move(client_factory)) {
+    if (!client_factory_) {
+      client_factory_ = [](ton::adnl::AdnlNodeIdFull adnl_id, td::IPAddress addr,
+                           std::unique_ptr<ton::adnl::AdnlExtClient::Callback> callback) {
+        return ton::adnl::AdnlExtClient::create(std::move(adnl_id), addr, std::move(callback));
+      };
+    }
+    CHECK(!servers.empty());
+    for (auto& s : servers) {
+      servers_.emplace_back(std::move(s.first), s.second);
+    }
   }
 
   void start_up() override {
@@ -36,92 +58,381 @@ class ExtClientLazyImp : public ExtClientLazy {
 
   void check_ready(td::Promise<td::Unit> promise) override {
     before_query();
-    if (client_.empty()) {
+    auto idx = choose_server(QueryKind::Normal);
+    if (idx < 0) {
       return promise.set_error(TonlibError::Cancelled());
     }
-    send_closure(client_, &ton::adnl::AdnlExtClient::check_ready, std::move(promise));
+    send_closure(servers_[idx].client, &ton::adnl::AdnlExtClient::check_ready, std::move(promise));
   }
 
   void send_query(std::string name, td::BufferSlice data, td::Timestamp timeout,
                   td::Promise<td::BufferSlice> promise) override {
     before_query();
-    if (client_.empty()) {
+    td::int32 wait_seqno = -1;
+    auto kind = classify_query(data, wait_seqno);
+    auto idx = choose_server(kind);
+    if (idx < 0) {
       return promise.set_error(TonlibError::Cancelled());
     }
-    td::Promise<td::BufferSlice> P = [SelfId = actor_id(this), idx = cur_server_idx_,
-                                      promise = std::move(promise)](td::Result<td::BufferSlice> R) mutable {
-      if (R.is_error() &&
-          (R.error().code() == ton::ErrorCode::timeout || R.error().code() == ton::ErrorCode::cancelled)) {
-        td::actor::send_closure(SelfId, &ExtClientLazyImp::set_server_bad, idx, true);
+    auto query_id = next_query_id_++;
+    auto& q = queries_[query_id];
+    q.promise = std::move(promise);
+    q.name = name;
+    q.timeout = timeout;
+    q.kind = kind;
+    q.wait_seqno = wait_seqno;
+    q.first_server = idx;
+    if (kind != QueryKind::LongPoll && connected_count() > 1) {
+      // long-polling queries are expected to be slow, so they are never duplicated
+      auto hedge_at = td::Timestamp::in(servers_[idx].hedge_delay());
+      if (!timeout || hedge_at < timeout) {
+        q.hedge_at = hedge_at;
+        q.data = data.clone();
+        alarm_timestamp().relax(hedge_at);
       }
-      promise.set_result(std::move(R));
-    };
-    send_closure(client_, &ton::adnl::AdnlExtClient::send_query, std::move(name), std::move(data), timeout,
-                 std::move(P));
+    }
+    send_to_server(query_id, q, idx, std::move(data));
   }
 
   void force_change_liteserver() override {
     if (servers_.size() == 1) {
       return;
     }
-    cur_server_bad_ = cur_server_bad_force_ = true;
+    auto idx = choose_server(QueryKind::Normal);
+    if (idx >= 0) {
+      servers_[idx].bad = servers_[idx].bad_force = true;
+    }
   }
 
  private:
-  void before_query() {
-    if (is_closing_) {
+  enum class QueryKind { Normal, MasterchainInfo, LongPoll };
+
+  struct Server {
+    Server(ton::adnl::AdnlNodeIdFull adnl_id, td::IPAddress addr) : adnl_id(std::move(adnl_id)), addr(addr) {
+    }
+    ton::adnl::AdnlNodeIdFull adnl_id;
+    td::IPAddress addr;
+    td::actor::ActorOwn<ton::adnl::AdnlExtClient> client;
+    td::uint32 generation = 0;
+    bool ready = false;
+    bool bad = false;
+    bool bad_force = false;
+    td::uint32 in_flight = 0;
+    double latency = -1;  // exponentially weighted mean and mean deviation of response time, in seconds
+    double latency_dev = 0;
+    td::int32 last_mc_seqno = -1;
+
+    double expected_latency() const {
+      return (latency < 0 ? DEFAULT_LATENCY : latency) * (1 + in_flight);
+    }
+    double hedge_delay() const {
+      // mean + 2 * mean deviation is a rough estimate of the 95th percentile
+      if (latency < 0) {
+        return DEFAULT_HEDGE_DELAY;
+      }
+      double delay = latency + 2 * latency_dev;
+      return delay < MIN_HEDGE_DELAY ? MIN_HEDGE_DELAY : delay;
+    }
+    void update_latency(double elapsed) {
+      if (latency < 0) {
+        latency = elapsed;
+        latency_dev = elapsed / 2;
+      } else {
+        latency_dev += (std::abs(elapsed - latency) - latency_dev) * LATENCY_EWMA_ALPHA;
+        latency += (elapsed - latency) * LATENCY_EWMA_ALPHA;
+      }
+    }
+  };
+
+  struct Query {
+    td::Promise<td::BufferSlice> promise;
+    std::string name;
+    td::BufferSlice data;  // kept only until a duplicate is sent
+    td::Timestamp timeout;
+    td::Timestamp hedge_at;
+    QueryKind kind = QueryKind::Normal;
+    td::int32 wait_seqno = -1;
+    size_t first_server = 0;
+    td::uint32 pending = 0;
+  };
+
+  static QueryKind classify_query(const td::BufferSlice& data, td::int32& wait_seqno) {
+    auto F = ton::fetch_tl_object<ton::lite_api::liteServer_query>(data.clone(), true);
+    if (F.is_error()) {
+      return QueryKind::Normal;
+    }
+    td::TlParser parser(F.ok()->data_.as_slice());
+    auto id = parser.fetch_int();
+    if (parser.get_error()) {
+      return QueryKind::Normal;
+    }
+    if (id == ton::lite_api::liteServer_waitMasterchainSeqno::ID) {
+      // most queries carry this prefix; it only delays the query if the server is behind, so the query itself
+      // decides how it is routed
+      wait_seqno = parser.fetch_int();
+      parser.fetch_int();  // timeout_ms
+      id = parser.fetch_int();
+      if (parser.get_error()) {
+        wait_seqno = -1;
+        return QueryKind::Normal;
+      }
+    }
+    if (id == ton::lite_api::liteServer_getMasterchainBlockUpdate::ID) {
+      return QueryKind::LongPoll;
+    }
+    if (id == ton::lite_api::liteServer_getMasterchainInfo::ID ||
+        id == ton::lite_api::liteServer_getMasterchainInfoExt::ID) {
+      return QueryKind::MasterchainInfo;
+    }
+    return QueryKind::Normal;
+  }
+
+  static td::int32 extract_mc_seqno(const td::BufferSlice& answer) {
+    auto F = ton::fetch_tl_object<ton::lite_api::liteServer_masterchainInfo>(answer.clone(), true);
+    if (F.is_ok()) {
+      return F.ok()->last_->seqno_;
+    }
+    auto G = ton::fetch_tl_object<ton::lite_api::liteServer_masterchainInfoExt>(answer.clone(), true);
+    if (G.is_ok()) {
+      return G.ok()->last_->seqno_;
+    }
+    return -1;
+  }
+
+  size_t connected_count() const {
+    size_t cnt = 0;
+    for (const auto& s : servers_) {
+      cnt += !s.client.empty();
+    }
+    return cnt;
+  }
+
+  // returns the index of the best connected server other than exclude, or -1
+  td::int32 choose_server(QueryKind kind, td::int32 exclude = -1) const {
+    td::int32 best = -1;
+    auto rank = [&](const Server& s) {
+      // ready and healthy servers come first
+      return (s.ready && !s.bad ? 2 : 0) + (s.bad ? 0 : 1);
+    };
+    for (td::int32 i = 0; i < static_cast<td::int32>(servers_.size()); i++) {
+      const auto& s = servers_[i];
+      if (s.client.empty() || i == exclude) {
+        continue;
+      }
+      if (best < 0) {
+        best = i;
+        continue;
+      }
+      const auto& b = servers_[best];
+      if (rank(s) != rank(b)) {
+        if (rank(s) > rank(b)) {
+          best = i;
+        }
+        continue;
+      }
+      if (kind == QueryKind::MasterchainInfo && s.last_mc_seqno != b.last_mc_seqno) {
+        if (s.last_mc_seqno > b.last_mc_seqno) {
+          best = i;
+        }
+        continue;
+      }
+      if (s.expected_latency() < b.expected_latency()) {
+        best = i;
+      }
+    }
+    if (best >= 0 && exclude >= 0 && servers_[best].bad) {
+      // duplicating a query to an unhealthy server is useless
+      return -1;
+    }
+    return best;
+  }
+
+  void send_to_server(td::uint64 query_id, Query& q, size_t idx, td::BufferSlice data) {
+    auto& s = servers_[idx];
+    s.in_flight++;
+    q.pending++;
+    td::Promise<td::BufferSlice> P = [SelfId = actor_id(this), query_id, idx, generation = s.generation,
+                                      sent_at = td::Timestamp::now()](td::Result<td::BufferSlice> R) mutable {
+      td::actor::send_closure(SelfId, &ExtClientLazyImp::on_query_result, query_id, idx, generation, sent_at,
+                              std::move(R));
+    };
+    send_closure(s.client, &ton::adnl::AdnlExtClient::send_query, q.name, std::move(data), q.timeout, std::move(P));
+  }
+
+  void on_query_result(td::uint64 query_id, size_t idx, td::uint32 generation, td::Timestamp sent_at,
+                       td::Result<td::BufferSlice> R) {
+    auto it = queries_.find(query_id);
+    auto kind = it == queries_.end() ? QueryKind::Normal : it->second.kind;
+    auto& s = servers_[idx];
+    if (generation == s.generation) {
+      if (s.in_flight > 0) {
+        s.in_flight--;
+      }
+      if (R.is_ok()) {
+        if (kind != QueryKind::LongPoll) {
+          s.update_latency(td::Timestamp::now().at() - sent_at.at());
+        }
+        if (kind == QueryKind::MasterchainInfo) {
+          s.last_mc_seqno = std::max(s.last_mc_seqno, extract_mc_seqno(R.ok()));
+        }
+        if (it != queries_.end()) {
+          // the server has answered only after applying the awaited block
+          s.last_mc_seqno = std::max(s.last_mc_seqno, it->second.wait_seqno);
+        }
+        if (!s.bad_force) {
+          s.bad = false;
+        }
+      } else if (R.error().code() == ton::ErrorCode::timeout || R.error().code() == ton::ErrorCode::cancelled) {
+        s.bad = true;
+      }
+    }
+    if (it == queries_.end()) {
+      // the other copy of the query has already been answered
       return;
     }
-    alarm_timestamp() = td::Timestamp::in(MAX_NO_QUERIES_TIMEOUT);
-    if (cur_server_bad_) {
-      ++cur_server_idx_;
-    } else if (!client_.empty()) {
+    auto& q = it->second;
+    q.pending--;
+    if (R.is_error() && (q.pending > 0 || q.hedge_at)) {
+      if (q.pending == 0 && !send_duplicate(query_id, q)) {
+        q.promise.set_error(R.move_as_error());
+        queries_.erase(it);
+      }
       return;
     }
+    q.promise.set_result(std::move(R));
+    queries_.erase(it);
+  }
+
+  bool send_duplicate(td::uint64 query_id, Query& q) {
+    q.hedge_at = td::Timestamp::never();
+    if (is_closing_ || q.data.empty() || (q.timeout && q.timeout.is_in_past())) {
+      return false;
+    }
+    auto idx = choose_server(q.kind, static_cast<td::int32>(q.first_server));
+    if (idx < 0) {
+      q.data = {};
+      return false;
+    }
+    LOG(DEBUG) << "Sending duplicate of query " << q.name << " to liteserver " << servers_[idx].addr;
+    send_to_server(query_id, q, idx, std::move(q.data));
+    return true;
+  }
+
+  void connect(size_t idx) {
     class Callback : public ton::adnl::AdnlExtClient::Callback {
      public:
-      explicit Callback(td::actor::ActorShared<ExtClientLazyImp> parent, size_t idx)
-          : parent_(std::move(parent)), idx_(idx) {
+      explicit Callback(td::actor::ActorShared<ExtClientLazyImp> parent, size_t idx, td::uint32 generation)
+          : parent_(std::move(parent)), idx_(idx), generation_(generation) {
       }
       void on_ready() override {
-        td::actor::send_closure(parent_, &ExtClientLazyImp::set_server_bad, idx_, false);
+        td::actor::send_closure(parent_, &ExtClientLazyImp::set_server_ready, idx_, generation_, true);
       }
       void on_stop_ready() override {
-        td::actor::send_closure(parent_, &ExtClientLazyImp::set_server_bad, idx_, true);
+        td::actor::send_closure(parent_, &ExtClientLazyImp::set_server_ready, idx_, generation_, false);
       }
 
      private:
       td::actor::ActorShared<ExtClientLazyImp> parent_;
       size_t idx_;
+      td::uint32 generation_;
     };
+    auto& s = servers_[idx];
     ref_cnt_++;
-    cur_server_bad_ = false;
-    cur_server_bad_force_ = false;
-    const auto& s = servers_[cur_server_idx_ % servers_.size()];
-    LOG(INFO) << "Connecting to liteserver " << s.second;
-    client_ = ton::adnl::AdnlExtClient::create(
-        s.first, s.second, std::make_unique<Callback>(td::actor::actor_shared(this), cur_server_idx_));
+    s.generation++;
+    s.ready = s.bad = s.bad_force = false;
+    s.in_flight = 0;
+    LOG(INFO) << "Connecting to liteserver " << s.addr;
+    s.client =
+        client_factory_(s.adnl_id, s.addr, std::make_unique<Callback>(td::actor::actor_shared(this), idx, s.generation));
+  }
+
+  void disconnect(size_t idx) {
+    auto& s = servers_[idx];
+    s.client.reset();
+    s.generation++;
+    s.ready = false;
+    s.in_flight = 0;
+  }
+
+  void before_query() {
+    if (is_closing_) {
+      return;
+    }
+    idle_timeout_ = td::Timestamp::in(MAX_NO_QUERIES_TIMEOUT);
+    alarm_timestamp().relax(idle_timeout_);
+    size_t max_connections = servers_.size() < MAX_CONNECTIONS ? servers_.size() : MAX_CONNECTIONS;
+    bool have_spare = servers_.size() > max_connections;
+    for (size_t i = 0; i < servers_.size(); i++) {
+      // unhealthy servers are replaced with spare ones; servers rejected by the user are reconnected anyway
+      auto& s = servers_[i];
+      if (!s.client.empty() && (s.bad_force || (s.bad && have_spare))) {
+        disconnect(i);
+      }
+    }
+    auto cnt = connected_count();
+    // healthy servers are tried first, in round-robin order
+    for (int pass = 0; pass < 2 && cnt < max_connections; pass++) {
+      for (size_t j = 0; j < servers_.size() && cnt < max_connections; j++) {
+        auto idx = (next_server_ + j) % servers_.size();
+        auto& s = servers_[idx];
+        if (s.client.empty() && (pass > 0 || !s.bad)) {
+          connect(idx);
+          next_server_ = idx + 1;
+          cnt++;
+        }
+      }
+    }
   }
 
-  std::vector<std::pair<ton::adnl::AdnlNodeIdFull, td::IPAddress>> servers_;
-  size_t cur_server_idx_ = 0;
-  bool cur_server_bad_ = false;
-  bool cur_server_bad_force_ = false;
+  void set_server_ready(size_t idx, td::uint32 generation, bool ready) {
+    auto& s = servers_[idx];
+    if (generation != s.generation) {
+      return;
+    }
+    s.ready = ready;
+    if (!s.bad_force) {
+      s.bad = !ready;
+    }
+  }
+
+  std::vector<Server> servers_;
+  size_t next_server_ = 0;
+  std::map<td::uint64, Query> queries_;
+  td::uint64 next_query_id_ = 0;
+  td::Timestamp idle_timeout_;
 
-  td::actor::ActorOwn<ton::adnl::AdnlExtClient> client_;
   td::unique_ptr<ExtClientLazy::Callback> callback_;
+  ClientFactory client_factory_;
   static constexpr double MAX_NO_QUERIES_TIMEOUT = 100;
+  static constexpr size_t MAX_CONNECTIONS = 3;
+  static constexpr double DEFAULT_LATENCY = 0.5;
+  static constexpr double DEFAULT_HEDGE_DELAY = 2.0;
+  static constexpr double MIN_HEDGE_DELAY = 0.05;
+  static constexpr double LATENCY_EWMA_ALPHA = 0.2;
 
   bool is_closing_{false};
   td::uint32 ref_cnt_{1};
 
-  void set_server_bad(size_t idx, bool bad) {
-    if (idx == cur_server_idx_ && servers_.size() > 1 && !cur_server_bad_force_) {
-      cur_server_bad_ = bad;
-    }
-  }
   void alarm() override {
-    client_.reset();
+    if (idle_timeout_ && idle_timeout_.is_in_past()) {
+      for (size_t i = 0; i < servers_.size(); i++) {
+        disconnect(i);
+      }
+      idle_timeout_ = td::Timestamp::never();
+    }
+    td::Timestamp next = idle_timeout_;
+    for (auto& it : queries_) {
+      auto& q = it.second;
+      if (!q.hedge_at) {
+        continue;
+      }
+      if (q.hedge_at.is_in_past()) {
+        send_duplicate(it.first, q);
+      } else {
+        next.relax(q.hedge_at);
+      }
+    }
+    alarm_timestamp() = next;
   }
   void hangup_shared() override {
     ref_cnt_--;
@@ -130,7 +441,9 @@ class ExtClientLazyImp : public ExtClientLazy {
   void hangup() override {
     is_closing_ = true;
     ref_cnt_--;
-    client_.reset();
+    for (size_t i = 0; i < servers_.size(); i++) {
+      disconnect(i);
+    }
     try_stop();
   }
   void try_stop() {
@@ -146,7 +459,9 @@ td::actor::ActorOwn<ExtClientLazy> ExtClientLazy::create(ton::adnl::AdnlNodeIdFu
 }
 
 td::actor::ActorOwn<ExtClientLazy> ExtClientLazy::create(
-    std::vector<std::pair<ton::adnl::AdnlNodeIdFull, td::IPAddress>> servers, td::unique_ptr<Callback> callback) {
-  return td::actor::create_actor<ExtClientLazyImp>("ExtClientLazy", std::move(servers), std::move(callback));
+    std::vector<std::pair<ton::adnl::AdnlNodeIdFull, td::IPAddress>> servers, td::unique_ptr<Callback> callback,
+    ClientFactory client_factory) {
+  return td::actor::create_actor<ExtClientLazyImp>("ExtClientLazy", std::move(servers), std::move(callback),
+                                                   std::move(client_factory));
 }
 }  // namespace tonlib
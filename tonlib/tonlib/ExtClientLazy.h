@@ -21,6 +21,8 @@
 
 #include "adnl/adnl-ext-client.h"
 
+#include <functional>
+
 namespace tonlib {
 class ExtClientLazy : public ton::adnl::AdnlExtClient {
  public:
@@ -32,10 +34,15 @@ class ExtClientLazy : public ton::adnl::AdnlExtClient {
 
   virtual void force_change_liteserver() = 0;
 
+  // opens a connection to one liteserver; tests replace it to run the pool without a network
+  using ClientFactory = std::function<td::actor::ActorOwn<ton::adnl::AdnlExtClient>(
+      ton::adnl::AdnlNodeIdFull, td::IPAddress, std::unique_ptr<ton::adnl::AdnlExtClient::Callback>)>;
+
   static td::actor::ActorOwn<ExtClientLazy> create(ton::adnl::AdnlNodeIdFull dst, td::IPAddress dst_addr,
                                                    td::unique_ptr<Callback> callback);
   static td::actor::ActorOwn<ExtClientLazy> create(
-      std::vector<std::pair<ton::adnl::AdnlNodeIdFull, td::IPAddress>> servers, td::unique_ptr<Callback> callback);
+      std::vector<std::pair<ton::adnl::AdnlNodeIdFull, td::IPAddress>> servers, td::unique_ptr<Callback> callback,
+      ClientFactory client_factory = {});
 };
 
 }  // namespace tonlib
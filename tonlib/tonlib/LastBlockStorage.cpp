@@ -35,27 +35,49 @@ namespace {
 std::string get_file_name(td::Slice name) {
   return td::buffer_to_hex(name) + ".blkstate";
 }
-}  // namespace
+std::string get_config_file_name(td::Slice name) {
+  return td::buffer_to_hex(name) + ".cfgproof";
+}
 
-td::Result<LastBlockState> LastBlockStorage::get_state(td::Slice name) {
-  TRY_RESULT(data, kv_->get(get_file_name(name)));
+template <class T>
+td::Result<T> load_checked(KeyValue &kv, td::Slice key) {
+  TRY_RESULT(data, kv.get(key));
   if (data.size() < 8) {
     return td::Status::Error("too short");
   }
   if (td::as<td::uint64>(data.data()) != td::crc64(td::Slice(data).substr(8))) {
     return td::Status::Error("crc64 mismatch");
   }
-  LastBlockState res;
+  T res;
   TRY_STATUS(td::unserialize(res, td::Slice(data).substr(8)));
-  return res;
+  return std::move(res);
 }
 
-void LastBlockStorage::save_state(td::Slice name, LastBlockState state) {
-  VLOG(last_block) << "Save to cache: " << state;
-  auto x = td::serialize(state);
+template <class T>
+void save_checked(KeyValue &kv, td::Slice key, const T &value) {
+  auto x = td::serialize(value);
   std::string y(x.size() + 8, 0);
   td::MutableSlice(y).substr(8).copy_from(x);
   td::as<td::uint64>(td::MutableSlice(y).data()) = td::crc64(x);
-  kv_->set(get_file_name(name), y);
+  kv.set(key, y);
+}
+}  // namespace
+
+td::Result<LastBlockState> LastBlockStorage::get_state(td::Slice name) {
+  return load_checked<LastBlockState>(*kv_, get_file_name(name));
+}
+
+void LastBlockStorage::save_state(td::Slice name, LastBlockState state) {
+  VLOG(last_block) << "Save to cache: " << state;
+  save_checked(*kv_, get_file_name(name), state);
+}
+
+td::Result<LastConfigProof> LastBlockStorage::get_config_proof(td::Slice name) {
+  return load_checked<LastConfigProof>(*kv_, get_config_file_name(name));
+}
+
+void LastBlockStorage::save_config_proof(td::Slice name, const LastConfigProof &proof) {
+  VLOG(last_config) << "Save to cache: config proof for key block " << proof.key_block_id.to_str();
+  save_checked(*kv_, get_config_file_name(name), proof);
 }
 }  // namespace tonlib
@@ -19,6 +19,7 @@
 #pragma once
 
 #include "tonlib/LastBlock.h"
+#include "tonlib/LastConfig.h"
 
 #include "tonlib/KeyValue.h"
 
@@ -28,6 +29,8 @@ class LastBlockStorage {
   void set_key_value(std::shared_ptr<KeyValue> kv);
   td::Result<LastBlockState> get_state(td::Slice name);
   void save_state(td::Slice name, LastBlockState state);
+  td::Result<LastConfigProof> get_config_proof(td::Slice name);
+  void save_config_proof(td::Slice name, const LastConfigProof &proof);
 
  private:
   std::shared_ptr<KeyValue> kv_;
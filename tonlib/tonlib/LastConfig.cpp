@@ -39,7 +39,8 @@ td::StringBuilder& operator<<(td::StringBuilder& sb, const LastConfigState& stat
   return sb;
 }
 
-LastConfig::LastConfig(ExtClientRef client, td::unique_ptr<Callback> callback) : callback_(std::move(callback)) {
+LastConfig::LastConfig(ExtClientRef client, LastConfigProof cached_proof, td::unique_ptr<Callback> callback)
+    : callback_(std::move(callback)), cached_proof_(std::move(cached_proof)) {
   client_.set_client(client);
   VLOG(last_block) << "State: " << state_;
 }
@@ -62,13 +63,47 @@ void LastConfig::with_last_block(td::Result<LastBlockState> r_last_block) {
   }
 
   auto last_block = r_last_block.move_as_ok();
+  if (try_cached_config(last_block)) {
+    return;
+  }
   client_.send_query(ton::lite_api::liteServer_getConfigAll(0, create_tl_lite_block_id(last_block.last_block_id)),
-                     [this](auto r_config) { this->on_config(std::move(r_config)); });
+                     [this, key_block_id = last_block.last_key_block_id](auto r_config) {
+                       this->on_config(key_block_id, std::move(r_config));
+                     });
+}
+
+bool LastConfig::try_cached_config(const LastBlockState& last_block) {
+  if (!cached_proof_.key_block_id.is_valid() || cached_proof_.key_block_id != last_block.last_key_block_id) {
+    return false;
+  }
+  auto status = process_config(
+      ton::fetch_tl_object<ton::lite_api::liteServer_configInfo>(td::BufferSlice(cached_proof_.config_info), true));
+  if (status.is_error()) {
+    VLOG(last_config) << "get_config: drop cached proof " << status;
+    cached_proof_ = {};
+    return false;
+  }
+  VLOG(last_config) << "get_config: done using cached proof for key block " << cached_proof_.key_block_id.to_str()
+                    << " in " << get_config_timer_;
+  on_ok();
+  get_config_state_ = QueryState::Done;
+  return true;
 }
 
-void LastConfig::on_config(td::Result<ton::ton_api::object_ptr<ton::lite_api::liteServer_configInfo>> r_config) {
+void LastConfig::on_config(ton::BlockIdExt key_block_id,
+                           td::Result<ton::ton_api::object_ptr<ton::lite_api::liteServer_configInfo>> r_config) {
+  td::BufferSlice raw_config;
+  if (r_config.is_ok()) {
+    raw_config = ton::serialize_tl_object(r_config.ok(), true);
+  }
   auto status = process_config(std::move(r_config));
   if (status.is_ok()) {
+    VLOG(last_config) << "get_config: done in " << get_config_timer_;
+    if (key_block_id.is_valid()) {
+      cached_proof_.key_block_id = key_block_id;
+      cached_proof_.config_info = raw_config.as_slice().str();
+      callback_->on_config_proof_changed(cached_proof_);
+    }
     on_ok();
     get_config_state_ = QueryState::Done;
   } else {
@@ -121,6 +156,7 @@ void LastConfig::loop() {
   if (get_config_state_ == QueryState::Empty) {
     VLOG(last_block) << "get_config: start";
     get_config_state_ = QueryState::Active;
+    get_config_timer_ = td::Timer();
     client_.with_last_block(
         [self = this](td::Result<LastBlockState> r_last_block) { self->with_last_block(std::move(r_last_block)); });
   }
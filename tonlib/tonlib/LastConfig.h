@@ -21,6 +21,7 @@
 
 #include "tonlib/Config.h"
 #include "tonlib/ExtClient.h"
+#include "tonlib/LastBlock.h"
 
 #include "td/utils/CancellationToken.h"
 #include "td/utils/tl_helpers.h"
@@ -34,21 +35,47 @@ struct LastConfigState {
 
 td::StringBuilder& operator<<(td::StringBuilder& sb, const LastConfigState& state);
 
+// Verified answer to liteServer.getConfigAll. Configuration may change only in key blocks, so the proof
+// may be reused for any masterchain block whose last key block is key_block_id.
+struct LastConfigProof {
+  ton::BlockIdExt key_block_id;
+  std::string config_info;  // serialized liteServer.configInfo
+
+  template <class StorerT>
+  void store(StorerT& storer) const {
+    using td::store;
+    using tonlib::store;
+    store(key_block_id, storer);
+    store(config_info, storer);
+  }
+
+  template <class ParserT>
+  void parse(ParserT& parser) {
+    using td::parse;
+    using tonlib::parse;
+    parse(key_block_id, parser);
+    parse(config_info, parser);
+  }
+};
+
 class LastConfig : public td::actor::Actor {
  public:
   class Callback {
    public:
     virtual ~Callback() {
     }
+    virtual void on_config_proof_changed(LastConfigProof proof) = 0;
   };
 
-  explicit LastConfig(ExtClientRef client, td::unique_ptr<Callback> callback);
+  explicit LastConfig(ExtClientRef client, LastConfigProof cached_proof, td::unique_ptr<Callback> callback);
   void get_last_config(td::Promise<LastConfigState> promise);
 
  private:
   td::unique_ptr<Callback> callback_;
   ExtClient client_;
   LastConfigState state_;
+  LastConfigProof cached_proof_;
+  td::Timer get_config_timer_;
 
   enum class QueryState { Empty, Active, Done };
   QueryState get_config_state_{QueryState::Empty};
@@ -57,7 +84,9 @@ class LastConfig : public td::actor::Actor {
   std::vector<td::int32> params_{4, 18, 20, 21, 24, 25};
 
   void with_last_block(td::Result<LastBlockState> r_last_block);
-  void on_config(td::Result<ton::ton_api::object_ptr<ton::lite_api::liteServer_configInfo>> r_config);
+  bool try_cached_config(const LastBlockState& last_block);
+  void on_config(ton::BlockIdExt key_block_id,
+                 td::Result<ton::ton_api::object_ptr<ton::lite_api::liteServer_configInfo>> r_config);
   td::Status process_config(td::Result<ton::ton_api::object_ptr<ton::lite_api::liteServer_configInfo>> r_config);
   td::Status process_config_proof(ton::ton_api::object_ptr<ton::lite_api::liteServer_configInfo> config);
 
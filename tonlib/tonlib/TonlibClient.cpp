@@ -1158,6 +1158,91 @@ class RemoteRunSmcMethod : public td::actor::Actor {
   }
 };
 
+static td::Result<RawAccountState> to_raw_account_state(ton::BlockIdExt block_id, block::AccountState::Info info) {
+  RawAccountState res;
+  res.block_id = block_id;
+  res.info = std::move(info);
+  auto cell = res.info.root;
+  //std::ostringstream outp;
+  //block::gen::t_Account.print_ref(outp, cell);
+  //LOG(INFO) << outp.str();
+  if (cell.is_null()) {
+    return res;
+  }
+  block::gen::Account::Record_account account;
+  if (!tlb::unpack_cell(cell, account)) {
+    return td::Status::Error("Failed to unpack Account");
+  }
+  {
+    block::gen::StorageInfo::Record storage_info;
+    if (!tlb::csr_unpack(account.storage_stat, storage_info)) {
+      return td::Status::Error("Failed to unpack StorageInfo");
+    }
+    res.storage_last_paid = storage_info.last_paid;
+    td::RefInt256 due_payment;
+    if (storage_info.due_payment->prefetch_ulong(1) == 1) {
+      vm::CellSlice& cs2 = storage_info.due_payment.write();
+      cs2.advance(1);
+      due_payment = block::tlb::t_Grams.as_integer_skip(cs2);
+      if (due_payment.is_null() || !cs2.empty_ext()) {
+        return td::Status::Error("Failed to upack due_payment");
+      }
+    } else {
+      due_payment = td::RefInt256{true, 0};
+    }
+    block::gen::StorageUsed::Record storage_used;
+    if (!tlb::csr_unpack(storage_info.used, storage_used)) {
+      return td::Status::Error("Failed to unpack StorageInfo");
+    }
+    unsigned long long u = 0;
+    vm::CellStorageStat storage_stat;
+    u |= storage_stat.cells = block::tlb::t_VarUInteger_7.as_uint(*storage_used.cells);
+    u |= storage_stat.bits = block::tlb::t_VarUInteger_7.as_uint(*storage_used.bits);
+    u |= storage_stat.public_cells = block::tlb::t_VarUInteger_7.as_uint(*storage_used.public_cells);
+    //LOG(DEBUG) << "last_paid=" << res.storage_last_paid << "; cells=" << storage_stat.cells
+    //<< " bits=" << storage_stat.bits << " public_cells=" << storage_stat.public_cells;
+    if (u == std::numeric_limits<td::uint64>::max()) {
+      return td::Status::Error("Failed to unpack StorageStat");
+    }
+
+    res.storage_stat = storage_stat;
+  }
+
+  block::gen::AccountStorage::Record storage;
+  if (!tlb::csr_unpack(account.storage, storage)) {
+    return td::Status::Error("Failed to unpack AccountStorage");
+  }
+  TRY_RESULT(balance, to_balance(storage.balance));
+  res.balance = balance;
+  auto state_tag = block::gen::t_AccountState.get_tag(*storage.state);
+  if (state_tag < 0) {
+    return td::Status::Error("Failed to parse AccountState tag");
+  }
+  if (state_tag == block::gen::AccountState::account_frozen) {
+    block::gen::AccountState::Record_account_frozen state;
+    if (!tlb::csr_unpack(storage.state, state)) {
+      return td::Status::Error("Failed to parse AccountState");
+    }
+    res.frozen_hash = state.state_hash.as_slice().str();
+    return res;
+  }
+  if (state_tag != block::gen::AccountState::account_active) {
+    return res;
+  }
+  block::gen::AccountState::Record_account_active state;
+  if (!tlb::csr_unpack(storage.state, state)) {
+    return td::Status::Error("Failed to parse AccountState");
+  }
+  block::gen::StateInit::Record state_init;
+  res.state = vm::CellBuilder().append_cellslice(state.x).finalize();
+  if (!tlb::csr_unpack(state.x, state_init)) {
+    return td::Status::Error("Failed to parse StateInit");
+  }
+  state_init.code->prefetch_maybe_ref(res.code);
+  state_init.data->prefetch_maybe_ref(res.data);
+  return res;
+}
+
 class GetRawAccountState : public td::actor::Actor {
  public:
   GetRawAccountState(ExtClientRef ext_client_ref, block::StdAddress address, td::optional<ton::BlockIdExt> block_id,
@@ -1194,89 +1279,107 @@ class GetRawAccountState : public td::actor::Actor {
       ton::tl_object_ptr<ton::lite_api::liteServer_accountState> raw_account_state) {
     auto account_state = create_account_state(std::move(raw_account_state));
     TRY_RESULT(info, account_state.validate(block_id_.value(), address_));
-    auto serialized_state = account_state.state.clone();
-    RawAccountState res;
-    res.block_id = block_id_.value();
-    res.info = std::move(info);
-    auto cell = res.info.root;
-    //std::ostringstream outp;
-    //block::gen::t_Account.print_ref(outp, cell);
-    //LOG(INFO) << outp.str();
-    if (cell.is_null()) {
-      return res;
-    }
-    block::gen::Account::Record_account account;
-    if (!tlb::unpack_cell(cell, account)) {
-      return td::Status::Error("Failed to unpack Account");
-    }
-    {
-      block::gen::StorageInfo::Record storage_info;
-      if (!tlb::csr_unpack(account.storage_stat, storage_info)) {
-        return td::Status::Error("Failed to unpack StorageInfo");
-      }
-      res.storage_last_paid = storage_info.last_paid;
-      td::RefInt256 due_payment;
-      if (storage_info.due_payment->prefetch_ulong(1) == 1) {
-        vm::CellSlice& cs2 = storage_info.due_payment.write();
-        cs2.advance(1);
-        due_payment = block::tlb::t_Grams.as_integer_skip(cs2);
-        if (due_payment.is_null() || !cs2.empty_ext()) {
-          return td::Status::Error("Failed to upack due_payment");
-        }
-      } else {
-        due_payment = td::RefInt256{true, 0};
-      }
-      block::gen::StorageUsed::Record storage_used;
-      if (!tlb::csr_unpack(storage_info.used, storage_used)) {
-        return td::Status::Error("Failed to unpack StorageInfo");
-      }
-      unsigned long long u = 0;
-      vm::CellStorageStat storage_stat;
-      u |= storage_stat.cells = block::tlb::t_VarUInteger_7.as_uint(*storage_used.cells);
-      u |= storage_stat.bits = block::tlb::t_VarUInteger_7.as_uint(*storage_used.bits);
-      u |= storage_stat.public_cells = block::tlb::t_VarUInteger_7.as_uint(*storage_used.public_cells);
-      //LOG(DEBUG) << "last_paid=" << res.storage_last_paid << "; cells=" << storage_stat.cells
-      //<< " bits=" << storage_stat.bits << " public_cells=" << storage_stat.public_cells;
-      if (u == std::numeric_limits<td::uint64>::max()) {
-        return td::Status::Error("Failed to unpack StorageStat");
-      }
+    return to_raw_account_state(block_id_.value(), std::move(info));
+  }
 
-      res.storage_stat = storage_stat;
-    }
+  void with_last_block(td::Result<LastBlockState> r_last_block) {
+    check(do_with_last_block(std::move(r_last_block)));
+  }
 
-    block::gen::AccountStorage::Record storage;
-    if (!tlb::csr_unpack(account.storage, storage)) {
-      return td::Status::Error("Failed to unpack AccountStorage");
-    }
-    TRY_RESULT(balance, to_balance(storage.balance));
-    res.balance = balance;
-    auto state_tag = block::gen::t_AccountState.get_tag(*storage.state);
-    if (state_tag < 0) {
-      return td::Status::Error("Failed to parse AccountState tag");
-    }
-    if (state_tag == block::gen::AccountState::account_frozen) {
-      block::gen::AccountState::Record_account_frozen state;
-      if (!tlb::csr_unpack(storage.state, state)) {
-        return td::Status::Error("Failed to parse AccountState");
-      }
-      res.frozen_hash = state.state_hash.as_slice().str();
-      return res;
+  void with_block_id() {
+    client_.send_query(
+        ton::lite_api::liteServer_getAccountState(
+            ton::create_tl_lite_block_id(block_id_.value()),
+            ton::create_tl_object<ton::lite_api::liteServer_accountId>(address_.workchain, address_.addr)),
+        [self = this](auto r_state) { self->with_account_state(std::move(r_state)); }, block_id_.value().id.seqno);
+  }
+
+  td::Status do_with_last_block(td::Result<LastBlockState> r_last_block) {
+    TRY_RESULT(last_block, std::move(r_last_block));
+    block_id_ = std::move(last_block.last_block_id);
+    with_block_id();
+    return td::Status::OK();
+  }
+
+  void start_up() override {
+    if (block_id_) {
+      with_block_id();
+    } else {
+      client_.with_last_block(
+          [self = this](td::Result<LastBlockState> r_last_block) { self->with_last_block(std::move(r_last_block)); });
     }
-    if (state_tag != block::gen::AccountState::account_active) {
-      return res;
+  }
+
+  void check(td::Status status) {
+    if (status.is_error()) {
+      promise_.set_error(std::move(status));
+      stop();
     }
-    block::gen::AccountState::Record_account_active state;
-    if (!tlb::csr_unpack(storage.state, state)) {
-      return td::Status::Error("Failed to parse AccountState");
+  }
+  void hangup() override {
+    check(TonlibError::Cancelled());
+  }
+};
+
+class GetRawAccountStates : public td::actor::Actor {
+ public:
+  GetRawAccountStates(ExtClientRef ext_client_ref, ton::WorkchainId workchain, std::vector<ton::StdSmcAddress> addrs,
+                      td::optional<ton::BlockIdExt> block_id, td::actor::ActorShared<> parent,
+                      td::Promise<std::vector<RawAccountState>>&& promise)
+      : workchain_(workchain)
+      , addrs_(std::move(addrs))
+      , block_id_(std::move(block_id))
+      , promise_(std::move(promise))
+      , parent_(std::move(parent)) {
+    client_.set_client(ext_client_ref);
+  }
+
+ private:
+  ton::WorkchainId workchain_;
+  std::vector<ton::StdSmcAddress> addrs_;
+  td::optional<ton::BlockIdExt> block_id_;
+  td::Promise<std::vector<RawAccountState>> promise_;
+  td::actor::ActorShared<> parent_;
+  ExtClient client_;
+  // states of the first accounts of addrs_, the server may answer only a part of them at once
+  std::vector<RawAccountState> states_;
+
+  std::vector<ton::StdSmcAddress> pending_addrs() const {
+    return std::vector<ton::StdSmcAddress>(addrs_.begin() + states_.size(), addrs_.end());
+  }
+
+  void with_account_states(td::Result<ton::tl_object_ptr<ton::lite_api::liteServer_accountStates>> r_account_states) {
+    check(do_with_account_states(std::move(r_account_states)));
+  }
+
+  td::Status do_with_account_states(
+      td::Result<ton::tl_object_ptr<ton::lite_api::liteServer_accountStates>> r_raw_account_states) {
+    TRY_RESULT(raw_account_states, std::move(r_raw_account_states));
+    TRY_STATUS_PREFIX(TRY_VM(do_with_account_states(std::move(raw_account_states))),
+                      TonlibError::ValidateAccountState());
+    if (states_.size() < addrs_.size()) {
+      with_block_id();
+      return td::Status::OK();
     }
-    block::gen::StateInit::Record state_init;
-    res.state = vm::CellBuilder().append_cellslice(state.x).finalize();
-    if (!tlb::csr_unpack(state.x, state_init)) {
-      return td::Status::Error("Failed to parse StateInit");
+    promise_.set_value(std::move(states_));
+    stop();
+    return td::Status::OK();
+  }
+
+  td::Status do_with_account_states(ton::tl_object_ptr<ton::lite_api::liteServer_accountStates> raw_account_states) {
+    block::AccountStateList account_states;
+    account_states.blk = ton::create_block_id(raw_account_states->id_);
+    account_states.shard_blk = ton::create_block_id(raw_account_states->shardblk_);
+    account_states.shard_proof = std::move(raw_account_states->shard_proof_);
+    account_states.proof = std::move(raw_account_states->proof_);
+    account_states.states = std::move(raw_account_states->states_);
+    account_states.count = static_cast<td::uint32>(raw_account_states->count_);
+    TRY_RESULT(infos, account_states.validate(block_id_.value(), workchain_, pending_addrs()));
+    for (auto& info : infos) {
+      TRY_RESULT(state, to_raw_account_state(block_id_.value(), std::move(info)));
+      states_.push_back(std::move(state));
     }
-    state_init.code->prefetch_maybe_ref(res.code);
-    state_init.data->prefetch_maybe_ref(res.data);
-    return res;
+    return td::Status::OK();
   }
 
   void with_last_block(td::Result<LastBlockState> r_last_block) {
@@ -1285,10 +1388,10 @@ class GetRawAccountState : public td::actor::Actor {
 
   void with_block_id() {
     client_.send_query(
-        ton::lite_api::liteServer_getAccountState(
-            ton::create_tl_lite_block_id(block_id_.value()),
-            ton::create_tl_object<ton::lite_api::liteServer_accountId>(address_.workchain, address_.addr)),
-        [self = this](auto r_state) { self->with_account_state(std::move(r_state)); }, block_id_.value().id.seqno);
+        ton::lite_api::liteServer_getAccountStates(ton::create_tl_lite_block_id(block_id_.value()), workchain_,
+                                                   pending_addrs()),
+        [self = this](auto r_states) { self->with_account_states(std::move(r_states)); },
+        block_id_.value().id.seqno);
   }
 
   td::Status do_with_last_block(td::Result<LastBlockState> r_last_block) {
@@ -1460,6 +1563,106 @@ class GetMasterchainBlockSignatures : public td::actor::Actor {
   ton::BlockIdExt last_block_;
 };
 
+class GetMasterchainBlockUpdate : public td::actor::Actor {
+ public:
+  GetMasterchainBlockUpdate(ExtClientRef ext_client_ref, ton::BlockSeqno seqno, td::actor::ActorShared<> parent,
+                            td::Promise<tonlib_api_ptr<tonlib_api::blocks_masterchainBlockUpdate>>&& promise)
+      : seqno_(seqno), parent_(std::move(parent)), promise_(std::move(promise)) {
+    client_.set_client(ext_client_ref);
+  }
+
+  void start_up() override {
+    // the query is sent with a waitMasterchainSeqno prefix, so it completes as soon as the block is applied
+    client_.send_query(
+        ton::lite_api::liteServer_getMasterchainBlockUpdate(seqno_),
+        [SelfId = actor_id(this)](td::Result<lite_api_ptr<ton::lite_api::liteServer_masterchainBlockUpdate>> R) {
+          if (R.is_error()) {
+            td::actor::send_closure(SelfId, &GetMasterchainBlockUpdate::abort, R.move_as_error());
+          } else {
+            td::actor::send_closure(SelfId, &GetMasterchainBlockUpdate::got_update, R.move_as_ok());
+          }
+        },
+        seqno_);
+  }
+
+  void got_update(lite_api_ptr<ton::lite_api::liteServer_masterchainBlockUpdate> update) {
+    block_id_ = ton::create_block_id(update->id_);
+    if (!block_id_.is_masterchain() || block_id_.seqno() != seqno_) {
+      abort(td::Status::Error("liteserver returned an update for another masterchain block"));
+      return;
+    }
+    for (const auto& id : update->shard_blocks_) {
+      shard_blocks_.push_back(ton::create_block_id(id));
+    }
+    auto S = block::check_new_shard_blocks_proof(block_id_, shard_blocks_, update->proof_.as_slice());
+    if (S.is_error()) {
+      abort(std::move(S));
+      return;
+    }
+    // the shard blocks are proven against block_id_ only, which in turn has to be linked to a trusted block
+    client_.with_last_block([SelfId = actor_id(this)](td::Result<LastBlockState> R) {
+      if (R.is_error()) {
+        td::actor::send_closure(SelfId, &GetMasterchainBlockUpdate::abort, R.move_as_error());
+      } else {
+        td::actor::send_closure(SelfId, &GetMasterchainBlockUpdate::got_last_block, R.ok().last_block_id);
+      }
+    });
+  }
+
+  void got_last_block(ton::BlockIdExt id) {
+    last_block_ = id;
+    client_.send_query(
+        ton::lite_api::liteServer_getBlockProof(0x1001, ton::create_tl_lite_block_id(last_block_),
+                                                ton::create_tl_lite_block_id(block_id_)),
+        [SelfId = actor_id(this)](td::Result<lite_api_ptr<ton::lite_api::liteServer_partialBlockProof>> R) {
+          if (R.is_error()) {
+            td::actor::send_closure(SelfId, &GetMasterchainBlockUpdate::abort, R.move_as_error());
+          } else {
+            td::actor::send_closure(SelfId, &GetMasterchainBlockUpdate::got_proof, R.move_as_ok());
+          }
+        });
+  }
+
+  void got_proof(lite_api_ptr<ton::lite_api::liteServer_partialBlockProof> proof) {
+    auto R = liteclient::deserialize_proof_chain(std::move(proof));
+    if (R.is_error()) {
+      abort(R.move_as_error());
+      return;
+    }
+    auto chain = R.move_as_ok();
+    if (chain->from != last_block_ || chain->to != block_id_ || !chain->complete) {
+      abort(td::Status::Error("got invalid proof chain"));
+      return;
+    }
+    auto S = chain->validate();
+    if (S.is_error()) {
+      abort(std::move(S));
+      return;
+    }
+    std::vector<tonlib_api_ptr<tonlib_api::ton_blockIdExt>> shards;
+    for (const auto& id : shard_blocks_) {
+      shards.push_back(to_tonlib_api(id));
+    }
+    promise_.set_result(
+        ton::create_tl_object<tonlib_api::blocks_masterchainBlockUpdate>(to_tonlib_api(block_id_), std::move(shards)));
+    stop();
+  }
+
+  void abort(td::Status error) {
+    promise_.set_error(std::move(error));
+    stop();
+  }
+
+ private:
+  ton::BlockSeqno seqno_;
+  td::actor::ActorShared<> parent_;
+  td::Promise<tonlib_api_ptr<tonlib_api::blocks_masterchainBlockUpdate>> promise_;
+  ExtClient client_;
+  ton::BlockIdExt block_id_;
+  std::vector<ton::BlockIdExt> shard_blocks_;
+  ton::BlockIdExt last_block_;
+};
+
 class GetShardBlockProof : public td::actor::Actor {
  public:
   GetShardBlockProof(ExtClientRef ext_client_ref, ton::BlockIdExt id, ton::BlockIdExt from,
@@ -1753,19 +1956,32 @@ void TonlibClient::init_last_block(LastBlockState state) {
       td::actor::ActorOptions().with_name("LastBlock").with_poll(false), get_client_ref(), std::move(state), config_,
       source_.get_cancellation_token(), td::make_unique<Callback>(td::actor::actor_shared(this), config_generation_));
 }
-void TonlibClient::init_last_config() {
+void TonlibClient::update_last_config_proof(LastConfigProof proof, td::uint32 config_generation) {
+  if (config_generation != config_generation_) {
+    return;
+  }
+
+  last_block_storage_.save_config_proof(last_state_key_, proof);
+}
+
+void TonlibClient::init_last_config(LastConfigProof cached_proof) {
   ref_cnt_++;
   class Callback : public LastConfig::Callback {
    public:
-    Callback(td::actor::ActorShared<TonlibClient> client) : client_(std::move(client)) {
+    Callback(td::actor::ActorShared<TonlibClient> client, td::uint32 config_generation)
+        : client_(std::move(client)), config_generation_(config_generation) {
+    }
+    void on_config_proof_changed(LastConfigProof proof) override {
+      send_closure(client_, &TonlibClient::update_last_config_proof, std::move(proof), config_generation_);
     }
 
    private:
     td::actor::ActorShared<TonlibClient> client_;
+    td::uint32 config_generation_;
   };
-  raw_last_config_ =
-      td::actor::create_actor<LastConfig>(td::actor::ActorOptions().with_name("LastConfig").with_poll(false),
-                                          get_client_ref(), td::make_unique<Callback>(td::actor::actor_shared(this)));
+  raw_last_config_ = td::actor::create_actor<LastConfig>(
+      td::actor::ActorOptions().with_name("LastConfig").with_poll(false), get_client_ref(), std::move(cached_proof),
+      td::make_unique<Callback>(td::actor::actor_shared(this), config_generation_));
 }
 
 void TonlibClient::on_result(td::uint64 id, tonlib_api::object_ptr<tonlib_api::Object> response) {
@@ -2442,6 +2658,12 @@ td::Result<TonlibClient::FullConfig> TonlibClient::validate_config(tonlib_api::o
   res.rwallet_init_public_key = "Puasxr0QfFZZnYISRphVse7XHKfW7pZU5SJarVHXvQ+rpzkD";
   res.last_state_key = std::move(last_state_key);
   res.last_state = std::move(state);
+  if (!config->ignore_cache_) {
+    auto r_proof = last_block_storage_.get_config_proof(res.last_state_key);
+    if (r_proof.is_ok()) {
+      res.last_config_proof = r_proof.move_as_ok();
+    }
+  }
 
   return std::move(res);
 }
@@ -2456,7 +2678,7 @@ void TonlibClient::set_config(FullConfig full_config) {
   use_callbacks_for_network_ = full_config.use_callbacks_for_network;
   init_ext_client();
   init_last_block(std::move(full_config.last_state));
-  init_last_config();
+  init_last_config(std::move(full_config.last_config_proof));
   client_.set_client(get_client_ref());
 }
 
@@ -2765,6 +2987,42 @@ td::Status TonlibClient::do_request(tonlib_api::raw_getAccountState& request,
   return td::Status::OK();
 }
 
+td::Status TonlibClient::do_request(tonlib_api::raw_getAccountStates& request,
+                                    td::Promise<object_ptr<tonlib_api::raw_fullAccountStates>>&& promise) {
+  if (request.account_addresses_.empty()) {
+    return TonlibError::EmptyField("account_addresses");
+  }
+  std::vector<block::StdAddress> addresses;
+  for (auto& account_address : request.account_addresses_) {
+    if (!account_address) {
+      return TonlibError::EmptyField("account_addresses");
+    }
+    TRY_RESULT(address, get_account_address(account_address->account_address_));
+    if (!addresses.empty() && address.workchain != addresses[0].workchain) {
+      return TonlibError::InvalidField("account_addresses", "all accounts must belong to the same workchain");
+    }
+    addresses.push_back(std::move(address));
+  }
+  std::vector<ton::StdSmcAddress> addrs;
+  for (auto& address : addresses) {
+    addrs.push_back(address.addr);
+  }
+  auto actor_id = actor_id_++;
+  actors_[actor_id] = td::actor::create_actor<GetRawAccountStates>(
+      "GetAccountStates", client_.get_client(), addresses[0].workchain, std::move(addrs),
+      query_context_.block_id.copy(), actor_shared(this, actor_id),
+      promise.wrap([addresses = std::move(addresses), wallet_id = wallet_id_](std::vector<RawAccountState>&& states)
+                       -> td::Result<object_ptr<tonlib_api::raw_fullAccountStates>> {
+        std::vector<object_ptr<tonlib_api::raw_fullAccountState>> res;
+        for (size_t i = 0; i < states.size(); i++) {
+          TRY_RESULT(state, AccountState(addresses[i], std::move(states[i]), wallet_id).to_raw_fullAccountState());
+          res.push_back(std::move(state));
+        }
+        return tonlib_api::make_object<tonlib_api::raw_fullAccountStates>(std::move(res));
+      }));
+  return td::Status::OK();
+}
+
 td::Result<KeyStorage::InputKey> from_tonlib(tonlib_api::inputKeyRegular& input_key) {
   if (!input_key.key_) {
     return TonlibError::EmptyField("key");
@@ -3853,6 +4111,8 @@ td::Result<vm::StackEntry> from_tonlib_api(tonlib_api::tvm_StackEntry& entry) {
           }));
 }
 
+static constexpr size_t max_resolved_code_libraries = 4096;
+
 void deep_library_search(std::set<td::Bits256>& set, std::set<vm::Cell::Hash>& visited,
                          vm::Dictionary& libs, td::Ref<vm::Cell> cell, int depth) {
   if (depth <= 0 || set.size() >= 16 || visited.size() >= 256) {
@@ -3939,19 +4199,40 @@ td::Status TonlibClient::do_request(const tonlib_api::smc_getLibraries& request,
 
 td::Status TonlibClient::do_request(const tonlib_api::smc_runGetMethod& request,
                                     td::Promise<object_ptr<tonlib_api::smc_runResult>>&& promise) {
-  auto it = smcs_.find(request.id_);
+  return run_get_method(request.id_, request.method_, request.stack_, false, std::move(promise));
+}
+
+td::Status TonlibClient::do_request(const tonlib_api::smc_runGetMethodV2& request,
+                                    td::Promise<object_ptr<tonlib_api::smc_runResult>>&& promise) {
+  return run_get_method(request.id_, request.method_, request.stack_, request.use_cache_, std::move(promise));
+}
+
+td::Status TonlibClient::do_request(const tonlib_api::smc_setGetMethodCacheSize& request,
+                                    td::Promise<object_ptr<tonlib_api::ok>>&& promise) {
+  if (request.max_bytes_ < 0) {
+    return TonlibError::InvalidField("max_bytes", "can't be negative");
+  }
+  run_result_cache_max_bytes_ = static_cast<size_t>(request.max_bytes_);
+  shrink_run_result_cache();
+  promise.set_value(tonlib_api::make_object<tonlib_api::ok>());
+  return td::Status::OK();
+}
+
+td::Status TonlibClient::run_get_method(td::int64 id, const object_ptr<tonlib_api::smc_MethodId>& method,
+                                        const std::vector<object_ptr<tonlib_api::tvm_StackEntry>>& stack_entries,
+                                        bool use_cache, td::Promise<object_ptr<tonlib_api::smc_runResult>>&& promise) {
+  auto it = smcs_.find(id);
   if (it == smcs_.end()) {
     return TonlibError::InvalidSmcId();
   }
 
   td::Ref<ton::SmartContract> smc(true, it->second->get_smc_state());
   ton::SmartContract::Args args;
-  downcast_call(*request.method_,
+  downcast_call(*method,
                 td::overloaded([&](tonlib_api::smc_methodIdNumber& number) { args.set_method_id(number.number_); },
                                [&](tonlib_api::smc_methodIdName& name) { args.set_method_id(name.name_); }));
   td::Ref<vm::Stack> stack(true);
-  td::Status status;
-  for (auto& entry : request.stack_) {
+  for (auto& entry : stack_entries) {
     TRY_RESULT(e, from_tonlib_api(*entry));
     stack.write().push(std::move(e));
   }
@@ -3960,13 +4241,13 @@ td::Status TonlibClient::do_request(const tonlib_api::smc_runGetMethod& request,
   args.set_now(it->second->get_sync_time());
   args.set_address(it->second->get_address());
 
-  client_.with_last_config([self = this, smc = std::move(smc), args = std::move(args), promise = std::move(promise)
-  ](td::Result<LastConfigState> r_state) mutable {
+  client_.with_last_config([self = this, smc = std::move(smc), args = std::move(args), use_cache,
+                            promise = std::move(promise)](td::Result<LastConfigState> r_state) mutable {
     TRY_RESULT_PROMISE(promise, state, std::move(r_state));
     args.set_config(state.config);
 
     auto code = smc->get_state().code;
-    if (code.not_null()) {
+    if (code.not_null() && !self->resolved_code_libraries_.count(code->get_hash())) {
       std::set<td::Bits256> librarySet;
       std::set<vm::Cell::Hash> visited;
       deep_library_search(librarySet, visited, self->libraries, code, 24);
@@ -3974,7 +4255,7 @@ td::Status TonlibClient::do_request(const tonlib_api::smc_runGetMethod& request,
       if (libraryList.size() > 0) {
         LOG(DEBUG) << "Requesting found libraries in code (" << libraryList.size() << ")";
         self->client_.send_query(ton::lite_api::liteServer_getLibraries(std::move(libraryList)),
-                    [self, smc = std::move(smc), args = std::move(args), promise = std::move(promise)]
+                    [self, smc = std::move(smc), args = std::move(args), use_cache, promise = std::move(promise)]
                     (td::Result<ton::lite_api::object_ptr<ton::lite_api::liteServer_libraryResult>> r_libraries) mutable
         {
           if (r_libraries.is_error()) {
@@ -4000,25 +4281,138 @@ td::Status TonlibClient::do_request(const tonlib_api::smc_runGetMethod& request,
               self->store_libs_to_disk();
             }
           }
-          self->perform_smc_execution(std::move(smc), std::move(args), std::move(promise));
+          self->perform_smc_execution(std::move(smc), std::move(args), use_cache, std::move(promise));
         });
       }
       else {
-        self->perform_smc_execution(std::move(smc), std::move(args), std::move(promise));
+        // libraries are never removed, so there is no need to traverse this code again
+        if (self->resolved_code_libraries_.size() >= max_resolved_code_libraries) {
+          self->resolved_code_libraries_.clear();
+        }
+        self->resolved_code_libraries_.insert(code->get_hash());
+        self->perform_smc_execution(std::move(smc), std::move(args), use_cache, std::move(promise));
       }
     }
     else {
-      self->perform_smc_execution(std::move(smc), std::move(args), std::move(promise));
+      self->perform_smc_execution(std::move(smc), std::move(args), use_cache, std::move(promise));
     }
   });
   return td::Status::OK();
 }
 
+td::Result<td::Bits256> get_method_cache_key(const ton::SmartContract& smc, const ton::SmartContract::Args& args) {
+  if (!args.method_id || !args.stack || !args.address || !args.config) {
+    return td::Status::Error("incomplete get-method arguments");
+  }
+  vm::FakeVmStateLimits fstate(1000);  // limit recursive serialization calls
+  vm::VmStateInterface::Guard guard(&fstate);
+  vm::CellBuilder cb;
+  td::Ref<vm::Cell> stack_cell;
+  if (!(args.stack.value()->serialize(cb) && cb.finalize_to(stack_cell))) {
+    return td::Status::Error("cannot serialize get-method stack");
+  }
+  auto config_root = args.config.value()->get_root_cell();
+  auto& state = smc.get_state();
+
+  td::Sha256State sha;
+  sha.init();
+  auto feed_cell_hash = [&](const td::Ref<vm::Cell>& cell) {
+    sha.feed(cell.is_null() ? td::Bits256::zero().as_slice() : cell->get_hash().as_slice());
+  };
+  feed_cell_hash(state.code);
+  feed_cell_hash(state.data);
+  feed_cell_hash(stack_cell);
+  feed_cell_hash(config_root);
+  // c7 fields used by prepare_vm_c7 except unixtime, so that a result can be reused after the account is
+  // synced again without changes; rand_seed is always zero for get-methods
+  td::int64 ints[] = {args.method_id.value(), static_cast<td::int64>(args.balance), args.address.value().workchain};
+  for (auto x : ints) {
+    char buf[8];
+    td::as<td::int64>(buf) = x;
+    sha.feed(td::Slice(buf, 8));
+  }
+  sha.feed(args.address.value().addr.as_slice());
+  td::Bits256 key;
+  sha.extract(key.as_slice());
+  return key;
+}
+
+TonlibClient::CachedRunResult* TonlibClient::get_cached_run_result(const td::Bits256& key) {
+  auto it = run_result_cache_.find(key);
+  if (it == run_result_cache_.end()) {
+    return nullptr;
+  }
+  it->second->remove();
+  run_result_lru_.put(it->second.get());
+  return it->second.get();
+}
+
+td::Result<size_t> estimate_stack_size(const vm::Stack& stack) {
+  vm::FakeVmStateLimits fstate(1000);  // limit recursive serialization calls
+  vm::VmStateInterface::Guard guard(&fstate);
+  vm::CellBuilder cb;
+  td::Ref<vm::Cell> stack_cell;
+  if (!(stack.serialize(cb) && cb.finalize_to(stack_cell))) {
+    return td::Status::Error("cannot serialize get-method result stack");
+  }
+  vm::CellStorageStat stat;
+  stat.compute_used_storage(stack_cell);
+  return static_cast<size_t>(stat.bits / 8 + stat.cells * sizeof(vm::DataCell));
+}
+
+void TonlibClient::add_cached_run_result(const td::Bits256& key, const ton::SmartContract::Answer& res) {
+  if (run_result_cache_max_bytes_ == 0 || res.stack.is_null() || run_result_cache_.count(key)) {
+    return;
+  }
+  auto r_size = estimate_stack_size(*res.stack);
+  if (r_size.is_error()) {
+    LOG(DEBUG) << "get-method result will not be cached: " << r_size.error();
+    return;
+  }
+  auto size = sizeof(CachedRunResult) + r_size.ok();
+  if (size > run_result_cache_max_bytes_) {
+    return;
+  }
+  auto entry = std::make_unique<CachedRunResult>(key, res.gas_used, res.stack, res.code, size);
+  run_result_lru_.put(entry.get());
+  run_result_cache_bytes_ += size;
+  run_result_cache_[key] = std::move(entry);
+  shrink_run_result_cache();
+}
+
+void TonlibClient::shrink_run_result_cache() {
+  while (run_result_cache_bytes_ > run_result_cache_max_bytes_) {
+    auto entry = CachedRunResult::from_list_node(run_result_lru_.get());
+    run_result_cache_bytes_ -= entry->size;
+    run_result_cache_.erase(entry->key);
+  }
+}
+
 void TonlibClient::perform_smc_execution(td::Ref<ton::SmartContract> smc, ton::SmartContract::Args args,
-                                         td::Promise<object_ptr<tonlib_api::smc_runResult>>&& promise) {
+                                         bool use_cache, td::Promise<object_ptr<tonlib_api::smc_runResult>>&& promise) {
 
   args.set_libraries(libraries);
 
+  td::optional<td::Bits256> cache_key;
+  if (use_cache && run_result_cache_max_bytes_ > 0) {
+    auto r_key = get_method_cache_key(*smc, args);
+    if (r_key.is_ok()) {
+      cache_key = r_key.move_as_ok();
+      auto cached = get_cached_run_result(cache_key.value());
+      if (cached) {
+        std::vector<object_ptr<tonlib_api::tvm_StackEntry>> res_stack;
+        for (auto& entry : cached->stack->as_span()) {
+          res_stack.push_back(to_tonlib_api(entry));
+        }
+        promise.set_value(
+            tonlib_api::make_object<tonlib_api::smc_runResult>(cached->gas_used, std::move(res_stack), cached->exit_code));
+        return;
+      }
+    } else {
+      LOG(DEBUG) << "get-method result will not be cached: " << r_key.error();
+    }
+  }
+
   auto res = smc->run_get_method(args);
 
   // smc.runResult gas_used:int53 stack:vector<tvm.StackEntry> exit_code:int32 = smc.RunResult;
@@ -4033,7 +4427,7 @@ void TonlibClient::perform_smc_execution(td::Ref<ton::SmartContract> smc, ton::S
     std::vector<td::Bits256> req = {std::move(hash)};
     client_.send_query(ton::lite_api::liteServer_getLibraries(std::move(req)),
                 [self = this, res = std::move(res), res_stack = std::move(res_stack), hash = std::move(hash),
-                 smc = std::move(smc), args = std::move(args), promise = std::move(promise)]
+                 smc = std::move(smc), args = std::move(args), use_cache, promise = std::move(promise)]
                 (td::Result<ton::lite_api::object_ptr<ton::lite_api::liteServer_libraryResult>> r_libraries) mutable
     {
       if (r_libraries.is_error()) {
@@ -4065,11 +4459,14 @@ void TonlibClient::perform_smc_execution(td::Ref<ton::SmartContract> smc, ton::S
         LOG(WARNING) << "cannot obtain library " << hash.to_hex() << ", it may not exist";
         promise.set_value(tonlib_api::make_object<tonlib_api::smc_runResult>(res.gas_used, std::move(res_stack), res.code));
       } else {
-        self->perform_smc_execution(std::move(smc), std::move(args), std::move(promise));
+        self->perform_smc_execution(std::move(smc), std::move(args), use_cache, std::move(promise));
       }
     });
   }
   else {
+    if (cache_key) {
+      add_cached_run_result(cache_key.value(), res);
+    }
     promise.set_value(tonlib_api::make_object<tonlib_api::smc_runResult>(res.gas_used, std::move(res_stack), res.code));
   }
 }
@@ -4713,6 +5110,17 @@ td::Status TonlibClient::do_request(const tonlib_api::blocks_getShards& request,
   return td::Status::OK();
 }
 
+td::Status TonlibClient::do_request(const tonlib_api::blocks_getMasterchainBlockUpdate& request,
+                                    td::Promise<object_ptr<tonlib_api::blocks_masterchainBlockUpdate>>&& promise) {
+  if (request.seqno_ < 0) {
+    return TonlibError::InvalidField("seqno", "can't be negative");
+  }
+  auto actor_id = actor_id_++;
+  actors_[actor_id] = td::actor::create_actor<GetMasterchainBlockUpdate>(
+      "GetMasterchainBlockUpdate", client_.get_client(), request.seqno_, actor_shared(this, actor_id),
+      std::move(promise));
+  return td::Status::OK();
+}
 
 td::Status TonlibClient::do_request(const tonlib_api::blocks_lookupBlock& request,
                         td::Promise<object_ptr<tonlib_api::ton_blockIdExt>>&& promise) {
@@ -30,11 +30,13 @@
 #include "td/actor/actor.h"
 
 #include "td/utils/CancellationToken.h"
+#include "td/utils/List.h"
 #include "td/utils/optional.h"
 
 #include "smc-envelope/ManualDns.h"
 
 #include <map>
+#include <set>
 
 namespace tonlib {
 namespace int_api {
@@ -72,6 +74,7 @@ class TonlibClient : public td::actor::Actor {
     Config config;
     bool use_callbacks_for_network;
     LastBlockState last_state;
+    LastConfigProof last_config_proof;
     std::string last_state_key;
     td::uint32 wallet_id;
     std::string rwallet_init_public_key;
@@ -108,6 +111,29 @@ class TonlibClient : public td::actor::Actor {
   };
   QueryContext query_context_;
   vm::Dictionary libraries{256};
+  // code cells whose library references are all present in `libraries`
+  std::set<vm::Cell::Hash> resolved_code_libraries_;
+
+  // get-method results, keyed by hash of code, data, method arguments and c7 fields except unixtime
+  class CachedRunResult : public td::ListNode {
+   public:
+    CachedRunResult(td::Bits256 key, td::int64 gas_used, td::Ref<vm::Stack> stack, td::int32 exit_code, size_t size)
+        : key(key), gas_used(gas_used), stack(std::move(stack)), exit_code(exit_code), size(size) {
+    }
+    static CachedRunResult* from_list_node(td::ListNode* node) {
+      return static_cast<CachedRunResult*>(node);
+    }
+    td::Bits256 key;
+    td::int64 gas_used;
+    td::Ref<vm::Stack> stack;
+    td::int32 exit_code;
+    size_t size;
+  };
+  static constexpr size_t default_run_result_cache_bytes = 16 << 20;
+  size_t run_result_cache_max_bytes_{default_run_result_cache_bytes};
+  size_t run_result_cache_bytes_{0};
+  td::ListNode run_result_lru_;
+  std::map<td::Bits256, std::unique_ptr<CachedRunResult>> run_result_cache_;
 
   // network
   td::actor::ActorOwn<ExtClientLazy> raw_client_;
@@ -124,7 +150,7 @@ class TonlibClient : public td::actor::Actor {
   ExtClientRef get_client_ref();
   void init_ext_client();
   void init_last_block(LastBlockState state);
-  void init_last_config();
+  void init_last_config(LastConfigProof cached_proof);
 
   bool is_closing_{false};
   td::uint32 ref_cnt_{1};
@@ -145,6 +171,7 @@ class TonlibClient : public td::actor::Actor {
   }
 
   void update_last_block_state(LastBlockState state, td::uint32 config_generation_);
+  void update_last_config_proof(LastConfigProof proof, td::uint32 config_generation_);
   void update_sync_state(LastBlockSyncState state, td::uint32 config_generation);
   void on_result(td::uint64 id, object_ptr<tonlib_api::Object> response);
   void on_update(object_ptr<tonlib_api::Object> response);
@@ -234,6 +261,8 @@ class TonlibClient : public td::actor::Actor {
 
   td::Status do_request(tonlib_api::raw_getAccountState& request,
                         td::Promise<object_ptr<tonlib_api::raw_fullAccountState>>&& promise);
+  td::Status do_request(tonlib_api::raw_getAccountStates& request,
+                        td::Promise<object_ptr<tonlib_api::raw_fullAccountStates>>&& promise);
   td::Status do_request(tonlib_api::raw_getTransactions& request,
                         td::Promise<object_ptr<tonlib_api::raw_transactions>>&& promise);
   td::Status do_request(tonlib_api::raw_getTransactionsV2& request,
@@ -315,6 +344,13 @@ class TonlibClient : public td::actor::Actor {
 
   td::Status do_request(const tonlib_api::smc_runGetMethod& request,
                         td::Promise<object_ptr<tonlib_api::smc_runResult>>&& promise);
+  td::Status do_request(const tonlib_api::smc_runGetMethodV2& request,
+                        td::Promise<object_ptr<tonlib_api::smc_runResult>>&& promise);
+  td::Status do_request(const tonlib_api::smc_setGetMethodCacheSize& request,
+                        td::Promise<object_ptr<tonlib_api::ok>>&& promise);
+  td::Status run_get_method(td::int64 id, const object_ptr<tonlib_api::smc_MethodId>& method,
+                            const std::vector<object_ptr<tonlib_api::tvm_StackEntry>>& stack, bool use_cache,
+                            td::Promise<object_ptr<tonlib_api::smc_runResult>>&& promise);
 
   td::Status do_request(const tonlib_api::smc_getLibraries& request,
                         td::Promise<object_ptr<tonlib_api::smc_libraryResult>>&& promise);
@@ -330,8 +366,11 @@ class TonlibClient : public td::actor::Actor {
   td::Status do_request(tonlib_api::pchan_unpackPromise& request,
                         td::Promise<object_ptr<tonlib_api::pchan_promise>>&& promise);
 
-  void perform_smc_execution(td::Ref<ton::SmartContract> smc, ton::SmartContract::Args args,
+  void perform_smc_execution(td::Ref<ton::SmartContract> smc, ton::SmartContract::Args args, bool use_cache,
                              td::Promise<object_ptr<tonlib_api::smc_runResult>>&& promise);
+  CachedRunResult* get_cached_run_result(const td::Bits256& key);
+  void add_cached_run_result(const td::Bits256& key, const ton::SmartContract::Answer& res);
+  void shrink_run_result_cache();
 
   void do_dns_request(std::string name, td::Bits256 category, td::int32 ttl, td::optional<ton::BlockIdExt> block_id,
                       block::StdAddress address, td::Promise<object_ptr<tonlib_api::dns_resolved>>&& promise);
@@ -359,6 +398,8 @@ class TonlibClient : public td::actor::Actor {
                         td::Promise<object_ptr<tonlib_api::blocks_masterchainInfo>>&& promise);
   td::Status do_request(const tonlib_api::blocks_getShards& request,
                         td::Promise<object_ptr<tonlib_api::blocks_shards>>&& promise);
+  td::Status do_request(const tonlib_api::blocks_getMasterchainBlockUpdate& request,
+                        td::Promise<object_ptr<tonlib_api::blocks_masterchainBlockUpdate>>&& promise);
   td::Status do_request(const tonlib_api::blocks_lookupBlock& block_header,
                         td::Promise<object_ptr<tonlib_api::ton_blockIdExt>>&& promise);
   td::Status do_request(const tonlib_api::blocks_getTransactions& block_data,
@@ -117,6 +117,29 @@ td::Result<std::pair<std::string, td::BufferSlice>> Package::read(td::uint64 off
   return std::pair<std::string, td::BufferSlice>{std::move(fname), std::move(data)};
 }
 
+td::Result<std::string> Package::read_filename(td::uint64 offset) const {
+  offset += header_size();
+
+  td::uint32 header[2];
+  TRY_RESULT(s1, fd_.pread(td::MutableSlice(reinterpret_cast<td::uint8*>(header), 8), offset));
+  if (s1 != 8) {
+    return td::Status::Error(ErrorCode::notready, "too short read");
+  }
+  if ((header[0] & 0xffff) != entry_header_magic()) {
+    return td::Status::Error(ErrorCode::notready,
+                             PSTRING() << "bad entry magic " << (header[0] & 0xffff) << " offset=" << offset);
+  }
+  offset += 8;
+  auto fname_size = header[0] >> 16;
+
+  std::string fname(fname_size, '\0');
+  TRY_RESULT(s2, fd_.pread(fname, offset));
+  if (s2 != fname_size) {
+    return td::Status::Error(ErrorCode::notready, "too short read (filename)");
+  }
+  return std::move(fname);
+}
+
 td::Result<td::uint64> Package::advance(td::uint64 offset) {
   offset += header_size();
 
@@ -195,6 +218,34 @@ void Package::iterate(std::function<bool(std::string, td::BufferSlice, td::uint6
   }
 }
 
+void Package::iterate_filenames(std::function<bool(std::string, td::uint64)> func) {
+  td::uint64 p = 0;
+
+  td::uint64 size = fd_.get_size().move_as_ok();
+  if (size < header_size()) {
+    LOG(ERROR) << "too short archive";
+    return;
+  }
+  size -= header_size();
+  while (p != size) {
+    auto R = read_filename(p);
+    if (R.is_error()) {
+      LOG(ERROR) << "broken archive: " << R.move_as_error();
+      return;
+    }
+    if (!func(R.move_as_ok(), p)) {
+      break;
+    }
+
+    auto N = advance(p);
+    if (N.is_error()) {
+      LOG(ERROR) << "broken archive: " << N.move_as_error();
+      return;
+    }
+    p = N.move_as_ok();
+  }
+}
+
 Package::~Package() {
   fd_.close();
 }
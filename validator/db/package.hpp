@@ -38,9 +38,12 @@ class Package {
   void sync();
   td::uint64 size() const;
   td::Result<std::pair<std::string, td::BufferSlice>> read(td::uint64 offset) const;
+  td::Result<std::string> read_filename(td::uint64 offset) const;
 
   td::Result<td::uint64> advance(td::uint64 offset);
   void iterate(std::function<bool(std::string, td::BufferSlice, td::uint64)> func);
+  // same as iterate, but does not read entry data
+  void iterate_filenames(std::function<bool(std::string, td::uint64)> func);
 
   td::FileFd &fd() {
     return fd_;
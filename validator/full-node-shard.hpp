@@ -152,8 +152,9 @@ class FullNodeShardImpl : public FullNodeShard {
                       td::Promise<ReceivedBlock> promise) override;
   void download_zero_state(BlockIdExt id, td::uint32 priority, td::Timestamp timeout,
                            td::Promise<td::BufferSlice> promise) override;
-  void download_persistent_state(BlockIdExt id, BlockIdExt masterchain_block_id, td::uint32 priority,
-                                 td::Timestamp timeout, td::Promise<td::BufferSlice> promise) override;
+  void download_persistent_state(BlockIdExt id, BlockIdExt masterchain_block_id, std::string tmp_dir,
+                                 td::uint32 priority, td::Timestamp timeout,
+                                 td::Promise<td::BufferSlice> promise) override;
 
   void download_block_proof(BlockIdExt block_id, td::uint32 priority, td::Timestamp timeout,
                             td::Promise<td::BufferSlice> promise) override;
@@ -215,6 +215,8 @@ class Collator final : public td::actor::Actor {
   std::unique_ptr<block::Account> make_account_from(td::ConstBitPtr addr, Ref<vm::CellSlice> account,
                                                     Ref<vm::CellSlice> extra, bool force_create = false);
   td::Result<block::Account*> make_account(td::ConstBitPtr addr, bool force_create = false);
+  void prefetch_accounts(td::Span<ton::StdSmcAddress> addrs);
+  void prefetch_neighbor_queues();
   td::actor::ActorId<Collator> get_self() {
     return actor_id(this);
   }
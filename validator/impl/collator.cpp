@@ -20,6 +20,7 @@
 #include "vm/boc.h"
 #include "td/db/utils/BlobView.h"
 #include "vm/db/StaticBagOfCellsDb.h"
+#include "vm/db/DynamicBagOfCellsDb.h"
 #include "block/mc-config.h"
 #include "block/block.h"
 #include "block/block-parse.h"
@@ -1578,69 +1579,35 @@ td::Result<std::unique_ptr<block::ConfigInfo>> Collator::impl_fetch_config_param
     block::ActionPhaseConfig* action_phase_cfg, td::RefInt256* masterchain_create_fee,
     td::RefInt256* basechain_create_fee, WorkchainId wc) {
   *old_mparams = config->get_config_param(9);
-  {
-    auto res = config->get_storage_prices();
-    if (res.is_error()) {
-      return res.move_as_error();
-    }
-    *storage_prices = res.move_as_ok();
-  }
+  // prices and limits are unpacked once per configuration and shared with other collators and validators
+  TRY_RESULT(parsed, config->get_parsed_config());
+  *storage_prices = parsed->storage_prices;
   {
     // generate rand seed
     prng::rand_gen().strong_rand_bytes(rand_seed->data(), 32);
     LOG(DEBUG) << "block random seed set to " << rand_seed->to_hex();
   }
-  TRY_RESULT(size_limits, config->get_size_limits_config());
   {
     // compute compute_phase_cfg / storage_phase_cfg
-    auto cell = config->get_config_param(wc == ton::masterchainId ? 20 : 21);
-    if (cell.is_null()) {
-      return td::Status::Error(-668, "cannot fetch current gas prices and limits from masterchain configuration");
-    }
-    if (!compute_phase_cfg->parse_GasLimitsPrices(std::move(cell), storage_phase_cfg->freeze_due_limit,
-                                                  storage_phase_cfg->delete_due_limit)) {
-      return td::Status::Error(-668, "cannot unpack current gas prices and limits from masterchain configuration");
-    }
+    auto& gas = parsed->get_gas_limits_prices(wc == ton::masterchainId);
+    compute_phase_cfg->set_gas_limits_prices(gas);
+    storage_phase_cfg->freeze_due_limit = td::make_refint(gas.freeze_due_limit);
+    storage_phase_cfg->delete_due_limit = td::make_refint(gas.delete_due_limit);
     compute_phase_cfg->block_rand_seed = *rand_seed;
     compute_phase_cfg->libraries = std::make_unique<vm::Dictionary>(config->get_libraries_root(), 256);
-    compute_phase_cfg->max_vm_data_depth = size_limits.max_vm_data_depth;
+    compute_phase_cfg->max_vm_data_depth = parsed->size_limits.max_vm_data_depth;
     compute_phase_cfg->global_config = config->get_root_cell();
   }
   {
     // compute action_phase_cfg
-    block::gen::MsgForwardPrices::Record rec;
-    auto cell = config->get_config_param(24);
-    if (cell.is_null() || !tlb::unpack_cell(std::move(cell), rec)) {
-      return td::Status::Error(-668, "cannot fetch masterchain message transfer prices from masterchain configuration");
-    }
-    action_phase_cfg->fwd_mc =
-        block::MsgPrices{rec.lump_price,           rec.bit_price,          rec.cell_price, rec.ihr_price_factor,
-                         (unsigned)rec.first_frac, (unsigned)rec.next_frac};
-    cell = config->get_config_param(25);
-    if (cell.is_null() || !tlb::unpack_cell(std::move(cell), rec)) {
-      return td::Status::Error(-668, "cannot fetch standard message transfer prices from masterchain configuration");
-    }
-    action_phase_cfg->fwd_std =
-        block::MsgPrices{rec.lump_price,           rec.bit_price,          rec.cell_price, rec.ihr_price_factor,
-                         (unsigned)rec.first_frac, (unsigned)rec.next_frac};
-    action_phase_cfg->workchains = &config->get_workchain_list();
+    action_phase_cfg->fwd_mc = parsed->fwd_mc;
+    action_phase_cfg->fwd_std = parsed->fwd_std;
+    action_phase_cfg->workchains = &parsed->workchains;
     action_phase_cfg->bounce_msg_body = (config->has_capability(ton::capBounceMsgBody) ? 256 : 0);
-    action_phase_cfg->size_limits = size_limits;
-  }
-  {
-    // fetch block_grams_created
-    auto cell = config->get_config_param(14);
-    if (cell.is_null()) {
-      *basechain_create_fee = *masterchain_create_fee = td::zero_refint();
-    } else {
-      block::gen::BlockCreateFees::Record create_fees;
-      if (!(tlb::unpack_cell(cell, create_fees) &&
-            block::tlb::t_Grams.as_integer_to(create_fees.masterchain_block_fee, *masterchain_create_fee) &&
-            block::tlb::t_Grams.as_integer_to(create_fees.basechain_block_fee, *basechain_create_fee))) {
-        return td::Status::Error(-668, "cannot unpack BlockCreateFees from configuration parameter #14");
-      }
-    }
+    action_phase_cfg->size_limits = parsed->size_limits;
   }
+  *masterchain_create_fee = parsed->masterchain_create_fee;
+  *basechain_create_fee = parsed->basechain_create_fee;
   return std::move(config);
 }
 
@@ -1729,6 +1696,10 @@ bool Collator::do_collate() {
   alarm_timestamp() = td::Timestamp::never();
 
   LOG(DEBUG) << "do_collate() : start";
+  // dictionaries are updated one key at a time and most of the intermediate cells are discarded,
+  // so hashes are computed only for the cells that are still needed
+  vm::DataCell::LazyHashing lazy_hashing;
+  auto total_hashes = vm::DataCell::get_thread_hashes();
   if (!fetch_config_params()) {
     return fatal_error("cannot fetch required configuration parameters from masterchain state");
   }
@@ -1750,6 +1721,7 @@ bool Collator::do_collate() {
   }
   // 1.3. create OutputQueueMerger from adjusted neighbors
   CHECK(!nb_out_msgs_);
+  prefetch_neighbor_queues();
   LOG(DEBUG) << "creating OutputQueueMerger";
   nb_out_msgs_ = std::make_unique<block::OutputQueueMerger>(shard_, neighbors_);
   // 1.4. compute created / minted / recovered
@@ -1844,6 +1816,7 @@ bool Collator::do_collate() {
   if (!create_block_candidate()) {
     return fatal_error("cannot serialize a new Block candidate");
   }
+  LOG(DEBUG) << "cell hashes computed by the collator thread: " << vm::DataCell::get_thread_hashes() - total_hashes;
   return true;
 }
 
@@ -1963,6 +1936,36 @@ block::Account* Collator::lookup_account(td::ConstBitPtr addr) const {
   return found != accounts.end() ? found->second.get() : nullptr;
 }
 
+// Loads the entries of the accounts in the previous state together with the top levels of their trees (code and data
+// roots), the loads of one level running in parallel, so that transactions do not wait for each of them in turn.
+void Collator::prefetch_accounts(td::Span<ton::StdSmcAddress> addrs) {
+  std::vector<td::ConstBitPtr> keys;
+  for (const auto& addr : addrs) {
+    if (!lookup_account(addr.cbits())) {
+      keys.push_back(addr.cbits());
+    }
+  }
+  auto dict_root = account_dict->get_root_cell();
+  vm::CellDbReader::prefetch_dict(dict_root, 256, keys, 256, 4);
+}
+
+// OutputQueueMerger descends from the roots of the neighbors' queues to the subdictionaries of messages for our shard
+// and then to the messages with the least lt; the paths and the top levels of these subdictionaries are loaded for all
+// neighbors at once.
+void Collator::prefetch_neighbor_queues() {
+  std::vector<Ref<vm::Cell>> roots;
+  for (const auto& nb : neighbors_) {
+    if (!nb.is_disabled() && nb.outmsg_root.not_null()) {
+      roots.push_back(nb.outmsg_root);
+    }
+  }
+  td::BitArray<96> prefix;
+  prefix.bits().store_int(shard_.workchain, 32);
+  td::bitstring::bits_store_long_top(prefix.bits() + 32, shard_.shard, shard_.pfx_len());
+  td::ConstBitPtr key = prefix.cbits();
+  vm::CellDbReader::prefetch_dict(roots, 352, key, 32 + shard_.pfx_len(), 8);
+}
+
 td::Result<block::Account*> Collator::make_account(td::ConstBitPtr addr, bool force_create) {
   auto found = lookup_account(addr);
   if (found) {
@@ -1992,6 +1995,8 @@ td::Result<block::Account*> Collator::make_account(td::ConstBitPtr addr, bool fo
 
 bool Collator::combine_account_transactions() {
   vm::AugmentedDictionary dict{256, block::tlb::aug_ShardAccountBlocks};
+  // accounts are sorted by address, so both dictionaries are updated in a single batch each
+  std::vector<vm::DictionaryFixed::BatchUpdate> account_blocks, account_updates;
   for (auto& z : accounts) {
     block::Account& acc = *(z.second);
     CHECK(acc.addr == z.first);
@@ -2020,10 +2025,7 @@ bool Collator::combine_account_transactions() {
         return fatal_error(std::string{"new AccountBlock for "} + z.first.to_hex() +
                            " failed to pass handwritten validation tests");
       }
-      if (!dict.set(z.first, csr, vm::Dictionary::SetMode::Add)) {
-        return fatal_error(std::string{"new AccountBlock for "} + z.first.to_hex() +
-                           " could not be added to ShardAccountBlocks");
-      }
+      account_blocks.push_back({z.first.cbits(), std::move(csr), vm::Dictionary::SetMode::Add});
       // update account_dict
       if (acc.total_state->get_hash() != acc.orig_total_state->get_hash()) {
         // account changed
@@ -2031,35 +2033,33 @@ bool Collator::combine_account_transactions() {
           // account created
           CHECK(acc.status != block::Account::acc_nonexist);
           vm::CellBuilder cb;
-          if (!(cb.store_ref_bool(acc.total_state)             // account_descr$_ account:^Account
-                && cb.store_bits_bool(acc.last_trans_hash_)    // last_trans_hash:bits256
-                && cb.store_long_bool(acc.last_trans_lt_, 64)  // last_trans_lt:uint64
-                && account_dict->set_builder(acc.addr, cb, vm::Dictionary::SetMode::Add))) {
-            return fatal_error(std::string{"cannot add newly-created account "} + acc.addr.to_hex() +
-                               " into ShardAccounts");
+          if (!(cb.store_ref_bool(acc.total_state)              // account_descr$_ account:^Account
+                && cb.store_bits_bool(acc.last_trans_hash_)     // last_trans_hash:bits256
+                && cb.store_long_bool(acc.last_trans_lt_, 64))) {  // last_trans_lt:uint64
+            return fatal_error(std::string{"cannot serialize newly-created account "} + acc.addr.to_hex());
           }
+          account_updates.push_back(
+              {z.first.cbits(), vm::load_cell_slice_ref(cb.finalize()), vm::Dictionary::SetMode::Add});
         } else if (acc.status == block::Account::acc_nonexist) {
           // account deleted
           if (verbosity > 2) {
             std::cerr << "deleting account " << acc.addr.to_hex() << " with empty new value ";
             block::gen::t_Account.print_ref(std::cerr, acc.total_state);
           }
-          if (account_dict->lookup_delete(acc.addr).is_null()) {
-            return fatal_error(std::string{"cannot delete account "} + acc.addr.to_hex() + " from ShardAccounts");
-          }
+          account_updates.push_back({z.first.cbits(), {}});
         } else {
           // existing account modified
           if (verbosity > 4) {
             std::cerr << "modifying account " << acc.addr.to_hex() << " to ";
             block::gen::t_Account.print_ref(std::cerr, acc.total_state);
           }
-          if (!(cb.store_ref_bool(acc.total_state)             // account_descr$_ account:^Account
-                && cb.store_bits_bool(acc.last_trans_hash_)    // last_trans_hash:bits256
-                && cb.store_long_bool(acc.last_trans_lt_, 64)  // last_trans_lt:uint64
-                && account_dict->set_builder(acc.addr, cb, vm::Dictionary::SetMode::Replace))) {
-            return fatal_error(std::string{"cannot modify existing account "} + acc.addr.to_hex() +
-                               " in ShardAccounts");
+          if (!(cb.store_ref_bool(acc.total_state)              // account_descr$_ account:^Account
+                && cb.store_bits_bool(acc.last_trans_hash_)     // last_trans_hash:bits256
+                && cb.store_long_bool(acc.last_trans_lt_, 64))) {  // last_trans_lt:uint64
+            return fatal_error(std::string{"cannot serialize modified account "} + acc.addr.to_hex());
           }
+          account_updates.push_back(
+              {z.first.cbits(), vm::load_cell_slice_ref(cb.finalize()), vm::Dictionary::SetMode::Replace});
         }
       }
     } else {
@@ -2069,6 +2069,16 @@ bool Collator::combine_account_transactions() {
       }
     }
   }
+  // InMsgDescr, OutMsgDescr and OutMsgQueue are not updated in batches: they change one message at a time while
+  // transactions are processed, and their current roots are used meanwhile for the block limits and collated data
+  // (see insert_in_msg() and register_out_msg_queue_op())
+  if (dict.apply_batch(account_blocks) != (int)account_blocks.size()) {
+    return fatal_error("new AccountBlocks could not be added to ShardAccountBlocks");
+  }
+  // every update must take effect: accounts are created with Add, modified with Replace and deleted only if present
+  if (account_dict->apply_batch(account_updates) != (int)account_updates.size()) {
+    return fatal_error("cannot apply account changes to ShardAccounts");
+  }
   vm::CellBuilder cb;
   if (!(cb.append_cellslice_bool(std::move(dict).extract_root()) && cb.finalize_to(shard_account_blocks_))) {
     return fatal_error("cannot serialize ShardAccountBlocks");
@@ -2777,7 +2787,7 @@ bool Collator::process_inbound_internal_messages() {
       LOG(WARNING) << "soft timeout reached, stop processing inbound internal messages";
       break;
     }
-    auto kv = nb_out_msgs_->extract_cur();
+    auto kv = nb_out_msgs_->cur();
     CHECK(kv && kv->msg.not_null());
     LOG(DEBUG) << "processing inbound message with (lt,hash)=(" << kv->lt << "," << kv->key.to_hex()
                << ") from neighbor #" << kv->source;
@@ -2805,6 +2815,18 @@ bool Collator::process_inbound_external_messages() {
     return true;
   }
   bool full = !block_limit_status_->fits(block::ParamLimits::cl_soft);
+  std::vector<ton::StdSmcAddress> dests;
+  for (auto& ext_msg_pair : ext_msg_list_) {
+    auto cs = load_cell_slice(ext_msg_pair.first);
+    block::gen::CommonMsgInfo::Record_ext_in_msg_info info;
+    ton::WorkchainId wc;
+    ton::StdSmcAddress addr;
+    if (tlb::unpack(cs, info) && is_our_address(info.dest) &&
+        block::tlb::t_MsgAddressInt.extract_std_address(info.dest, wc, addr)) {
+      dests.push_back(addr);
+    }
+  }
+  prefetch_accounts(dests);
   for (auto& ext_msg_pair : ext_msg_list_) {
     if (full) {
       LOG(INFO) << "BLOCK FULL, stop processing external messages";
@@ -26,7 +26,9 @@
 #include "fabric.h"
 #include "td/actor/actor.h"
 #include "td/utils/Random.h"
+#include "td/utils/port/thread.h"
 #include "crypto/openssl/rand.hpp"
+#include "common/worker-pool.h"
 
 namespace ton {
 
@@ -86,78 +88,35 @@ td::Result<Ref<ExtMessageQ>> ExtMessageQ::create_ext_message(td::BufferSlice dat
   return Ref<ExtMessageQ>{true, std::move(data), std::move(ext_msg), dest_prefix, wc, addr};
 }
 
-void ExtMessageQ::run_message(td::BufferSlice data, block::SizeLimitsConfig::ExtMsgLimits limits,
-                              td::actor::ActorId<ton::validator::ValidatorManager> manager,
-                              td::Promise<td::Ref<ExtMessage>> promise) {
-  auto R = create_ext_message(std::move(data), limits);
-  if (R.is_error()) {
-    return promise.set_error(R.move_as_error_prefix("failed to parse external message "));
+td::Result<std::unique_ptr<ExtMessageQ::RunConfig>> ExtMessageQ::prepare_run_config(td::Ref<vm::Cell> mc_root,
+                                                                                   ton::WorkchainId wc) {
+  TRY_RESULT(config, block::ConfigInfo::extract_config(
+                         std::move(mc_root), block::ConfigInfo::needLibraries | block::ConfigInfo::needCapabilities));
+  auto res = std::make_unique<RunConfig>();
+  Ref<vm::Cell> old_mparams;
+  td::BitArray<256> rand_seed;
+  td::RefInt256 masterchain_create_fee, basechain_create_fee;
+  auto fetch_res = Collator::impl_fetch_config_params(std::move(config), &old_mparams, &res->storage_prices,
+                                                      &res->storage_phase_cfg, &rand_seed, &res->compute_phase_cfg,
+                                                      &res->action_phase_cfg, &masterchain_create_fee,
+                                                      &basechain_create_fee, wc);
+  if (fetch_res.is_error()) {
+    auto error = fetch_res.move_as_error();
+    LOG(DEBUG) << "Cannot fetch config params: " << error.message();
+    return error.move_as_error_prefix("Cannot fetch config params: ");
   }
-  auto M = R.move_as_ok();
-  auto root = M->root_cell();
-  block::gen::CommonMsgInfo::Record_ext_in_msg_info info;
-  tlb::unpack_cell_inexact(root, info);  // checked in create message
-  ton::StdSmcAddress addr = M->addr();
-  ton::WorkchainId wc = M->wc();
-
-  run_fetch_account_state(
-      wc, addr, manager,
-      [promise = std::move(promise), msg_root = root, wc,
-       M](td::Result<std::tuple<td::Ref<vm::CellSlice>, UnixTime, LogicalTime, std::unique_ptr<block::ConfigInfo>>>
-              res) mutable {
-        if (res.is_error()) {
-          promise.set_error(td::Status::Error(PSLICE() << "Failed to get account state"));
-        } else {
-          auto tuple = res.move_as_ok();
-          block::Account acc;
-          auto shard_acc = std::move(std::get<0>(tuple));
-          auto utime = std::get<1>(tuple);
-          auto lt = std::get<2>(tuple);
-          auto config = std::move(std::get<3>(tuple));
-          if (!acc.unpack(shard_acc, {}, utime, false)) {
-            promise.set_error(td::Status::Error(PSLICE() << "Failed to unpack account state"));
-          } else {
-            auto status = run_message_on_account(wc, &acc, utime, lt + 1, msg_root, std::move(config));
-            if (status.is_ok()) {
-              promise.set_value(std::move(M));
-            } else {
-              promise.set_error(td::Status::Error(PSLICE() << "External message was not accepted\n"
-                                                           << status.message()));
-            }
-          }
-        }
-      });
+  res->config = fetch_res.move_as_ok();
+  res->compute_phase_cfg.with_vm_log = true;
+  return std::move(res);
 }
 
-td::Status ExtMessageQ::run_message_on_account(ton::WorkchainId wc,
-                                               block::Account* acc,
+td::Status ExtMessageQ::run_message_on_account(block::Account* acc,
                                                UnixTime utime, LogicalTime lt,
                                                td::Ref<vm::Cell> msg_root,
-                                               std::unique_ptr<block::ConfigInfo> config) {
-
-   Ref<vm::Cell> old_mparams;
-   std::vector<block::StoragePrices> storage_prices_;
-   block::StoragePhaseConfig storage_phase_cfg_{&storage_prices_};
-   td::BitArray<256> rand_seed_;
-   block::ComputePhaseConfig compute_phase_cfg_;
-   block::ActionPhaseConfig action_phase_cfg_;
-   td::RefInt256 masterchain_create_fee, basechain_create_fee;
-
-   auto fetch_res = Collator::impl_fetch_config_params(std::move(config), &old_mparams,
-                                                 &storage_prices_, &storage_phase_cfg_,
-                                                 &rand_seed_, &compute_phase_cfg_,
-                                                 &action_phase_cfg_, &masterchain_create_fee,
-                                                 &basechain_create_fee, wc);
-   if(fetch_res.is_error()) {
-     auto error = fetch_res.move_as_error();
-     LOG(DEBUG) << "Cannot fetch config params: " << error.message();
-     return error.move_as_error_prefix("Cannot fetch config params: ");
-   }
-   compute_phase_cfg_.with_vm_log = true;
-
+                                               RunConfig& config) {
    auto res = Collator::impl_create_ordinary_transaction(msg_root, acc, utime, lt,
-                                                    &storage_phase_cfg_, &compute_phase_cfg_,
-                                                    &action_phase_cfg_,
+                                                    &config.storage_phase_cfg, &config.compute_phase_cfg,
+                                                    &config.action_phase_cfg,
                                                     true, lt);
    if(res.is_error()) {
      auto error = res.move_as_error();
@@ -174,5 +133,349 @@ td::Status ExtMessageQ::run_message_on_account(ton::WorkchainId wc,
    return td::Status::OK();
 }
 
+namespace {
+
+// runs a job on its own actor, so that the checker keeps accepting messages while it runs, and reports the result
+template <class T, class F>
+class ExtMessageJob : public td::actor::Actor {
+ public:
+  ExtMessageJob(F job, td::Promise<T> promise) : job_(std::move(job)), promise_(std::move(promise)) {
+  }
+  void start_up() override {
+    promise_.set_value(job_());
+    stop();
+  }
+
+ private:
+  F job_;
+  td::Promise<T> promise_;
+};
+
+template <class T, class F>
+void run_job(F job, td::Promise<T> promise) {
+  td::actor::create_actor<ExtMessageJob<T, F>>("extmsgjob", std::move(job), std::move(promise)).release();
+}
+
+}  // namespace
+
+void ExtMessageCheckerImpl::check_external_message(td::BufferSlice data, block::SizeLimitsConfig::ExtMsgLimits limits,
+                                                   td::Promise<td::Ref<ExtMessage>> promise) {
+  auto hash = block::compute_file_hash(data);
+  if (snapshot_expires_ && !snapshot_expires_.is_in_past()) {
+    auto it = results_.find(hash);
+    if (it != results_.end()) {
+      if (it->second.is_error()) {
+        promise.set_error(it->second.clone());
+        return;
+      }
+      // the message was accepted, only the message itself has to be created again
+      auto R = ExtMessageQ::create_ext_message(std::move(data), limits);
+      if (R.is_error()) {
+        promise.set_error(R.move_as_error_prefix("failed to parse external message "));
+      } else {
+        promise.set_value(R.move_as_ok());
+      }
+      return;
+    }
+  }
+  auto& promises = pending_[hash];
+  promises.push_back(std::move(promise));
+  if (promises.size() > 1) {
+    // the same message is being checked already
+    return;
+  }
+  queue_.push_back(Queued{hash, std::move(data), limits});
+  if (!snapshot_requested_) {
+    request_snapshot();
+  }
+}
+
+void ExtMessageCheckerImpl::request_snapshot() {
+  snapshot_requested_ = true;
+  td::actor::send_closure(
+      manager_, &ValidatorManager::get_last_liteserver_state_block,
+      [SelfId = actor_id(this)](td::Result<std::pair<td::Ref<MasterchainState>, BlockIdExt>> R) {
+        if (R.is_error()) {
+          td::actor::send_closure(SelfId, &ExtMessageCheckerImpl::failed_snapshot, R.move_as_error());
+        } else {
+          auto res = R.move_as_ok();
+          td::actor::send_closure(SelfId, &ExtMessageCheckerImpl::got_snapshot, std::move(res.first), res.second);
+        }
+      });
+}
+
+void ExtMessageCheckerImpl::failed_snapshot(td::Status error) {
+  snapshot_requested_ = false;
+  auto queue = std::move(queue_);
+  queue_.clear();
+  for (auto& queued : queue) {
+    finish(queued.hash, Result{{}, error.clone()}, false);
+  }
+}
+
+void ExtMessageCheckerImpl::got_snapshot(td::Ref<MasterchainState> mc_state, BlockIdExt blkid) {
+  snapshot_requested_ = false;
+  if (blkid != mc_blkid_) {
+    mc_state_ = std::move(mc_state);
+    mc_blkid_ = blkid;
+    shard_states_.clear();
+    clear_results();
+  }
+  snapshot_expires_ = td::Timestamp::in(snapshot_ttl());
+  check_batch();
+}
+
+void ExtMessageCheckerImpl::check_batch() {
+  // a long queue is checked in several batches, each against a snapshot that is still fresh
+  std::vector<Queued> queue;
+  while (!queue_.empty() && queue.size() < max_batch_size()) {
+    queue.push_back(std::move(queue_.front()));
+    queue_.pop_front();
+  }
+  if (!queue_.empty()) {
+    snapshot_requested_ = true;
+    td::actor::send_closure_later(actor_id(this), &ExtMessageCheckerImpl::next_batch);
+  }
+  std::vector<ExtMessage::Hash> hashes;
+  hashes.reserve(queue.size());
+  for (auto& queued : queue) {
+    hashes.push_back(queued.hash);
+  }
+  using Parsed = std::vector<td::Result<td::Ref<ExtMessageQ>>>;
+  run_job<Parsed>(
+      [queue = std::move(queue)]() mutable {
+        Parsed parsed(queue.size());
+        td::WorkerPool::get().run(queue.size(), td::thread::hardware_concurrency(), [&](size_t i) {
+          parsed[i] = ExtMessageQ::create_ext_message(std::move(queue[i].data), queue[i].limits);
+        });
+        return parsed;
+      },
+      [SelfId = actor_id(this), mc_state = mc_state_, hashes = std::move(hashes)](td::Result<Parsed> R) mutable {
+        td::actor::send_closure(SelfId, &ExtMessageCheckerImpl::got_parsed, std::move(mc_state), std::move(hashes),
+                                std::move(R));
+      });
+}
+
+void ExtMessageCheckerImpl::got_parsed(td::Ref<MasterchainState> mc_state, std::vector<ExtMessage::Hash> hashes,
+                                       td::Result<std::vector<td::Result<td::Ref<ExtMessageQ>>>> R) {
+  if (R.is_error()) {
+    for (auto& hash : hashes) {
+      finish(hash, Result{{}, R.error().clone()}, false);
+    }
+    return;
+  }
+  auto parsed = R.move_as_ok();
+  auto mc_blkid = mc_state->get_block_id();
+  std::map<BlockIdExt, std::vector<td::Ref<ExtMessageQ>>> ready;
+  for (size_t i = 0; i < parsed.size(); i++) {
+    if (parsed[i].is_error()) {
+      finish(hashes[i], Result{{}, parsed[i].move_as_error_prefix("failed to parse external message ")},
+             is_current(mc_state));
+      continue;
+    }
+    auto M = parsed[i].move_as_ok();
+    BlockIdExt state_blkid = mc_blkid;
+    if (M->wc() != masterchainId) {
+      auto shard = mc_state->get_shard_from_config(extract_addr_prefix(M->wc(), M->addr()).as_leaf_shard());
+      if (shard.is_null()) {
+        finish(M->hash(), Result{{}, td::Status::Error(PSLICE() << "Failed to get account state")}, false);
+        continue;
+      }
+      state_blkid = shard->top_block_id();
+    }
+    if (state_blkid == mc_blkid || shard_states_.count(state_blkid)) {
+      ready[state_blkid].push_back(std::move(M));
+      continue;
+    }
+    auto& waiting = waiting_for_state_[state_blkid];
+    waiting.push_back(Waiting{mc_state, std::move(M)});
+    if (waiting.size() == 1) {
+      td::actor::send_closure(manager_, &ValidatorManager::get_shard_state_from_db_short, state_blkid,
+                              [SelfId = actor_id(this), state_blkid](td::Result<td::Ref<ShardState>> R) {
+                                td::actor::send_closure(SelfId, &ExtMessageCheckerImpl::got_shard_state, state_blkid,
+                                                        std::move(R));
+                              });
+    }
+  }
+  for (auto& p : ready) {
+    auto state = p.first == mc_blkid ? td::Ref<ShardState>{mc_state} : shard_states_[p.first];
+    run_checks(mc_state, std::move(state), std::move(p.second));
+  }
+}
+
+void ExtMessageCheckerImpl::next_batch() {
+  snapshot_requested_ = false;
+  if (snapshot_expires_ && !snapshot_expires_.is_in_past()) {
+    check_batch();
+  } else {
+    request_snapshot();
+  }
+}
+
+void ExtMessageCheckerImpl::got_shard_state(BlockIdExt blkid, td::Result<td::Ref<ShardState>> R) {
+  auto waiting = std::move(waiting_for_state_[blkid]);
+  waiting_for_state_.erase(blkid);
+  if (R.is_error()) {
+    LOG(DEBUG) << "cannot load state of " << blkid.to_str() << " to check external messages: " << R.error();
+    for (auto& w : waiting) {
+      finish(w.message->hash(), Result{{}, td::Status::Error(PSLICE() << "Failed to get account state")}, false);
+    }
+    return;
+  }
+  auto state = R.move_as_ok();
+  auto shard = mc_state_->get_shard_from_config(state->get_shard());
+  if (shard.not_null() && shard->top_block_id() == blkid) {
+    // a newer snapshot may have been taken while the state was loading, keep only states it refers to
+    shard_states_[blkid] = state;
+  }
+  // the messages may come from batches taken with different snapshots, each is checked against its own
+  std::map<BlockIdExt, std::pair<td::Ref<MasterchainState>, std::vector<td::Ref<ExtMessageQ>>>> by_snapshot;
+  for (auto& w : waiting) {
+    auto& p = by_snapshot[w.mc_state->get_block_id()];
+    p.first = std::move(w.mc_state);
+    p.second.push_back(std::move(w.message));
+  }
+  for (auto& p : by_snapshot) {
+    run_checks(std::move(p.second.first), state, std::move(p.second.second));
+  }
+}
+
+void ExtMessageCheckerImpl::run_checks(td::Ref<MasterchainState> mc_state, td::Ref<ShardState> state,
+                                       std::vector<td::Ref<ExtMessageQ>> messages) {
+  auto job = [mc_root = mc_state->root_cell(), state_root = state->root_cell(), utime = state->get_unix_time(),
+              lt = state->get_logical_time(), messages]() {
+    Checked checked;
+    checked.statuses.resize(messages.size());
+    checked.transient.resize(messages.size(), 0);
+    // all messages are to accounts of the same shard, so of the same workchain
+    auto r_config = ExtMessageQ::prepare_run_config(mc_root, messages[0]->wc());
+    if (r_config.is_error()) {
+      for (size_t i = 0; i < messages.size(); i++) {
+        checked.statuses[i] = r_config.error().clone().move_as_error_prefix("Failed to get account state: ");
+        checked.transient[i] = 1;
+      }
+      return checked;
+    }
+    auto config = r_config.move_as_ok();
+    std::map<std::pair<WorkchainId, StdSmcAddress>, std::vector<size_t>> by_account;
+    for (size_t i = 0; i < messages.size(); i++) {
+      by_account[std::make_pair(messages[i]->wc(), messages[i]->addr())].push_back(i);
+    }
+    std::vector<std::vector<size_t>*> accounts;
+    for (auto& p : by_account) {
+      accounts.push_back(&p.second);
+    }
+    auto& statuses = checked.statuses;
+    auto& transient = checked.transient;
+    td::WorkerPool::get().run(accounts.size(), td::thread::hardware_concurrency(), [&](size_t i) {
+      auto& indices = *accounts[i];
+      try {
+        block::gen::ShardStateUnsplit::Record sstate;
+        if (!tlb::unpack_cell(state_root, sstate)) {
+          for (size_t idx : indices) {
+            statuses[idx] = td::Status::Error(PSLICE() << "Failed to get account state");
+            transient[idx] = 1;
+          }
+          return;
+        }
+        vm::AugmentedDictionary accounts_dict{vm::load_cell_slice_ref(sstate.accounts), 256,
+                                              block::tlb::aug_ShardAccounts};
+        auto shard_acc = accounts_dict.lookup(messages[indices[0]]->addr());
+        for (size_t idx : indices) {
+          auto& M = messages[idx];
+          block::Account acc;
+          if (!acc.unpack(shard_acc, {}, utime, false)) {
+            statuses[idx] = td::Status::Error(PSLICE() << "Failed to unpack account state");
+            continue;
+          }
+          auto status = ExtMessageQ::run_message_on_account(&acc, utime, lt + 1, M->root_cell(), *config);
+          if (status.is_error()) {
+            statuses[idx] = td::Status::Error(PSLICE() << "External message was not accepted\n" << status.message());
+          }
+        }
+      } catch (vm::VmError& err) {
+        for (size_t idx : indices) {
+          statuses[idx] = td::Status::Error(PSLICE() << "Failed to get account state: " << err.get_msg());
+          transient[idx] = 1;
+        }
+      } catch (vm::VmVirtError& err) {
+        for (size_t idx : indices) {
+          statuses[idx] = td::Status::Error(PSLICE() << "Failed to get account state: " << err.get_msg());
+          transient[idx] = 1;
+        }
+      }
+    });
+    return checked;
+  };
+  run_job<Checked>(std::move(job), [SelfId = actor_id(this), mc_state = std::move(mc_state),
+                                    messages = std::move(messages)](td::Result<Checked> R) mutable {
+    td::actor::send_closure(SelfId, &ExtMessageCheckerImpl::got_checks, std::move(mc_state), std::move(messages),
+                            std::move(R));
+  });
+}
+
+void ExtMessageCheckerImpl::got_checks(td::Ref<MasterchainState> mc_state, std::vector<td::Ref<ExtMessageQ>> messages,
+                                       td::Result<Checked> R) {
+  if (R.is_error()) {
+    for (auto& M : messages) {
+      finish(M->hash(), Result{{}, R.error().clone()}, false);
+    }
+    return;
+  }
+  auto checked = R.move_as_ok();
+  // results checked against an older snapshot are not cached: the cache belongs to the current one
+  bool cache = is_current(mc_state);
+  for (size_t i = 0; i < messages.size(); i++) {
+    auto hash = messages[i]->hash();
+    if (checked.statuses[i].is_error()) {
+      finish(hash, Result{{}, std::move(checked.statuses[i])}, cache && !checked.transient[i]);
+    } else {
+      finish(hash, Result{std::move(messages[i]), td::Status::OK()}, cache);
+    }
+  }
+}
+
+void ExtMessageCheckerImpl::finish(const ExtMessage::Hash& hash, Result result, bool cache) {
+  auto it = pending_.find(hash);
+  if (it != pending_.end()) {
+    for (auto& promise : it->second) {
+      reply(result, std::move(promise));
+    }
+    pending_.erase(it);
+  }
+  if (!cache || results_.count(hash)) {
+    return;
+  }
+  size_t size = cached_result_size(result.error);
+  while (!results_order_.empty() && results_size_ + size > max_cached_results_size()) {
+    auto old = results_.find(results_order_.front());
+    results_size_ -= cached_result_size(old->second);
+    results_.erase(old);
+    results_order_.pop_front();
+  }
+  results_.emplace(hash, std::move(result.error));
+  results_order_.push_back(hash);
+  results_size_ += size;
+}
+
+void ExtMessageCheckerImpl::clear_results() {
+  results_.clear();
+  results_order_.clear();
+  results_size_ = 0;
+}
+
+size_t ExtMessageCheckerImpl::cached_result_size(const td::Status& status) {
+  // the map node and the queue entry take about the same as two hashes
+  return 3 * sizeof(ExtMessage::Hash) + (status.is_error() ? status.message().size() : 0);
+}
+
+void ExtMessageCheckerImpl::reply(const Result& result, td::Promise<td::Ref<ExtMessage>> promise) {
+  if (result.error.is_error()) {
+    promise.set_error(result.error.clone());
+  } else {
+    promise.set_value(result.message);
+  }
+}
+
 }  // namespace validator
 }  // namespace ton
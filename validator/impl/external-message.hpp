@@ -24,6 +24,9 @@
 #include "adnl/utils.hpp"
 #include "block/transaction.h"
 
+#include <deque>
+#include <map>
+
 namespace ton {
 
 namespace validator {
@@ -61,14 +64,100 @@ class ExtMessageQ : public ExtMessage {
               ton::StdSmcAddress addr);
   static td::Result<td::Ref<ExtMessageQ>> create_ext_message(td::BufferSlice data,
                                                              block::SizeLimitsConfig::ExtMsgLimits limits);
-  static void run_message(td::BufferSlice data, block::SizeLimitsConfig::ExtMsgLimits limits,
-                          td::actor::ActorId<ton::validator::ValidatorManager> manager,
-                          td::Promise<td::Ref<ExtMessage>> promise);
-  static td::Status run_message_on_account(ton::WorkchainId wc,
-                                           block::Account* acc,
+
+  // transaction parameters taken from the configuration; prepared once per batch and only read by the checks
+  struct RunConfig {
+    std::unique_ptr<block::ConfigInfo> config;
+    std::vector<block::StoragePrices> storage_prices;
+    block::StoragePhaseConfig storage_phase_cfg{&storage_prices};
+    block::ComputePhaseConfig compute_phase_cfg;
+    block::ActionPhaseConfig action_phase_cfg;
+  };
+  static td::Result<std::unique_ptr<RunConfig>> prepare_run_config(td::Ref<vm::Cell> mc_root, ton::WorkchainId wc);
+  static td::Status run_message_on_account(block::Account* acc,
                                            UnixTime utime, LogicalTime lt,
                                            td::Ref<vm::Cell> msg_root,
-                                           std::unique_ptr<block::ConfigInfo> config);
+                                           RunConfig& config);
+};
+
+// Checks external messages in batches against a snapshot of the last masterchain state and the shard states it
+// refers to. The snapshot is refreshed once per batch instead of once per message, and each batch is checked against
+// the snapshot it was taken with. Messages are parsed and run on the worker pool by short-lived job actors, so the
+// checker keeps accepting messages meanwhile; messages to the same account share one account lookup, and identical
+// messages are checked once: later copies wait for the pending check or get the cached result while the snapshot is
+// still current. Only the outcome of a check is cached, and only if it does not depend on loading the states.
+class ExtMessageCheckerImpl : public ExtMessageChecker {
+ public:
+  explicit ExtMessageCheckerImpl(td::actor::ActorId<ValidatorManager> manager) : manager_(std::move(manager)) {
+  }
+  void check_external_message(td::BufferSlice data, block::SizeLimitsConfig::ExtMsgLimits limits,
+                              td::Promise<td::Ref<ExtMessage>> promise) override;
+
+  static constexpr double snapshot_ttl() {
+    return 1.0;
+  }
+  // approximate total size of the cached results in bytes
+  static constexpr size_t max_cached_results_size() {
+    return 8 << 20;
+  }
+  // at most this many messages are checked at once, the rest wait for the next batch
+  static constexpr size_t max_batch_size() {
+    return 4096;
+  }
+
+ private:
+  struct Queued {
+    ExtMessage::Hash hash;
+    td::BufferSlice data;
+    block::SizeLimitsConfig::ExtMsgLimits limits;
+  };
+  struct Result {
+    td::Ref<ExtMessageQ> message;
+    td::Status error;
+  };
+  struct Waiting {
+    td::Ref<MasterchainState> mc_state;
+    td::Ref<ExtMessageQ> message;
+  };
+  struct Checked {
+    std::vector<td::Status> statuses;
+    // errors of loading the states are not cached
+    std::vector<char> transient;
+  };
+
+  td::actor::ActorId<ValidatorManager> manager_;
+  td::Ref<MasterchainState> mc_state_;
+  BlockIdExt mc_blkid_;
+  td::Timestamp snapshot_expires_;
+  bool snapshot_requested_{false};
+  std::map<BlockIdExt, td::Ref<ShardState>> shard_states_;
+  std::map<BlockIdExt, std::vector<Waiting>> waiting_for_state_;
+  std::deque<Queued> queue_;
+  std::map<ExtMessage::Hash, std::vector<td::Promise<td::Ref<ExtMessage>>>> pending_;
+  // OK if the message was accepted, the error otherwise
+  std::map<ExtMessage::Hash, td::Status> results_;
+  std::deque<ExtMessage::Hash> results_order_;
+  size_t results_size_{0};
+
+  void request_snapshot();
+  void got_snapshot(td::Ref<MasterchainState> mc_state, BlockIdExt blkid);
+  void failed_snapshot(td::Status error);
+  void check_batch();
+  void next_batch();
+  void got_parsed(td::Ref<MasterchainState> mc_state, std::vector<ExtMessage::Hash> hashes,
+                  td::Result<std::vector<td::Result<td::Ref<ExtMessageQ>>>> R);
+  void got_shard_state(BlockIdExt blkid, td::Result<td::Ref<ShardState>> R);
+  void run_checks(td::Ref<MasterchainState> mc_state, td::Ref<ShardState> state,
+                  std::vector<td::Ref<ExtMessageQ>> messages);
+  void got_checks(td::Ref<MasterchainState> mc_state, std::vector<td::Ref<ExtMessageQ>> messages,
+                  td::Result<Checked> R);
+  bool is_current(const td::Ref<MasterchainState>& mc_state) const {
+    return mc_state.get() == mc_state_.get();
+  }
+  void finish(const ExtMessage::Hash& hash, Result result, bool cache = true);
+  void clear_results();
+  static size_t cached_result_size(const td::Status& status);
+  static void reply(const Result& result, td::Promise<td::Ref<ExtMessage>> promise);
 };
 
 }  // namespace validator
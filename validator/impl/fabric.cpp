@@ -48,6 +48,10 @@ td::actor::ActorOwn<LiteServerCache> create_liteserver_cache_actor(td::actor::Ac
   return td::actor::create_actor<LiteServerCache>("cache");
 }
 
+td::actor::ActorOwn<ExtMessageChecker> create_ext_message_checker_actor(td::actor::ActorId<ValidatorManager> manager) {
+  return td::actor::create_actor<ExtMessageCheckerImpl>("extmsgchecker", manager);
+}
+
 td::Result<td::Ref<BlockData>> create_block(BlockIdExt block_id, td::BufferSlice data) {
   auto res = BlockQ::create(block_id, std::move(data));
   if (res.is_error()) {
@@ -117,12 +121,6 @@ td::Result<td::Ref<ExtMessage>> create_ext_message(td::BufferSlice data,
   return std::move(res);
 }
 
-void run_check_external_message(td::BufferSlice data, block::SizeLimitsConfig::ExtMsgLimits limits,
-                                td::actor::ActorId<ValidatorManager> manager,
-                                td::Promise<td::Ref<ExtMessage>> promise) {
-  ExtMessageQ::run_message(std::move(data), limits, std::move(manager), std::move(promise));
-}
-
 td::Result<td::Ref<IhrMessage>> create_ihr_message(td::BufferSlice data) {
   TRY_RESULT(res, IhrMessageQ::create_ihr_message(std::move(data)));
   return std::move(res);
@@ -244,11 +242,6 @@ void run_liteserver_query(td::BufferSlice data, td::actor::ActorId<ValidatorMana
   LiteQuery::run_query(std::move(data), std::move(manager), std::move(promise));
 }
 
-void run_fetch_account_state(WorkchainId wc, StdSmcAddress  addr, td::actor::ActorId<ValidatorManager> manager,
-                             td::Promise<std::tuple<td::Ref<vm::CellSlice>,UnixTime,LogicalTime,std::unique_ptr<block::ConfigInfo>>> promise) {
-  LiteQuery::fetch_account_state(wc, addr, std::move(manager), std::move(promise));
-}
-
 void run_validate_shard_block_description(td::BufferSlice data, BlockHandle masterchain_block,
                                           td::Ref<MasterchainState> masterchain_state,
                                           td::actor::ActorId<ValidatorManager> manager, td::Timestamp timeout,
@@ -35,6 +35,7 @@
 #include "block/check-proof.h"
 #include "vm/dict.h"
 #include "vm/cells/MerkleProof.h"
+#include "vm/db/DynamicBagOfCellsDb.h"
 #include "vm/vm.h"
 #include "vm/memo.h"
 #include "shard.hpp"
@@ -58,28 +59,15 @@ void LiteQuery::run_query(td::BufferSlice data, td::actor::ActorId<ValidatorMana
   td::actor::create_actor<LiteQuery>("litequery", std::move(data), std::move(manager), std::move(promise)).release();
 }
 
-void LiteQuery::fetch_account_state(WorkchainId wc, StdSmcAddress  acc_addr, td::actor::ActorId<ton::validator::ValidatorManager> manager,
-                                 td::Promise<std::tuple<td::Ref<vm::CellSlice>,UnixTime,LogicalTime,std::unique_ptr<block::ConfigInfo>>> promise) {
-  td::actor::create_actor<LiteQuery>("litequery", wc, acc_addr, std::move(manager), std::move(promise)).release();
-}
-
 LiteQuery::LiteQuery(td::BufferSlice data, td::actor::ActorId<ValidatorManager> manager,
                      td::Promise<td::BufferSlice> promise)
     : query_(std::move(data)), manager_(std::move(manager)), promise_(std::move(promise)) {
   timeout_ = td::Timestamp::in(default_timeout_msec * 0.001);
 }
 
-LiteQuery::LiteQuery(WorkchainId wc, StdSmcAddress  acc_addr, td::actor::ActorId<ValidatorManager> manager,
-                     td::Promise<std::tuple<td::Ref<vm::CellSlice>,UnixTime,LogicalTime,std::unique_ptr<block::ConfigInfo>>> promise)
-    : manager_(std::move(manager)), acc_state_promise_(std::move(promise)), acc_workchain_(wc), acc_addr_(acc_addr) {
-  timeout_ = td::Timestamp::in(default_timeout_msec * 0.001);
-}
-
 void LiteQuery::abort_query(td::Status reason) {
   LOG(INFO) << "aborted liteserver query: " << reason.to_string();
-  if (acc_state_promise_) {
-    acc_state_promise_.set_error(std::move(reason));
-  } else if (promise_) {
+  if (promise_) {
     promise_.set_error(std::move(reason));
   }
   stop();
@@ -124,11 +112,6 @@ bool LiteQuery::finish_query(td::BufferSlice result) {
 void LiteQuery::start_up() {
   alarm_timestamp() = timeout_;
 
-  if(acc_state_promise_) {
-    td::actor::send_closure_later(actor_id(this),&LiteQuery::perform_fetchAccountState);
-    return;
-  }
-
   auto F = fetch_tl_object<ton::lite_api::Function>(std::move(query_), true);
   if (F.is_error()) {
     abort_query(F.move_as_error());
@@ -157,6 +140,10 @@ void LiteQuery::start_up() {
             this->perform_getAccountState(ton::create_block_id(q.id_), static_cast<WorkchainId>(q.account_->workchain_),
                                           q.account_->id_, 0x40000000);
           },
+          [&](lite_api::liteServer_getAccountStates& q) {
+            this->perform_getAccountStates(ton::create_block_id(q.id_), static_cast<WorkchainId>(q.workchain_),
+                                           std::move(q.accounts_));
+          },
           [&](lite_api::liteServer_getOneTransaction& q) {
             this->perform_getOneTransaction(ton::create_block_id(q.id_),
                                             static_cast<WorkchainId>(q.account_->workchain_), q.account_->id_,
@@ -174,6 +161,9 @@ void LiteQuery::start_up() {
           [&](lite_api::liteServer_getAllShardsInfo& q) {
             this->perform_getAllShardsInfo(ton::create_block_id(q.id_));
           },
+          [&](lite_api::liteServer_getMasterchainBlockUpdate& q) {
+            this->perform_getMasterchainBlockUpdate(static_cast<BlockSeqno>(q.seqno_));
+          },
           [&](lite_api::liteServer_lookupBlock& q) {
             this->perform_lookupBlock(ton::create_block_id_simple(q.id_), q.mode_, q.lt_, q.utime_);
           },
@@ -233,23 +223,17 @@ void LiteQuery::perform_getMasterchainInfo(int mode) {
   }
   td::actor::send_closure_later(
       manager_, &ton::validator::ValidatorManager::get_last_liteserver_state_block,
-      [Self = actor_id(this), return_state = bool(acc_state_promise_), mode](td::Result<std::pair<Ref<ton::validator::MasterchainState>, BlockIdExt>> res) {
+      [Self = actor_id(this), mode](td::Result<std::pair<Ref<ton::validator::MasterchainState>, BlockIdExt>> res) {
         if (res.is_error()) {
           td::actor::send_closure(Self, &LiteQuery::abort_query, res.move_as_error());
         } else {
           auto pair = res.move_as_ok();
-          auto func = return_state ? &LiteQuery::gotMasterchainInfoForAccountState : &LiteQuery::continue_getMasterchainInfo;
-          td::actor::send_closure_later(Self, func, std::move(pair.first),
+          td::actor::send_closure_later(Self, &LiteQuery::continue_getMasterchainInfo, std::move(pair.first),
                                         pair.second, mode);
         }
       });
 }
 
-void LiteQuery::gotMasterchainInfoForAccountState(Ref<ton::validator::MasterchainState> mc_state, BlockIdExt blkid,
-                                            int mode) {
-  perform_getAccountState(blkid, acc_workchain_, acc_addr_, 0x80000000);
-}
-
 void LiteQuery::continue_getMasterchainInfo(Ref<ton::validator::MasterchainState> mc_state, BlockIdExt blkid,
                                             int mode) {
   LOG(INFO) << "obtained data for getMasterchainInfo() : last block = " << blkid.to_str();
@@ -801,8 +785,29 @@ void LiteQuery::continue_getAccountState_0(Ref<ton::validator::MasterchainState>
   request_mc_block_data(blkid);
 }
 
-void LiteQuery::perform_fetchAccountState() {
-  perform_getMasterchainInfo(-1);
+void LiteQuery::perform_getAccountStates(BlockIdExt blkid, WorkchainId workchain, std::vector<StdSmcAddress> addrs) {
+  LOG(INFO) << "started a getAccountStates(" << blkid.to_str() << ", " << workchain << ", " << addrs.size()
+            << " accounts) liteserver query";
+  if (addrs.empty()) {
+    fatal_error("getAccountStates() requires at least one account");
+    return;
+  }
+  if (addrs.size() > max_account_states_count) {
+    fatal_error(PSTRING() << "getAccountStates() can fetch at most " << max_account_states_count
+                          << " accounts in one query");
+    return;
+  }
+  if (workchain == blkid.id.workchain) {
+    for (const auto& addr : addrs) {
+      if (!ton::shard_contains(blkid.shard_full(), extract_addr_prefix(workchain, addr))) {
+        fatal_error("requested account id is not contained in the shard of the reference block");
+        return;
+      }
+    }
+  }
+  // all accounts must reside in the shard of the first one; this is checked once the shard block is known
+  acc_addrs_ = std::move(addrs);
+  perform_getAccountState(blkid, workchain, acc_addrs_[0], 0x20000);
 }
 
 void LiteQuery::perform_runSmcMethod(BlockIdExt blkid, WorkchainId workchain, StdSmcAddress addr, int mode,
@@ -1155,23 +1160,62 @@ void LiteQuery::continue_getAccountState() {
     // no shard with requested address found
     LOG(INFO) << "getAccountState(" << acc_workchain_ << ":" << acc_addr_.to_hex()
               << ") query completed (unknown workchain/shard)";
+    if (mode_ & 0x20000) {
+      finish_query(ton::create_serialize_tl_object<ton::lite_api::liteServer_accountStates>(
+          ton::create_tl_lite_block_id(base_blk_id_), ton::create_tl_lite_block_id(blkid), proof.move_as_ok(),
+          td::BufferSlice{}, td::BufferSlice{}, static_cast<td::int32>(acc_addrs_.size())));
+      return;
+    }
     auto b = ton::create_serialize_tl_object<ton::lite_api::liteServer_accountState>(
         ton::create_tl_lite_block_id(base_blk_id_), ton::create_tl_lite_block_id(blkid), proof.move_as_ok(),
         td::BufferSlice{}, td::BufferSlice{});
     finish_query(std::move(b));
   } else {
+    if (mode_ & 0x20000) {
+      for (const auto& addr : acc_addrs_) {
+        if (!ton::shard_contains(blkid.shard_full(), extract_addr_prefix(acc_workchain_, addr))) {
+          fatal_error(PSTRING() << "account " << acc_workchain_ << ":" << addr.to_hex() << " does not belong to shard "
+                                << blkid.shard_full().to_str() << " of the other requested accounts");
+          return;
+        }
+      }
+    }
     shard_proof_ = proof.move_as_ok();
     set_continuation([this]() -> void { finish_getAccountState(std::move(shard_proof_)); });
     request_block_data_state(blkid);
   }
 }
 
+// Loads the ShardAccounts entries of the accounts and `depth` levels of their trees in parallel waves; the state root
+// is not wrapped in usage cells, so the prefetched cells are not added to the proofs unless the lookups use them.
+static void prefetch_accounts(Ref<vm::Cell> state_root, td::Span<StdSmcAddress> addrs, int depth) {
+  block::gen::ShardStateUnsplit::Record sstate;
+  if (!tlb::unpack_cell(std::move(state_root), sstate)) {
+    return;
+  }
+  vm::AugmentedDictionary accounts_dict{vm::load_cell_slice_ref(sstate.accounts), 256, block::tlb::aug_ShardAccounts};
+  auto dict_root = accounts_dict.get_root_cell();
+  std::vector<td::ConstBitPtr> keys;
+  for (const auto& addr : addrs) {
+    keys.push_back(addr.cbits());
+  }
+  vm::CellDbReader::prefetch_dict(dict_root, 256, keys, 256, depth);
+}
+
 void LiteQuery::finish_getAccountState(td::BufferSlice shard_proof) {
+  if (mode_ & 0x20000) {
+    finish_getAccountStates(std::move(shard_proof));
+    return;
+  }
   LOG(INFO) << "completing getAccountState() query";
   Ref<vm::Cell> proof1;
   if (!make_state_root_proof(proof1)) {
     return;
   }
+  // the whole account is serialized unless only its root is requested; a get-method touches only a few cells of it,
+  // so just the account root, the roots of its code and data and one level below them are loaded in advance
+  int depth = mode_ & 0x10000 ? 3 : (mode_ & 0x40000000 ? 1 : 256);
+  prefetch_accounts(state_->root_cell(), td::Span<StdSmcAddress>(&acc_addr_, 1), depth);
   vm::MerkleProofBuilder pb{state_->root_cell()};
   block::gen::ShardStateUnsplit::Record sstate;
   if (!tlb::unpack_cell(pb.root(), sstate)) {
@@ -1180,19 +1224,6 @@ void LiteQuery::finish_getAccountState(td::BufferSlice shard_proof) {
   }
   vm::AugmentedDictionary accounts_dict{vm::load_cell_slice_ref(sstate.accounts), 256, block::tlb::aug_ShardAccounts};
   auto acc_csr = accounts_dict.lookup(acc_addr_);
-  if (mode_ & 0x80000000) {
-    auto config = block::ConfigInfo::extract_config(mc_state_->root_cell(), 0xFFFF);
-    if (config.is_error()) {
-      fatal_error(config.move_as_error());
-      return;
-    }
-    auto rconfig = config.move_as_ok();
-    acc_state_promise_.set_value(std::make_tuple(
-                                  std::move(acc_csr), sstate.gen_utime, sstate.gen_lt, std::move(rconfig)
-                                 ));
-    return;
-  }
-
   Ref<vm::Cell> acc_root;
   if (acc_csr.not_null()) {
     acc_root = acc_csr->prefetch_ref();
@@ -1237,6 +1268,93 @@ void LiteQuery::finish_getAccountState(td::BufferSlice shard_proof) {
   finish_query(std::move(b));
 }
 
+// rough size of an account in a bag of cells, from the storage statistics kept in the account itself
+static td::uint64 estimate_account_size(Ref<vm::Cell> acc_root) {
+  block::gen::Account::Record_account acc;
+  block::gen::StorageInfo::Record info;
+  block::gen::StorageUsed::Record used;
+  if (!(tlb::unpack_cell(std::move(acc_root), acc) && tlb::csr_unpack(acc.storage_stat, info) &&
+        tlb::csr_unpack(info.used, used))) {
+    return 0;
+  }
+  auto cells = block::tlb::t_VarUInteger_7.as_uint(*used.cells) + 1;
+  auto bits = block::tlb::t_VarUInteger_7.as_uint(*used.bits);
+  // descriptor bytes and references take a few bytes per cell
+  return cells * 8 + bits / 8;
+}
+
+void LiteQuery::finish_getAccountStates(td::BufferSlice shard_proof) {
+  LOG(INFO) << "completing getAccountStates() query";
+  Ref<vm::Cell> proof1;
+  if (!make_state_root_proof(proof1)) {
+    return;
+  }
+  prefetch_accounts(state_->root_cell(), acc_addrs_, 256);
+  block::gen::ShardStateUnsplit::Record sstate;
+  if (!tlb::unpack_cell(state_->root_cell(), sstate)) {
+    fatal_error("cannot unpack state header");
+    return;
+  }
+  // answer only as many accounts, in the order of the request, as fit into the size budget (but at least one);
+  // the client asks for the rest again
+  std::size_t count = 0;
+  {
+    vm::AugmentedDictionary accounts_dict{vm::load_cell_slice_ref(sstate.accounts), 256,
+                                          block::tlb::aug_ShardAccounts};
+    td::uint64 total_size = 0;
+    for (const auto& addr : acc_addrs_) {
+      auto acc_csr = accounts_dict.lookup(addr);
+      if (acc_csr.not_null()) {
+        total_size += estimate_account_size(acc_csr->prefetch_ref());
+        if (count > 0 && total_size > max_account_states_size) {
+          break;
+        }
+      }
+      count++;
+    }
+  }
+  if (count < acc_addrs_.size()) {
+    LOG(INFO) << "getAccountStates() answers only " << count << " of " << acc_addrs_.size()
+              << " accounts because of the size limit";
+  }
+  acc_addrs_.resize(count);
+  // all lookups share one usage tree, so the common part of the ShardAccounts dictionary is included only once
+  vm::MerkleProofBuilder pb{state_->root_cell()};
+  if (!tlb::unpack_cell(pb.root(), sstate)) {
+    fatal_error("cannot unpack state header");
+    return;
+  }
+  vm::AugmentedDictionary accounts_dict{vm::load_cell_slice_ref(sstate.accounts), 256, block::tlb::aug_ShardAccounts};
+  std::vector<Ref<vm::Cell>> acc_roots;
+  for (const auto& addr : acc_addrs_) {
+    auto acc_csr = accounts_dict.lookup(addr);
+    if (acc_csr.not_null()) {
+      acc_roots.push_back(acc_csr->prefetch_ref());
+    }
+  }
+  auto proof = vm::std_boc_serialize_multi({std::move(proof1), pb.extract_proof()});
+  pb.clear();
+  if (proof.is_error()) {
+    fatal_error(proof.move_as_error());
+    return;
+  }
+  td::BufferSlice data;
+  if (!acc_roots.empty()) {
+    // existing accounts are stored in the order of the request; cells shared between them are serialized once
+    auto res = vm::std_boc_serialize_multi(std::move(acc_roots));
+    if (res.is_error()) {
+      fatal_error(res.move_as_error());
+      return;
+    }
+    data = res.move_as_ok();
+  }
+  LOG(INFO) << "getAccountStates(" << acc_workchain_ << ", " << acc_addrs_.size() << " accounts) query completed";
+  auto b = ton::create_serialize_tl_object<ton::lite_api::liteServer_accountStates>(
+      ton::create_tl_lite_block_id(base_blk_id_), ton::create_tl_lite_block_id(blk_id_), std::move(shard_proof),
+      proof.move_as_ok(), std::move(data), static_cast<td::int32>(count));
+  finish_query(std::move(b));
+}
+
 // same as in lite-client/lite-client-common.cpp
 static td::Ref<vm::Tuple> prepare_vm_c7(ton::UnixTime now, ton::LogicalTime lt, td::Ref<vm::CellSlice> my_addr,
                                         const block::CurrencyCollection& balance) {
@@ -1781,6 +1899,65 @@ void LiteQuery::continue_getAllShardsInfo() {
   finish_query(std::move(b));
 }
 
+void LiteQuery::perform_getMasterchainBlockUpdate(BlockSeqno seqno) {
+  LOG(INFO) << "started a getMasterchainBlockUpdate(" << seqno << ") liteserver query";
+  // clients normally send this query with a liteServer.waitMasterchainSeqno prefix, so that it is answered
+  // as soon as the masterchain block is applied; one outstanding query per client replaces polling
+  auto P = td::PromiseCreator::lambda([Self = actor_id(this)](td::Result<ConstBlockHandle> res) {
+    if (res.is_error()) {
+      td::actor::send_closure(Self, &LiteQuery::abort_query, res.move_as_error());
+      return;
+    }
+    auto handle = res.move_as_ok();
+    if (!handle->is_applied()) {
+      td::actor::send_closure(Self, &LiteQuery::abort_query, td::Status::Error("block is not applied"));
+      return;
+    }
+    td::actor::send_closure_later(Self, &LiteQuery::continue_getMasterchainBlockUpdate, handle->id());
+  });
+  td::actor::send_closure_later(manager_, &ValidatorManager::get_block_by_seqno_from_db,
+                                ton::AccountIdPrefixFull{masterchainId, shardIdAll}, seqno, std::move(P));
+}
+
+void LiteQuery::continue_getMasterchainBlockUpdate(BlockIdExt blkid) {
+  set_continuation([&]() -> void { finish_getMasterchainBlockUpdate(); });
+  request_mc_block_data_state(blkid);
+}
+
+void LiteQuery::finish_getMasterchainBlockUpdate() {
+  LOG(INFO) << "completing getMasterchainBlockUpdate(" << base_blk_id_.to_str() << ") query";
+  Ref<vm::Cell> proof1, proof2;
+  if (!make_mc_state_root_proof(proof1)) {
+    return;
+  }
+  // all leaves of ShardHashes are visited, so that the client can recompute the list of new shard blocks
+  vm::MerkleProofBuilder mpb{mc_state_->root_cell()};
+  auto shards_dict = block::ShardConfig::extract_shard_hashes_dict(mpb.root());
+  block::ShardConfig sh_conf;
+  if (!shards_dict || !sh_conf.unpack(shards_dict->get_root_cell())) {
+    fatal_error("cannot extract ShardHashes from masterchain state");
+    return;
+  }
+  auto new_blocks = sh_conf.get_shard_blocks_registered_at(base_blk_id_.seqno());
+  if (!mpb.extract_proof_to(proof2)) {
+    fatal_error("cannot construct Merkle proof for shard configuration");
+    return;
+  }
+  auto proof = vm::std_boc_serialize_multi({std::move(proof1), std::move(proof2)});
+  if (proof.is_error()) {
+    fatal_error(proof.move_as_error());
+    return;
+  }
+  std::vector<tl_object_ptr<lite_api::tonNode_blockIdExt>> shard_blocks;
+  for (const auto& id : new_blocks) {
+    shard_blocks.push_back(ton::create_tl_lite_block_id(id));
+  }
+  LOG(INFO) << "getMasterchainBlockUpdate() query completed: " << shard_blocks.size() << " new shard blocks";
+  auto b = ton::create_serialize_tl_object<ton::lite_api::liteServer_masterchainBlockUpdate>(
+      ton::create_tl_lite_block_id(base_blk_id_), std::move(shard_blocks), proof.move_as_ok());
+  finish_query(std::move(b));
+}
+
 void LiteQuery::perform_lookupBlock(BlockId blkid, int mode, LogicalTime lt, UnixTime utime) {
   if (!((1 << (mode & 7)) & 0x16)) {
     fatal_error("exactly one of mode.0, mode.1 and mode.2 bits must be set");
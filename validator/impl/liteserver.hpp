@@ -40,12 +40,11 @@ class LiteQuery : public td::actor::Actor {
   td::Timestamp timeout_;
   td::Promise<td::BufferSlice> promise_;
 
-  td::Promise<std::tuple<td::Ref<vm::CellSlice>,UnixTime,LogicalTime,std::unique_ptr<block::ConfigInfo>>> acc_state_promise_;
-
   int pending_{0};
   int mode_{0};
   WorkchainId acc_workchain_;
   StdSmcAddress acc_addr_;
+  std::vector<StdSmcAddress> acc_addrs_;
   LogicalTime trans_lt_;
   Bits256 trans_hash_;
   BlockIdExt base_blk_id_, base_blk_id_alt_, blk_id_;
@@ -68,22 +67,20 @@ class LiteQuery : public td::actor::Actor {
   enum {
     default_timeout_msec = 4500,      // 4.5 seconds
     max_transaction_count = 16,       // fetch at most 16 transactions in one query
-    client_method_gas_limit = 300000  // gas limit for liteServer.runSmcMethod
+    client_method_gas_limit = 300000,  // gas limit for liteServer.runSmcMethod
+    max_account_states_count = 256,   // fetch at most 256 accounts in one liteServer.getAccountStates
+    max_account_states_size = 1 << 22  // and return at most about 4 MiB of account states in one answer
   };
   enum {
     ls_version = 0x101,
-    ls_capabilities = 7
-  };  // version 1.1; +1 = build block proof chains, +2 = masterchainInfoExt, +4 = runSmcMethod
+    ls_capabilities = 31
+  };  // version 1.1; +1 = build block proof chains, +2 = masterchainInfoExt, +4 = runSmcMethod, +8 = getAccountStates,
+      // +16 = getMasterchainBlockUpdate
   LiteQuery(td::BufferSlice data, td::actor::ActorId<ton::validator::ValidatorManager> manager,
             td::Promise<td::BufferSlice> promise);
-  LiteQuery(WorkchainId wc, StdSmcAddress  acc_addr, td::actor::ActorId<ton::validator::ValidatorManager> manager,
-            td::Promise<std::tuple<td::Ref<vm::CellSlice>,UnixTime,LogicalTime,std::unique_ptr<block::ConfigInfo>>> promise);
   static void run_query(td::BufferSlice data, td::actor::ActorId<ton::validator::ValidatorManager> manager,
                         td::Promise<td::BufferSlice> promise);
 
-  static void fetch_account_state(WorkchainId wc, StdSmcAddress  acc_addr, td::actor::ActorId<ton::validator::ValidatorManager> manager,
-                                  td::Promise<std::tuple<td::Ref<vm::CellSlice>,UnixTime,LogicalTime,std::unique_ptr<block::ConfigInfo>>> promise);
-
  private:
   bool fatal_error(td::Status error);
   bool fatal_error(std::string err_msg, int err_code = -400);
@@ -97,7 +94,6 @@ class LiteQuery : public td::actor::Actor {
   void perform_getVersion();
   void perform_getMasterchainInfo(int mode);
   void continue_getMasterchainInfo(Ref<MasterchainState> mc_state, BlockIdExt blkid, int mode);
-  void gotMasterchainInfoForAccountState(Ref<MasterchainState> mc_state, BlockIdExt blkid, int mode);
   void perform_getBlock(BlockIdExt blkid);
   void continue_getBlock(BlockIdExt blkid, Ref<BlockData> block);
   void perform_getBlockHeader(BlockIdExt blkid, int mode);
@@ -110,7 +106,8 @@ class LiteQuery : public td::actor::Actor {
   void continue_getAccountState_0(Ref<MasterchainState> mc_state, BlockIdExt blkid);
   void continue_getAccountState();
   void finish_getAccountState(td::BufferSlice shard_proof);
-  void perform_fetchAccountState();
+  void perform_getAccountStates(BlockIdExt blkid, WorkchainId workchain, std::vector<StdSmcAddress> addrs);
+  void finish_getAccountStates(td::BufferSlice shard_proof);
   void perform_runSmcMethod(BlockIdExt blkid, WorkchainId workchain, StdSmcAddress addr, int mode, td::int64 method_id,
                             td::BufferSlice params);
   void finish_runSmcMethod(td::BufferSlice shard_proof, td::BufferSlice state_proof, Ref<vm::Cell> acc_root,
@@ -128,6 +125,9 @@ class LiteQuery : public td::actor::Actor {
   void perform_getAllShardsInfo(BlockIdExt blkid);
   void continue_getShardInfo(ShardIdFull shard, bool exact);
   void continue_getAllShardsInfo();
+  void perform_getMasterchainBlockUpdate(BlockSeqno seqno);
+  void continue_getMasterchainBlockUpdate(BlockIdExt blkid);
+  void finish_getMasterchainBlockUpdate();
   void perform_getConfigParams(BlockIdExt blkid, int mode, std::vector<int> param_list = {});
   void continue_getConfigParams(int mode, std::vector<int> param_list);
   void perform_lookupBlock(BlockId blkid, int mode, LogicalTime lt, UnixTime utime);
@@ -753,75 +753,37 @@ bool ValidateQuery::try_unpack_mc_state() {
 // almost the same as in Collator
 bool ValidateQuery::fetch_config_params() {
   old_mparams_ = config_->get_config_param(9);
-  {
-    auto res = config_->get_storage_prices();
-    if (res.is_error()) {
-      return fatal_error(res.move_as_error());
-    }
-    storage_prices_ = res.move_as_ok();
+  auto r_parsed = config_->get_parsed_config();
+  if (r_parsed.is_error()) {
+    return fatal_error(r_parsed.move_as_error());
   }
+  auto parsed = r_parsed.move_as_ok();
+  storage_prices_ = parsed->storage_prices;
   {
     // recover (not generate) rand seed from block header
     CHECK(!rand_seed_.is_zero());
   }
-  block::SizeLimitsConfig size_limits;
-  {
-    auto res = config_->get_size_limits_config();
-    if (res.is_error()) {
-      return fatal_error(res.move_as_error());
-    }
-    size_limits = res.move_as_ok();
-  }
   {
     // compute compute_phase_cfg / storage_phase_cfg
-    auto cell = config_->get_config_param(is_masterchain() ? 20 : 21);
-    if (cell.is_null()) {
-      return fatal_error("cannot fetch current gas prices and limits from masterchain configuration");
-    }
-    if (!compute_phase_cfg_.parse_GasLimitsPrices(std::move(cell), storage_phase_cfg_.freeze_due_limit,
-                                                  storage_phase_cfg_.delete_due_limit)) {
-      return fatal_error("cannot unpack current gas prices and limits from masterchain configuration");
-    }
+    auto& gas = parsed->get_gas_limits_prices(is_masterchain());
+    compute_phase_cfg_.set_gas_limits_prices(gas);
+    storage_phase_cfg_.freeze_due_limit = td::make_refint(gas.freeze_due_limit);
+    storage_phase_cfg_.delete_due_limit = td::make_refint(gas.delete_due_limit);
     compute_phase_cfg_.block_rand_seed = rand_seed_;
     compute_phase_cfg_.libraries = std::make_unique<vm::Dictionary>(config_->get_libraries_root(), 256);
-    compute_phase_cfg_.max_vm_data_depth = size_limits.max_vm_data_depth;
+    compute_phase_cfg_.max_vm_data_depth = parsed->size_limits.max_vm_data_depth;
     compute_phase_cfg_.global_config = config_->get_root_cell();
   }
   {
     // compute action_phase_cfg
-    block::gen::MsgForwardPrices::Record rec;
-    auto cell = config_->get_config_param(24);
-    if (cell.is_null() || !tlb::unpack_cell(std::move(cell), rec)) {
-      return fatal_error("cannot fetch masterchain message transfer prices from masterchain configuration");
-    }
-    action_phase_cfg_.fwd_mc =
-        block::MsgPrices{rec.lump_price,           rec.bit_price,          rec.cell_price, rec.ihr_price_factor,
-                         (unsigned)rec.first_frac, (unsigned)rec.next_frac};
-    cell = config_->get_config_param(25);
-    if (cell.is_null() || !tlb::unpack_cell(std::move(cell), rec)) {
-      return fatal_error("cannot fetch standard message transfer prices from masterchain configuration");
-    }
-    action_phase_cfg_.fwd_std =
-        block::MsgPrices{rec.lump_price,           rec.bit_price,          rec.cell_price, rec.ihr_price_factor,
-                         (unsigned)rec.first_frac, (unsigned)rec.next_frac};
-    action_phase_cfg_.workchains = &config_->get_workchain_list();
+    action_phase_cfg_.fwd_mc = parsed->fwd_mc;
+    action_phase_cfg_.fwd_std = parsed->fwd_std;
+    action_phase_cfg_.workchains = &parsed->workchains;
     action_phase_cfg_.bounce_msg_body = (config_->has_capability(ton::capBounceMsgBody) ? 256 : 0);
-    action_phase_cfg_.size_limits = size_limits;
-  }
-  {
-    // fetch block_grams_created
-    auto cell = config_->get_config_param(14);
-    if (cell.is_null()) {
-      basechain_create_fee_ = masterchain_create_fee_ = td::zero_refint();
-    } else {
-      block::gen::BlockCreateFees::Record create_fees;
-      if (!(tlb::unpack_cell(cell, create_fees) &&
-            block::tlb::t_Grams.as_integer_to(create_fees.masterchain_block_fee, masterchain_create_fee_) &&
-            block::tlb::t_Grams.as_integer_to(create_fees.basechain_block_fee, basechain_create_fee_))) {
-        return fatal_error("cannot unpack BlockCreateFees from configuration parameter #14");
-      }
-    }
+    action_phase_cfg_.size_limits = parsed->size_limits;
   }
+  masterchain_create_fee_ = parsed->masterchain_create_fee;
+  basechain_create_fee_ = parsed->basechain_create_fee;
   return true;
 }
 
@@ -4012,7 +3974,7 @@ bool ValidateQuery::check_neighbor_outbound_message(Ref<vm::CellSlice> enq_msg,
 bool ValidateQuery::check_in_queue() {
   block::OutputQueueMerger nb_out_msgs(shard_, neighbors_);
   while (!nb_out_msgs.is_eof()) {
-    auto kv = nb_out_msgs.extract_cur();
+    auto kv = nb_out_msgs.cur();
     CHECK(kv && kv->msg.not_null());
     LOG(DEBUG) << "processing inbound message with (lt,hash)=(" << kv->lt << "," << kv->key.to_hex()
                << ") from neighbor #" << kv->source;
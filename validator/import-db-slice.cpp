@@ -41,6 +41,37 @@ ArchiveImporter::ArchiveImporter(std::string path, td::Ref<MasterchainState> sta
     , promise_(std::move(promise)) {
 }
 
+td::Result<std::pair<BlockSeqno, BlockSeqno>> ArchiveImporter::get_masterchain_seqno_range(std::string path) {
+  TRY_RESULT(package, Package::open(path, true, false));
+
+  td::Status status;
+  BlockSeqno first = 0, last = 0;
+  bool found = false;
+  package.iterate_filenames([&](std::string filename, td::uint64 offset) -> bool {
+    auto F = FileReference::create(filename);
+    if (F.is_error()) {
+      status = F.move_as_error();
+      return false;
+    }
+    auto f = F.move_as_ok();
+    f.ref().visit(td::overloaded(
+        [&](const fileref::Block &p) {
+          if (p.block_id.is_masterchain()) {
+            first = found ? std::min(first, p.block_id.seqno()) : p.block_id.seqno();
+            last = found ? std::max(last, p.block_id.seqno()) : p.block_id.seqno();
+            found = true;
+          }
+        },
+        [&](const auto &p) {}));
+    return true;
+  });
+  TRY_STATUS(std::move(status));
+  if (!found) {
+    return td::Status::Error(ErrorCode::notready, "archive does not contain any masterchain blocks");
+  }
+  return std::make_pair(first, last);
+}
+
 void ArchiveImporter::start_up() {
   auto R = Package::open(path_, false, false);
   if (R.is_error()) {
@@ -219,15 +250,22 @@ void ArchiveImporter::got_new_materchain_state(td::Ref<MasterchainState> state)
 }
 
 void ArchiveImporter::checked_all_masterchain_blocks(BlockSeqno seqno) {
-  check_next_shard_client_seqno(shard_client_seqno_ + 1);
+  if (shard_client_seqno_ >= state_->get_seqno()) {
+    finish_query();
+    return;
+  }
+  next_load_seqno_ = next_apply_seqno_ = shard_client_seqno_ + 1;
+  load_next_masterchain_states();
 }
 
-void ArchiveImporter::check_next_shard_client_seqno(BlockSeqno seqno) {
-  if (seqno > state_->get_seqno()) {
-    finish_query();
-  } else if (seqno == state_->get_seqno()) {
-    got_masterchain_state(state_);
-  } else {
+void ArchiveImporter::load_next_masterchain_states() {
+  while (next_load_seqno_ <= state_->get_seqno() &&
+         next_load_seqno_ <= shard_client_seqno_ + max_shard_client_seqnos_in_flight()) {
+    auto seqno = next_load_seqno_++;
+    if (seqno == state_->get_seqno()) {
+      got_masterchain_state(state_);
+      continue;
+    }
     BlockIdExt b;
     bool f = state_->get_old_mc_block_id(seqno, b);
     CHECK(f);
@@ -241,35 +279,62 @@ void ArchiveImporter::check_next_shard_client_seqno(BlockSeqno seqno) {
 }
 
 void ArchiveImporter::got_masterchain_state(td::Ref<MasterchainState> state) {
-  auto s = state->get_shards();
+  loaded_masterchain_states_.emplace(state->get_seqno(), std::move(state));
 
-  auto P = td::PromiseCreator::lambda([SelfId = actor_id(this), seqno = state->get_seqno()](td::Result<td::Unit> R) {
-    if (R.is_error()) {
-      td::actor::send_closure(SelfId, &ArchiveImporter::abort_query, R.move_as_error());
-    } else {
-      td::actor::send_closure(SelfId, &ArchiveImporter::checked_shard_client_seqno, seqno);
-    }
-  });
+  // shard top blocks are registered in masterchain order: a shard block is then always applied with the first
+  // masterchain block that references it, and splits/merges find their parents at least being applied
+  while (!loaded_masterchain_states_.empty() && loaded_masterchain_states_.begin()->first == next_apply_seqno_) {
+    auto mc_state = std::move(loaded_masterchain_states_.begin()->second);
+    loaded_masterchain_states_.erase(loaded_masterchain_states_.begin());
+    next_apply_seqno_++;
+
+    auto P = td::PromiseCreator::lambda(
+        [SelfId = actor_id(this), seqno = mc_state->get_seqno()](td::Result<td::Unit> R) {
+          if (R.is_error()) {
+            td::actor::send_closure(SelfId, &ArchiveImporter::abort_query, R.move_as_error());
+          } else {
+            td::actor::send_closure(SelfId, &ArchiveImporter::checked_shard_client_seqno, seqno);
+          }
+        });
 
-  td::MultiPromise mp;
-  auto ig = mp.init_guard();
-  ig.add_promise(std::move(P));
+    td::MultiPromise mp;
+    auto ig = mp.init_guard();
+    ig.add_promise(std::move(P));
 
-  for (auto &shard : s) {
-    apply_shard_block(shard->top_block_id(), state->get_block_id(), ig.get_promise());
+    for (auto &shard : mc_state->get_shards()) {
+      apply_shard_block(shard->top_block_id(), mc_state->get_block_id(), ig.get_promise());
+    }
   }
 }
 
 void ArchiveImporter::checked_shard_client_seqno(BlockSeqno seqno) {
-  CHECK(shard_client_seqno_ + 1 == seqno);
-  shard_client_seqno_++;
-  check_next_shard_client_seqno(seqno + 1);
+  CHECK(seqno > shard_client_seqno_);
+  applied_shard_client_seqnos_.insert(seqno);
+  while (!applied_shard_client_seqnos_.empty() && *applied_shard_client_seqnos_.begin() == shard_client_seqno_ + 1) {
+    applied_shard_client_seqnos_.erase(applied_shard_client_seqnos_.begin());
+    shard_client_seqno_++;
+  }
+  if (shard_client_seqno_ >= state_->get_seqno()) {
+    finish_query();
+    return;
+  }
+  load_next_masterchain_states();
 }
 
 void ArchiveImporter::apply_shard_block(BlockIdExt block_id, BlockIdExt masterchain_block_id,
                                         td::Promise<td::Unit> promise) {
+  auto it = applying_shard_blocks_.find(block_id);
+  if (it != applying_shard_blocks_.end()) {
+    it->second.push_back(std::move(promise));
+    return;
+  }
+  applying_shard_blocks_[block_id].push_back(std::move(promise));
+
+  auto Q = td::PromiseCreator::lambda([SelfId = actor_id(this), block_id](td::Result<td::Unit> R) {
+    td::actor::send_closure(SelfId, &ArchiveImporter::applied_shard_block, block_id, std::move(R));
+  });
   auto P = td::PromiseCreator::lambda(
-      [SelfId = actor_id(this), masterchain_block_id, promise = std::move(promise)](td::Result<BlockHandle> R) mutable {
+      [SelfId = actor_id(this), masterchain_block_id, promise = std::move(Q)](td::Result<BlockHandle> R) mutable {
         R.ensure();
         td::actor::send_closure(SelfId, &ArchiveImporter::apply_shard_block_cont1, R.move_as_ok(), masterchain_block_id,
                                 std::move(promise));
@@ -277,6 +342,16 @@ void ArchiveImporter::apply_shard_block(BlockIdExt block_id, BlockIdExt masterch
   td::actor::send_closure(manager_, &ValidatorManager::get_block_handle, block_id, true, std::move(P));
 }
 
+void ArchiveImporter::applied_shard_block(BlockIdExt block_id, td::Result<td::Unit> R) {
+  auto it = applying_shard_blocks_.find(block_id);
+  CHECK(it != applying_shard_blocks_.end());
+  auto promises = std::move(it->second);
+  applying_shard_blocks_.erase(it);
+  for (auto &promise : promises) {
+    promise.set_result(R.clone());
+  }
+}
+
 void ArchiveImporter::apply_shard_block_cont1(BlockHandle handle, BlockIdExt masterchain_block_id,
                                               td::Promise<td::Unit> promise) {
   if (handle->is_applied()) {
@@ -358,6 +433,11 @@ void ArchiveImporter::apply_shard_block_cont3(BlockHandle handle, BlockIdExt mas
 }
 
 void ArchiveImporter::check_shard_block_applied(BlockIdExt block_id, td::Promise<td::Unit> promise) {
+  auto it = applying_shard_blocks_.find(block_id);
+  if (it != applying_shard_blocks_.end()) {
+    it->second.push_back(std::move(promise));
+    return;
+  }
   auto P = td::PromiseCreator::lambda(
       [SelfId = actor_id(this), promise = std::move(promise)](td::Result<BlockHandle> R) mutable {
         if (R.is_error()) {
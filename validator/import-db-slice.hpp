@@ -22,6 +22,8 @@
 #include "validator/interfaces/validator-manager.h"
 #include "validator/db/package.hpp"
 
+#include <set>
+
 namespace ton {
 
 namespace validator {
@@ -33,6 +35,9 @@ class ArchiveImporter : public td::actor::Actor {
                   td::Promise<std::vector<BlockSeqno>> promise);
   void start_up() override;
 
+  // first and last masterchain block seqno in the package, scanned without reading block data
+  static td::Result<std::pair<BlockSeqno, BlockSeqno>> get_masterchain_seqno_range(std::string path);
+
   void abort_query(td::Status error);
   void finish_query();
 
@@ -42,10 +47,11 @@ class ArchiveImporter : public td::actor::Actor {
   void got_new_materchain_state(td::Ref<MasterchainState> state);
   void checked_all_masterchain_blocks(BlockSeqno seqno);
 
-  void check_next_shard_client_seqno(BlockSeqno seqno);
+  void load_next_masterchain_states();
   void checked_shard_client_seqno(BlockSeqno seqno);
   void got_masterchain_state(td::Ref<MasterchainState> state);
   void apply_shard_block(BlockIdExt block_id, BlockIdExt masterchain_block_id, td::Promise<td::Unit> promise);
+  void applied_shard_block(BlockIdExt block_id, td::Result<td::Unit> R);
   void apply_shard_block_cont1(BlockHandle handle, BlockIdExt masterchain_block_id, td::Promise<td::Unit> promise);
   void apply_shard_block_cont2(BlockHandle handle, BlockIdExt masterchain_block_id, td::Promise<td::Unit> promise);
   void apply_shard_block_cont3(BlockHandle handle, BlockIdExt masterchain_block_id, td::Promise<td::Unit> promise);
@@ -65,6 +71,16 @@ class ArchiveImporter : public td::actor::Actor {
 
   std::map<BlockSeqno, BlockIdExt> masterchain_blocks_;
   std::map<BlockIdExt, std::array<td::uint64, 2>> blocks_;
+
+  // shard blocks of several masterchain blocks are applied at once; shard_client_seqno_ still advances in order
+  static constexpr td::uint32 max_shard_client_seqnos_in_flight() {
+    return 8;
+  }
+  BlockSeqno next_load_seqno_ = 0;
+  BlockSeqno next_apply_seqno_ = 0;
+  std::map<BlockSeqno, td::Ref<MasterchainState>> loaded_masterchain_states_;
+  std::set<BlockSeqno> applied_shard_client_seqnos_;
+  std::map<BlockIdExt, std::vector<td::Promise<td::Unit>>> applying_shard_blocks_;
 };
 
 }  // namespace validator
@@ -21,6 +21,8 @@
 #include "crypto/common/refcnt.hpp"
 #include "ton/ton-types.h"
 #include "crypto/vm/cells.h"
+#include "crypto/block/mc-config.h"
+#include "td/actor/actor.h"
 
 namespace ton {
 
@@ -39,6 +41,14 @@ class ExtMessage : public td::CntObject {
   virtual ton::StdSmcAddress addr() const = 0;
 };
 
+// Checks that inbound external messages are accepted by their destination accounts
+class ExtMessageChecker : public td::actor::Actor {
+ public:
+  virtual ~ExtMessageChecker() = default;
+  virtual void check_external_message(td::BufferSlice data, block::SizeLimitsConfig::ExtMsgLimits limits,
+                                      td::Promise<td::Ref<ExtMessage>> promise) = 0;
+};
+
 }  // namespace validator
 
 }  // namespace ton
@@ -406,8 +406,8 @@ void ValidatorManagerImpl::check_external_message(td::BufferSlice data, td::Prom
     promise.set_error(td::Status::Error(ErrorCode::notready, "not ready"));
     return;
   }
-  run_check_external_message(std::move(data), state->get_ext_msg_limits(), actor_id(this),
-                             std::move(promise));
+  td::actor::send_closure(ext_message_checker_, &ExtMessageChecker::check_external_message, std::move(data),
+                          state->get_ext_msg_limits(), std::move(promise));
 }
 
 void ValidatorManagerImpl::new_ihr_message(td::BufferSlice data) {
@@ -1394,8 +1394,8 @@ void ValidatorManagerImpl::send_get_zero_state_request(BlockIdExt id, td::uint32
 void ValidatorManagerImpl::send_get_persistent_state_request(BlockIdExt id, BlockIdExt masterchain_block_id,
                                                              td::uint32 priority,
                                                              td::Promise<td::BufferSlice> promise) {
-  callback_->download_persistent_state(id, masterchain_block_id, priority, td::Timestamp::in(3600 * 3),
-                                       std::move(promise));
+  callback_->download_persistent_state(id, masterchain_block_id, db_root_ + "/tmp/", priority,
+                                       td::Timestamp::in(3600 * 3), std::move(promise));
 }
 
 void ValidatorManagerImpl::send_get_block_proof_request(BlockIdExt block_id, td::uint32 priority,
@@ -1443,6 +1443,7 @@ void ValidatorManagerImpl::send_block_broadcast(BlockBroadcast broadcast) {
 void ValidatorManagerImpl::start_up() {
   db_ = create_db_actor(actor_id(this), db_root_);
   lite_server_cache_ = create_liteserver_cache_actor(actor_id(this), db_root_);
+  ext_message_checker_ = create_ext_message_checker_actor(actor_id(this));
   token_manager_ = td::actor::create_actor<TokenManager>("tokenmanager");
   td::mkdir(db_root_ + "/tmp/").ensure();
   td::mkdir(db_root_ + "/catchains/").ensure();
@@ -1630,6 +1631,7 @@ void ValidatorManagerImpl::prestart_sync() {
 }
 
 void ValidatorManagerImpl::download_next_archive() {
+  archive_import_in_flight_ = false;
   if (!out_of_sync()) {
     finish_prestart_sync();
     return;
@@ -1645,20 +1647,93 @@ void ValidatorManagerImpl::download_next_archive() {
       return;
     }
   }
+
+  while (!staged_archives_.empty() && staged_archives_.begin()->second.last_seqno <= seqno) {
+    td::unlink(staged_archives_.begin()->second.name).ignore();
+    staged_archives_.erase(staged_archives_.begin());
+  }
+  if (!staged_archives_.empty() && staged_archives_.begin()->first <= seqno + 1) {
+    auto archive = std::move(staged_archives_.begin()->second);
+    staged_archives_.erase(staged_archives_.begin());
+    importing_archive_last_seqno_ = archive.last_seqno;
+    downloaded_archive_slice(std::move(archive.name), true);
+    return;
+  }
+  if (!archive_download_in_flight_) {
+    download_archive_slice(seqno + 1);
+  }
+}
+
+void ValidatorManagerImpl::download_archive_slice(BlockSeqno seqno) {
+  CHECK(!archive_download_in_flight_);
+  archive_download_in_flight_ = true;
   auto P = td::PromiseCreator::lambda([SelfId = actor_id(this)](td::Result<std::string> R) {
     if (R.is_error()) {
-      LOG(INFO) << "failed to download archive slice: " << R.error();
-      delay_action([SelfId]() { td::actor::send_closure(SelfId, &ValidatorManagerImpl::download_next_archive); },
-                   td::Timestamp::in(2.0));
-    } else {
-      td::actor::send_closure(SelfId, &ValidatorManagerImpl::downloaded_archive_slice, R.move_as_ok(), true);
+      td::actor::send_closure(SelfId, &ValidatorManagerImpl::got_archive_slice, R.move_as_error());
+      return;
+    }
+    // scanned here, in the downloader, to keep package reads off the manager
+    auto name = R.move_as_ok();
+    auto S = ArchiveImporter::get_masterchain_seqno_range(name);
+    if (S.is_error()) {
+      td::unlink(name).ignore();
+      td::actor::send_closure(SelfId, &ValidatorManagerImpl::got_archive_slice, S.move_as_error());
+      return;
     }
+    td::actor::send_closure(SelfId, &ValidatorManagerImpl::got_archive_slice,
+                            std::make_pair(std::move(name), S.move_as_ok()));
   });
-  callback_->download_archive(seqno + 1, db_root_ + "/tmp/", td::Timestamp::in(36000.0), std::move(P));
+  callback_->download_archive(seqno, db_root_ + "/tmp/", td::Timestamp::in(36000.0), std::move(P));
+}
+
+void ValidatorManagerImpl::prefetch_archive_slice() {
+  if (archive_sync_finished_) {
+    return;
+  }
+  if (!archive_import_in_flight_) {
+    download_next_archive();
+    return;
+  }
+  if (archive_download_in_flight_ || staged_archives_.size() >= max_staged_archives()) {
+    return;
+  }
+  auto seqno = std::max(std::min(last_masterchain_seqno_, shard_client_handle_->id().seqno()),
+                        importing_archive_last_seqno_);
+  if (!staged_archives_.empty()) {
+    seqno = std::max(seqno, staged_archives_.rbegin()->second.last_seqno);
+  }
+  download_archive_slice(seqno + 1);
+}
+
+void ValidatorManagerImpl::got_archive_slice(td::Result<std::pair<std::string, std::pair<BlockSeqno, BlockSeqno>>> R) {
+  archive_download_in_flight_ = false;
+  if (R.is_error()) {
+    LOG(INFO) << "failed to download archive slice: " << R.error();
+    delay_action(
+        [SelfId = actor_id(this)]() { td::actor::send_closure(SelfId, &ValidatorManagerImpl::prefetch_archive_slice); },
+        td::Timestamp::in(2.0));
+    return;
+  }
+  auto res = R.move_as_ok();
+  if (archive_sync_finished_) {
+    td::unlink(res.first).ignore();
+    return;
+  }
+  LOG(INFO) << "downloaded archive slice " << res.first << ": mc_seqno=[" << res.second.first << ","
+            << res.second.second << "]";
+  auto &archive = staged_archives_[res.second.first];
+  if (!archive.name.empty()) {
+    td::unlink(archive.name).ignore();
+  }
+  archive.name = std::move(res.first);
+  archive.last_seqno = res.second.second;
+
+  prefetch_archive_slice();
 }
 
 void ValidatorManagerImpl::downloaded_archive_slice(std::string name, bool is_tmp) {
-  LOG(INFO) << "downloaded archive slice: " << name;
+  LOG(INFO) << "importing archive slice: " << name;
+  archive_import_in_flight_ = true;
   auto P = td::PromiseCreator::lambda([SelfId = actor_id(this), name, is_tmp](td::Result<std::vector<BlockSeqno>> R) {
     if (is_tmp) {
       td::unlink(name).ensure();
@@ -1677,6 +1752,10 @@ void ValidatorManagerImpl::downloaded_archive_slice(std::string name, bool is_tm
   td::actor::create_actor<ArchiveImporter>("archiveimport", name, last_masterchain_state_, seqno, opts_, actor_id(this),
                                            std::move(P))
       .release();
+  if (is_tmp) {
+    // next slices are downloaded while this one is applied
+    prefetch_archive_slice();
+  }
 }
 
 void ValidatorManagerImpl::checked_archive_slice(std::vector<BlockSeqno> seqno) {
@@ -1711,6 +1790,11 @@ void ValidatorManagerImpl::checked_archive_slice(std::vector<BlockSeqno> seqno)
 
 void ValidatorManagerImpl::finish_prestart_sync() {
   to_import_.clear();
+  archive_sync_finished_ = true;
+  for (auto &it : staged_archives_) {
+    td::unlink(it.second.name).ignore();
+  }
+  staged_archives_.clear();
 
   auto P = td::PromiseCreator::lambda([SelfId = actor_id(this)](td::Result<td::Unit> R) {
     R.ensure();
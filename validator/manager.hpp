@@ -279,6 +279,9 @@ class ValidatorManagerImpl : public ValidatorManager {
   void applied_hardfork();
   void prestart_sync();
   void download_next_archive();
+  void download_archive_slice(BlockSeqno seqno);
+  void prefetch_archive_slice();
+  void got_archive_slice(td::Result<std::pair<std::string, std::pair<BlockSeqno, BlockSeqno>>> R);
   void downloaded_archive_slice(std::string name, bool is_tmp);
   void checked_archive_slice(std::vector<BlockSeqno> seqno);
   void finish_prestart_sync();
@@ -563,6 +566,7 @@ class ValidatorManagerImpl : public ValidatorManager {
  private:
   td::actor::ActorOwn<adnl::AdnlExtServer> lite_server_;
   td::actor::ActorOwn<LiteServerCache> lite_server_cache_;
+  td::actor::ActorOwn<ExtMessageChecker> ext_message_checker_;
   std::vector<td::uint16> pending_ext_ports_;
   std::vector<adnl::AdnlNodeIdShort> pending_ext_ids_;
 
@@ -586,6 +590,20 @@ class ValidatorManagerImpl : public ValidatorManager {
 
   std::map<BlockSeqno, std::pair<std::string, bool>> to_import_;
 
+  // archive slices downloaded ahead of import during initial sync
+  struct StagedArchive {
+    std::string name;
+    BlockSeqno last_seqno;
+  };
+  std::map<BlockSeqno, StagedArchive> staged_archives_;
+  bool archive_download_in_flight_ = false;
+  bool archive_import_in_flight_ = false;
+  bool archive_sync_finished_ = false;
+  BlockSeqno importing_archive_last_seqno_ = 0;
+  static constexpr td::uint32 max_staged_archives() {
+    return 2;
+  }
+
  private:
   std::unique_ptr<Callback> callback_;
   td::actor::ActorOwn<Db> db_;
@@ -20,6 +20,9 @@
 #include "ton/ton-tl.hpp"
 #include "ton/ton-io.hpp"
 #include "td/utils/overloaded.h"
+#include "td/utils/filesystem.h"
+#include "td/utils/port/path.h"
+#include "td/utils/Time.h"
 #include "full-node.h"
 
 namespace ton {
@@ -28,15 +31,16 @@ namespace validator {
 
 namespace fullnode {
 
-DownloadState::DownloadState(BlockIdExt block_id, BlockIdExt masterchain_block_id, adnl::AdnlNodeIdShort local_id,
-                             overlay::OverlayIdShort overlay_id, adnl::AdnlNodeIdShort download_from,
-                             td::uint32 priority, td::Timestamp timeout,
+DownloadState::DownloadState(BlockIdExt block_id, BlockIdExt masterchain_block_id, std::string tmp_dir,
+                             adnl::AdnlNodeIdShort local_id, overlay::OverlayIdShort overlay_id,
+                             adnl::AdnlNodeIdShort download_from, td::uint32 priority, td::Timestamp timeout,
                              td::actor::ActorId<ValidatorManagerInterface> validator_manager,
                              td::actor::ActorId<rldp::Rldp> rldp, td::actor::ActorId<overlay::Overlays> overlays,
                              td::actor::ActorId<adnl::Adnl> adnl, td::actor::ActorId<adnl::AdnlExtClient> client,
                              td::Promise<td::BufferSlice> promise)
     : block_id_(block_id)
     , masterchain_block_id_(masterchain_block_id)
+    , tmp_dir_(std::move(tmp_dir))
     , local_id_(local_id)
     , overlay_id_(overlay_id)
     , download_from_(download_from)
@@ -53,13 +57,13 @@ DownloadState::DownloadState(BlockIdExt block_id, BlockIdExt masterchain_block_i
 void DownloadState::abort_query(td::Status reason) {
   if (promise_) {
     if (reason.code() == ErrorCode::notready || reason.code() == ErrorCode::timeout) {
-      VLOG(FULL_NODE_DEBUG) << "failed to download state " << block_id_ << " from " << download_from_ << ": " << reason;
+      VLOG(FULL_NODE_DEBUG) << "failed to download state " << block_id_ << ": " << reason;
     } else {
-      VLOG(FULL_NODE_NOTICE) << "failed to download state " << block_id_ << " from " << download_from_ << ": "
-                             << reason;
+      VLOG(FULL_NODE_NOTICE) << "failed to download state " << block_id_ << ": " << reason;
     }
     promise_.set_error(std::move(reason));
   }
+  // staging file is kept: next attempt continues from the last written part
   stop();
 }
 
@@ -91,38 +95,40 @@ void DownloadState::start_up() {
 
 void DownloadState::got_block_handle(BlockHandle handle) {
   handle_ = std::move(handle);
-  if (!download_from_.is_zero() || !client_.empty()) {
+  if (fixed_source()) {
     got_node_to_download(download_from_);
   } else {
     auto P = td::PromiseCreator::lambda([SelfId = actor_id(this)](td::Result<std::vector<adnl::AdnlNodeIdShort>> R) {
       if (R.is_error()) {
         td::actor::send_closure(SelfId, &DownloadState::abort_query, R.move_as_error());
       } else {
-        auto vec = R.move_as_ok();
-        if (vec.size() == 0) {
-          td::actor::send_closure(SelfId, &DownloadState::abort_query,
-                                  td::Status::Error(ErrorCode::notready, "no nodes"));
-        } else {
-          td::actor::send_closure(SelfId, &DownloadState::got_node_to_download, vec[0]);
-        }
+        td::actor::send_closure(SelfId, &DownloadState::got_nodes_to_download, R.move_as_ok());
       }
     });
 
-    td::actor::send_closure(overlays_, &overlay::Overlays::get_overlay_random_peers, local_id_, overlay_id_, 1,
-                            std::move(P));
+    td::actor::send_closure(overlays_, &overlay::Overlays::get_overlay_random_peers, local_id_, overlay_id_,
+                            max_peers(), std::move(P));
+  }
+}
+
+void DownloadState::got_nodes_to_download(std::vector<adnl::AdnlNodeIdShort> nodes) {
+  if (nodes.size() == 0) {
+    abort_query(td::Status::Error(ErrorCode::notready, "no nodes"));
+    return;
+  }
+  for (auto &node : nodes) {
+    got_node_to_download(node);
   }
 }
 
 void DownloadState::got_node_to_download(adnl::AdnlNodeIdShort node) {
-  download_from_ = node;
-  LOG(INFO) << "downloading state " << block_id_ << " from " << download_from_;
+  if (!peers_.emplace(node, Peer{}).second) {
+    return;
+  }
+  LOG(INFO) << "downloading state " << block_id_ << " from " << node;
 
-  auto P = td::PromiseCreator::lambda([SelfId = actor_id(this)](td::Result<td::BufferSlice> R) mutable {
-    if (R.is_error()) {
-      td::actor::send_closure(SelfId, &DownloadState::abort_query, R.move_as_error());
-    } else {
-      td::actor::send_closure(SelfId, &DownloadState::got_block_state_description, R.move_as_ok());
-    }
+  auto P = td::PromiseCreator::lambda([SelfId = actor_id(this), node](td::Result<td::BufferSlice> R) mutable {
+    td::actor::send_closure(SelfId, &DownloadState::got_block_state_description, node, std::move(R));
   });
 
   td::BufferSlice query;
@@ -134,8 +140,8 @@ void DownloadState::got_node_to_download(adnl::AdnlNodeIdShort node) {
   }
 
   if (client_.empty()) {
-    td::actor::send_closure(overlays_, &overlay::Overlays::send_query, download_from_, local_id_, overlay_id_,
-                            "get_prepare", std::move(P), td::Timestamp::in(1.0), std::move(query));
+    td::actor::send_closure(overlays_, &overlay::Overlays::send_query, node, local_id_, overlay_id_, "get_prepare",
+                            std::move(P), td::Timestamp::in(1.0), std::move(query));
   } else {
     td::actor::send_closure(client_, &adnl::AdnlExtClient::send_query, "get_prepare",
                             create_serialize_tl_object_suffix<ton_api::tonNode_query>(std::move(query)),
@@ -143,98 +149,278 @@ void DownloadState::got_node_to_download(adnl::AdnlNodeIdShort node) {
   }
 }
 
-void DownloadState::got_block_state_description(td::BufferSlice data) {
-  auto F = fetch_tl_object<ton_api::tonNode_PreparedState>(std::move(data), true);
+void DownloadState::got_block_state_description(adnl::AdnlNodeIdShort node, td::Result<td::BufferSlice> R) {
+  auto F = [&]() -> td::Result<ton_api::object_ptr<ton_api::tonNode_PreparedState>> {
+    TRY_RESULT(data, std::move(R));
+    return fetch_tl_object<ton_api::tonNode_PreparedState>(std::move(data), true);
+  }();
   if (F.is_error()) {
-    abort_query(F.move_as_error());
+    VLOG(FULL_NODE_DEBUG) << "failed to prepare state " << block_id_ << " on " << node << ": " << F.error();
+    peers_.erase(node);
+    if (peers_.empty()) {
+      abort_query(F.move_as_error());
+    }
     return;
   }
-  prev_logged_timer_ = td::Timer();
 
   ton_api::downcast_call(
       *F.move_as_ok().get(),
       td::overloaded(
           [&](ton_api::tonNode_notFoundState &f) {
-            abort_query(td::Status::Error(ErrorCode::notready, "state not found"));
+            peers_.erase(node);
+            if (peers_.empty()) {
+              abort_query(td::Status::Error(ErrorCode::notready, "state not found"));
+            }
           },
-          [&, self = this](ton_api::tonNode_preparedState &f) {
-            if (masterchain_block_id_.is_valid()) {
-              got_block_state_part(td::BufferSlice{}, 0);
+          [&](ton_api::tonNode_preparedState &f) {
+            if (!masterchain_block_id_.is_valid()) {
+              download_zero_state(node);
               return;
             }
-            auto P = td::PromiseCreator::lambda([SelfId = actor_id(self)](td::Result<td::BufferSlice> R) {
-              if (R.is_error()) {
-                td::actor::send_closure(SelfId, &DownloadState::abort_query, R.move_as_error());
-              } else {
-                td::actor::send_closure(SelfId, &DownloadState::got_block_state, R.move_as_ok());
+            peers_[node].ready = true;
+            if (!staging_) {
+              prev_logged_timer_ = td::Timer();
+              auto S = StateStagingFile::open(tmp_dir_, block_id_, masterchain_block_id_);
+              if (S.is_error()) {
+                abort_query(S.move_as_error_prefix("failed to open staging file: "));
+                return;
+              }
+              staging_ = S.move_as_ok();
+              sum_ = next_offset_ = resumed_from_ = prev_logged_sum_ = staging_.value().size();
+              if (sum_ > 0) {
+                LOG(INFO) << "resuming download of state " << block_id_ << " at offset " << sum_;
               }
-            });
-
-            td::BufferSlice query =
-                create_serialize_tl_object<ton_api::tonNode_downloadZeroState>(create_tl_block_id(block_id_));
-            if (client_.empty()) {
-              td::actor::send_closure(overlays_, &overlay::Overlays::send_query_via, download_from_, local_id_,
-                                      overlay_id_, "download state", std::move(P), td::Timestamp::in(3.0),
-                                      std::move(query), FullNode::max_state_size(), rldp_);
-            } else {
-              td::actor::send_closure(client_, &adnl::AdnlExtClient::send_query, "download state",
-                                      create_serialize_tl_object_suffix<ton_api::tonNode_query>(std::move(query)),
-                                      td::Timestamp::in(3.0), std::move(P));
             }
+            download_parts();
           }));
 }
 
-void DownloadState::got_block_state_part(td::BufferSlice data, td::uint32 requested_size) {
-  bool last_part = data.size() < requested_size;
-  sum_ += data.size();
-  parts_.push_back(std::move(data));
-
-  double elapsed = prev_logged_timer_.elapsed();
-  if (elapsed > 10.0) {
-    prev_logged_timer_ = td::Timer();
-    LOG(INFO) << "downloading state " << block_id_ << ": total=" << sum_ <<
-        " (" << double(sum_ - prev_logged_sum_) / elapsed << " B/s)";
-    prev_logged_sum_ = sum_;
-  }
-
-  if (last_part) {
-    td::BufferSlice res{td::narrow_cast<std::size_t>(sum_)};
-    auto S = res.as_slice();
-    for (auto &p : parts_) {
-      S.copy_from(p.as_slice());
-      S.remove_prefix(p.size());
-    }
-    parts_.clear();
-    CHECK(!S.size());
-    got_block_state(std::move(res));
+void DownloadState::download_zero_state(adnl::AdnlNodeIdShort node) {
+  if (zero_state_requested_) {
     return;
   }
+  zero_state_requested_ = true;
 
-  td::uint32 part_size = 1 << 18;
-  auto P = td::PromiseCreator::lambda([SelfId = actor_id(this), part_size](td::Result<td::BufferSlice> R) {
+  auto P = td::PromiseCreator::lambda([SelfId = actor_id(this)](td::Result<td::BufferSlice> R) {
     if (R.is_error()) {
       td::actor::send_closure(SelfId, &DownloadState::abort_query, R.move_as_error());
     } else {
-      td::actor::send_closure(SelfId, &DownloadState::got_block_state_part, R.move_as_ok(), part_size);
+      td::actor::send_closure(SelfId, &DownloadState::got_block_state, R.move_as_ok());
     }
   });
 
+  td::BufferSlice query = create_serialize_tl_object<ton_api::tonNode_downloadZeroState>(create_tl_block_id(block_id_));
+  if (client_.empty()) {
+    td::actor::send_closure(overlays_, &overlay::Overlays::send_query_via, node, local_id_, overlay_id_,
+                            "download state", std::move(P), td::Timestamp::in(3.0), std::move(query),
+                            FullNode::max_state_size(), rldp_);
+  } else {
+    td::actor::send_closure(client_, &adnl::AdnlExtClient::send_query, "download state",
+                            create_serialize_tl_object_suffix<ton_api::tonNode_query>(std::move(query)),
+                            td::Timestamp::in(3.0), std::move(P));
+  }
+}
+
+void DownloadState::download_parts() {
+  while (!end_known_ && parts_.size() < max_parts_in_flight()) {
+    parts_.emplace(next_offset_, Part{});
+    next_offset_ += part_size();
+  }
+  for (auto &it : parts_) {
+    auto &part = it.second;
+    if (part.in_flight || part.received || part.deferred) {
+      continue;
+    }
+    adnl::AdnlNodeIdShort node;
+    if (!choose_peer(node)) {
+      break;
+    }
+    download_part(it.first, node);
+  }
+}
+
+bool DownloadState::choose_peer(adnl::AdnlNodeIdShort &node) {
+  // peers without any answered part yet are rated as the best measured peer, so that they get a rate estimate
+  // without being preferred to everyone else
+  double best_rate = 0.0;
+  for (auto &it : peers_) {
+    best_rate = std::max(best_rate, it.second.rate());
+  }
+  if (best_rate == 0.0) {
+    best_rate = 1.0;
+  }
+
+  bool found = false;
+  double best_score = 0.0;
+  for (auto &it : peers_) {
+    auto &peer = it.second;
+    if (!peer.ready || peer.in_flight >= max_parts_per_peer()) {
+      continue;
+    }
+    double score = peer.received == 0 ? best_rate : peer.rate();
+    score /= (peer.in_flight + 1) * (peer.total_failures + 1);
+    if (!found || score > best_score) {
+      found = true;
+      best_score = score;
+      node = it.first;
+    }
+  }
+  return found;
+}
+
+void DownloadState::download_part(td::uint64 offset, adnl::AdnlNodeIdShort node) {
+  auto &part = parts_[offset];
+  part.in_flight = true;
+  part.attempts++;
+  peers_[node].in_flight++;
+
+  auto P = td::PromiseCreator::lambda([SelfId = actor_id(this), offset, node,
+                                       started_at = td::Time::now()](td::Result<td::BufferSlice> R) {
+    td::actor::send_closure(SelfId, &DownloadState::got_block_state_part, offset, node, started_at, std::move(R));
+  });
+
   td::BufferSlice query = create_serialize_tl_object<ton_api::tonNode_downloadPersistentStateSlice>(
-      create_tl_block_id(block_id_), create_tl_block_id(masterchain_block_id_), sum_, part_size);
+      create_tl_block_id(block_id_), create_tl_block_id(masterchain_block_id_), offset, part_size());
   if (client_.empty()) {
-    td::actor::send_closure(overlays_, &overlay::Overlays::send_query_via, download_from_, local_id_, overlay_id_,
-                            "download state", std::move(P), td::Timestamp::in(10.0), std::move(query),
+    td::actor::send_closure(overlays_, &overlay::Overlays::send_query_via, node, local_id_, overlay_id_,
+                            "download state", std::move(P), td::Timestamp::in(20.0), std::move(query),
                             FullNode::max_state_size(), rldp_);
   } else {
     td::actor::send_closure(client_, &adnl::AdnlExtClient::send_query, "download state",
                             create_serialize_tl_object_suffix<ton_api::tonNode_query>(std::move(query)),
-                            td::Timestamp::in(10.0), std::move(P));
+                            td::Timestamp::in(20.0), std::move(P));
+  }
+}
+
+void DownloadState::got_block_state_part(td::uint64 offset, adnl::AdnlNodeIdShort node, double started_at,
+                                         td::Result<td::BufferSlice> R) {
+  auto peer_it = peers_.find(node);
+  if (peer_it != peers_.end()) {
+    peer_it->second.in_flight--;
+  }
+  auto it = parts_.find(offset);
+  if (it == parts_.end()) {
+    // part lies past the end of the state
+    download_parts();
+    return;
+  }
+  auto &part = it->second;
+  part.in_flight = false;
+  if (R.is_ok() && R.ok().size() > part_size()) {
+    R = td::Status::Error(ErrorCode::protoviolation, "too big state part");
+  }
+
+  if (R.is_error()) {
+    VLOG(FULL_NODE_DEBUG) << "failed to download state " << block_id_ << " at offset " << offset << " from " << node
+                          << ": " << R.error();
+    if (it != parts_.begin()) {
+      part.deferred = true;
+      part.failed_by.push_back(node);
+    } else {
+      if (part.attempts >= max_part_attempts()) {
+        abort_query(R.move_as_error_prefix("failed to download state part: "));
+        return;
+      }
+      if (!peer_failed(node)) {
+        return;
+      }
+    }
+    download_parts();
+    return;
+  }
+
+  auto data = R.move_as_ok();
+  if (peer_it != peers_.end()) {
+    auto &peer = peer_it->second;
+    peer.failures = 0;
+    peer.received += data.size();
+    peer.busy_time += td::Time::now() - started_at;
+  }
+  if (data.size() < part_size()) {
+    end_known_ = true;
+    end_ = offset + data.size();
+    parts_.erase(std::next(it), parts_.end());
+  }
+  part.received = true;
+  part.data = std::move(data);
+  flush_parts();
+}
+
+bool DownloadState::peer_failed(adnl::AdnlNodeIdShort node) {
+  auto it = peers_.find(node);
+  if (it == peers_.end()) {
+    return true;
   }
+  auto &peer = it->second;
+  peer.total_failures++;
+  if (++peer.failures < max_peer_failures()) {
+    return true;
+  }
+  VLOG(FULL_NODE_DEBUG) << "dropping node " << node << " for state " << block_id_;
+  peers_.erase(it);
+  if (peers_.empty()) {
+    abort_query(td::Status::Error(ErrorCode::notready, "no nodes left"));
+    return false;
+  }
+  return true;
+}
+
+void DownloadState::flush_parts() {
+  while (!parts_.empty() && parts_.begin()->second.received) {
+    auto &data = parts_.begin()->second.data;
+    auto S = staging_.value().append(data.as_slice());
+    if (S.is_error()) {
+      // the file may end with a partly written part: start over next time
+      staging_.value().remove();
+      abort_query(S.move_as_error_prefix("failed to write staging file: "));
+      return;
+    }
+    sum_ += data.size();
+    parts_.erase(parts_.begin());
+  }
+  if (!parts_.empty()) {
+    // everything before the first missing part is written, so it is not past the end of the state
+    auto &first = parts_.begin()->second;
+    if (first.deferred) {
+      first.deferred = false;
+      first.attempts = 0;
+      auto failed_by = std::move(first.failed_by);
+      for (auto &node : failed_by) {
+        if (!peer_failed(node)) {
+          return;
+        }
+      }
+    }
+  }
+
+  double elapsed = prev_logged_timer_.elapsed();
+  if (elapsed > 10.0) {
+    prev_logged_timer_ = td::Timer();
+    LOG(INFO) << "downloading state " << block_id_ << ": total=" << sum_ << " ("
+              << double(sum_ - prev_logged_sum_) / elapsed << " B/s, " << peers_.size() << " nodes)";
+    prev_logged_sum_ = sum_;
+  }
+
+  if (end_known_ && parts_.empty()) {
+    CHECK(sum_ == end_);
+    auto R = staging_.value().finish();
+    if (R.is_error()) {
+      abort_query(R.move_as_error_prefix("failed to read staging file: "));
+      return;
+    }
+    got_block_state(R.move_as_ok());
+    return;
+  }
+  download_parts();
 }
 
 void DownloadState::got_block_state(td::BufferSlice data) {
   state_ = std::move(data);
-  LOG(INFO) << "finished downloading state " << block_id_ << ": total=" << sum_;
+  if (!staging_) {
+    sum_ = state_.size();
+  }
+  LOG(INFO) << "finished downloading state " << block_id_ << ": total=" << sum_ << " (resumed at " << resumed_from_
+            << ")";
   finish_query();
 }
 
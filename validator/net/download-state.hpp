@@ -23,6 +23,10 @@
 #include "validator/validator.h"
 #include "rldp/rldp.h"
 #include "adnl/adnl-ext-client.h"
+#include "td/utils/optional.h"
+#include "state-staging.hpp"
+
+#include <map>
 
 namespace ton {
 
@@ -32,12 +36,12 @@ namespace fullnode {
 
 class DownloadState : public td::actor::Actor {
  public:
-  DownloadState(BlockIdExt block_id, BlockIdExt masterchain_block_id, adnl::AdnlNodeIdShort local_id,
-                overlay::OverlayIdShort overlay_id, adnl::AdnlNodeIdShort download_from, td::uint32 priority,
-                td::Timestamp timeout, td::actor::ActorId<ValidatorManagerInterface> validator_manager,
-                td::actor::ActorId<rldp::Rldp> rldp, td::actor::ActorId<overlay::Overlays> overlays,
-                td::actor::ActorId<adnl::Adnl> adnl, td::actor::ActorId<adnl::AdnlExtClient> client,
-                td::Promise<td::BufferSlice> promise);
+  DownloadState(BlockIdExt block_id, BlockIdExt masterchain_block_id, std::string tmp_dir,
+                adnl::AdnlNodeIdShort local_id, overlay::OverlayIdShort overlay_id,
+                adnl::AdnlNodeIdShort download_from, td::uint32 priority, td::Timestamp timeout,
+                td::actor::ActorId<ValidatorManagerInterface> validator_manager, td::actor::ActorId<rldp::Rldp> rldp,
+                td::actor::ActorId<overlay::Overlays> overlays, td::actor::ActorId<adnl::Adnl> adnl,
+                td::actor::ActorId<adnl::AdnlExtClient> client, td::Promise<td::BufferSlice> promise);
 
   void abort_query(td::Status reason);
   void alarm() override;
@@ -45,14 +49,72 @@ class DownloadState : public td::actor::Actor {
 
   void start_up() override;
   void got_block_handle(BlockHandle handle);
+  void got_nodes_to_download(std::vector<adnl::AdnlNodeIdShort> nodes);
   void got_node_to_download(adnl::AdnlNodeIdShort node);
-  void got_block_state_description(td::BufferSlice data_description);
-  void got_block_state_part(td::BufferSlice data, td::uint32 requested_size);
+  void got_block_state_description(adnl::AdnlNodeIdShort node, td::Result<td::BufferSlice> R);
+  void got_block_state_part(td::uint64 offset, adnl::AdnlNodeIdShort node, double started_at,
+                            td::Result<td::BufferSlice> R);
   void got_block_state(td::BufferSlice data);
 
+  static constexpr td::uint32 part_size() {
+    return 1 << 18;
+  }
+  static constexpr td::uint32 max_peers() {
+    return 4;
+  }
+  static constexpr td::uint32 max_parts_in_flight() {
+    return 16;
+  }
+  static constexpr td::uint32 max_parts_per_peer() {
+    return 4;
+  }
+  static constexpr td::uint32 max_peer_failures() {
+    return 3;
+  }
+  static constexpr td::uint32 max_part_attempts() {
+    return 5;
+  }
+
  private:
+  struct Peer {
+    bool ready = false;
+    td::uint32 in_flight = 0;
+    // consecutive failures, the peer is dropped after max_peer_failures() of them
+    td::uint32 failures = 0;
+    // all failures, lower the priority of the peer
+    td::uint32 total_failures = 0;
+    td::uint64 received = 0;
+    double busy_time = 0.0;
+
+    double rate() const {
+      return busy_time > 0.0 ? static_cast<double>(received) / busy_time : 0.0;
+    }
+  };
+  struct Part {
+    bool in_flight = false;
+    bool received = false;
+    // failed while a part before it was still missing: may lie past the end of the state, retried once the
+    // preceding parts are written
+    bool deferred = false;
+    td::uint32 attempts = 0;
+    // peers that failed the part while it was deferred, charged once the part is known to exist
+    std::vector<adnl::AdnlNodeIdShort> failed_by;
+    td::BufferSlice data;
+  };
+
+  bool fixed_source() const {
+    return !download_from_.is_zero() || !client_.empty();
+  }
+  void download_parts();
+  bool choose_peer(adnl::AdnlNodeIdShort &node);
+  void download_part(td::uint64 offset, adnl::AdnlNodeIdShort node);
+  bool peer_failed(adnl::AdnlNodeIdShort node);
+  void flush_parts();
+  void download_zero_state(adnl::AdnlNodeIdShort node);
+
   BlockIdExt block_id_;
   BlockIdExt masterchain_block_id_;
+  std::string tmp_dir_;
   adnl::AdnlNodeIdShort local_id_;
   overlay::OverlayIdShort overlay_id_;
 
@@ -70,8 +132,18 @@ class DownloadState : public td::actor::Actor {
 
   BlockHandle handle_;
   td::BufferSlice state_;
-  std::vector<td::BufferSlice> parts_;
+
+  std::map<adnl::AdnlNodeIdShort, Peer> peers_;
+  bool zero_state_requested_ = false;
+
+  td::optional<StateStagingFile> staging_;
+  // parts in [sum_, next_offset_) that are not written to the staging file yet
+  std::map<td::uint64, Part> parts_;
+  td::uint64 next_offset_ = 0;
   td::uint64 sum_ = 0;
+  td::uint64 resumed_from_ = 0;
+  bool end_known_ = false;
+  td::uint64 end_ = 0;
 
   td::uint64 prev_logged_sum_ = 0;
   td::Timer prev_logged_timer_;
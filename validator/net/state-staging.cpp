@@ -0,0 +1,111 @@
+/*
+    This file is part of TON Blockchain Library.
+
+    TON Blockchain Library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    TON Blockchain Library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with TON Blockchain Library.  If not, see <http://www.gnu.org/licenses/>.
+
+    Copyright 2017-2020 Telegram Systems LLP
+*/
+#include "state-staging.hpp"
+#include "td/utils/filesystem.h"
+#include "td/utils/misc.h"
+#include "td/utils/port/Clocks.h"
+#include "td/utils/port/path.h"
+#include "td/utils/port/Stat.h"
+
+namespace ton {
+
+namespace validator {
+
+namespace fullnode {
+
+td::Result<StateStagingFile> StateStagingFile::open(std::string tmp_dir, BlockIdExt block_id,
+                                                    BlockIdExt masterchain_block_id) {
+  remove_stale(tmp_dir, block_id, masterchain_block_id);
+  std::string name = PSTRING() << tmp_dir << "state_" << block_id.file_hash.to_hex() << "_"
+                               << masterchain_block_id.seqno();
+  TRY_RESULT(fd, td::FileFd::open(name, td::FileFd::Read | td::FileFd::Write | td::FileFd::Create));
+  TRY_RESULT(size, fd.get_size());
+  return StateStagingFile(std::move(name), std::move(fd), static_cast<td::uint64>(size));
+}
+
+void StateStagingFile::remove_stale(const std::string &tmp_dir, BlockIdExt block_id,
+                                    BlockIdExt masterchain_block_id) {
+  std::string prefix = PSTRING() << "state_" << block_id.file_hash.to_hex() << "_";
+  auto expire_at = td::Clocks::system() - max_idle_time();
+  bool root = true;
+  td::WalkPath::run(tmp_dir, [&](td::CSlice path, td::WalkPath::Type t) -> td::WalkPath::Action {
+    if (t == td::WalkPath::Type::EnterDir) {
+      // staging files are created right in tmp_dir
+      if (!root) {
+        return td::WalkPath::Action::SkipDir;
+      }
+      root = false;
+      return td::WalkPath::Action::Continue;
+    }
+    if (t != td::WalkPath::Type::NotDir) {
+      return td::WalkPath::Action::Continue;
+    }
+    td::Slice fname = path;
+    auto pos = fname.rfind('/');
+    if (pos != td::Slice::npos) {
+      fname.remove_prefix(pos + 1);
+    }
+    if (!td::begins_with(fname, "state_")) {
+      return td::WalkPath::Action::Continue;
+    }
+    bool stale = false;
+    if (td::begins_with(fname, prefix)) {
+      auto r_seqno = td::to_integer_safe<BlockSeqno>(fname.substr(prefix.size()));
+      stale = r_seqno.is_ok() && r_seqno.ok() < masterchain_block_id.seqno();
+    }
+    if (!stale) {
+      auto r_stat = td::stat(path);
+      stale = r_stat.is_ok() && static_cast<double>(r_stat.ok().mtime_nsec_) * 1e-9 < expire_at;
+    }
+    if (stale) {
+      LOG(INFO) << "removing stale state staging file " << path;
+      td::unlink(path).ignore();
+    }
+    return td::WalkPath::Action::Continue;
+  }).ignore();
+}
+
+td::Status StateStagingFile::append(td::Slice data) {
+  TRY_RESULT(written, fd_.pwrite(data, size_));
+  if (written != data.size()) {
+    return td::Status::Error("short write");
+  }
+  size_ += data.size();
+  return td::Status::OK();
+}
+
+td::Result<td::BufferSlice> StateStagingFile::finish() {
+  fd_.close();
+  auto R = td::read_file(name_);
+  remove();
+  return R;
+}
+
+void StateStagingFile::remove() {
+  if (!fd_.empty()) {
+    fd_.close();
+  }
+  td::unlink(name_).ignore();
+}
+
+}  // namespace fullnode
+
+}  // namespace validator
+
+}  // namespace ton
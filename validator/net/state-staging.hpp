@@ -0,0 +1,73 @@
+/*
+    This file is part of TON Blockchain Library.
+
+    TON Blockchain Library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    TON Blockchain Library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with TON Blockchain Library.  If not, see <http://www.gnu.org/licenses/>.
+
+    Copyright 2017-2020 Telegram Systems LLP
+*/
+#pragma once
+
+#include "ton/ton-types.h"
+#include "td/utils/buffer.h"
+#include "td/utils/port/FileFd.h"
+
+namespace ton {
+
+namespace validator {
+
+namespace fullnode {
+
+// persistent state being downloaded, written in order to <tmp_dir>state_<file_hash>_<mc_seqno>
+// the file outlives an aborted download, so that the next attempt continues from its end
+class StateStagingFile {
+ public:
+  // staging files not touched for this long belong to downloads that were given up
+  static constexpr double max_idle_time() {
+    return 86400.0;
+  }
+
+  // opens the staging file of the state, creating it if needed; removes staging files of the same state for
+  // older masterchain blocks and expired staging files
+  static td::Result<StateStagingFile> open(std::string tmp_dir, BlockIdExt block_id, BlockIdExt masterchain_block_id);
+
+  const std::string &name() const {
+    return name_;
+  }
+  td::uint64 size() const {
+    return size_;
+  }
+
+  td::Status append(td::Slice data);
+  // reads the downloaded state and removes the file
+  td::Result<td::BufferSlice> finish();
+  // removes the file, e.g. when its contents can't be trusted
+  void remove();
+
+ private:
+  StateStagingFile(std::string name, td::FileFd fd, td::uint64 size)
+      : name_(std::move(name)), fd_(std::move(fd)), size_(size) {
+  }
+
+  static void remove_stale(const std::string &tmp_dir, BlockIdExt block_id, BlockIdExt masterchain_block_id);
+
+  std::string name_;
+  td::FileFd fd_;
+  td::uint64 size_ = 0;
+};
+
+}  // namespace fullnode
+
+}  // namespace validator
+
+}  // namespace ton
@@ -129,8 +129,9 @@ class ValidatorManagerInterface : public td::actor::Actor {
                                 td::Promise<ReceivedBlock> promise) = 0;
     virtual void download_zero_state(BlockIdExt block_id, td::uint32 priority, td::Timestamp timeout,
                                      td::Promise<td::BufferSlice> promise) = 0;
-    virtual void download_persistent_state(BlockIdExt block_id, BlockIdExt masterchain_block_id, td::uint32 priority,
-                                           td::Timestamp timeout, td::Promise<td::BufferSlice> promise) = 0;
+    virtual void download_persistent_state(BlockIdExt block_id, BlockIdExt masterchain_block_id, std::string tmp_dir,
+                                           td::uint32 priority, td::Timestamp timeout,
+                                           td::Promise<td::BufferSlice> promise) = 0;
     virtual void download_block_proof(BlockIdExt block_id, td::uint32 priority, td::Timestamp timeout,
                                       td::Promise<td::BufferSlice> promise) = 0;
     virtual void download_block_proof_link(BlockIdExt block_id, td::uint32 priority, td::Timestamp timeout,